@@ -40,7 +40,7 @@
  *   
  */
 #define BUTTONS_CONFIGURATIONS                                                     \
-  BUTTON_CONFIG(BUTTON_0, GPIO_NUM_4, GPIO_PULLDOWN_ONLY, GPIO_INTR_POSEDGE, 800u)    
+  BUTTON_CONFIG(BUTTON_0, GPIO_NUM_4, GPIO_PULLDOWN_ONLY, GPIO_INTR_ANYEDGE, 20u)
 
 /***************************************************************************************
  * Data Type Definitions
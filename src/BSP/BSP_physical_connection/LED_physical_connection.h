@@ -35,13 +35,29 @@
  *   6) Channel of the timer that will control the LED. It is mandatory to use 
  *      ledc_channel_t enumerate -> ledc_channel_t.
  *   7) Resolution in bits of the PWM duty cycle. It is mandatory to use ledc_timer_bit_t
- *      enumerate -> ledc_types.h.
- *   8) Frequency in Hertz of the PWM that controls the LED.
+ *      enumerate -> ledc_types.h or LED_PWM_RESOLUTION_AUTO. With 
+ *      LED_PWM_RESOLUTION_AUTO the highest resolution that the clock source can reach
+ *      at the given frequency is chosen.
+ *   8) Frequency in Hertz of the PWM that controls the LED or LED_PWM_FREQUENCY_AUTO. 
+ *      With LED_PWM_FREQUENCY_AUTO the highest frequency that the clock source can 
+ *      reach at the given resolution is chosen, it can not be lower than 
+ *      LED_PWM_MIN_FREQUENCY_HZ.
+ *   9) Clock source of the timer. It is mandatory to use ledc_clk_cfg_t enumerate
+ *      -> ledc_types.h.
  *   
+ *   LEDs that share a timer must end up with the same resolution and frequency. The
+ *   chosen values can be read with get_LED_PWM_config (LED.h).
  */
 #define LED_CONFIGURATIONS                                                         \
   LED_CONFIG(LED_0, GPIO_NUM_20, GPIO_FLOATING, LEDC_TIMER_0, LEDC_LOW_SPEED_MODE, \
-             LEDC_CHANNEL_0, LEDC_TIMER_13_BIT, 4000u)     
+             LEDC_CHANNEL_0, LED_PWM_RESOLUTION_AUTO, 4000u, LEDC_USE_APB_CLK)     
+
+/* Values to let the BSP choose the resolution or the frequency of a LED PWM. */
+#define LED_PWM_RESOLUTION_AUTO ((ledc_timer_bit_t)0)
+#define LED_PWM_FREQUENCY_AUTO  0u
+
+/* Minimum frequency in Hertz of the PWMs to avoid visible flicker. */
+#define LED_PWM_MIN_FREQUENCY_HZ 1000u
 
 #endif /* LED_PHYSICAL_CONNECTION_H_ */
   
\ No newline at end of file
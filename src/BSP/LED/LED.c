@@ -11,6 +11,12 @@
  ***************************************************************************************/
 #include <LED.h>
 #include <Debug.h>
+#include <esp_cpu.h>
+#include <esp_rom_sys.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <esp_timer.h>
+#include <soc/soc_caps.h>
 
 /***************************************************************************************
  * Defines
@@ -28,6 +34,20 @@
   #define TAG "BSP_BUTTON"
 #endif
 
+/* Frequency in Hertz of the clock sources of the LEDC timers. */
+#define LEDC_APB_CLK_HZ      80000000ul
+#define LEDC_REF_TICK_CLK_HZ 1000000ul
+#define LEDC_RC_FAST_CLK_HZ  8000000ul
+
+/* Maximum resolution in bits and maximum integer divider of the LEDC timers. */
+#define LEDC_TIMER_MAX_RESOLUTION SOC_LEDC_TIMER_BIT_WIDTH
+#define LEDC_TIMER_MAX_DIVIDER    1023u
+
+#if LED_DITHERING_ENABLE == 1
+  /* Value of a whole duty step in the dithering fractions. */
+  #define DITHER_ONE_STEP (1ul << LED_DITHER_FRACTION_BITS)
+#endif
+
 /***************************************************************************************
  * Data Type Definitions
  ***************************************************************************************/
@@ -49,8 +69,27 @@ typedef struct
    * LED. 
    */
   ledc_channel_config_t ledc_channel;
+  /* Duty cycle in steps that will be applied in the next commit. */
+  uint32_t staged_duty;
 } system_LED_info;
 
+#if LED_DITHERING_ENABLE == 1
+
+/* Structure that contains the dithering state of a LED. */
+typedef struct
+{
+  /* Integer part of the duty cycle in steps. */
+  uint32_t duty;
+  /* Fraction of step to reproduce, in 1/DITHER_ONE_STEP units. */
+  uint32_t fraction;
+  /* Accumulated fraction, a step is added to the duty every time it overflows. */
+  uint32_t accumulator;
+  /* Duty cycle in steps written in the channel. */
+  uint32_t applied_duty;
+} LED_dither_state;
+
+#endif
+
 /***************************************************************************************
  * Global Variables
  ***************************************************************************************/
@@ -62,7 +101,7 @@ static bool LED_module_was_initialized;
 static system_LED_info system_LEDs_infos[NUM_OF_LEDS] =
 {
   #define LED_CONFIG(LED_ID, LED_GPIO_ID, LED_GPIO_PULL_MODE, LED_TIMER, PWM_SPEED, \
-                     PWM_CHAN, PWM_RESOL, PWM_FREQ)                                 \
+                     PWM_CHAN, PWM_RESOL, PWM_FREQ, PWM_CLK)                        \
     {                                                                               \
       /* LED ID */                 LED_ID,                                          \
       /* Was initialized */        false,                                           \
@@ -74,7 +113,7 @@ static system_LED_info system_LEDs_infos[NUM_OF_LEDS] =
                                    .timer_num        = LED_TIMER,                   \
                                    .duty_resolution  = PWM_RESOL,                   \
                                    .freq_hz          = PWM_FREQ,                    \
-                                   .clk_cfg          = LEDC_AUTO_CLK,               \
+                                   .clk_cfg          = PWM_CLK,                     \
       },                                                                            \
       /* Timer configuration */                                                     \
       {                                                                             \
@@ -86,11 +125,57 @@ static system_LED_info system_LEDs_infos[NUM_OF_LEDS] =
                                    .duty             = 0,                           \
                                    .hpoint           = 0,                           \
       },                                                                            \
+      /* Staged duty cycle */      0u,                                              \
     },                                                                        
     LED_CONFIGURATIONS
   #undef LED_CONFIG
 };
 
+/* Mask of the LEDs that have a staged duty cycle. */
+static uint32_t staged_LEDs;
+
+/* Spinlock that protects the staged duty cycles. */
+static portMUX_TYPE staged_LEDs_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Spinlock that keeps the latch of the channels free of interruptions. */
+static portMUX_TYPE latch_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Latch window measured in the commits of the staged duty cycles. */
+static LED_latch_window latch_window;
+
+#if LED_DITHERING_ENABLE == 1
+
+/* Array that contains the dithering state of all the system LEDs. */
+static LED_dither_state dither_states[NUM_OF_LEDS];
+
+/* Mask of the LEDs that are being dithered. */
+static uint32_t dithered_LEDs;
+
+/* Spinlock that protects the dithering states. */
+static portMUX_TYPE dither_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Timer that executes the dithering tick and mutex that serializes its start and stop. */
+static esp_timer_handle_t dither_timer;
+static SemaphoreHandle_t dither_timer_mutex;
+static StaticSemaphore_t dither_timer_mutex_buffer;
+
+/* Measured cost of the dithering tick. */
+static LED_dither_stats dither_stats;
+
+/* State of the pseudo random sequence that chooses the starting phase of the 
+ * dithering of each LED, it must never be 0.
+ */
+static uint16_t dither_noise = 0xACE1u;
+
+#endif
+
+/* Mutex that serializes the commits of the staged duty cycles. */
+static SemaphoreHandle_t commit_mutex;
+static StaticSemaphore_t commit_mutex_buffer;
+
+/* The staged LEDs mask stores one bit per LED. */
+_Static_assert(NUM_OF_LEDS <= 32u, "LEDS does not fit in the staged LEDs mask");
+
 /***************************************************************************************
  * Functions Prototypes
  ***************************************************************************************/
@@ -100,7 +185,8 @@ static system_LED_info system_LEDs_infos[NUM_OF_LEDS] =
  *        LED_CONFIGURATIONS macro (LED_physical_connection.h) list
  *        is correct. Also, as it needs to loop each button configuration,
  *        it sort them to avoid inncessary complexity cost in the rest of
- *        the module function.
+ *        the module function. It also chooses the automatic PWM resolutions
+ *        and frequencies.
  *
  * @param void
  *
@@ -132,6 +218,118 @@ static bool check_LED_ID(const LED_ID ID);
 static bool cacl_pwm_duty(const LED_ID ID, const uint8_t dutyPercentage, 
   uint32_t *dutyInSteps);
 
+/**
+ * @brief Gets the frequency of a clock source of the LEDC timers.
+ *
+ * @param clock Clock source.
+ * 
+ * @param freq_hz Return frequency in Hertz of the clock source.
+ * 
+ * @return True if the clock source is supported, otherwise false.
+ */
+static bool get_clock_source_freq(const ledc_clk_cfg_t clock, uint32_t *freq_hz);
+
+/**
+ * @brief Chooses the PWM resolution or frequency that are set to auto and checks that
+ *        the timer divider can reach the result. With an automatic resolution it picks 
+ *        the highest one at the given frequency, with an automatic frequency the highest
+ *        one at the given resolution.
+ *
+ * @param clock_hz Frequency in Hertz of the timer clock source.
+ * 
+ * @param freq_hz Frequency in Hertz of the PWM or LED_PWM_FREQUENCY_AUTO. It returns
+ *                the chosen frequency.
+ * 
+ * @param resolution Resolution of the PWM or LED_PWM_RESOLUTION_AUTO. It returns the 
+ *                   chosen resolution.
+ * 
+ * @return True if the PWM can be generated, otherwise false.
+ */
+static bool solve_pwm_config(const uint32_t clock_hz, uint32_t *freq_hz, 
+  ledc_timer_bit_t *resolution);
+
+/**
+ * @brief Stores a duty cycle in terms of steps to be applied in the next commit.
+ *
+ * @param ID Identifier of the LED.
+ * 
+ * @param dutyInSteps Duty cycle in terms of steps.
+ * 
+ * @return void
+ */
+static void stage_duty(const LED_ID ID, const uint32_t dutyInSteps);
+
+#if LED_PHASE_STAGGER_ENABLE == 1
+
+/**
+ * @brief Spreads the on-times of the channels of each timer along the PWM period. The
+ *        channels are placed from the longest to the shortest duty cycle, each one in
+ *        the first lane of the period where it fits after the channels already placed,
+ *        so on-times only overlap when they do not fit in a single period.
+ *
+ * @param duties Duty cycles in steps of all the LEDs.
+ * 
+ * @param hpoints Return hpoints of all the LEDs. LEDs that are off keep their value.
+ * 
+ * @return void
+ */
+static void stagger_hpoints(const uint32_t *duties, uint32_t *hpoints);
+
+#endif
+
+/**
+ * @brief Models the number of channels of a timer that are on along the PWM period. It
+ *        does not access the hardware.
+ *
+ * @param channels Mask of the LEDs that belong to the timer.
+ * 
+ * @param duties Duty cycles in steps of all the LEDs.
+ * 
+ * @param hpoints Hpoints of all the LEDs.
+ * 
+ * @param period Steps of the PWM period of the timer.
+ * 
+ * @param on_time_permille Return part of the period, in per mille, in which N channels
+ *                         are on. It must have NUM_OF_LEDS + 1 elements.
+ * 
+ * @return Maximum number of channels that are on at the same time.
+ */
+static uint8_t model_phase_profile(const uint32_t channels, const uint32_t *duties, 
+  const uint32_t *hpoints, const uint32_t period, uint16_t *on_time_permille);
+
+#if LED_DITHERING_ENABLE == 1
+
+/**
+ * @brief Stops dithering a LED, so other function can set its duty cycle.
+ *
+ * @param ID Identifier of the LED.
+ * 
+ * @return void
+ */
+static void cancel_dithering(const LED_ID ID);
+
+/**
+ * @brief Starts the dithering timer if there are LEDs to dither, otherwise it stops it.
+ *
+ * @param void
+ * 
+ * @return void
+ */
+static void update_dither_timer(void);
+
+/**
+ * @brief Tick of the dithering, it applies the next duty cycle of the dithered LEDs and
+ *        measures its own cost. The channels are written with the commit mutex taken,
+ *        so the tick and the commits do not interleave their writes.
+ *
+ * @param args arguments to pass to the function.
+ * 
+ * @return void
+ */
+static void dither_tick(void *args);
+
+#endif
+
 /***************************************************************************************
  * Functions
  ***************************************************************************************/
@@ -145,6 +343,26 @@ LED_return init_BSP_LED_module(void)
      {
        return BSP_LED_INVALID_LEDS_CONFIG;
      }
+
+     commit_mutex = xSemaphoreCreateMutexStatic(&commit_mutex_buffer);
+
+     #if LED_DITHERING_ENABLE == 1
+       const esp_timer_create_args_t dither_timer_args =
+       {
+         .callback = dither_tick,
+         .arg = NULL,
+         .dispatch_method = ESP_TIMER_TASK,
+         .name = "LED_dither",
+         .skip_unhandled_events = true,
+       };
+
+       dither_timer_mutex = xSemaphoreCreateMutexStatic(&dither_timer_mutex_buffer);
+       if(ESP_error_check(esp_timer_create(&dither_timer_args, &dither_timer)) != ESP_OK)
+       {
+         return BSP_LED_MODULE_INIT_ERR;
+       }
+       dither_stats.period_us = LED_DITHER_PERIOD_US;
+     #endif
  
      LED_module_was_initialized = true;
    }
@@ -152,6 +370,63 @@ LED_return init_BSP_LED_module(void)
    return BSP_LED_OK;
 }
 
+LED_return set_LED_connection(const LED_ID ID, const LED_connection *connection)
+{
+  if(LED_module_was_initialized)
+  {
+    return BSP_LED_MODULE_WAS_INIT_ERR;
+  }
+
+  /* The LEDs are sorted by identifier when the module is initialized. */
+  for(LED_ID i = 0u; i < NUM_OF_LEDS; i++)
+  {
+    system_LED_info *info = &system_LEDs_infos[i];
+    if(info->ID == ID)
+    {
+      info->GPIO = connection->GPIO;
+      info->pull_mode = connection->pull_mode;
+      info->ledc_timer.speed_mode = connection->speed_mode;
+      info->ledc_timer.timer_num = connection->timer;
+      info->ledc_timer.duty_resolution = connection->resolution;
+      info->ledc_timer.freq_hz = connection->freq_hz;
+      info->ledc_timer.clk_cfg = connection->clock;
+      info->ledc_channel.speed_mode = connection->speed_mode;
+      info->ledc_channel.channel = connection->channel;
+      info->ledc_channel.timer_sel = connection->timer;
+      info->ledc_channel.gpio_num = connection->GPIO;
+      return BSP_LED_OK;
+    }
+  }
+
+  return BSP_LED_DOES_NOT_EXIST_ERR;
+}
+
+LED_return check_LED_connection(const LED_connection *connection, uint32_t *freq_hz, 
+  ledc_timer_bit_t *resolution)
+{
+  uint32_t clock_hz = 0u;
+  uint32_t freq = connection->freq_hz;
+  ledc_timer_bit_t bits = connection->resolution;
+
+  if(!get_clock_source_freq(connection->clock, &clock_hz) ||
+     !solve_pwm_config(clock_hz, &freq, &bits))
+  {
+    return BSP_LED_INVALID_LEDS_CONFIG;
+  }
+
+  if(freq_hz != NULL)
+  {
+    *freq_hz = freq;
+  }
+
+  if(resolution != NULL)
+  {
+    *resolution = bits;
+  }
+
+  return BSP_LED_OK;
+}
+
 LED_return init_LED(const LED_ID ID)
 {
   CHECK_IF_MODULE_WAS_INTIALIZED;
@@ -220,6 +495,54 @@ LED_return de_init_LED(const LED_ID ID)
 }
 
 LED_return set_LED_state(const LED_ID ID, const uint8_t duty_cycle)
+{
+
+  const LED_return ret = stage_LED_state(ID, duty_cycle);
+  if(ret != BSP_LED_OK)
+  {
+    return ret;
+  }
+
+  return commit_LED_states();
+}
+
+LED_return turn_off_LED(const LED_ID ID)
+{
+
+  const LED_return ret = stage_turn_off_LED(ID);
+  if(ret != BSP_LED_OK)
+  {
+    return ret;
+  }
+
+  return commit_LED_states();
+}
+
+LED_return get_LED_PWM_config(const LED_ID ID, uint32_t *freq_hz, 
+  uint8_t *resolution_bits)
+{
+
+  CHECK_IF_MODULE_WAS_INTIALIZED;
+
+  if(!check_LED_ID(ID))
+  {
+    return BSP_LED_DOES_NOT_EXIST_ERR;
+  }
+
+  if(freq_hz != NULL)
+  {
+    *freq_hz = system_LEDs_infos[ID].ledc_timer.freq_hz;
+  }
+
+  if(resolution_bits != NULL)
+  {
+    *resolution_bits = (uint8_t)system_LEDs_infos[ID].ledc_timer.duty_resolution;
+  }
+
+  return BSP_LED_OK;
+}
+
+LED_return stage_LED_state(const LED_ID ID, const uint8_t duty_cycle)
 {
 
   CHECK_IF_MODULE_WAS_INTIALIZED;
@@ -236,50 +559,290 @@ LED_return set_LED_state(const LED_ID ID, const uint8_t duty_cycle)
     return BSP_LED_DOES_NOT_EXIST_ERR;
   }
 
-  /* Set duty cycle. */
-  if(ESP_error_check(ledc_set_duty(system_LEDs_infos[ID].ledc_timer.speed_mode, 
-      system_LEDs_infos[ID].ledc_channel.channel, dutyCycle)) != ESP_OK)
+  stage_duty(ID, dutyCycle);
+
+  return BSP_LED_OK;
+}
+
+LED_return stage_turn_off_LED(const LED_ID ID)
+{
+
+  CHECK_IF_MODULE_WAS_INTIALIZED;
+
+  if(!check_LED_ID(ID))
   {
-    return BSP_LED_SET_LED_STATE_ERR;
+    return BSP_LED_DOES_NOT_EXIST_ERR;
   }
 
-  /* Update duty to apply the new value. */
-  if(ESP_error_check(ledc_update_duty(system_LEDs_infos[ID].ledc_timer.speed_mode, 
-       system_LEDs_infos[ID].ledc_channel.channel)) != ESP_OK)
+  stage_duty(ID, 0u);
+
+  return BSP_LED_OK;
+}
+
+LED_return commit_LED_states(void)
+{
+
+  CHECK_IF_MODULE_WAS_INTIALIZED;
+
+  uint32_t duties[NUM_OF_LEDS];
+  uint32_t hpoints[NUM_OF_LEDS];
+  uint32_t LEDs;
+  uint32_t pending;
+
+  if(xSemaphoreTake(commit_mutex, portMAX_DELAY) != pdTRUE)
   {
     return BSP_LED_SET_LED_STATE_ERR;
   }
 
-  return BSP_LED_OK;
+  /* Start from the applied state of all the channels. */
+  for(LED_ID ID = 0u; ID < NUM_OF_LEDS; ID++)
+  {
+    duties[ID] = system_LEDs_infos[ID].ledc_channel.duty;
+    hpoints[ID] = (uint32_t)system_LEDs_infos[ID].ledc_channel.hpoint;
+  }
+
+  /* Take the staged duty cycles, new stages will go to the next commit. */
+  portENTER_CRITICAL(&staged_LEDs_lock);
+  LEDs = staged_LEDs;
+  staged_LEDs = 0u;
+  pending = LEDs;
+  while(pending != 0u)
+  {
+    const LED_ID ID = (LED_ID)__builtin_ctzl(pending);
+    pending &= pending - 1u;
+    duties[ID] = system_LEDs_infos[ID].staged_duty;
+  }
+  portEXIT_CRITICAL(&staged_LEDs_lock);
+
+  if(LEDs == 0u)
+  {
+    xSemaphoreGive(commit_mutex);
+    return BSP_LED_OK;
+  }
+
+  #if LED_PHASE_STAGGER_ENABLE == 1
+    /* The new duties move the on-times of the other channels of the same timers. */
+    stagger_hpoints(duties, hpoints);
+    for(LED_ID ID = 0u; ID < NUM_OF_LEDS; ID++)
+    {
+      if(hpoints[ID] != (uint32_t)system_LEDs_infos[ID].ledc_channel.hpoint)
+      {
+        LEDs |= (1ul << ID);
+      }
+    }
+  #endif
+
+  LED_return ret = BSP_LED_OK;
+
+  /* First phase, write the duty registers. Nothing changes until they are latched. */
+  pending = LEDs;
+  while(pending != 0u)
+  {
+    const LED_ID ID = (LED_ID)__builtin_ctzl(pending);
+    pending &= pending - 1u;
+
+    if(ESP_error_check(ledc_set_duty_with_hpoint(
+        system_LEDs_infos[ID].ledc_timer.speed_mode, 
+        system_LEDs_infos[ID].ledc_channel.channel, duties[ID], hpoints[ID])) != ESP_OK)
+    {
+      ret = BSP_LED_SET_LED_STATE_ERR;
+    }
+  }
+
+  /* Second phase, latch all the channels back to back. Errors are checked outside of
+   * the critical section as they may print traces.
+   */
+  esp_err_t latch_err = ESP_OK;
+  esp_cpu_cycle_count_t first_latch;
+  esp_cpu_cycle_count_t last_latch;
+
+  /* The window goes from the start of the first latch to the end of the last one. */
+  pending = LEDs;
+  portENTER_CRITICAL(&latch_lock);
+  first_latch = esp_cpu_get_cycle_count();
+  while(pending != 0u)
+  {
+    const LED_ID ID = (LED_ID)__builtin_ctzl(pending);
+    pending &= pending - 1u;
+
+    const esp_err_t err = ledc_update_duty(system_LEDs_infos[ID].ledc_timer.speed_mode,
+                            system_LEDs_infos[ID].ledc_channel.channel);
+    if(err != ESP_OK)
+    {
+      latch_err = err;
+    }
+  }
+  last_latch = esp_cpu_get_cycle_count();
+  portEXIT_CRITICAL(&latch_lock);
+
+  if(ESP_error_check(latch_err) != ESP_OK)
+  {
+    ret = BSP_LED_SET_LED_STATE_ERR;
+  }
+
+  /* Keep the applied state. */
+  pending = LEDs;
+  while(pending != 0u)
+  {
+    const LED_ID ID = (LED_ID)__builtin_ctzl(pending);
+    pending &= pending - 1u;
+    system_LEDs_infos[ID].ledc_channel.duty = duties[ID];
+    system_LEDs_infos[ID].ledc_channel.hpoint = (int)hpoints[ID];
+  }
+
+  #if LED_DITHERING_ENABLE == 1
+    /* The staggered channels can be dithered ones, they hold the integer part of their
+     * duty now, so the tick must know it to write the next step.
+     */
+    portENTER_CRITICAL(&dither_lock);
+    pending = LEDs & dithered_LEDs;
+    while(pending != 0u)
+    {
+      const LED_ID ID = (LED_ID)__builtin_ctzl(pending);
+      pending &= pending - 1u;
+      dither_states[ID].applied_duty = duties[ID];
+    }
+    portEXIT_CRITICAL(&dither_lock);
+  #endif
+
+  /* Update the latch window measurements. */
+  const uint32_t window = (uint32_t)(last_latch - first_latch);
+  latch_window.commits++;
+  latch_window.last_window_cycles = window;
+  if(window > latch_window.max_window_cycles)
+  {
+    latch_window.max_window_cycles = window;
+    latch_window.max_window_ns = (window * 1000u) / esp_rom_get_cpu_ticks_per_us();
+  }
+
+  xSemaphoreGive(commit_mutex);
+
+  return ret;
 }
 
-LED_return turn_off_LED(const LED_ID ID)
+void get_LED_latch_window(LED_latch_window *window)
+{
+  /* The measurements are updated by the commits with the mutex taken. */
+  if(window != NULL && LED_module_was_initialized && 
+     xSemaphoreTake(commit_mutex, portMAX_DELAY) == pdTRUE)
+  {
+    *window = latch_window;
+    xSemaphoreGive(commit_mutex);
+  }
+}
+
+LED_return get_LED_phase_profile(const ledc_mode_t speed_mode, const ledc_timer_t timer,
+  LED_phase_profile *profile)
 {
 
   CHECK_IF_MODULE_WAS_INTIALIZED;
 
-  if(!check_LED_ID(ID))
+  if(profile == NULL)
   {
     return BSP_LED_DOES_NOT_EXIST_ERR;
   }
 
-  /* Set duty cycle. */
-  if(ESP_error_check(ledc_set_duty(system_LEDs_infos[ID].ledc_timer.speed_mode, 
-      system_LEDs_infos[ID].ledc_channel.channel, 0u)) != ESP_OK)
+  uint32_t duties[NUM_OF_LEDS];
+  uint32_t hpoints[NUM_OF_LEDS];
+  uint32_t aligned_hpoints[NUM_OF_LEDS] = {0u};
+  uint32_t channels = 0u;
+  uint32_t period = 0u;
+
+  if(xSemaphoreTake(commit_mutex, portMAX_DELAY) != pdTRUE)
   {
     return BSP_LED_SET_LED_STATE_ERR;
   }
+  for(LED_ID ID = 0u; ID < NUM_OF_LEDS; ID++)
+  {
+    duties[ID] = system_LEDs_infos[ID].ledc_channel.duty;
+    hpoints[ID] = (uint32_t)system_LEDs_infos[ID].ledc_channel.hpoint;
+    if(system_LEDs_infos[ID].ledc_timer.speed_mode == speed_mode &&
+       system_LEDs_infos[ID].ledc_timer.timer_num == timer)
+    {
+      channels |= (1ul << ID);
+      period = 1ul << system_LEDs_infos[ID].ledc_timer.duty_resolution;
+    }
+  }
+  xSemaphoreGive(commit_mutex);
 
-  /* Update duty to apply the new value. */
-  if(ESP_error_check(ledc_update_duty(system_LEDs_infos[ID].ledc_timer.speed_mode, 
-       system_LEDs_infos[ID].ledc_channel.channel)) != ESP_OK)
+  if(channels == 0u)
   {
-    return BSP_LED_SET_LED_STATE_ERR;
+    return BSP_LED_DOES_NOT_EXIST_ERR;
+  }
+
+  profile->peak_channels = model_phase_profile(channels, duties, hpoints, period, 
+                             profile->on_time_permille);
+
+  uint16_t aligned_on_time[NUM_OF_LEDS + 1u];
+  profile->aligned_peak_channels = model_phase_profile(channels, duties, aligned_hpoints,
+                                     period, aligned_on_time);
+
+  return BSP_LED_OK;
+}
+
+#if LED_DITHERING_ENABLE == 1
+
+LED_return set_LED_level(const LED_ID ID, const uint16_t level)
+{
+
+  CHECK_IF_MODULE_WAS_INTIALIZED;
+
+  if(!check_LED_ID(ID))
+  {
+    return BSP_LED_DOES_NOT_EXIST_ERR;
   }
 
+  /* Full scale in steps, limited by the maximum duty cycle. */
+  const uint64_t full_scale = 
+    (((1ull << system_LEDs_infos[ID].ledc_timer.duty_resolution) - 1ull) * 
+      MAX_DUTY_CYCLE_PERC) / 100ull;
+
+  /* Duty cycle in steps with 16 bits of fraction. */
+  const uint64_t duty = (uint64_t)level * full_scale;
+
+  const uint32_t integer = (uint32_t)(duty >> 16u);
+  const uint32_t fraction = (uint32_t)(duty >> (16u - LED_DITHER_FRACTION_BITS)) & 
+                              (DITHER_ONE_STEP - 1u);
+
+  /* Apply the integer part as any other duty cycle, the tick will add the fraction. */
+  stage_duty(ID, integer);
+  const LED_return ret = commit_LED_states();
+  if(ret != BSP_LED_OK || fraction == 0u)
+  {
+    return ret;
+  }
+
+  LED_dither_state *state = &dither_states[ID];
+  portENTER_CRITICAL(&dither_lock);
+  state->duty = integer;
+  state->fraction = fraction;
+  /* Start each LED in a random phase of its pattern, so LEDs with the same fraction 
+   * do not add their extra steps in the same ticks. Next value of a 16 bits Galois 
+   * LFSR.
+   */
+  dither_noise = (dither_noise >> 1u) ^ ((dither_noise & 1u) ? 0xB400u : 0u);
+  state->accumulator = dither_noise & (DITHER_ONE_STEP - 1u);
+  state->applied_duty = integer;
+  dithered_LEDs |= (1ul << ID);
+  portEXIT_CRITICAL(&dither_lock);
+
+  update_dither_timer();
+
   return BSP_LED_OK;
 }
 
+void get_LED_dither_stats(LED_dither_stats *stats)
+{
+  if(stats != NULL)
+  {
+    portENTER_CRITICAL(&dither_lock);
+    *stats = dither_stats;
+    portEXIT_CRITICAL(&dither_lock);
+  }
+}
+
+#endif
+
 inline LED_return BSP_LED_LOG(const LED_return ret)
 {
   #if DEBUG_MODE_ENABLE == 1
@@ -335,12 +898,39 @@ static bool check_configurations_sort(void)
       default: 
         return false;
     }
+
+    /* Choose the automatic PWM values and check that the clock source reaches them. */
+    uint32_t clock_hz = 0u;
+    if(!get_clock_source_freq(system_LEDs_infos[i].ledc_timer.clk_cfg, &clock_hz) ||
+       !solve_pwm_config(clock_hz, &system_LEDs_infos[i].ledc_timer.freq_hz, 
+          &system_LEDs_infos[i].ledc_timer.duty_resolution))
+    {
+      return false;
+    }
     
     /* Ensure that is in the correct index. */
     LEDs_info[system_LEDs_infos[i].ID] = system_LEDs_infos[i];
 
   }
 
+  for(LED_ID i = 0u; i < NUM_OF_LEDS; i++)
+  {
+    /* LEDs that share a timer must have the same timer configuration. */
+    for(LED_ID j = 0u; j < i; j++)
+    {
+      const ledc_timer_config_t *timer_i = &LEDs_info[i].ledc_timer;
+      const ledc_timer_config_t *timer_j = &LEDs_info[j].ledc_timer;
+      if(timer_i->speed_mode == timer_j->speed_mode && 
+         timer_i->timer_num == timer_j->timer_num &&
+         (timer_i->freq_hz != timer_j->freq_hz || 
+          timer_i->duty_resolution != timer_j->duty_resolution ||
+          timer_i->clk_cfg != timer_j->clk_cfg))
+      {
+        return false;
+      }
+    }
+  }
+
   for(LED_ID i = 0u; i < NUM_OF_LEDS; i++)
   {
     /* Copy the sorted array in the global. */
@@ -379,20 +969,410 @@ static bool cacl_pwm_duty(const LED_ID ID, const uint8_t dutyPercentage,
 
   const float duty = (float)dutyPerc/100.0f;
 
-  switch(ID)
+  if(!check_LED_ID(ID))
+  {
+    /* Unkown LED. */
+    return false;
+  }
+
+  /* (2^Resolution) * percetange, the resolution is the one chosen at initialization. */
+  *dutyInSteps = 
+    ((1ull << system_LEDs_infos[ID].ledc_timer.duty_resolution) - 1ull) * duty;
+
+  return true;
+}
+
+static bool get_clock_source_freq(const ledc_clk_cfg_t clock, uint32_t *freq_hz)
+{
+  switch(clock)
   {
-    #define LED_CONFIG(LED_ID, LED_GPIO_ID, LED_GPIO_PULL_MODE, LED_TIMER, PWM_SPEED, \
-                       PWM_CHAN, PWM_RESOL, PWM_FREQ)                                 \
-      case LED_ID:                                                                    \
-        /* (2^Resolution) * percetange */                                             \
-        *dutyInSteps = (((1ull << PWM_RESOL) - 1ull)) * duty;                         \
-        break;                                                                        
-      LED_CONFIGURATIONS                                                              
-    #undef LED_CONFIG 
+    /* The driver picks the APB clock whenever the divider fits, solve with it. */
+    case LEDC_AUTO_CLK:
+    case LEDC_USE_APB_CLK:
+      *freq_hz = LEDC_APB_CLK_HZ;
+      return true;
+    #if SOC_LEDC_SUPPORT_REF_TICK
+      case LEDC_USE_REF_TICK:
+        *freq_hz = LEDC_REF_TICK_CLK_HZ;
+        return true;
+    #endif
+    case LEDC_USE_RC_FAST_CLK:
+      *freq_hz = LEDC_RC_FAST_CLK_HZ;
+      return true;
     default:
-      /* Unkown LED. */
       return false;
   }
+}
+
+static bool solve_pwm_config(const uint32_t clock_hz, uint32_t *freq_hz, 
+  ledc_timer_bit_t *resolution)
+{
+
+  uint32_t freq = *freq_hz;
+  uint32_t bits = (uint32_t)*resolution;
+
+  /* Both can not be chosen, there would be no constraint. */
+  if(freq == LED_PWM_FREQUENCY_AUTO && bits == (uint32_t)LED_PWM_RESOLUTION_AUTO)
+  {
+    return false;
+  }
+
+  if(bits == (uint32_t)LED_PWM_RESOLUTION_AUTO)
+  {
+    /* Highest resolution that keeps the divider over 1: floor(log2(clock / freq)). */
+    if(freq == 0u || freq > clock_hz)
+    {
+      return false;
+    }
+    bits = 31u - (uint32_t)__builtin_clz(clock_hz / freq);
+    if(bits > LEDC_TIMER_MAX_RESOLUTION)
+    {
+      bits = LEDC_TIMER_MAX_RESOLUTION;
+    }
+  }
+  else if(freq == LED_PWM_FREQUENCY_AUTO)
+  {
+    /* Highest frequency at the given resolution, with the divider at 1. */
+    if(bits > LEDC_TIMER_MAX_RESOLUTION)
+    {
+      return false;
+    }
+    freq = clock_hz >> bits;
+  }
+
+  if(bits == 0u || bits > LEDC_TIMER_MAX_RESOLUTION || freq < LED_PWM_MIN_FREQUENCY_HZ)
+  {
+    return false;
+  }
+
+  /* Check that the divider that the timer needs is reachable, in 1/256 units. */
+  const uint64_t divider = ((uint64_t)clock_hz << 8u) / ((uint64_t)freq << bits);
+  if(divider < (1ull << 8u) || divider > ((uint64_t)LEDC_TIMER_MAX_DIVIDER << 8u))
+  {
+    return false;
+  }
+
+  *freq_hz = freq;
+  *resolution = (ledc_timer_bit_t)bits;
 
   return true;
-}
\ No newline at end of file
+}
+
+static void stage_duty(const LED_ID ID, const uint32_t dutyInSteps)
+{
+  portENTER_CRITICAL(&staged_LEDs_lock);
+  system_LEDs_infos[ID].staged_duty = dutyInSteps;
+  staged_LEDs |= (1ul << ID);
+  portEXIT_CRITICAL(&staged_LEDs_lock);
+
+  #if LED_DITHERING_ENABLE == 1
+    cancel_dithering(ID);
+  #endif
+}
+
+#if LED_PHASE_STAGGER_ENABLE == 1
+
+static void stagger_hpoints(const uint32_t *duties, uint32_t *hpoints)
+{
+  uint32_t pending = (NUM_OF_LEDS == 32u) ? UINT32_MAX : ((1ul << NUM_OF_LEDS) - 1u);
+
+  while(pending != 0u)
+  {
+    /* Take the LEDs of the timer of the first pending LED. */
+    const LED_ID first = (LED_ID)__builtin_ctzl(pending);
+    const ledc_timer_config_t *timer = &system_LEDs_infos[first].ledc_timer;
+    const uint32_t period = 1ul << timer->duty_resolution;
+
+    LED_ID order[NUM_OF_LEDS];
+    uint32_t num_of_channels = 0u;
+    for(LED_ID ID = first; ID < NUM_OF_LEDS; ID++)
+    {
+      if((pending & (1ul << ID)) != 0u &&
+         system_LEDs_infos[ID].ledc_timer.speed_mode == timer->speed_mode &&
+         system_LEDs_infos[ID].ledc_timer.timer_num == timer->timer_num)
+      {
+        pending &= ~(1ul << ID);
+        if(duties[ID] == 0u)
+        {
+          continue;
+        }
+
+        /* Insert sorted from the longest to the shortest duty cycle. */
+        uint32_t i = num_of_channels++;
+        while(i > 0u && duties[order[i - 1u]] < duties[ID])
+        {
+          order[i] = order[i - 1u];
+          i--;
+        }
+        order[i] = ID;
+      }
+    }
+
+    /* First fit decreasing, each lane is a period that on-times fill one after other. */
+    uint32_t lanes_end[NUM_OF_LEDS];
+    uint32_t num_of_lanes = 0u;
+    for(uint32_t i = 0u; i < num_of_channels; i++)
+    {
+      const LED_ID ID = order[i];
+      uint32_t lane = 0u;
+      while(lane < num_of_lanes && lanes_end[lane] + duties[ID] > period)
+      {
+        lane++;
+      }
+      if(lane == num_of_lanes)
+      {
+        lanes_end[num_of_lanes++] = 0u;
+      }
+
+      hpoints[ID] = lanes_end[lane];
+      lanes_end[lane] += duties[ID];
+    }
+  }
+}
+
+#endif
+
+static uint8_t model_phase_profile(const uint32_t channels, const uint32_t *duties, 
+  const uint32_t *hpoints, const uint32_t period, uint16_t *on_time_permille)
+{
+
+  /* Edges of the on-times: +1 when a channel turns on, -1 when it turns off. */
+  uint32_t edges_time[2u * NUM_OF_LEDS];
+  int8_t edges_step[2u * NUM_OF_LEDS];
+  uint32_t num_of_edges = 0u;
+
+  for(uint32_t i = 0u; i <= NUM_OF_LEDS; i++)
+  {
+    on_time_permille[i] = 0u;
+  }
+
+  uint32_t pending = channels;
+  while(pending != 0u)
+  {
+    const LED_ID ID = (LED_ID)__builtin_ctzl(pending);
+    pending &= pending - 1u;
+
+    if(duties[ID] == 0u)
+    {
+      continue;
+    }
+
+    const uint32_t on = hpoints[ID];
+    const uint32_t off = (on + duties[ID] > period) ? period : on + duties[ID];
+    const uint32_t times[2] = {on, off};
+    const int8_t steps[2] = {1, -1};
+
+    /* Insert sorted by time, turn offs first so touching on-times do not overlap. */
+    for(uint32_t k = 0u; k < 2u; k++)
+    {
+      uint32_t i = num_of_edges++;
+      while(i > 0u && (edges_time[i - 1u] > times[k] || 
+            (edges_time[i - 1u] == times[k] && edges_step[i - 1u] > steps[k])))
+      {
+        edges_time[i] = edges_time[i - 1u];
+        edges_step[i] = edges_step[i - 1u];
+        i--;
+      }
+      edges_time[i] = times[k];
+      edges_step[i] = steps[k];
+    }
+  }
+
+  /* Sweep the period accumulating the time spent with each number of channels on. */
+  uint32_t on_time[NUM_OF_LEDS + 1u] = {0u};
+  uint32_t last_time = 0u;
+  uint32_t channels_on = 0u;
+  uint8_t peak = 0u;
+  for(uint32_t i = 0u; i < num_of_edges; i++)
+  {
+    on_time[channels_on] += edges_time[i] - last_time;
+    last_time = edges_time[i];
+    channels_on = (uint32_t)((int32_t)channels_on + edges_step[i]);
+    if(channels_on > peak)
+    {
+      peak = (uint8_t)channels_on;
+    }
+  }
+  on_time[channels_on] += period - last_time;
+
+  for(uint32_t i = 0u; i <= NUM_OF_LEDS; i++)
+  {
+    on_time_permille[i] = (uint16_t)(((uint64_t)on_time[i] * 1000u) / period);
+  }
+
+  return peak;
+}
+
+#if LED_DITHERING_ENABLE == 1
+
+static void cancel_dithering(const LED_ID ID)
+{
+  bool was_dithered;
+
+  portENTER_CRITICAL(&dither_lock);
+  was_dithered = (dithered_LEDs & (1ul << ID)) != 0u;
+  dithered_LEDs &= ~(1ul << ID);
+  portEXIT_CRITICAL(&dither_lock);
+
+  if(was_dithered)
+  {
+    update_dither_timer();
+  }
+}
+
+static void update_dither_timer(void)
+{
+  if(xSemaphoreTake(dither_timer_mutex, portMAX_DELAY) != pdTRUE)
+  {
+    return;
+  }
+
+  /* The mask is read with the mutex taken, so the last caller always sees the last 
+   * state of the mask.
+   */
+  portENTER_CRITICAL(&dither_lock);
+  const bool needed = dithered_LEDs != 0u;
+  const uint32_t period_us = dither_stats.period_us;
+  portEXIT_CRITICAL(&dither_lock);
+
+  const bool running = esp_timer_is_active(dither_timer);
+  if(needed && !running)
+  {
+    ESP_error_check(esp_timer_start_periodic(dither_timer, period_us));
+  }
+  else if(!needed && running)
+  {
+    ESP_error_check(esp_timer_stop(dither_timer));
+  }
+
+  xSemaphoreGive(dither_timer_mutex);
+}
+
+static void dither_tick(void *args)
+{
+  const esp_cpu_cycle_count_t start = esp_cpu_get_cycle_count();
+  esp_err_t err = ESP_OK;
+  uint32_t duties[NUM_OF_LEDS];
+  uint32_t LEDs = 0u;
+
+  /* The commits write the same channels, the tick never waits for one, it is skipped
+   * and the pattern goes on from the same point in the next tick.
+   */
+  if(xSemaphoreTake(commit_mutex, 0u) != pdTRUE)
+  {
+    portENTER_CRITICAL(&dither_lock);
+    dither_stats.skipped_ticks++;
+    portEXIT_CRITICAL(&dither_lock);
+    return;
+  }
+
+  /* Choose the new duties with the lock taken, the channels are written after it. */
+  portENTER_CRITICAL(&dither_lock);
+  uint32_t pending = dithered_LEDs;
+  while(pending != 0u)
+  {
+    const LED_ID ID = (LED_ID)__builtin_ctzl(pending);
+    pending &= pending - 1u;
+
+    /* First order sigma-delta, the average duty is duty + fraction/DITHER_ONE_STEP. */
+    LED_dither_state *state = &dither_states[ID];
+    uint32_t duty = state->duty;
+    state->accumulator += state->fraction;
+    if(state->accumulator >= DITHER_ONE_STEP)
+    {
+      state->accumulator -= DITHER_ONE_STEP;
+      duty++;
+    }
+
+    /* Only write the channels that change. */
+    if(duty != state->applied_duty)
+    {
+      duties[ID] = duty;
+      LEDs |= (1ul << ID);
+    }
+  }
+  portEXIT_CRITICAL(&dither_lock);
+
+  /* The hpoint of the channel is kept, a commit may have staggered it. */
+  uint32_t applied = 0u;
+  pending = LEDs;
+  while(pending != 0u)
+  {
+    const LED_ID ID = (LED_ID)__builtin_ctzl(pending);
+    pending &= pending - 1u;
+
+    esp_err_t ret = ledc_set_duty_with_hpoint(
+                      system_LEDs_infos[ID].ledc_timer.speed_mode, 
+                      system_LEDs_infos[ID].ledc_channel.channel, duties[ID],
+                      (uint32_t)system_LEDs_infos[ID].ledc_channel.hpoint);
+    if(ret == ESP_OK)
+    {
+      ret = ledc_update_duty(system_LEDs_infos[ID].ledc_timer.speed_mode, 
+              system_LEDs_infos[ID].ledc_channel.channel);
+    }
+
+    if(ret == ESP_OK)
+    {
+      applied |= (1ul << ID);
+    }
+    else
+    {
+      err = ret;
+    }
+  }
+  xSemaphoreGive(commit_mutex);
+
+  portENTER_CRITICAL(&dither_lock);
+  pending = applied & dithered_LEDs;
+  while(pending != 0u)
+  {
+    const LED_ID ID = (LED_ID)__builtin_ctzl(pending);
+    pending &= pending - 1u;
+    dither_states[ID].applied_duty = duties[ID];
+  }
+
+  /* Measure the cost of the tick against the CPU time of its period. */
+  const uint32_t cycles = (uint32_t)(esp_cpu_get_cycle_count() - start);
+  dither_stats.ticks++;
+  if(cycles > dither_stats.max_cycles)
+  {
+    dither_stats.max_cycles = cycles;
+  }
+  dither_stats.avg_cycles = 
+    (dither_stats.avg_cycles == 0u) ? cycles : 
+      ((dither_stats.avg_cycles * 7u) + cycles) / 8u;
+  dither_stats.load_permille = (dither_stats.avg_cycles * 1000u) / 
+    (dither_stats.period_us * esp_rom_get_cpu_ticks_per_us());
+
+  bool over_budget = false;
+  if(dither_stats.load_permille > LED_DITHER_MAX_LOAD_PERMILLE &&
+     dither_stats.period_us < LED_DITHER_MAX_PERIOD_US)
+  {
+    /* The period is bounded to keep the dithering cycle over the flicker threshold. */
+    const uint32_t old_period_us = dither_stats.period_us;
+    over_budget = true;
+    dither_stats.period_us = (old_period_us * 2u > LED_DITHER_MAX_PERIOD_US) ? 
+      LED_DITHER_MAX_PERIOD_US : old_period_us * 2u;
+    dither_stats.load_permille = 
+      (dither_stats.load_permille * old_period_us) / dither_stats.period_us;
+    dither_stats.budget_overruns++;
+  }
+  const uint32_t period_us = dither_stats.period_us;
+  portEXIT_CRITICAL(&dither_lock);
+
+  ESP_error_check(err);
+
+  /* Slow down the tick to respect the budget, if the timer is being started or stopped
+   * it will take the new period the next time.
+   */
+  if(over_budget && xSemaphoreTake(dither_timer_mutex, 0u) == pdTRUE)
+  {
+    if(esp_timer_is_active(dither_timer))
+    {
+      ESP_error_check(esp_timer_restart(dither_timer, period_us));
+    }
+    xSemaphoreGive(dither_timer_mutex);
+  }
+}
+
+#endif
\ No newline at end of file
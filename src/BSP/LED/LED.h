@@ -13,6 +13,7 @@
  * Includes
  ***************************************************************************************/
 #include <LED_physical_connection.h>
+#include <stdint.h>
 
 /***************************************************************************************
  * Defines
@@ -30,7 +31,8 @@
   LED_RETURN(BSP_LED_DOES_NOT_EXIST_ERR)      \
   LED_RETURN(BSP_LED_WAS_INIT_ERR)            \
   LED_RETURN(BSP_LED_SET_LED_STATE_ERR)       \
-  LED_RETURN(BSP_LED_WAS_NOT_INIT_ERR)        
+  LED_RETURN(BSP_LED_WAS_NOT_INIT_ERR)        \
+  LED_RETURN(BSP_LED_MODULE_WAS_INIT_ERR)
 
 /***************************************************************************************
  * Data Type Definitions
@@ -46,6 +48,82 @@ typedef enum
   NUM_OF_LED_RETURNS,
 } LED_return;
 
+/* Structure that contains the physical connection of a LED, the parameters of 
+ * LED_CONFIGURATIONS (LED_physical_connection.h) without the identifier.
+ */
+typedef struct
+{
+  /* Identifier of the GPIO that sets the LED state. */
+  gpio_num_t GPIO;
+  /* Pull mode of the GPIO. */
+  gpio_pull_mode_t pull_mode;
+  /* Timer, speed mode and channel that control the LED. */
+  ledc_timer_t timer;
+  ledc_mode_t speed_mode;
+  ledc_channel_t channel;
+  /* Resolution of the PWM duty cycle or LED_PWM_RESOLUTION_AUTO. */
+  ledc_timer_bit_t resolution;
+  /* Frequency in Hertz of the PWM or LED_PWM_FREQUENCY_AUTO. */
+  uint32_t freq_hz;
+  /* Clock source of the timer. */
+  ledc_clk_cfg_t clock;
+} LED_connection;
+
+/* Structure that reports the latch window of commit_LED_states: the CPU time from the
+ * start of the first channel latch to the end of the last one. It does not bound the
+ * skew between the PWM outputs, a channel takes its latched duty at the next overflow
+ * of its own timer.
+ */
+typedef struct
+{
+  /* Number of commits that latched at least one channel. */
+  uint32_t commits;
+  /* Latch window of the last commit in CPU cycles. */
+  uint32_t last_window_cycles;
+  /* Maximum latch window of all the commits in CPU cycles. */
+  uint32_t max_window_cycles;
+  /* Maximum latch window of all the commits in nanoseconds. */
+  uint32_t max_window_ns;
+} LED_latch_window;
+
+/* Structure that models how many channels of a timer are on along the PWM period. The
+ * supply current follows the number of channels that are on.
+ */
+typedef struct
+{
+  /* Maximum number of channels that are on at the same time. */
+  uint8_t peak_channels;
+  /* Maximum number of channels that would be on if all of them started at the 
+   * beginning of the period.
+   */
+  uint8_t aligned_peak_channels;
+  /* Part of the period in per mille in which N channels are on, indexed by N. */
+  uint16_t on_time_permille[NUM_OF_LEDS + 1];
+} LED_phase_profile;
+
+#if LED_DITHERING_ENABLE == 1
+
+/* Structure that reports the cost of the dithering tick. */
+typedef struct
+{
+  /* Number of executed ticks. */
+  uint32_t ticks;
+  /* Current period in microseconds of the tick. */
+  uint32_t period_us;
+  /* Average CPU cycles consumed by a tick. */
+  uint32_t avg_cycles;
+  /* Maximum CPU cycles consumed by a tick. */
+  uint32_t max_cycles;
+  /* Average CPU load in per mille of the tick at the current period. */
+  uint32_t load_permille;
+  /* Number of times that the tick period was doubled to respect the budget. */
+  uint32_t budget_overruns;
+  /* Number of ticks skipped because a commit was writing the channels. */
+  uint32_t skipped_ticks;
+} LED_dither_stats;
+
+#endif
+
 /***************************************************************************************
  * Functions Prototypes
  ***************************************************************************************/
@@ -61,10 +139,57 @@ typedef enum
  *         otherise:
  * 
  *           - BSP_LED_INVALID_LEDS_CONFIG: 
- *               The provided configuration in LED_physical_connection.h is not valid.            
+ *               The provided configuration in LED_physical_connection.h is not valid or
+ *               the clock source can not reach the requested PWM.            
+ * 
+ *           - BSP_LED_MODULE_INIT_ERR:
+ *               An error ocurred in one of the intermediate functions.
+ * 
  */
 LED_return init_BSP_LED_module(void);
 
+/**
+ * @brief Replaces the compiled physical connection of a LED. It is mandatory to call
+ *        this function before init_BSP_LED_module, that checks the connections.
+ *
+ * @param ID Identifier of the LED.
+ * 
+ * @param connection New physical connection of the LED.
+ *
+ * @return BSP_LED_RET_OK If the operation went well, 
+ *         otherwise:
+ *  
+ *           - BSP_LED_MODULE_WAS_INIT_ERR: 
+ *               BSP LED module was intialized before.
+ * 
+ *           - BSP_LED_DOES_NOT_EXIST_ERR: 
+ *               The given ID does not exist.
+ * 
+ */
+LED_return set_LED_connection(const LED_ID ID, const LED_connection *connection);
+
+/**
+ * @brief Checks that the clock source of a physical connection can generate its PWM, 
+ *        and chooses the resolution or the frequency set to auto, the same check that
+ *        the module does when it is initialized. It can be called at any time.
+ *
+ * @param connection Physical connection to check.
+ * 
+ * @param freq_hz Return frequency in Hertz that the PWM would have, it can be NULL.
+ * 
+ * @param resolution Return resolution that the PWM would have, it can be NULL.
+ *
+ * @return BSP_LED_RET_OK If the PWM can be generated, 
+ *         otherwise:
+ *  
+ *           - BSP_LED_INVALID_LEDS_CONFIG: 
+ *               The clock source is not supported or it can not reach the resolution
+ *               and the frequency of the PWM.
+ * 
+ */
+LED_return check_LED_connection(const LED_connection *connection, uint32_t *freq_hz, 
+  ledc_timer_bit_t *resolution);
+
 /**
  * @brief Initializes a board LED.
  *
@@ -112,7 +237,8 @@ LED_return init_LED(const LED_ID ID);
 LED_return de_init_LED(const LED_ID ID);
 
 /**
- * @brief Sets a new duty cycle to a given LED.
+ * @brief Sets a new duty cycle to a given LED. It also applies the duty cycles staged
+ *        before.
  *
  * @param ID Identifier of the LED in which it will modify its PWM.
  * 
@@ -134,7 +260,7 @@ LED_return de_init_LED(const LED_ID ID);
 LED_return set_LED_state(const LED_ID ID, const uint8_t duty_cycle);
 
 /**
- * @brief Turns off a LED.
+ * @brief Turns off a LED. It also applies the duty cycles staged before.
  *
  * @param ID Identifier of the LED to turn off.
  *
@@ -153,6 +279,162 @@ LED_return set_LED_state(const LED_ID ID, const uint8_t duty_cycle);
  */
 LED_return turn_off_LED(const LED_ID ID);
 
+/**
+ * @brief Gets the PWM resolution and frequency chosen for a LED when the module was
+ *        initialized.
+ *
+ * @param ID Identifier of the LED.
+ * 
+ * @param freq_hz Frequency in Hertz of the LED PWM.
+ * 
+ * @param resolution_bits Resolution in bits of the LED PWM duty cycle.
+ *
+ * @return BSP_LED_RET_OK If the operation went well,
+ *         otherwise:
+ * 
+ *           - BSP_LED_MODULE_WAS_NOT_INIT_ERR: 
+ *               BSP LED module was not intialized before.
+ * 
+ *           - BSP_LED_DOES_NOT_EXIST_ERR: 
+ *               The given ID does not exist.
+ * 
+ */
+LED_return get_LED_PWM_config(const LED_ID ID, uint32_t *freq_hz, 
+  uint8_t *resolution_bits);
+
+/**
+ * @brief Stages a new duty cycle to a given LED. The new duty cycle is not applied until
+ *        commit_LED_states is called.
+ *
+ * @param ID Identifier of the LED in which it will modify its PWM.
+ * 
+ * @param duty_cycle Duty cycle in percentage terms to stage.
+ *
+ * @return BSP_LED_RET_OK If the operation went well,
+ *         otherwise:
+ * 
+ *           - BSP_LED_MODULE_WAS_NOT_INIT_ERR: 
+ *               BSP LED module was not intialized before.
+ * 
+ *           - BSP_LED_DOES_NOT_EXIST_ERR: 
+ *               The given ID does not exist.
+ * 
+ */
+LED_return stage_LED_state(const LED_ID ID, const uint8_t duty_cycle);
+
+/**
+ * @brief Stages the turn off of a LED. The LED is not turned off until 
+ *        commit_LED_states is called.
+ *
+ * @param ID Identifier of the LED to turn off.
+ *
+ * @return BSP_LED_RET_OK If the operation went well,
+ *         otherwise:
+ * 
+ *           - BSP_LED_MODULE_WAS_NOT_INIT_ERR: 
+ *               BSP LED module was not intialized before.
+ * 
+ *           - BSP_LED_DOES_NOT_EXIST_ERR: 
+ *               The given ID does not exist.
+ * 
+ */
+LED_return stage_turn_off_LED(const LED_ID ID);
+
+/**
+ * @brief Applies all the staged duty cycles together. The duty registers are written 
+ *        first and then all the channels are latched back to back with the interrupts
+ *        disabled, which keeps the latch window short (get_LED_latch_window). Every 
+ *        channel takes its new duty at the next overflow of its timer, so channels 
+ *        that share a timer usually change at the same overflow, but the latches can 
+ *        straddle an overflow and the channels of different timers are not 
+ *        synchronized. With LED_PHASE_STAGGER_ENABLE the hpoints of the channels are
+ *        recomputed too.
+ *
+ * @param void
+ *
+ * @return BSP_LED_RET_OK If the operation went well,
+ *         otherwise:
+ * 
+ *           - BSP_LED_MODULE_WAS_NOT_INIT_ERR: 
+ *               BSP LED module was not intialized before.
+ * 
+ *           - BSP_LED_SET_LED_STATE_ERR:
+ *               An error ocurred in one of the intermediate functions.
+ * 
+ */
+LED_return commit_LED_states(void);
+
+/**
+ * @brief Models the PWM period of a timer with the applied duty cycles and hpoints, and
+ *        the same period with all the channels starting at the beginning of it.
+ *
+ * @param speed_mode Speed mode of the timer.
+ * 
+ * @param timer Identifier of the timer.
+ * 
+ * @param profile Structure where the model is returned.
+ *
+ * @return BSP_LED_RET_OK If the operation went well,
+ *         otherwise:
+ * 
+ *           - BSP_LED_MODULE_WAS_NOT_INIT_ERR: 
+ *               BSP LED module was not intialized before.
+ * 
+ *           - BSP_LED_DOES_NOT_EXIST_ERR: 
+ *               No LED uses the given timer.
+ * 
+ */
+LED_return get_LED_phase_profile(const ledc_mode_t speed_mode, const ledc_timer_t timer,
+  LED_phase_profile *profile);
+
+/**
+ * @brief Gets the latch window measured in commit_LED_states.
+ *
+ * @param window Structure where the measurements are returned.
+ *
+ * @return void
+ */
+void get_LED_latch_window(LED_latch_window *window);
+
+#if LED_DITHERING_ENABLE == 1
+
+/**
+ * @brief Sets the brightness of a LED with a resolution finer than a duty step. The 
+ *        fraction of step is reproduced by the dithering tick, that alternates between
+ *        the two adjacent duty values. MIN_DUTY_CYCLE_PERC is not applied, so it can
+ *        reach the dimmest levels of the LED.
+ *
+ * @param ID Identifier of the LED in which it will modify its PWM.
+ * 
+ * @param level Brightness as a fraction of the full scale, from 0 (off) to 
+ *              UINT16_MAX (MAX_DUTY_CYCLE_PERC).
+ *
+ * @return BSP_LED_RET_OK If the operation went well,
+ *         otherwise:
+ * 
+ *           - BSP_LED_MODULE_WAS_NOT_INIT_ERR: 
+ *               BSP LED module was not intialized before.
+ * 
+ *           - BSP_LED_DOES_NOT_EXIST_ERR: 
+ *               The given ID does not exist.
+ * 
+ *           - BSP_LED_SET_LED_STATE_ERR:
+ *               An error ocurred in one of the intermediate functions.
+ * 
+ */
+LED_return set_LED_level(const LED_ID ID, const uint16_t level);
+
+/**
+ * @brief Gets the measured cost of the dithering tick.
+ *
+ * @param stats Structure where the measurements are returned.
+ *
+ * @return void
+ */
+void get_LED_dither_stats(LED_dither_stats *stats);
+
+#endif
+
 /**
  * @brief Prints the return of a LED module function if the system was configured 
  *        in debug mode.
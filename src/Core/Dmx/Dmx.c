@@ -0,0 +1,560 @@
+/**
+ * @file      Dmx.c
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This source file defines the functions to receive a DMX universe over 
+ *            Art-Net or sACN (E1.31) and to pass its slots to the LEDs.
+ */
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <Dmx.h>
+#include <Debug.h>
+#include <System_memory.h>
+#include <System_tasks.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include "lwip/udp.h"
+#include "lwip/igmp.h"
+#include "lwip/tcpip.h"
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+#if DEBUG_MODE_ENABLE == 1
+/* Tag to show traces in DMX module. */
+  #define TAG "CORE_DMX"
+#endif
+
+/* ArtDmx packet: identifier, opcode and offsets of its fields. */
+#define ARTNET_ID               "Art-Net"
+#define ARTNET_OPCODE_DMX       0x5000u
+#define ARTNET_OPCODE_OFFSET    8u
+#define ARTNET_SEQUENCE_OFFSET  12u
+#define ARTNET_PORT_ADDR_OFFSET 14u
+#define ARTNET_LENGTH_OFFSET    16u
+#define ARTNET_HEADER_SIZE      18u
+
+/* E1.31 data packet: identifier, vectors and offsets of its fields. */
+#define E131_ID                 "ASC-E1.17\0\0"
+#define E131_ID_OFFSET          4u
+#define E131_ROOT_VECTOR        0x00000004ul
+#define E131_ROOT_VECTOR_OFFSET 18u
+#define E131_FRAME_VECTOR       0x00000002ul
+#define E131_FRAME_VECTOR_OFFSET 40u
+#define E131_SEQUENCE_OFFSET    111u
+#define E131_OPTIONS_OFFSET     112u
+#define E131_UNIVERSE_OFFSET    113u
+#define E131_DMP_VECTOR         0x02u
+#define E131_DMP_VECTOR_OFFSET  117u
+#define E131_COUNT_OFFSET       123u
+#define E131_START_CODE_OFFSET  125u
+#define E131_HEADER_SIZE        126u
+
+/* E1.31 option bits. */
+#define E131_OPTION_PREVIEW     0x80u
+#define E131_OPTION_TERMINATED  0x40u
+
+/* Packets whose sequence number is behind the last one by less than this value are
+ * out of order, a bigger distance means that the source restarted.
+ */
+#define DMX_SEQUENCE_WINDOW 20
+
+/* Size of the biggest packet, an E1.31 packet with a full universe. */
+#define DMX_MAX_PACKET_SIZE (E131_HEADER_SIZE + DMX_UNIVERSE_SIZE)
+
+/* Reads big endian fields. */
+#define READ_BE16(data) (((uint16_t)(data)[0] << 8u) | (data)[1])
+#define READ_BE32(data) (((uint32_t)READ_BE16(data) << 16u) | READ_BE16(&(data)[2]))
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Enumerate that enlist the protocols of the receiver. */
+typedef enum
+{
+  DMX_PROTOCOL_ARTNET,
+  DMX_PROTOCOL_E131,
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_DMX_PROTOCOLS,
+} dmx_protocol;
+
+/***************************************************************************************
+ * Global Variables
+ ***************************************************************************************/
+
+/* Statistics of the receiver. */
+static Dmx_stats dmx_stats;
+
+/* Lock that protects the statistics and the pending levels. */
+static portMUX_TYPE dmx_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Newest levels received and not applied yet, the lwIP thread only replaces them, so 
+ * it never waits for the lamps.
+ */
+static uint16_t pending_levels[DMX_MAX_CHANNELS];
+static uint8_t pending_num_of_channels;
+static bool levels_pending;
+
+/* Time in microseconds spent parsing the pending levels. */
+static uint32_t pending_parse_us;
+
+/* Storage of the DMX task, there is no heap allocation for it. */
+static StackType_t dmx_task_stack[SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_DMX)];
+static StaticTask_t dmx_task_buffer;
+
+/* Handler of the task that applies the levels. */
+static TaskHandle_t dmx_task_handler;
+
+/* RAM reserved by the RTOS objects of the DMX receiver. */
+_Static_assert(sizeof(dmx_task_stack) + sizeof(dmx_task_buffer) <= 
+  DMX_STATIC_RAM_BUDGET, "DMX RTOS objects go over DMX_STATIC_RAM_BUDGET");
+
+/* Last sequence number of every protocol and true if it was received. */
+static uint8_t last_sequences[NUM_OF_DMX_PROTOCOLS];
+static bool any_sequence[NUM_OF_DMX_PROTOCOLS];
+
+/* Start time, busy time in microseconds and applied packets of the load window. */
+static int64_t window_start_us;
+static uint32_t window_busy_us;
+static uint32_t window_packets;
+
+/* Buffer for the packets split among several lwIP buffers, the usual ones are parsed
+ * in place.
+ */
+static uint8_t dmx_scratch[DMX_MAX_PACKET_SIZE];
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Creates the UDP control blocks of the enabled protocols. It must run in the 
+ *        lwIP thread.
+ *
+ * @param ctx Not used.
+ *
+ * @return void
+ */
+static void start_dmx_reception(void *ctx);
+
+/**
+ * @brief Function of the DMX task, it passes the newest pending levels to 
+ *        dmx_levels_CB every time that the lwIP thread notifies it.
+ *
+ * @param args arguments to pass to the function.
+ *
+ * @return void
+ */
+static void dmx_task_func(void *args);
+
+/**
+ * @brief Receives a packet of a protocol, parses it and leaves the mapped slots to the
+ *        DMX task.
+ *
+ * @param arg Protocol of the control block, a value of dmx_protocol.
+ * 
+ * @param pcb UDP control block that received the packet.
+ * 
+ * @param p lwIP buffers of the packet, they are freed here.
+ * 
+ * @param addr Source address of the packet.
+ * 
+ * @param port Source port of the packet.
+ *
+ * @return void
+ */
+static void dmx_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, 
+  const ip_addr_t *addr, u16_t port);
+
+/**
+ * @brief Locates the slots of the configured universe in an ArtDmx packet.
+ *
+ * @param data Bytes of the packet.
+ * 
+ * @param len Number of bytes of the packet.
+ * 
+ * @param slots Return slots of the universe, NULL if it is not valid.
+ * 
+ * @param sequence Return sequence number of the packet, 0 if it is not used.
+ *
+ * @return Number of slots of the universe.
+ */
+static uint16_t parse_artnet(const uint8_t *data, const uint16_t len, 
+  const uint8_t **slots, uint8_t *sequence);
+
+/**
+ * @brief Locates the slots of the configured universe in an E1.31 data packet.
+ *
+ * @param data Bytes of the packet.
+ * 
+ * @param len Number of bytes of the packet.
+ * 
+ * @param slots Return slots of the universe, NULL if it is not valid.
+ * 
+ * @param sequence Return sequence number of the packet.
+ *
+ * @return Number of slots of the universe.
+ */
+static uint16_t parse_e131(const uint8_t *data, const uint16_t len, 
+  const uint8_t **slots, uint8_t *sequence);
+
+/**
+ * @brief Checks the sequence number of a packet against the last one of its protocol.
+ *
+ * @param protocol Protocol of the packet.
+ * 
+ * @param sequence Sequence number of the packet.
+ *
+ * @return True if the packet is in order, otherwise false.
+ */
+static bool check_sequence(const dmx_protocol protocol, const uint8_t sequence);
+
+/**
+ * @brief Updates the statistics with a processed packet.
+ *
+ * @param process_us Time in microseconds spent with the packet.
+ * 
+ * @param applied True if the packet was applied to the LEDs.
+ *
+ * @return void
+ */
+static void measure_packet(const uint32_t process_us, const bool applied);
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+Dmx_return init_dmx(void)
+{
+  dmx_task_handler = xTaskCreateStaticPinnedToCore(dmx_task_func, 
+    SYSTEM_TASK_NAME(SYSTEM_TASK_DMX), SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_DMX), 
+    (void *) 0, SYSTEM_TASK_PRIORITY(SYSTEM_TASK_DMX), dmx_task_stack, 
+    &dmx_task_buffer, SYSTEM_TASK_CORE(SYSTEM_TASK_DMX));
+  if(dmx_task_handler == NULL)
+  {
+    return CORE_DMX_INIT_TASK_ERR;
+  }
+
+  /* The raw API is not thread safe, the control blocks are created by its thread. */
+  if(tcpip_callback(start_dmx_reception, NULL) != ERR_OK)
+  {
+    return CORE_DMX_INIT_ERR;
+  }
+
+  return CORE_DMX_OK;
+}
+
+void get_dmx_stats(Dmx_stats *stats)
+{
+  const int64_t now_us = esp_timer_get_time();
+
+  taskENTER_CRITICAL(&dmx_lock);
+  *stats = dmx_stats;
+  /* The load is computed with the packets, without them the last window is stale. */
+  if(now_us - window_start_us > 2 * (int64_t)DMX_LOAD_WINDOW_US)
+  {
+    stats->packet_rate_hz = 0u;
+    stats->load_permille = 0u;
+  }
+  taskEXIT_CRITICAL(&dmx_lock);
+}
+
+inline Dmx_return core_dmx_LOG(const Dmx_return ret)
+{
+  #if DEBUG_MODE_ENABLE == 1
+    switch(ret)
+    {
+      #define DMX_RETURN(enumerate)    \
+        case enumerate:                \
+          if(ret > 0)                  \
+          {                            \
+            ESP_LOGE(TAG, #enumerate); \
+          }                            \
+          else                         \
+          {                            \
+            ESP_LOGI(TAG, #enumerate); \
+          }                            \
+          break;       
+        DMX_RETURNS
+      #undef DMX_RETURN
+      default:
+        ESP_LOGE(TAG, "Unkown return.");
+        break;
+    }
+  #endif
+  return ret;
+}
+
+static void start_dmx_reception(void *ctx)
+{
+  const uint16_t ports[NUM_OF_DMX_PROTOCOLS] = {DMX_ARTNET_PORT, DMX_E131_PORT};
+  const bool enabled[NUM_OF_DMX_PROTOCOLS] = {DMX_ARTNET_ENABLE, DMX_E131_ENABLE};
+
+  window_start_us = esp_timer_get_time();
+
+  for(uint8_t i = 0u; i < NUM_OF_DMX_PROTOCOLS; i++)
+  {
+    if(!enabled[i])
+    {
+      continue;
+    }
+
+    struct udp_pcb *pcb = udp_new();
+    if(pcb == NULL || udp_bind(pcb, IP_ANY_TYPE, ports[i]) != ERR_OK)
+    {
+      #if DEBUG_MODE_ENABLE == 1
+        ESP_LOGE(TAG, "Unable to open the DMX port %u.", ports[i]);
+      #endif
+      if(pcb != NULL)
+      {
+        udp_remove(pcb);
+      }
+      continue;
+    }
+    udp_recv(pcb, dmx_recv, (void *)(uintptr_t)i);
+  }
+
+  #if DMX_E131_ENABLE == 1
+    /* The E1.31 sources send every universe to its own multicast group. */
+    ip4_addr_t group;
+    IP4_ADDR(&group, 239u, 255u, (DMX_E131_UNIVERSE >> 8u) & 0xFFu, 
+      DMX_E131_UNIVERSE & 0xFFu);
+    if(igmp_joingroup(IP4_ADDR_ANY4, &group) != ERR_OK)
+    {
+      #if DEBUG_MODE_ENABLE == 1
+        ESP_LOGE(TAG, "Unable to join the E1.31 universe group.");
+      #endif
+    }
+  #endif
+}
+
+static void dmx_task_func(void *args)
+{
+  uint16_t levels[DMX_MAX_CHANNELS];
+
+  while(true)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    taskENTER_CRITICAL(&dmx_lock);
+    const bool pending = levels_pending;
+    const uint8_t num_of_channels = pending_num_of_channels;
+    const uint32_t parse_us = pending_parse_us;
+    memcpy(levels, pending_levels, num_of_channels * sizeof(levels[0]));
+    levels_pending = false;
+    taskEXIT_CRITICAL(&dmx_lock);
+
+    if(pending)
+    {
+      const int64_t start_us = esp_timer_get_time();
+      dmx_levels_CB(levels, num_of_channels);
+      measure_packet(parse_us + (uint32_t)(esp_timer_get_time() - start_us), true);
+    }
+  }
+}
+
+static void dmx_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, 
+  const ip_addr_t *addr, u16_t port)
+{
+  const int64_t start_us = esp_timer_get_time();
+  const dmx_protocol protocol = (dmx_protocol)(uintptr_t)arg;
+  bool queued = false;
+
+  /* It returns the lwIP buffer itself when the packet is contiguous, the usual case. */
+  const uint8_t *data = NULL;
+  if(p->tot_len <= sizeof(dmx_scratch))
+  {
+    data = pbuf_get_contiguous(p, dmx_scratch, sizeof(dmx_scratch), p->tot_len, 0u);
+  }
+
+  const uint8_t *slots = NULL;
+  uint16_t num_of_slots = 0u;
+  uint8_t sequence = 0u;
+  if(data != NULL)
+  {
+    num_of_slots = (protocol == DMX_PROTOCOL_ARTNET) ? 
+      parse_artnet(data, p->tot_len, &slots, &sequence) :
+      parse_e131(data, p->tot_len, &slots, &sequence);
+  }
+
+  uint16_t levels[DMX_MAX_CHANNELS];
+  uint8_t num_of_channels = 0u;
+  if(slots != NULL && check_sequence(protocol, sequence))
+  {
+    /* One pass over the mapped slots, the missing ones at the end are not applied. */
+    for(uint16_t slot = DMX_START_ADDRESS - 1u; 
+        num_of_channels < DMX_MAX_CHANNELS && slot + DMX_SLOT_SIZE <= num_of_slots;
+        slot += DMX_SLOT_SIZE)
+    {
+      #if DMX_16_BIT_SLOTS == 1
+        levels[num_of_channels++] = READ_BE16(&slots[slot]);
+      #else
+        levels[num_of_channels++] = (uint16_t)slots[slot] * 257u;
+      #endif
+    }
+  }
+
+  taskENTER_CRITICAL(&dmx_lock);
+  /* The lamps only need the newest universe, a pending older one is replaced. */
+  if(num_of_channels > 0u)
+  {
+    if(levels_pending)
+    {
+      dmx_stats.overwritten++;
+      window_busy_us += pending_parse_us;
+    }
+    memcpy(pending_levels, levels, num_of_channels * sizeof(levels[0]));
+    pending_num_of_channels = num_of_channels;
+    pending_parse_us = (uint32_t)(esp_timer_get_time() - start_us);
+    levels_pending = true;
+    queued = true;
+  }
+  if(data != NULL && data != p->payload)
+  {
+    dmx_stats.copied++;
+  }
+  if(slots == NULL && num_of_slots == 0u)
+  {
+    dmx_stats.invalid++;
+  }
+  taskEXIT_CRITICAL(&dmx_lock);
+
+  pbuf_free(p);
+
+  if(queued)
+  {
+    xTaskNotifyGive(dmx_task_handler);
+  }
+  else
+  {
+    measure_packet((uint32_t)(esp_timer_get_time() - start_us), false);
+  }
+}
+
+static uint16_t parse_artnet(const uint8_t *data, const uint16_t len, 
+  const uint8_t **slots, uint8_t *sequence)
+{
+  *slots = NULL;
+
+  if(len < ARTNET_HEADER_SIZE || memcmp(data, ARTNET_ID, sizeof(ARTNET_ID)) != 0 ||
+     (data[ARTNET_OPCODE_OFFSET] | ((uint16_t)data[ARTNET_OPCODE_OFFSET + 1u] << 8u)) != 
+       ARTNET_OPCODE_DMX)
+  {
+    return 0u;
+  }
+
+  const uint16_t num_of_slots = READ_BE16(&data[ARTNET_LENGTH_OFFSET]);
+  if(num_of_slots > DMX_UNIVERSE_SIZE || len < ARTNET_HEADER_SIZE + num_of_slots)
+  {
+    return 0u;
+  }
+
+  /* Other universes are valid packets that are not for this lamp. */
+  const uint16_t port_address = data[ARTNET_PORT_ADDR_OFFSET] | 
+    ((uint16_t)(data[ARTNET_PORT_ADDR_OFFSET + 1u] & 0x7Fu) << 8u);
+  if(port_address == DMX_ARTNET_PORT_ADDRESS)
+  {
+    *slots = &data[ARTNET_HEADER_SIZE];
+    *sequence = data[ARTNET_SEQUENCE_OFFSET];
+  }
+
+  return num_of_slots;
+}
+
+static uint16_t parse_e131(const uint8_t *data, const uint16_t len, 
+  const uint8_t **slots, uint8_t *sequence)
+{
+  *slots = NULL;
+
+  if(len < E131_HEADER_SIZE || 
+     memcmp(&data[E131_ID_OFFSET], E131_ID, sizeof(E131_ID)) != 0 ||
+     READ_BE32(&data[E131_ROOT_VECTOR_OFFSET]) != E131_ROOT_VECTOR ||
+     READ_BE32(&data[E131_FRAME_VECTOR_OFFSET]) != E131_FRAME_VECTOR ||
+     data[E131_DMP_VECTOR_OFFSET] != E131_DMP_VECTOR)
+  {
+    return 0u;
+  }
+
+  /* The count includes the start code. */
+  const uint16_t count = READ_BE16(&data[E131_COUNT_OFFSET]);
+  if(count < 1u || count > DMX_UNIVERSE_SIZE + 1u || 
+     len < E131_START_CODE_OFFSET + count)
+  {
+    return 0u;
+  }
+  const uint16_t num_of_slots = count - 1u;
+
+  /* Other universes, preview data, alternative start codes and terminated streams are 
+   * valid packets that are not applied.
+   */
+  const uint8_t options = data[E131_OPTIONS_OFFSET];
+  if(READ_BE16(&data[E131_UNIVERSE_OFFSET]) == DMX_E131_UNIVERSE &&
+     (options & (E131_OPTION_PREVIEW | E131_OPTION_TERMINATED)) == 0u &&
+     data[E131_START_CODE_OFFSET] == 0u)
+  {
+    *slots = &data[E131_HEADER_SIZE];
+    *sequence = data[E131_SEQUENCE_OFFSET];
+  }
+
+  return num_of_slots;
+}
+
+static bool check_sequence(const dmx_protocol protocol, const uint8_t sequence)
+{
+  /* Art-Net sources that do not number the packets send 0. */
+  if(protocol == DMX_PROTOCOL_ARTNET && sequence == 0u)
+  {
+    return true;
+  }
+
+  const int8_t distance = (int8_t)(sequence - last_sequences[protocol]);
+  if(any_sequence[protocol] && distance <= 0 && distance > -DMX_SEQUENCE_WINDOW)
+  {
+    taskENTER_CRITICAL(&dmx_lock);
+    dmx_stats.out_of_order++;
+    taskEXIT_CRITICAL(&dmx_lock);
+    return false;
+  }
+
+  last_sequences[protocol] = sequence;
+  any_sequence[protocol] = true;
+  return true;
+}
+
+static void measure_packet(const uint32_t process_us, const bool applied)
+{
+  const int64_t now_us = esp_timer_get_time();
+
+  taskENTER_CRITICAL(&dmx_lock);
+  dmx_stats.last_process_us = process_us;
+  if(process_us > dmx_stats.max_process_us)
+  {
+    dmx_stats.max_process_us = process_us;
+  }
+  if(applied)
+  {
+    dmx_stats.applied++;
+    window_packets++;
+  }
+
+  /* All the packets count in the load, also the ones that are not for this lamp. */
+  window_busy_us += process_us;
+  const int64_t window_us = now_us - window_start_us;
+  if(window_us >= DMX_LOAD_WINDOW_US)
+  {
+    dmx_stats.load_permille = (uint32_t)(((int64_t)window_busy_us * 1000) / window_us);
+    dmx_stats.packet_rate_hz = 
+      (uint32_t)(((int64_t)window_packets * 1000000) / window_us);
+    window_start_us = now_us;
+    window_busy_us = 0u;
+    window_packets = 0u;
+  }
+  taskEXIT_CRITICAL(&dmx_lock);
+}
@@ -0,0 +1,151 @@
+/**
+ * @file      Dmx.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This header file declares the functions to receive a DMX universe over 
+ *            Art-Net or sACN (E1.31) and to pass its slots to the LEDs.
+ */
+
+#ifndef CORE_DMX_H_
+#define CORE_DMX_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <stdint.h>
+#include <DMX_config.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* UDP ports of the protocols. */
+#define DMX_ARTNET_PORT 6454u
+#define DMX_E131_PORT   5568u
+
+/* Number of slots of a DMX universe. */
+#define DMX_UNIVERSE_SIZE 512u
+
+/* Number of slots that drive a LED. */
+#define DMX_SLOT_SIZE ((DMX_16_BIT_SLOTS == 1) ? 2u : 1u)
+
+/* Maximum number of channels that the mapping can drive, channel N drives the LED N. */
+#define DMX_MAX_CHANNELS                                                \
+  (((DMX_UNIVERSE_SIZE - DMX_START_ADDRESS + 1u) / DMX_SLOT_SIZE < 32u) ? \
+    (DMX_UNIVERSE_SIZE - DMX_START_ADDRESS + 1u) / DMX_SLOT_SIZE : 32u)
+
+/* Window in microseconds of the measured CPU load. */
+#define DMX_LOAD_WINDOW_US 1000000u
+
+/* List of the possible return codes that module DMX can return. */
+#define DMX_RETURNS                         \
+  /* Info codes */                          \
+  DMX_RETURN(CORE_DMX_OK)                   \
+  /* Error codes */                         \
+  DMX_RETURN(CORE_DMX_INIT_ERR)             \
+  DMX_RETURN(CORE_DMX_INIT_TASK_ERR)
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Structure that contains the statistics of the DMX receiver. */
+typedef struct
+{
+  /* Number of packets of the configured universe applied to the LEDs. */
+  uint32_t applied;
+  /* Number of packets discarded because they were not valid DMX data. */
+  uint32_t invalid;
+  /* Number of packets discarded because they arrived out of order. */
+  uint32_t out_of_order;
+  /* Number of packets that were not contiguous in the receive buffer and had to be
+   * copied.
+   */
+  uint32_t copied;
+  /* Time in microseconds to parse the last packet in the lwIP thread and to apply it
+   * in the DMX task, and its maximum.
+   */
+  uint32_t last_process_us;
+  uint32_t max_process_us;
+  /* Packets applied per second in the last DMX_LOAD_WINDOW_US. */
+  uint32_t packet_rate_hz;
+  /* Time spent in the receiver in the last DMX_LOAD_WINDOW_US, in per mille of a CPU. 
+   * The headroom of the CPU is 1000 minus this value.
+   */
+  uint32_t load_permille;
+  /* Number of packets replaced by a newer one before the DMX task applied them. It is
+   * the last field so the ones before keep their offsets in EXT_FRAME_GET_DMX_STATS.
+   */
+  uint32_t overwritten;
+} Dmx_stats;
+
+/* Enumerate that lists the posible return codes that the module can return. */
+typedef enum
+{
+  #define DMX_RETURN(enumerate) enumerate,
+    DMX_RETURNS
+  #undef DMX_RETURN
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_DMX_RETURNS,
+} Dmx_return;
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Starts the reception of the configured universe over the enabled protocols.
+ *        The packets are parsed in the lwIP thread straight from its receive buffers 
+ *        and the last levels are applied by the DMX task. It is mandatory to start the 
+ *        network before.
+ *
+ * @param void
+ *
+ * @return CORE_DMX_OK if the operation went well,
+ *         otherwise:
+ * 
+ *           - CORE_DMX_INIT_ERR: 
+ *               Error trying to start the reception in the lwIP thread.
+ * 
+ *           - CORE_DMX_INIT_TASK_ERR: 
+ *               Error trying to create the DMX task.
+ *                                      
+ */
+Dmx_return init_dmx(void);
+
+/**
+ * @brief Gets the statistics of the DMX receiver.
+ *
+ * @param stats Return statistics.
+ *
+ * @return void
+ */
+void get_dmx_stats(Dmx_stats *stats);
+
+/**
+ * @brief Prints the return of a DMX module function if the system was configured in 
+ *        debug mode.
+ *
+ * @param ret Received return from a DMX module function.
+ *
+ * @return The given return.
+ */
+Dmx_return core_dmx_LOG(const Dmx_return ret);
+
+/**
+ * @brief Function that will be called with every received universe. This function 
+ *        should be implemented in other application module. It is called from the DMX
+ *        task with the newest universe, the ones received while it runs are skipped.
+ *
+ * @param levels Level of every channel as a fraction of the full scale, from 0 to 
+ *               UINT16_MAX. The 8 bits slots are scaled to 16 bits.
+ * 
+ * @param num_of_channels Number of channels.
+ *
+ * @return void
+ */
+void __attribute__((weak)) dmx_levels_CB(const uint16_t *levels, 
+  const uint8_t num_of_channels);
+
+#endif /* CORE_DMX_H_ */
@@ -0,0 +1,480 @@
+/**
+ * @file      GUI_server.c
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This source file defines the functions of the WebSocket server of the GUI,
+ *            that keeps a connection open per GUI session to receive commands and to 
+ *            push the state of the lamps.
+ */
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <GUI_server.h>
+#include <TCP_server.h>
+#include <Notifier.h>
+#include <Debug.h>
+#include <System_tasks.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+#include <esp_http_server.h>
+#include "lwip/sockets.h"
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+#if DEBUG_MODE_ENABLE == 1
+/* Tag to show traces in GUI server module. */
+  #define TAG "CORE_GUI_SERVER"
+#endif
+
+/* Size of the header of the extended frames. */
+#define EXT_FRAME_HEADER_SIZE sizeof(Ext_frame_header)
+
+/* Size of the biggest message that a session can send, it must fit any kind of frame. */
+#define GUI_RX_BUFFER_SIZE                                                   \
+  ((TCP_COMMAND_SIZE > (EXT_FRAME_HEADER_SIZE + EXT_FRAME_MAX_PAYLOAD_SIZE)) ? \
+    TCP_COMMAND_SIZE : (EXT_FRAME_HEADER_SIZE + EXT_FRAME_MAX_PAYLOAD_SIZE))
+
+/* Value of the free entries of the sessions table. */
+#define GUI_NO_SESSION -1
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Structure that contains an open GUI session. */
+typedef struct
+{
+  /* Socket of the session, GUI_NO_SESSION if it is free. */
+  int fd;
+  /* Subscriber of the session. */
+  uint8_t subscriber;
+} GUI_session;
+
+/***************************************************************************************
+ * Global Variables
+ ***************************************************************************************/
+
+/* Handler of the HTTP server. */
+static httpd_handle_t GUI_server;
+
+/* Open GUI sessions. */
+static GUI_session sessions[GUI_SERVER_MAX_SESSIONS] = 
+{
+  [0 ... GUI_SERVER_MAX_SESSIONS - 1u] = 
+  {
+    .fd = GUI_NO_SESSION,
+    .subscriber = NOTIFIER_INVALID_SUBSCRIBER,
+  },
+};
+
+/* Timer that gathers the events before pushing them, and true while it runs. The flag
+ * is decided under the lock and the timer is started after leaving it.
+ */
+static esp_timer_handle_t push_timer;
+static bool push_pending;
+
+/* Lock that protects the sessions table and the pending push. */
+static portMUX_TYPE GUI_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Buffers of the received and sent messages. They are only used by the HTTP server 
+ * task, static to keep them out of its stack.
+ */
+static uint8_t rx_buf[GUI_RX_BUFFER_SIZE];
+static uint8_t tx_buf[EXT_FRAME_HEADER_SIZE + EXT_FRAME_MAX_REPLY_SIZE];
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Handler of the WebSocket endpoint. It opens the session on the handshake and
+ *        processes the frame of every received message.
+ *
+ * @param req Request of the HTTP server.
+ *
+ * @return ESP_OK to keep the session open, otherwise it is closed.
+ */
+static esp_err_t ws_handler(httpd_req_t *req);
+
+/**
+ * @brief Closes a socket of the HTTP server, removing its session if it had one.
+ *
+ * @param hd Handler of the HTTP server.
+ * 
+ * @param sockfd Socket to close.
+ *
+ * @return void
+ */
+static void close_session(httpd_handle_t hd, int sockfd);
+
+/**
+ * @brief Processes the frame of a message and writes the reply of the extended frames 
+ *        in tx_buf.
+ *
+ * @param session Session that received the message.
+ * 
+ * @param len Number of bytes of the message stored in rx_buf.
+ *
+ * @return Number of bytes of the reply, 0 to not reply.
+ */
+static size_t process_GUI_frame(GUI_session *session, const size_t len);
+
+/**
+ * @brief Writes the state of the lamps in tx_buf as an EXT_FRAME_GET_STATE reply.
+ *
+ * @param void
+ *
+ * @return Number of bytes of the message, 0 if the state is not available.
+ */
+static size_t build_state_message(void);
+
+/**
+ * @brief Starts the push timer, the events published during GUI_SERVER_PUSH_DELAY_US 
+ *        are pushed together. It is the wake function of the sessions, so it does not
+ *        block.
+ *
+ * @param arg Not used.
+ *
+ * @return void
+ */
+static void wake_GUI_server(void *arg);
+
+/**
+ * @brief Callback of the push timer, it passes the push to the HTTP server task.
+ *
+ * @param args arguments to pass to the function.
+ *
+ * @return void
+ */
+static void push_timer_callback(void *args);
+
+/**
+ * @brief Sends the pending events of every session, it runs in the HTTP server task.
+ *
+ * @param arg Not used.
+ *
+ * @return void
+ */
+static void push_state_work(void *arg);
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+GUI_server_return init_GUI_server(void)
+{
+  const esp_timer_create_args_t push_timer_args =
+  {
+    .callback = push_timer_callback,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "GUI_push",
+  };
+  if(esp_timer_create(&push_timer_args, &push_timer) != ESP_OK)
+  {
+    return CORE_GUI_SERVER_INIT_TIMER_ERR;
+  }
+
+  httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+  config.server_port = GUI_SERVER_PORT;
+  config.close_fn = close_session;
+  config.task_priority = SYSTEM_TASK_PRIORITY(SYSTEM_TASK_HTTPD);
+  config.core_id = SYSTEM_TASK_CORE(SYSTEM_TASK_HTTPD);
+  config.stack_size = SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_HTTPD);
+
+  const httpd_uri_t ws_uri =
+  {
+    .uri = GUI_SERVER_URI,
+    .method = HTTP_GET,
+    .handler = ws_handler,
+    .is_websocket = true,
+  };
+
+  if(httpd_start(&GUI_server, &config) != ESP_OK)
+  {
+    GUI_server = NULL;
+    return CORE_GUI_SERVER_INIT_ERR;
+  }
+
+  if(httpd_register_uri_handler(GUI_server, &ws_uri) != ESP_OK)
+  {
+    httpd_stop(GUI_server);
+    GUI_server = NULL;
+    return CORE_GUI_SERVER_INIT_ERR;
+  }
+
+  return CORE_GUI_SERVER_OK;
+}
+
+static void wake_GUI_server(void *arg)
+{
+  /* The timer is started only by the first event, the next ones go in its push. */
+  taskENTER_CRITICAL(&GUI_lock);
+  const bool start_push = !push_pending;
+  push_pending = true;
+  taskEXIT_CRITICAL(&GUI_lock);
+
+  /* If the timer can not start, the next event tries it again. */
+  if(start_push && esp_timer_start_once(push_timer, GUI_SERVER_PUSH_DELAY_US) != ESP_OK)
+  {
+    taskENTER_CRITICAL(&GUI_lock);
+    push_pending = false;
+    taskEXIT_CRITICAL(&GUI_lock);
+  }
+}
+
+inline GUI_server_return core_GUI_server_LOG(const GUI_server_return ret)
+{
+  #if DEBUG_MODE_ENABLE == 1
+    switch(ret)
+    {
+      #define GUI_SERVER_RETURN(enumerate) \
+        case enumerate:                    \
+          if(ret > 0)                      \
+          {                                \
+            ESP_LOGE(TAG, #enumerate);     \
+          }                                \
+          else                             \
+          {                                \
+            ESP_LOGI(TAG, #enumerate);     \
+          }                                \
+          break;       
+        GUI_SERVER_RETURNS
+      #undef GUI_SERVER_RETURN
+      default:
+        ESP_LOGE(TAG, "Unkown return.");
+        break;
+    }
+  #endif
+  return ret;
+}
+
+static esp_err_t ws_handler(httpd_req_t *req)
+{
+  const int sockfd = httpd_req_to_sockfd(req);
+
+  GUI_session *session = NULL;
+  for(uint8_t i = 0u; i < GUI_SERVER_MAX_SESSIONS && session == NULL; i++)
+  {
+    if(sessions[i].fd == sockfd)
+    {
+      session = &sessions[i];
+    }
+  }
+
+  /* The handshake opens the session, it gets the state right away and the changes 
+   * from then on.
+   */
+  if(req->method == HTTP_GET)
+  {
+    for(uint8_t i = 0u; i < GUI_SERVER_MAX_SESSIONS && session == NULL; i++)
+    {
+      if(sessions[i].fd == GUI_NO_SESSION)
+      {
+        session = &sessions[i];
+      }
+    }
+
+    if(session != NULL)
+    {
+      session->subscriber = notifier_subscribe(wake_GUI_server, NULL);
+      if(session->subscriber != NOTIFIER_INVALID_SUBSCRIBER)
+      {
+        session->fd = sockfd;
+      }
+    }
+
+    if(session == NULL || session->subscriber == NOTIFIER_INVALID_SUBSCRIBER)
+    {
+      #if DEBUG_MODE_ENABLE == 1
+        ESP_LOGE(TAG, "No free GUI sessions.");
+      #endif
+      return ESP_FAIL;
+    }
+
+    httpd_ws_frame_t state = 
+    {
+      .final = true,
+      .type = HTTPD_WS_TYPE_BINARY,
+      .payload = tx_buf,
+      .len = build_state_message(),
+    };
+    if(state.len > 0u)
+    {
+      httpd_ws_send_frame(req, &state);
+    }
+    return ESP_OK;
+  }
+
+  /* The length is read first to check that the message fits. */
+  httpd_ws_frame_t frame = { .type = HTTPD_WS_TYPE_BINARY };
+  if(httpd_ws_recv_frame(req, &frame, 0u) != ESP_OK || frame.len > sizeof(rx_buf))
+  {
+    return ESP_FAIL;
+  }
+
+  frame.payload = rx_buf;
+  if(frame.len > 0u && httpd_ws_recv_frame(req, &frame, frame.len) != ESP_OK)
+  {
+    return ESP_FAIL;
+  }
+
+  if(frame.type != HTTPD_WS_TYPE_BINARY || session == NULL)
+  {
+    return ESP_OK;
+  }
+
+  /* The frame callbacks get the address of the GUI as any other client. */
+  struct sockaddr_in source_addr;
+  socklen_t source_addr_len = sizeof(source_addr);
+  set_TCP_client_IP(
+    (getpeername(sockfd, (struct sockaddr *)&source_addr, &source_addr_len) == 0) ?
+      source_addr.sin_addr.s_addr : 0u);
+
+  httpd_ws_frame_t reply = 
+  {
+    .final = true,
+    .type = HTTPD_WS_TYPE_BINARY,
+    .payload = tx_buf,
+    .len = process_GUI_frame(session, frame.len),
+  };
+  if(reply.len > 0u && httpd_ws_send_frame(req, &reply) != ESP_OK)
+  {
+    return ESP_FAIL;
+  }
+
+  return ESP_OK;
+}
+
+static void close_session(httpd_handle_t hd, int sockfd)
+{
+  for(uint8_t i = 0u; i < GUI_SERVER_MAX_SESSIONS; i++)
+  {
+    if(sessions[i].fd == sockfd)
+    {
+      notifier_unsubscribe(sessions[i].subscriber);
+      sessions[i].subscriber = NOTIFIER_INVALID_SUBSCRIBER;
+      sessions[i].fd = GUI_NO_SESSION;
+    }
+  }
+
+  close(sockfd);
+}
+
+static size_t process_GUI_frame(GUI_session *session, const size_t len)
+{
+  Ext_frame_header header;
+
+  if(len >= EXT_FRAME_HEADER_SIZE && rx_buf[0] == EXT_FRAME_START_BYTE)
+  {
+    memcpy(&header, rx_buf, EXT_FRAME_HEADER_SIZE);
+    if(header.type >= NUM_OF_EXT_FRAMES || len != EXT_FRAME_HEADER_SIZE + header.len)
+    {
+      #if DEBUG_MODE_ENABLE == 1
+        ESP_LOGE(TAG, "Received invalid extended frame.");
+      #endif
+      return 0u;
+    }
+
+    /* The sessions are always subscribed, the subscription frames are acknowledged 
+     * without changing it.
+     */
+    if(header.type == EXT_FRAME_SUBSCRIBE)
+    {
+      tx_buf[EXT_FRAME_HEADER_SIZE] = 
+        (session->subscriber != NOTIFIER_INVALID_SUBSCRIBER) ? 1u : 0u;
+      header.len = 1u;
+    }
+    else
+    {
+      header.len = RX_ext_command_frame((Ext_frame_type)header.type, 
+        &rx_buf[EXT_FRAME_HEADER_SIZE], header.len, &tx_buf[EXT_FRAME_HEADER_SIZE], 
+        EXT_FRAME_MAX_REPLY_SIZE);
+    }
+    if(header.len == 0u)
+    {
+      return 0u;
+    }
+
+    memcpy(tx_buf, &header, EXT_FRAME_HEADER_SIZE);
+    return EXT_FRAME_HEADER_SIZE + header.len;
+  }
+
+  if(len == TCP_COMMAND_SIZE)
+  {
+    TCP_COMMAND_TYPE cmd;
+    memcpy((void*)&cmd, rx_buf, TCP_COMMAND_SIZE);
+    RX_command_frame(cmd);
+  }
+  else
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Received invalid frame.");
+    #endif
+  }
+
+  return 0u;
+}
+
+static size_t build_state_message(void)
+{
+  const Ext_frame_header header =
+  {
+    .start = EXT_FRAME_START_BYTE,
+    .type = EXT_FRAME_GET_STATE,
+    .len = RX_ext_command_frame(EXT_FRAME_GET_STATE, NULL, 0u, 
+             &tx_buf[EXT_FRAME_HEADER_SIZE], EXT_FRAME_MAX_REPLY_SIZE),
+  };
+  if(header.len == 0u)
+  {
+    return 0u;
+  }
+
+  memcpy(tx_buf, &header, EXT_FRAME_HEADER_SIZE);
+  return EXT_FRAME_HEADER_SIZE + header.len;
+}
+
+static void push_timer_callback(void *args)
+{
+  /* The sessions are only written by the HTTP server task. */
+  if(httpd_queue_work(GUI_server, push_state_work, NULL) != ESP_OK)
+  {
+    taskENTER_CRITICAL(&GUI_lock);
+    push_pending = false;
+    taskEXIT_CRITICAL(&GUI_lock);
+  }
+}
+
+static void push_state_work(void *arg)
+{
+  /* The events from now on need another push. */
+  taskENTER_CRITICAL(&GUI_lock);
+  push_pending = false;
+  taskEXIT_CRITICAL(&GUI_lock);
+
+  /* The sessions are opened and closed in this task too. */
+  for(uint8_t i = 0u; i < GUI_SERVER_MAX_SESSIONS; i++)
+  {
+    if(sessions[i].fd == GUI_NO_SESSION)
+    {
+      continue;
+    }
+
+    httpd_ws_frame_t events = 
+    {
+      .final = true,
+      .type = HTTPD_WS_TYPE_BINARY,
+      .payload = tx_buf,
+      .len = build_state_events_frame(sessions[i].subscriber, tx_buf, sizeof(tx_buf)),
+    };
+    if(events.len > 0u &&
+       httpd_ws_get_fd_info(GUI_server, sessions[i].fd) == HTTPD_WS_CLIENT_WEBSOCKET)
+    {
+      httpd_ws_send_frame_async(GUI_server, sessions[i].fd, &events);
+    }
+  }
+}
@@ -0,0 +1,92 @@
+/**
+ * @file      GUI_server.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This header file declares the functions of the WebSocket server of the GUI,
+ *            that keeps a connection open per GUI session to receive commands and to 
+ *            push the state of the lamps.
+ */
+
+#ifndef CORE_GUI_SERVER_H_
+#define CORE_GUI_SERVER_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <stdint.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* HTTP port and URI of the WebSocket endpoint. */
+#define GUI_SERVER_PORT 80u
+#define GUI_SERVER_URI  "/ws"
+
+/* Maximum number of GUI sessions open at the same time. */
+#define GUI_SERVER_MAX_SESSIONS 4u
+
+/* Time in microseconds that the events are gathered before pushing them. */
+#define GUI_SERVER_PUSH_DELAY_US 20000u
+
+/* List of the possible return codes that module GUI server can return. */
+#define GUI_SERVER_RETURNS                          \
+  /* Info codes */                                  \
+  GUI_SERVER_RETURN(CORE_GUI_SERVER_OK)             \
+  /* Error codes */                                 \
+  GUI_SERVER_RETURN(CORE_GUI_SERVER_INIT_TIMER_ERR) \
+  GUI_SERVER_RETURN(CORE_GUI_SERVER_INIT_ERR)
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Enumerate that lists the posible return codes that the module can return. */
+typedef enum
+{
+  #define GUI_SERVER_RETURN(enumerate) enumerate,
+    GUI_SERVER_RETURNS
+  #undef GUI_SERVER_RETURN
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_GUI_SERVER_RETURNS,
+} GUI_server_return;
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Starts the HTTP server with the WebSocket endpoint of the GUI. Every binary 
+ *        message of a session carries one frame, extended (Ext_frame_header) or legacy 
+ *        (TCP_COMMAND_TYPE), and the replies of the extended frames are sent back on 
+ *        the same session. The state of the lamps is sent as an EXT_FRAME_GET_STATE 
+ *        reply when the session is opened, and the session is subscribed to its 
+ *        changes, that are pushed as EXT_FRAME_STATE_EVENTS frames. It is mandatory to
+ *        start the network before.
+ *
+ * @param void
+ *
+ * @return CORE_GUI_SERVER_OK if the operation went well,
+ *         otherwise:
+ * 
+ *           - CORE_GUI_SERVER_INIT_TIMER_ERR: 
+ *               Error trying to create the push timer.
+ * 
+ *           - CORE_GUI_SERVER_INIT_ERR: 
+ *               Error trying to start the HTTP server.
+ *                                      
+ */
+GUI_server_return init_GUI_server(void);
+
+/**
+ * @brief Prints the return of a GUI server module function if the system was 
+ *        configured in debug mode.
+ *
+ * @param ret Received return from a GUI server module function.
+ *
+ * @return The given return.
+ */
+GUI_server_return core_GUI_server_LOG(const GUI_server_return ret);
+
+#endif /* CORE_GUI_SERVER_H_ */
@@ -0,0 +1,268 @@
+/**
+ * @file      Gesture.c
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This source file defines the functions to classify the edges of a button
+ *            in gestures (clicks, long presses and holds).
+ */
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <Gesture.h>
+#include <stddef.h>
+#include <string.h>
+#include <esp_attr.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Times of the gestures in microseconds. */
+#define DEBOUNCE_US        (GESTURE_DEBOUNCE_MS * 1000u)
+#define CLICK_MAX_US       (GESTURE_CLICK_MAX_MS * 1000u)
+#define MULTI_CLICK_GAP_US (GESTURE_MULTI_CLICK_GAP_MS * 1000u)
+#define HOLD_US            (GESTURE_HOLD_MS * 1000u)
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Applies an edge to the detector.
+ *
+ * @param detector Detector of the button.
+ * 
+ * @param edge Edge to apply.
+ * 
+ * @param gestures Array where the detected gestures are added.
+ * 
+ * @param num_of_gestures Number of gestures in the array.
+ *
+ * @return void
+ */
+static void apply_edge(Gesture_detector *detector, const Gesture_edge edge, 
+  Gesture *gestures, uint32_t *num_of_gestures);
+
+/**
+ * @brief Reports the clicks of the current sequence.
+ *
+ * @param detector Detector of the button.
+ * 
+ * @param gestures Array where the detected gestures are added.
+ * 
+ * @param num_of_gestures Number of gestures in the array.
+ *
+ * @return void
+ */
+static void report_clicks(Gesture_detector *detector, Gesture *gestures, 
+  uint32_t *num_of_gestures);
+
+/**
+ * @brief Returns the microseconds left until a deadline.
+ *
+ * @param now_us Current time in microseconds.
+ * 
+ * @param deadline_us Deadline in microseconds.
+ *
+ * @return Microseconds left, 0 if the deadline has passed.
+ */
+static uint32_t time_left_us(const uint32_t now_us, const uint32_t deadline_us);
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+void gesture_init(Gesture_detector *detector)
+{
+  memset(detector, 0, sizeof(*detector));
+
+  /* The first edge is accepted even if it happens right after the boot. */
+  detector->last_edge_us = 0u - DEBOUNCE_US;
+}
+
+void IRAM_ATTR gesture_record_edge_from_ISR(Gesture_detector *detector, 
+  const bool pressed, const uint32_t time_us)
+{
+  const uint32_t head = detector->head;
+  const uint32_t tail = __atomic_load_n(&detector->tail, __ATOMIC_ACQUIRE);
+
+  if(head - tail >= GESTURE_EDGES_RING_SIZE)
+  {
+    detector->lost_edges++;
+    return;
+  }
+
+  detector->edges[head & (GESTURE_EDGES_RING_SIZE - 1u)].time_us = time_us;
+  detector->edges[head & (GESTURE_EDGES_RING_SIZE - 1u)].pressed = pressed;
+
+  /* Publish the edge after writing it. */
+  __atomic_store_n(&detector->head, head + 1u, __ATOMIC_RELEASE);
+}
+
+uint32_t gesture_process(Gesture_detector *detector, const bool pressed_now, 
+  const uint32_t now_us, Gesture *gestures, uint32_t *num_of_gestures)
+{
+
+  *num_of_gestures = 0u;
+
+  /* Apply the recorded edges in order. */
+  const uint32_t head = __atomic_load_n(&detector->head, __ATOMIC_ACQUIRE);
+  uint32_t tail = detector->tail;
+  while(tail != head)
+  {
+    const Gesture_edge edge = detector->edges[tail & (GESTURE_EDGES_RING_SIZE - 1u)];
+    tail++;
+    apply_edge(detector, edge, gestures, num_of_gestures);
+  }
+  __atomic_store_n(&detector->tail, tail, __ATOMIC_RELEASE);
+
+  /* The interruption can miss an edge that happens inside its own debounce window, 
+   * recover it once the window is over.
+   */
+  if(pressed_now != detector->pressed && 
+     now_us - detector->last_edge_us >= DEBOUNCE_US)
+  {
+    const Gesture_edge edge = 
+    {
+      .time_us = detector->last_edge_us + DEBOUNCE_US,
+      .pressed = pressed_now,
+    };
+    apply_edge(detector, edge, gestures, num_of_gestures);
+  }
+
+  /* Gestures that finish with the time. */
+  if(detector->pressed && !detector->holding && now_us - detector->press_us >= HOLD_US)
+  {
+    detector->holding = true;
+    detector->clicks = 0u;
+    gestures[(*num_of_gestures)++] = GESTURE_HOLD_START;
+  }
+  else if(!detector->pressed && detector->clicks > 0u &&
+          now_us - detector->release_us >= MULTI_CLICK_GAP_US)
+  {
+    report_clicks(detector, gestures, num_of_gestures);
+  }
+
+  /* Time until the next gesture that can finish without a new edge. The level is read
+   * again at the end of every debounce window in case the last bounce was not reported.
+   */
+  uint32_t timeout_us = UINT32_MAX;
+  if(now_us - detector->last_edge_us < DEBOUNCE_US)
+  {
+    timeout_us = time_left_us(now_us, detector->last_edge_us + DEBOUNCE_US);
+  }
+
+  uint32_t deadline_left_us = UINT32_MAX;
+  if(detector->pressed && !detector->holding)
+  {
+    deadline_left_us = time_left_us(now_us, detector->press_us + HOLD_US);
+  }
+  else if(detector->clicks > 0u)
+  {
+    deadline_left_us = time_left_us(now_us, detector->release_us + MULTI_CLICK_GAP_US);
+  }
+
+  if(deadline_left_us < timeout_us)
+  {
+    timeout_us = deadline_left_us;
+  }
+
+  if(timeout_us == UINT32_MAX)
+  {
+    return GESTURE_NO_TIMEOUT;
+  }
+
+  /* Round up so the deadline has passed when the caller wakes up. */
+  return (timeout_us + 999u) / 1000u;
+}
+
+static void apply_edge(Gesture_detector *detector, const Gesture_edge edge, 
+  Gesture *gestures, uint32_t *num_of_gestures)
+{
+
+  /* Repeated levels and bounces are discarded. */
+  if(edge.pressed == detector->pressed || 
+     edge.time_us - detector->last_edge_us < DEBOUNCE_US)
+  {
+    return;
+  }
+
+  detector->last_edge_us = edge.time_us;
+  detector->pressed = edge.pressed;
+
+  if(edge.pressed)
+  {
+    /* A sequence that expired before this press is reported first. */
+    if(detector->clicks > 0u && edge.time_us - detector->release_us >= MULTI_CLICK_GAP_US)
+    {
+      report_clicks(detector, gestures, num_of_gestures);
+    }
+
+    detector->press_us = edge.time_us;
+    if(detector->clicks == 0u)
+    {
+      gestures[(*num_of_gestures)++] = GESTURE_PRESS;
+    }
+    return;
+  }
+
+  detector->release_us = edge.time_us;
+  const uint32_t press_duration_us = edge.time_us - detector->press_us;
+
+  if(detector->holding)
+  {
+    detector->holding = false;
+    detector->clicks = 0u;
+    gestures[(*num_of_gestures)++] = GESTURE_HOLD_END;
+  }
+  else if(press_duration_us < CLICK_MAX_US)
+  {
+    detector->clicks++;
+    if(detector->clicks == 3u)
+    {
+      report_clicks(detector, gestures, num_of_gestures);
+    }
+  }
+  else if(press_duration_us < HOLD_US)
+  {
+    detector->clicks = 0u;
+    gestures[(*num_of_gestures)++] = GESTURE_LONG_PRESS;
+  }
+  else
+  {
+    /* The hold was not reported yet because the task did not run in time. */
+    detector->clicks = 0u;
+    gestures[(*num_of_gestures)++] = GESTURE_HOLD_START;
+    gestures[(*num_of_gestures)++] = GESTURE_HOLD_END;
+  }
+}
+
+static void report_clicks(Gesture_detector *detector, Gesture *gestures, 
+  uint32_t *num_of_gestures)
+{
+  switch(detector->clicks)
+  {
+    case 1u:
+      gestures[(*num_of_gestures)++] = GESTURE_SINGLE_CLICK;
+      break;
+    case 2u:
+      gestures[(*num_of_gestures)++] = GESTURE_DOUBLE_CLICK;
+      break;
+    case 3u:
+      gestures[(*num_of_gestures)++] = GESTURE_TRIPLE_CLICK;
+      break;
+    default:
+      break;
+  }
+
+  detector->clicks = 0u;
+}
+
+static uint32_t time_left_us(const uint32_t now_us, const uint32_t deadline_us)
+{
+  /* Signed difference to survive the wrap around of the microseconds counter. */
+  const int32_t left = (int32_t)(deadline_us - now_us);
+  return (left > 0) ? (uint32_t)left : 0u;
+}
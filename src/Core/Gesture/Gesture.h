@@ -0,0 +1,174 @@
+/**
+ * @file      Gesture.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This header file declares the functions to classify the edges of a button
+ *            in gestures (clicks, long presses and holds).
+ */
+
+#ifndef CORE_GESTURE_H_
+#define CORE_GESTURE_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Minimum time in milliseconds between two edges of the button, faster edges are 
+ * considered noise.
+ */
+#define GESTURE_DEBOUNCE_MS 30u
+
+/* Maximum time in milliseconds that the button can be pressed to count as a click. */
+#define GESTURE_CLICK_MAX_MS 300u
+
+/* Maximum time in milliseconds between the release of a click and the next press to
+ * count both in the same multiple click.
+ */
+#define GESTURE_MULTI_CLICK_GAP_MS 250u
+
+/* Time in milliseconds that the button must be pressed to start a hold. Presses released
+ * between GESTURE_CLICK_MAX_MS and this time are long presses. The detector does not 
+ * wake up while the button is held, the user of GESTURE_HOLD_START drives its own 
+ * cadence until GESTURE_HOLD_END.
+ */
+#define GESTURE_HOLD_MS 800u
+
+/* Number of edges that the ring between the ISR and the task can store. It is mandatory
+ * to use a power of 2.
+ */
+#define GESTURE_EDGES_RING_SIZE 16u
+
+/* Value returned by gesture_process when there is no need to call it again until a new
+ * edge arrives.
+ */
+#define GESTURE_NO_TIMEOUT UINT32_MAX
+
+/* Maximum number of gestures that a single call to gesture_process can report. Every 
+ * edge can report up to two gestures.
+ */
+#define GESTURE_MAX_EVENTS (2u * (GESTURE_EDGES_RING_SIZE + 1u) + 1u)
+
+#if (GESTURE_EDGES_RING_SIZE & (GESTURE_EDGES_RING_SIZE - 1u)) != 0u
+  #error "Invalid ring size, it must be a power of 2:"
+  #error "refer to (GESTURE_EDGES_RING_SIZE)"
+#endif
+
+/* Macro that enlist the gestures that can be detected. It is mandatory to not set 
+ * values to the enumerates. GESTURE_PRESS is the first press of a sequence and it is 
+ * reported as soon as it is detected, the rest are reported when they finish.
+ */
+#define GESTURES                      \
+  GESTURE(GESTURE_PRESS)              \
+  GESTURE(GESTURE_SINGLE_CLICK)       \
+  GESTURE(GESTURE_DOUBLE_CLICK)       \
+  GESTURE(GESTURE_TRIPLE_CLICK)       \
+  GESTURE(GESTURE_LONG_PRESS)         \
+  GESTURE(GESTURE_HOLD_START)         \
+  GESTURE(GESTURE_HOLD_END)
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Enumerate that enlist the gestures. */
+typedef enum
+{
+  #define GESTURE(enumerate) enumerate,
+    GESTURES
+  #undef GESTURE
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_GESTURES,
+} Gesture;
+
+/* Structure that contains an edge of the button. */
+typedef struct
+{
+  /* Time in microseconds of the edge. */
+  uint32_t time_us;
+  /* True if the button is pressed after the edge. */
+  bool pressed;
+} Gesture_edge;
+
+/* Structure that contains the state of the gesture detector of a button. */
+typedef struct
+{
+  /* Ring of edges, written by the ISR and read by the task. */
+  Gesture_edge edges[GESTURE_EDGES_RING_SIZE];
+  /* Index of the next edge to write, only modified by the ISR. */
+  uint32_t head;
+  /* Index of the next edge to read, only modified by the task. */
+  uint32_t tail;
+  /* Number of edges lost because the ring was full. */
+  uint32_t lost_edges;
+  /* Debounced state of the button. */
+  bool pressed;
+  /* Time in microseconds of the last accepted edge. */
+  uint32_t last_edge_us;
+  /* Time in microseconds of the last press. */
+  uint32_t press_us;
+  /* Time in microseconds of the last release. */
+  uint32_t release_us;
+  /* Number of clicks of the current sequence. */
+  uint8_t clicks;
+  /* True if the button is being held. */
+  bool holding;
+} Gesture_detector;
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Initializes a gesture detector.
+ *
+ * @param detector Detector to initialize.
+ *
+ * @return void
+ */
+void gesture_init(Gesture_detector *detector);
+
+/**
+ * @brief Records an edge of the button. It is meant to be called from the button ISR,
+ *        it only writes the edge in the ring.
+ *
+ * @param detector Detector of the button.
+ * 
+ * @param pressed True if the button is pressed after the edge.
+ * 
+ * @param time_us Time in microseconds of the edge.
+ *
+ * @return void
+ */
+void gesture_record_edge_from_ISR(Gesture_detector *detector, const bool pressed,
+  const uint32_t time_us);
+
+/**
+ * @brief Classifies the recorded edges and the elapsed time in gestures. It is meant to
+ *        be called from a task every time an edge is recorded or the returned timeout 
+ *        expires.
+ *
+ * @param detector Detector of the button.
+ * 
+ * @param pressed_now True if the button is pressed now. It recovers edges that the 
+ *                    button interruption did not report.
+ * 
+ * @param now_us Current time in microseconds.
+ * 
+ * @param gestures Return array of detected gestures, it must have GESTURE_MAX_EVENTS
+ *                 elements.
+ * 
+ * @param num_of_gestures Return number of detected gestures.
+ *
+ * @return Milliseconds until the next call or GESTURE_NO_TIMEOUT.
+ */
+uint32_t gesture_process(Gesture_detector *detector, const bool pressed_now, 
+  const uint32_t now_us, Gesture *gestures, uint32_t *num_of_gestures);
+
+#endif /* CORE_GESTURE_H_ */
@@ -0,0 +1,417 @@
+/**
+ * @file      Hardware_map.c
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This source file defines the functions to load the hardware map of the
+ *            installation from a flash partition.
+ */
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <Hardware_map.h>
+#include <Debug.h>
+#include <string.h>
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+#if DEBUG_MODE_ENABLE == 1
+  /* Tag to show traces in hardware map Core module. */
+  #define TAG "CORE_HARDWARE_MAP"
+#endif
+
+/* Value of the first field of an erased partition. */
+#define ERASED_MAGIC UINT32_MAX
+
+/***************************************************************************************
+ * Global Variables
+ ***************************************************************************************/
+
+/* Array that contains the physical connection of each button, the compiled one until a
+ * map replaces it.
+ */
+static Hardware_map_button buttons_map[NUM_OF_BUTTONS] =
+{
+  #define BUTTON_CONFIG(BUTTON_ID, GPIO_NUM, PULL_MODE, INTR_TYPE, DEBOUNCE_MS) \
+    [BUTTON_ID] = { .GPIO = (GPIO_NUM), .pull_mode = (PULL_MODE),              \
+                    .intr_type = (INTR_TYPE), .debounce_ms = (DEBOUNCE_MS) },
+    BUTTONS_CONFIGURATIONS
+  #undef BUTTON_CONFIG
+};
+
+/* Array that contains the button and the LED of each lamp, the compiled ones until a
+ * map replaces them.
+ */
+static Hardware_map_lamp lamps_map[NUM_OF_LAMPS] =
+{
+  #define LAMP_CONNECTION(LAMP_ID, BUTTON_ID, LED_ID) \
+    [LAMP_ID] = { .button = (BUTTON_ID), .LED = (LED_ID) },
+    LAMPS_CONNECTIONS
+  #undef LAMP_CONNECTION
+};
+
+/* Array that contains the compiled physical connection of each LED, the map is checked
+ * against them before it replaces any of them.
+ */
+static const LED_connection compiled_LEDs[NUM_OF_LEDS] =
+{
+  #define LED_CONFIG(LED_ID, LED_GPIO_ID, LED_GPIO_PULL_MODE, LED_TIMER, PWM_SPEED, \
+                     PWM_CHAN, PWM_RESOL, PWM_FREQ, PWM_CLK)                        \
+    [LED_ID] = { .GPIO = (LED_GPIO_ID), .pull_mode = (LED_GPIO_PULL_MODE),          \
+                 .timer = (LED_TIMER), .speed_mode = (PWM_SPEED),                   \
+                 .channel = (PWM_CHAN), .resolution = (PWM_RESOL),                  \
+                 .freq_hz = (PWM_FREQ), .clock = (PWM_CLK) },
+    LED_CONFIGURATIONS
+  #undef LED_CONFIG
+};
+
+/* The identifiers are stored in a byte of the records. */
+_Static_assert(NUM_OF_LEDS <= UINT8_MAX && NUM_OF_BUTTONS <= UINT8_MAX &&
+  NUM_OF_LAMPS <= UINT8_MAX, "The identifiers do not fit in the map records");
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Checks a map and applies its records. The records are checked before applying
+ *        any of them, so an invalid map keeps all the compiled connections.
+ *
+ * @param map Bytes of the map.
+ *
+ * @param size Number of bytes of the map, the size of the partition.
+ *
+ * @return CORE_HARDWARE_MAP_OK if the map was applied, otherwise the error.
+ */
+static Hardware_map_return load_hardware_map(const uint8_t *map, const size_t size);
+
+/**
+ * @brief Checks that a record describes an existing element with valid values.
+ *
+ * @param record Record to check.
+ *
+ * @return True if the record is valid, otherwise false.
+ */
+static bool check_record(const Hardware_map_record *record);
+
+/**
+ * @brief Checks the LEDs that result of applying the records of a map over the compiled
+ *        ones: two LEDs can not share a channel and the LEDs that share a timer must
+ *        end up with the same clock source, resolution and frequency.
+ *
+ * @param records Records of the map, they must be checked before.
+ *
+ * @param num_of_records Number of records of the map.
+ *
+ * @return True if the LEDs are valid, otherwise false.
+ */
+static bool check_LEDs_map(const Hardware_map_record *records,
+  const uint16_t num_of_records);
+
+/**
+ * @brief Gets the physical connection of the LED of a record.
+ *
+ * @param record Record of a LED.
+ *
+ * @param connection Return connection of the LED.
+ *
+ * @return void
+ */
+static void get_record_LED_connection(const Hardware_map_record *record,
+  LED_connection *connection);
+
+/**
+ * @brief Replaces the connection of the element of a record.
+ *
+ * @param record Record to apply, it must be checked before.
+ *
+ * @return True if the operation went well, otherwise false.
+ */
+static bool apply_record(const Hardware_map_record *record);
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+Hardware_map_return init_hardware_map(void)
+{
+  const void *map;
+  esp_partition_mmap_handle_t map_handle;
+
+  const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+    HARDWARE_MAP_PARTITION_SUBTYPE, HARDWARE_MAP_PARTITION_LABEL);
+  if(partition == NULL)
+  {
+    return CORE_HARDWARE_MAP_NO_PARTITION_ERR;
+  }
+
+  /* The map is read in place from the flash cache, it is only mapped while loading. */
+  if(esp_partition_mmap(partition, 0u, partition->size, ESP_PARTITION_MMAP_DATA, &map,
+     &map_handle) != ESP_OK)
+  {
+    return CORE_HARDWARE_MAP_MMAP_ERR;
+  }
+
+  const Hardware_map_return ret = load_hardware_map((const uint8_t *)map,
+    partition->size);
+  esp_partition_munmap(map_handle);
+
+  return ret;
+}
+
+Hardware_map_return get_hardware_map_button(const Button_ID ID,
+  Hardware_map_button *button)
+{
+  if(ID >= NUM_OF_BUTTONS)
+  {
+    return CORE_HARDWARE_MAP_UNKOWN_ID_ERR;
+  }
+
+  *button = buttons_map[ID];
+  return CORE_HARDWARE_MAP_OK;
+}
+
+Hardware_map_return get_hardware_map_lamp(const Lamp_ID ID, Button_ID *button,
+  LED_ID *LED)
+{
+  if(ID >= NUM_OF_LAMPS)
+  {
+    return CORE_HARDWARE_MAP_UNKOWN_ID_ERR;
+  }
+
+  *button = (Button_ID)lamps_map[ID].button;
+  *LED = (LED_ID)lamps_map[ID].LED;
+  return CORE_HARDWARE_MAP_OK;
+}
+
+inline Hardware_map_return core_hardware_map_LOG(const Hardware_map_return ret)
+{
+  #if DEBUG_MODE_ENABLE == 1
+    switch(ret)
+    {
+      #define HARDWARE_MAP_RETURN(enumerate) \
+        case enumerate:                      \
+          if(ret > 0)                        \
+          {                                  \
+            ESP_LOGE(TAG, #enumerate);       \
+          }                                  \
+          else                               \
+          {                                  \
+            ESP_LOGI(TAG, #enumerate);       \
+          }                                  \
+          break;
+        HARDWARE_MAP_RETURNS
+      #undef HARDWARE_MAP_RETURN
+      default:
+        ESP_LOGE(TAG, "Unkown return.");
+        break;
+    }
+  #endif
+  return ret;
+}
+
+static Hardware_map_return load_hardware_map(const uint8_t *map, const size_t size)
+{
+  Hardware_map_header header;
+
+  if(size < sizeof(header))
+  {
+    return CORE_HARDWARE_MAP_INVALID_ERR;
+  }
+  memcpy(&header, map, sizeof(header));
+
+  if(header.magic == ERASED_MAGIC)
+  {
+    return CORE_HARDWARE_MAP_EMPTY_ERR;
+  }
+
+  const size_t records_size = (size_t)header.num_of_records * sizeof(Hardware_map_record);
+  if(header.magic != HARDWARE_MAP_MAGIC || header.version != HARDWARE_MAP_VERSION ||
+     records_size > size - sizeof(header))
+  {
+    return CORE_HARDWARE_MAP_INVALID_ERR;
+  }
+
+  const Hardware_map_record *records =
+    (const Hardware_map_record *)&map[sizeof(header)];
+  if(esp_rom_crc32_le(0u, (const uint8_t *)records, records_size) != header.crc)
+  {
+    return CORE_HARDWARE_MAP_INVALID_ERR;
+  }
+
+  /* One pass to check all the records and another one to apply them. */
+  for(uint16_t i = 0u; i < header.num_of_records; i++)
+  {
+    if(!check_record(&records[i]))
+    {
+      #if DEBUG_MODE_ENABLE == 1
+        ESP_LOGE(TAG, "Invalid record %u.", (unsigned)i);
+      #endif
+      return CORE_HARDWARE_MAP_INVALID_ERR;
+    }
+  }
+
+  if(!check_LEDs_map(records, header.num_of_records))
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Two LEDs share a channel or a timer with other PWM.");
+    #endif
+    return CORE_HARDWARE_MAP_INVALID_ERR;
+  }
+
+  for(uint16_t i = 0u; i < header.num_of_records; i++)
+  {
+    if(!apply_record(&records[i]))
+    {
+      return CORE_HARDWARE_MAP_APPLY_ERR;
+    }
+  }
+
+  return CORE_HARDWARE_MAP_OK;
+}
+
+static bool check_record(const Hardware_map_record *record)
+{
+  switch(record->kind)
+  {
+    case HARDWARE_MAP_LED:
+    {
+      if(record->ID >= NUM_OF_LEDS ||
+         !GPIO_IS_VALID_OUTPUT_GPIO(record->LED.GPIO) ||
+         record->LED.pull_mode > GPIO_FLOATING ||
+         record->LED.timer >= LEDC_TIMER_MAX ||
+         record->LED.speed_mode >= LEDC_SPEED_MODE_MAX ||
+         record->LED.channel >= LEDC_CHANNEL_MAX ||
+         record->LED.resolution >= LEDC_TIMER_BIT_MAX)
+      {
+        return false;
+      }
+
+      /* The clock source must reach the resolution and the frequency of the PWM. */
+      LED_connection connection;
+      get_record_LED_connection(record, &connection);
+      return check_LED_connection(&connection, NULL, NULL) == BSP_LED_OK;
+    }
+
+    case HARDWARE_MAP_BUTTON:
+      /* The button driver configures the compiled button, so a record can not move 
+       * the button to other GPIO or change its pull mode, the lamp would read a pin 
+       * that nobody configured. Neither its interruption mode nor its debounce, they 
+       * would be stored without effect, and the gestures need both edges.
+       */
+      if(record->ID >= NUM_OF_BUTTONS)
+      {
+        return false;
+      }
+      switch(record->ID)
+      {
+        #define BUTTON_CONFIG(BUTTON_ID, GPIO_NUM, PULL_MODE, INTR_TYPE, DEBOUNCE_MS) \
+          case BUTTON_ID:                                                          \
+            return record->button.GPIO == (GPIO_NUM) &&                            \
+                   record->button.pull_mode == (PULL_MODE) &&                      \
+                   record->button.intr_type == (INTR_TYPE) &&                      \
+                   record->button.debounce_ms == (DEBOUNCE_MS);
+          BUTTONS_CONFIGURATIONS
+        #undef BUTTON_CONFIG
+        default:
+          return false;
+      }
+
+    case HARDWARE_MAP_LAMP:
+      return record->ID < NUM_OF_LAMPS &&
+             record->lamp.button < NUM_OF_BUTTONS &&
+             record->lamp.LED < NUM_OF_LEDS;
+
+    default:
+      return false;
+  }
+}
+
+static bool apply_record(const Hardware_map_record *record)
+{
+  switch(record->kind)
+  {
+    case HARDWARE_MAP_LED:
+    {
+      LED_connection connection;
+      get_record_LED_connection(record, &connection);
+      return BSP_LED_LOG(set_LED_connection((LED_ID)record->ID, &connection)) ==
+        BSP_LED_OK;
+    }
+
+    case HARDWARE_MAP_BUTTON:
+      buttons_map[record->ID] = record->button;
+      return true;
+
+    case HARDWARE_MAP_LAMP:
+      lamps_map[record->ID] = record->lamp;
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+static bool check_LEDs_map(const Hardware_map_record *records,
+  const uint16_t num_of_records)
+{
+  LED_connection LEDs[NUM_OF_LEDS];
+  uint32_t freqs_hz[NUM_OF_LEDS];
+  ledc_timer_bit_t resolutions[NUM_OF_LEDS];
+
+  memcpy(LEDs, compiled_LEDs, sizeof(LEDs));
+  for(uint16_t i = 0u; i < num_of_records; i++)
+  {
+    if(records[i].kind == HARDWARE_MAP_LED)
+    {
+      get_record_LED_connection(&records[i], &LEDs[records[i].ID]);
+    }
+  }
+
+  for(LED_ID i = 0u; i < NUM_OF_LEDS; i++)
+  {
+    /* The automatic values are compared once they are chosen. */
+    if(check_LED_connection(&LEDs[i], &freqs_hz[i], &resolutions[i]) != BSP_LED_OK)
+    {
+      return false;
+    }
+
+    for(LED_ID j = 0u; j < i; j++)
+    {
+      if(LEDs[i].speed_mode != LEDs[j].speed_mode)
+      {
+        continue;
+      }
+      if(LEDs[i].channel == LEDs[j].channel)
+      {
+        return false;
+      }
+      if(LEDs[i].timer == LEDs[j].timer &&
+         (LEDs[i].clock != LEDs[j].clock || freqs_hz[i] != freqs_hz[j] ||
+          resolutions[i] != resolutions[j]))
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+static void get_record_LED_connection(const Hardware_map_record *record,
+  LED_connection *connection)
+{
+  connection->GPIO = (gpio_num_t)record->LED.GPIO;
+  connection->pull_mode = (gpio_pull_mode_t)record->LED.pull_mode;
+  connection->timer = (ledc_timer_t)record->LED.timer;
+  connection->speed_mode = (ledc_mode_t)record->LED.speed_mode;
+  connection->channel = (ledc_channel_t)record->LED.channel;
+  connection->resolution = (ledc_timer_bit_t)record->LED.resolution;
+  connection->freq_hz = record->LED.freq_hz;
+  connection->clock = (ledc_clk_cfg_t)record->LED.clock;
+}
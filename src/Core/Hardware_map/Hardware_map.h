@@ -0,0 +1,242 @@
+/**
+ * @file      Hardware_map.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This header file declares the functions to load the hardware map of the
+ *            installation from a flash partition. The map overrides the physical
+ *            connections of the LEDs, the buttons and the lamps compiled in the
+ *            firmware, so several installations can run the same firmware.
+ */
+
+#ifndef CORE_HARDWARE_MAP_H_
+#define CORE_HARDWARE_MAP_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <stdint.h>
+#include <Lamp.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* List of the possible return codes that module hardware map can return. */
+#define HARDWARE_MAP_RETURNS                              \
+  /* Info codes */                                        \
+  HARDWARE_MAP_RETURN(CORE_HARDWARE_MAP_OK)               \
+  /* Error codes */                                       \
+  HARDWARE_MAP_RETURN(CORE_HARDWARE_MAP_NO_PARTITION_ERR) \
+  HARDWARE_MAP_RETURN(CORE_HARDWARE_MAP_MMAP_ERR)         \
+  HARDWARE_MAP_RETURN(CORE_HARDWARE_MAP_EMPTY_ERR)        \
+  HARDWARE_MAP_RETURN(CORE_HARDWARE_MAP_INVALID_ERR)      \
+  HARDWARE_MAP_RETURN(CORE_HARDWARE_MAP_APPLY_ERR)        \
+  HARDWARE_MAP_RETURN(CORE_HARDWARE_MAP_UNKOWN_ID_ERR)
+
+/* Label and subtype of the data partition that contains the map, partitions.csv. */
+#define HARDWARE_MAP_PARTITION_LABEL   "hw_map"
+#define HARDWARE_MAP_PARTITION_SUBTYPE 0x40
+
+/* First field of every map, "LHWM". */
+#define HARDWARE_MAP_MAGIC 0x4C48574Dul
+
+/* Version of the format of the map, the maps of other versions are rejected. */
+#define HARDWARE_MAP_VERSION 1u
+
+/* Macro that enlist the kinds of records of the map. It is mandatory to not set values
+ * to the enumerates, they are the first byte of every record.
+ */
+#define HARDWARE_MAP_RECORDS               \
+  HARDWARE_MAP_RECORD(HARDWARE_MAP_LED)    \
+  HARDWARE_MAP_RECORD(HARDWARE_MAP_BUTTON) \
+  HARDWARE_MAP_RECORD(HARDWARE_MAP_LAMP)
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Enumerate that lists the posible return codes that the module can return. */
+typedef enum
+{
+  #define HARDWARE_MAP_RETURN(enumerate) enumerate,
+    HARDWARE_MAP_RETURNS
+  #undef HARDWARE_MAP_RETURN
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_HARDWARE_MAP_RETURNS,
+} Hardware_map_return;
+
+/* Enumerate that enlist the kinds of records of the map. */
+typedef enum
+{
+  #define HARDWARE_MAP_RECORD(enumerate) enumerate,
+    HARDWARE_MAP_RECORDS
+  #undef HARDWARE_MAP_RECORD
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_HARDWARE_MAP_RECORDS,
+} Hardware_map_record_kind;
+
+/* Header of the map, it is followed by "num_of_records" records. All the fields of the
+ * map are little endian.
+ */
+typedef struct __attribute__((packed))
+{
+  /* Always HARDWARE_MAP_MAGIC. */
+  uint32_t magic;
+  /* Always HARDWARE_MAP_VERSION. */
+  uint8_t version;
+  /* Number of records that follow the header. */
+  uint16_t num_of_records;
+  /* CRC-32 (IEEE 802.3) of the records. */
+  uint32_t crc;
+} Hardware_map_header;
+
+/* Physical connection of a LED, the same parameters than LED_CONFIGURATIONS
+ * (LED_physical_connection.h).
+ */
+typedef struct __attribute__((packed))
+{
+  /* GPIO that sets the LED state, a value of gpio_num_t. */
+  uint8_t GPIO;
+  /* Pull mode of the GPIO, a value of gpio_pull_mode_t. */
+  uint8_t pull_mode;
+  /* Timer, speed mode and channel that control the LED, values of ledc_timer_t,
+   * ledc_mode_t and ledc_channel_t.
+   */
+  uint8_t timer;
+  uint8_t speed_mode;
+  uint8_t channel;
+  /* Resolution of the PWM, a value of ledc_timer_bit_t or LED_PWM_RESOLUTION_AUTO. */
+  uint8_t resolution;
+  /* Clock source of the timer, a value of ledc_clk_cfg_t. */
+  uint8_t clock;
+  /* Frequency in Hertz of the PWM or LED_PWM_FREQUENCY_AUTO. */
+  uint32_t freq_hz;
+} Hardware_map_LED;
+
+/* Physical connection of a button, the same parameters than BUTTONS_CONFIGURATIONS
+ * (Button_physical_connection.h). The button driver configures the compiled button, so
+ * all the fields of a record must be the compiled ones, the record only documents the
+ * board.
+ */
+typedef struct __attribute__((packed))
+{
+  /* GPIO that reads the button state, a value of gpio_num_t. */
+  uint8_t GPIO;
+  /* Pull mode of the GPIO, a value of gpio_pull_mode_t. */
+  uint8_t pull_mode;
+  /* Interruption mode of the GPIO, a value of gpio_int_type_t. */
+  uint8_t intr_type;
+  /* Debounce time in milliseconds. */
+  uint16_t debounce_ms;
+} Hardware_map_button;
+
+/* Button and LED of a lamp, the same parameters than LAMPS_CONNECTIONS (Lamp.h). */
+typedef struct __attribute__((packed))
+{
+  /* Button of the lamp, a value of Button_ID. */
+  uint8_t button;
+  /* LED of the lamp, a value of LED_ID. */
+  uint8_t LED;
+} Hardware_map_lamp;
+
+/* Record of the map, all the records have the same size. */
+typedef struct __attribute__((packed))
+{
+  /* Kind of the record, it is mandatory to use a value of Hardware_map_record_kind. */
+  uint8_t kind;
+  /* Identifier of the LED, the button or the lamp that the record describes. */
+  uint8_t ID;
+  /* Connection of the element, it depends on the kind of the record. */
+  union __attribute__((packed))
+  {
+    Hardware_map_LED LED;
+    Hardware_map_button button;
+    Hardware_map_lamp lamp;
+  };
+} Hardware_map_record;
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Loads the hardware map of the partition HARDWARE_MAP_PARTITION_LABEL. The
+ *        partition is memory mapped, the map is checked and its records override the
+ *        compiled connections of their elements, without heap allocations. It is
+ *        mandatory to call this function before initializing the BSP modules. If it
+ *        fails the compiled connections are kept, so the system can go on.
+ *
+ * @param void
+ *
+ * @return CORE_HARDWARE_MAP_OK if the map was loaded,
+ *         otherwise:
+ *
+ *         - CORE_HARDWARE_MAP_NO_PARTITION_ERR:
+ *             The partition table does not contain the partition of the map.
+ *
+ *         - CORE_HARDWARE_MAP_MMAP_ERR:
+ *             The partition could not be memory mapped.
+ *
+ *         - CORE_HARDWARE_MAP_EMPTY_ERR:
+ *             The partition is erased, no map was flashed.
+ *
+ *         - CORE_HARDWARE_MAP_INVALID_ERR:
+ *             The map is corrupted, of other version, it has an invalid record, or two
+ *             of the resulting LEDs share a channel or a timer with other PWM.
+ *
+ *         - CORE_HARDWARE_MAP_APPLY_ERR:
+ *             The BSP modules were initialized before loading the map.
+ *
+ */
+Hardware_map_return init_hardware_map(void);
+
+/**
+ * @brief Gets the physical connection of a button, the one of the map or the compiled
+ *        one.
+ *
+ * @param ID Identifier of the button.
+ *
+ * @param button Return connection of the button.
+ *
+ * @return CORE_HARDWARE_MAP_OK if the operation went well,
+ *         otherwise:
+ *
+ *         - CORE_HARDWARE_MAP_UNKOWN_ID_ERR:
+ *             The given button does not exist.
+ *
+ */
+Hardware_map_return get_hardware_map_button(const Button_ID ID,
+  Hardware_map_button *button);
+
+/**
+ * @brief Gets the button and the LED of a lamp, the ones of the map or the compiled
+ *        ones.
+ *
+ * @param ID Identifier of the lamp.
+ *
+ * @param button Return button of the lamp.
+ *
+ * @param LED Return LED of the lamp.
+ *
+ * @return CORE_HARDWARE_MAP_OK if the operation went well,
+ *         otherwise:
+ *
+ *         - CORE_HARDWARE_MAP_UNKOWN_ID_ERR:
+ *             The given lamp does not exist.
+ *
+ */
+Hardware_map_return get_hardware_map_lamp(const Lamp_ID ID, Button_ID *button,
+  LED_ID *LED);
+
+/**
+ * @brief Prints the return of a hardware map module function if the system was
+ *        configured in debug mode.
+ *
+ * @param ret Received return from a hardware map module function.
+ *
+ * @return The given return.
+ */
+Hardware_map_return core_hardware_map_LOG(const Hardware_map_return ret);
+
+#endif /* CORE_HARDWARE_MAP_H_ */
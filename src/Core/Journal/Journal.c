@@ -0,0 +1,89 @@
+/**
+ * @file      Journal.c
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This source file defines the functions to record the commands received 
+ *            by the system in a ring buffer that can be dumped later.
+ */
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <Journal.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+
+/***************************************************************************************
+ * Global Variables
+ ***************************************************************************************/
+
+/* Ring buffer of the journal entries. */
+static Journal_entry journal[JOURNAL_SIZE];
+
+/* Sequence number of the next entry, the entry is stored at next_seq % JOURNAL_SIZE. */
+static uint32_t next_seq;
+
+/* Lock that protects the journal between the tasks that record and dump it. */
+static portMUX_TYPE journal_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+void journal_record(const Journal_entry *entry)
+{
+  taskENTER_CRITICAL(&journal_lock);
+  journal[next_seq & (JOURNAL_SIZE - 1u)] = *entry;
+  next_seq++;
+  taskEXIT_CRITICAL(&journal_lock);
+}
+
+uint8_t get_journal_dump(const uint32_t first_seq, uint8_t *dump, const uint8_t size)
+{
+  if(size < sizeof(Journal_dump_header))
+  {
+    return 0u;
+  }
+
+  const uint32_t max_entries = (size - sizeof(Journal_dump_header)) / 
+                                 sizeof(Journal_entry);
+  Journal_dump_header header;
+  uint8_t len = sizeof(Journal_dump_header);
+
+  /* The entries are copied one by one to keep the critical section short. */
+  taskENTER_CRITICAL(&journal_lock);
+  const uint32_t oldest_seq = (next_seq > JOURNAL_SIZE) ? next_seq - JOURNAL_SIZE : 0u;
+  header.first_seq = (first_seq < oldest_seq || first_seq > next_seq) ? 
+                       oldest_seq : first_seq;
+  taskEXIT_CRITICAL(&journal_lock);
+
+  uint32_t seq = header.first_seq;
+  header.num_of_entries = 0u;
+  while(header.num_of_entries < max_entries)
+  {
+    taskENTER_CRITICAL(&journal_lock);
+    const bool available = seq < next_seq && seq + JOURNAL_SIZE >= next_seq;
+    Journal_entry entry;
+    if(available)
+    {
+      entry = journal[seq & (JOURNAL_SIZE - 1u)];
+    }
+    taskEXIT_CRITICAL(&journal_lock);
+
+    if(!available)
+    {
+      break;
+    }
+
+    memcpy(&dump[len], &entry, sizeof(entry));
+    len += sizeof(entry);
+    header.num_of_entries++;
+    seq++;
+  }
+
+  header.next_seq = seq;
+  memcpy(dump, &header, sizeof(header));
+
+  return len;
+}
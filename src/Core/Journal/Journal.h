@@ -0,0 +1,117 @@
+/**
+ * @file      Journal.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This header file declares the functions to record the commands received 
+ *            by the system in a ring buffer that can be dumped later.
+ */
+
+#ifndef CORE_JOURNAL_H_
+#define CORE_JOURNAL_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <stdint.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Number of entries of the journal, the oldest entries are overwritten when it is full.
+ * It is mandatory to use a power of 2.
+ */
+#define JOURNAL_SIZE 128u
+
+#if (JOURNAL_SIZE & (JOURNAL_SIZE - 1u)) != 0u
+  #error "Invalid journal size, it must be a power of 2:"
+  #error "refer to (JOURNAL_SIZE)"
+#endif
+
+/* Macro that enlist the sources of the journal entries. It is mandatory to not set 
+ * values to the enumerates.
+ */
+#define JOURNAL_SOURCES                    \
+  JOURNAL_SOURCE(JOURNAL_SOURCE_TCP_LEGACY) \
+  JOURNAL_SOURCE(JOURNAL_SOURCE_TCP_GROUP)  \
+  JOURNAL_SOURCE(JOURNAL_SOURCE_BUTTON)     \
+  JOURNAL_SOURCE(JOURNAL_SOURCE_SCHEDULER)  \
+  JOURNAL_SOURCE(JOURNAL_SOURCE_UDP_FLEET)  \
+  JOURNAL_SOURCE(JOURNAL_SOURCE_TCP_SEQ)
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Enumerate that enlist the sources of the journal entries. */
+typedef enum
+{
+  #define JOURNAL_SOURCE(enumerate) enumerate,
+    JOURNAL_SOURCES
+  #undef JOURNAL_SOURCE
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_JOURNAL_SOURCES,
+} Journal_source;
+
+/* Entry of the journal, it contains a decoded command. */
+typedef struct __attribute__((packed))
+{
+  /* Time in microseconds when the command was received. */
+  uint32_t time_us;
+  /* IPv4 address of the client that sent the command in network order, 0 if it did 
+   * not come from the network.
+   */
+  uint32_t client_IP;
+  /* Time in microseconds that the system spent processing the command. */
+  uint16_t processing_us;
+  /* Source of the command, it is a value of Journal_source. */
+  uint8_t source;
+  /* Lamp or group of lamps targeted by the command, it depends on the source. */
+  uint8_t target;
+  /* Action of the command, a Lamp_action or a Gesture for the button source. */
+  uint8_t action;
+  /* PWM duty cycle in percentage terms of the command. */
+  uint8_t pwm;
+} Journal_entry;
+
+/* Header of a journal dump, it is followed by "num_of_entries" entries. */
+typedef struct __attribute__((packed))
+{
+  /* Sequence number of the first entry of the dump. */
+  uint32_t first_seq;
+  /* Sequence number that the next recorded entry will have. */
+  uint32_t next_seq;
+  /* Number of entries that follow the header. */
+  uint8_t num_of_entries;
+} Journal_dump_header;
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Records an entry in the journal. It can be called from any task.
+ *
+ * @param entry Entry to record.
+ *
+ * @return void
+ */
+void journal_record(const Journal_entry *entry);
+
+/**
+ * @brief Writes a dump of the journal starting by the given sequence number. If it was
+ *        overwritten, the dump starts by the oldest entry kept. The dumps can be read
+ *        in pages using next_seq of a dump as the start of the next one.
+ *
+ * @param first_seq Sequence number of the first entry to write.
+ * 
+ * @param dump Buffer where the dump is written.
+ * 
+ * @param size Size in bytes of the buffer.
+ *
+ * @return Number of bytes written, 0 if the buffer can not hold the header.
+ */
+uint8_t get_journal_dump(const uint32_t first_seq, uint8_t *dump, const uint8_t size);
+
+#endif /* CORE_JOURNAL_H_ */
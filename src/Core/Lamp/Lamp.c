@@ -10,8 +10,13 @@
  * Includes
  ***************************************************************************************/
 #include <Lamp.h>
+#include <Hardware_map.h>
 #include <freertos/FreeRTOS.h>
+#include <esp_timer.h>
+#include <string.h>
 #include <Debug.h>
+#include <System_memory.h>
+#include <System_tasks.h>
 
 /***************************************************************************************
  * Defines
@@ -22,6 +27,24 @@
   #define TAG "CORE_LAMP"
 #endif
 
+/* Weight of the last edge in the average button latency, 1/2^LAMP_AVG_SHIFT. */
+#define LAMP_AVG_SHIFT 3u
+
+/* Fixed point 16.16 value of 1, used by the power scale. */
+#define POWER_SCALE_ONE (1ul << 16u)
+
+/* Power budget in milliwatts per cent of duty cycle, the units of the lamp draws. */
+#define POWER_BUDGET_DRAW ((uint32_t)LEDS_POWER_BUDGET_MW * 100u)
+
+/* Percentage of duty cycle of a 16 bits level, rounded up so the budget never counts 
+ * less power than the LED draws. UINT16_MAX is MAX_DUTY_CYCLE_PERC, as in set_LED_level.
+ */
+#define LEVEL_TO_PERCENTAGE(level) \
+  (((uint32_t)(level) * MAX_DUTY_CYCLE_PERC + UINT16_MAX - 1u) / UINT16_MAX)
+
+/* 16 bits level of MIN_DUTY_CYCLE_PERC, the lowest level applied to a lamp. */
+#define MIN_LEVEL (((uint32_t)MIN_DUTY_CYCLE_PERC * UINT16_MAX) / MAX_DUTY_CYCLE_PERC)
+
 /***************************************************************************************
  * Data Type Definitions
  ***************************************************************************************/
@@ -39,10 +62,83 @@ typedef struct
   SemaphoreHandle_t lamp_semaphore;
   /* Indicates if the lamp is on or off. */
   bool state;
-  /* PWM duty cycle applied to the lamp LED. */
+  /* PWM duty cycle requested for the lamp LED. */
   uint8_t PWM_percentage;
+  /* PWM duty cycle requested for the lamp LED within the LED limits, 0 when it is off. */
+  uint8_t requested_percentage;
+  /* PWM duty cycle applied to the lamp LED after the power budget, 0 when it is off. */
+  uint8_t applied_percentage;
+  /* Brightness requested with a finer resolution than PWM_percentage, from 0 to 
+   * UINT16_MAX, 0 when the lamp is driven by percentages. Only DMX sets it.
+   */
+  uint16_t level;
+  /* Brightness applied to the lamp LED after the power budget, 0 when it is driven by 
+   * percentages.
+   */
+  uint16_t applied_level;
+  /* Power requested by the lamp in milliwatts per cent of duty cycle. */
+  uint32_t requested_draw;
+  /* Gesture detector of the lamp button. */
+  Gesture_detector gestures;
+  /* True if the first press of the current sequence turned on the lamp. */
+  bool turned_on_by_press;
+  /* True if the next hold dims the lamp up, it reverses on every hold. */
+  bool dimming_up;
+  /* Periodic timer that drives the dimming ramp, only running while the button is 
+   * held.
+   */
+  esp_timer_handle_t ramp_timer;
+  /* Ramp steps signaled by the timer and not applied yet by the lamp task. */
+  uint32_t ramp_pending_steps;
+  /* Time in microseconds when the current ramp started. */
+  int64_t ramp_start_us;
+  /* Number of steps of the current ramp, applied or discarded at the limits. */
+  uint32_t ramp_steps;
+  /* Cadence statistics of the dimming ramp. */
+  Lamp_ramp_stats ramp_stats;
+  /* Time in microseconds of the first button edge not processed yet, 0 if there is 
+   * none. It is written by the button ISR.
+   */
+  uint32_t pending_edge_us;
+  /* Latency statistics of the button. */
+  Lamp_button_stats button_stats;
 } lamp_info;
 
+/* Structure that contains the published state of a lamp, protected by a seqlock. */
+typedef struct
+{
+  /* Sequence counter, it is odd while the state is being written. */
+  uint32_t seq;
+  /* Last published state of the lamp. */
+  Lamp_state_entry state;
+} lamp_snapshot;
+
+/* Structure that contains the sequenced commands remembered of a client. */
+typedef struct
+{
+  /* IPv4 address of the client in network order, 0 if the entry is free. */
+  uint32_t client_IP;
+  /* Session chosen by the client. */
+  uint16_t session;
+  /* Value of seq_clock the last time the client sent a command. */
+  uint32_t last_use;
+  /* Highest sequence number performed for the client. */
+  uint16_t newest_seq;
+  /* Mask of the entries of replies that contain a reply. */
+  uint32_t valid_replies;
+  /* Replies of the last commands, indexed by sequence number modulo LAMP_SEQ_WINDOW. */
+  Lamp_seq_reply replies[LAMP_SEQ_WINDOW];
+} seq_client_info;
+
+/* Structure that contains the GPIO of a button and the level when it is pressed. */
+typedef struct
+{
+  /* GPIO that reads the button state. */
+  gpio_num_t GPIO;
+  /* Level of the GPIO when the button is pressed. */
+  int pressed_level;
+} button_level_info;
+
 /***************************************************************************************
  * Global Variables
  ***************************************************************************************/
@@ -50,6 +146,89 @@ typedef struct
 /* Array that contains the configuration of the all the system lamps. */
 static lamp_info lamps_infos[NUM_OF_LAMPS];
 
+/* Array that contains the mask of the lamps that belong to each group. */
+static const uint32_t lamp_groups_masks[NUM_OF_LAMP_GROUPS] =
+{
+  #define LAMP_GROUP(group, mask) [group] = (mask),
+    LAMP_GROUPS
+  #undef LAMP_GROUP
+};
+
+/* Array that contains the power in milliwatts drawn by each LED at 100% duty cycle. */
+static const uint32_t LEDs_power_mW[NUM_OF_LEDS] =
+{
+  #define LED_POWER(LED_ID, POWER_MW) [LED_ID] = (POWER_MW),
+    LEDS_POWER
+  #undef LED_POWER
+};
+
+/* Array that contains how to read the level of each button, a pulled down button reads
+ * a high level when it is pressed. It is filled with the hardware map when the lamps
+ * are initialized.
+ */
+static button_level_info buttons_levels[NUM_OF_BUTTONS];
+
+/* Storage of the RTOS objects of the lamps, there is no heap allocation for them. */
+static StackType_t lamps_stacks[NUM_OF_LAMPS][SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_LAMP)];
+static StaticTask_t lamps_tasks_buffers[NUM_OF_LAMPS];
+static StaticSemaphore_t lamps_semaphores_buffers[NUM_OF_LAMPS];
+
+/* Sum of the power requested by all the lamps in milliwatts per cent of duty cycle. */
+static uint32_t total_requested_draw;
+
+/* Sum of the power applied to the LEDs of all the lamps after the budget and the 
+ * minimum duty cycle, in milliwatts per cent of duty cycle.
+ */
+static uint32_t total_applied_draw;
+
+/* Fixed point 16.16 scale applied to the duty cycles to respect the power budget. */
+static uint32_t power_scale = POWER_SCALE_ONE;
+
+/* Published state of the lamps, the readers copy it without taking any lock. */
+static lamp_snapshot lamps_snapshots[NUM_OF_LAMPS];
+
+/* Lock that makes the publication of a snapshot atomic in its core, so a reader never
+ * preempts a half written snapshot and spins until the writer runs again.
+ */
+static portMUX_TYPE snapshots_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Mutex that lets a single task at a time write the state of the lamps. The commands 
+ * come from the servers, the lamp tasks, the stream and the lwIP thread.
+ */
+static SemaphoreHandle_t lamps_writer_mutex;
+static StaticSemaphore_t lamps_writer_mutex_buffer;
+
+/* Clients whose sequenced commands are remembered. */
+static seq_client_info seq_clients[LAMP_SEQ_CLIENTS];
+
+/* Counter increased on every sequenced command, it orders the use of the clients. */
+static uint32_t seq_clock;
+
+/* Mutex of the sequenced commands clients, they are used from several servers. It is 
+ * held from the check of a command until its reply is recorded, so a retry that 
+ * arrives through other server while the command is performed is not performed again.
+ */
+static SemaphoreHandle_t seq_mutex;
+static StaticSemaphore_t seq_mutex_buffer;
+
+/* RAM reserved by the RTOS objects of the lamps. */
+_Static_assert(sizeof(lamps_stacks) + sizeof(lamps_tasks_buffers) + 
+  sizeof(lamps_semaphores_buffers) <= LAMP_STATIC_RAM_BUDGET, 
+  "Lamp RTOS objects go over LAMP_STATIC_RAM_BUDGET");
+
+/* The replies of a client are indexed with a mask of the sequence number. */
+_Static_assert((LAMP_SEQ_WINDOW & (LAMP_SEQ_WINDOW - 1u)) == 0u && 
+  LAMP_SEQ_WINDOW <= 32u, "LAMP_SEQ_WINDOW must be a power of 2 up to 32");
+
+/* The group masks store one bit per lamp. */
+_Static_assert(NUM_OF_LAMPS <= 32u, "LAMPS does not fit in the group masks");
+
+/* The budget can not be respected if it does not cover all the LEDs at minimum duty. */
+#define LED_POWER(LED_ID, POWER_MW) + (POWER_MW)
+_Static_assert((0u LEDS_POWER) * MIN_DUTY_CYCLE_PERC <= POWER_BUDGET_DRAW, 
+  "LEDS_POWER_BUDGET_MW does not cover all the LEDs at MIN_DUTY_CYCLE_PERC");
+#undef LED_POWER
+
 /***************************************************************************************
  * Functions Prototypes
  ***************************************************************************************/
@@ -73,7 +252,8 @@ static void lamp_0_handler_func(void *args);
 static bool check_lamp_ID(const Lamp_ID ID);
 
 /**
- * @brief Toogles the LED of a given lamp
+ * @brief Toogles the LED of a given lamp. The new state is applied to the LED with
+ *        update_lamps_outputs.
  *
  * @param ID Identifier of the lamp to toggle.
  *
@@ -81,6 +261,190 @@ static bool check_lamp_ID(const Lamp_ID ID);
  */
 static bool toogle_LED_lamp(const Lamp_ID ID);
 
+/**
+ * @brief Performs an action over a given lamp. The new state is applied to the LED with
+ *        update_lamps_outputs.
+ *
+ * @param ID Identifier of the lamp.
+ * 
+ * @param action Action to perform.
+ * 
+ * @param pwm PWM duty cycle in percentage terms, only used by LAMP_ACTION_SET_PWM.
+ *
+ * @return True if the operation went well, otherwise false.
+ */
+static bool perform_lamp_action(const Lamp_ID ID, const Lamp_action action, 
+  const uint8_t pwm);
+
+/**
+ * @brief Performs an action over all the lamps of a group in a single pass, the cost
+ *        is proportional to the number of lamps of the group. The new states are 
+ *        applied to the LEDs with update_lamps_outputs.
+ *
+ * @param group Identifier of the group.
+ * 
+ * @param action Action to perform.
+ * 
+ * @param pwm PWM duty cycle in percentage terms, only used by LAMP_ACTION_SET_PWM.
+ *
+ * @return True if the operation went well, otherwise false.
+ */
+static bool perform_group_action(const Lamp_group_ID group, const Lamp_action action,
+  const uint8_t pwm);
+
+/**
+ * @brief Applies the state of the given lamps to their LEDs through the power budget. 
+ *        The power requested by the lamps is tracked incrementally, and when it goes 
+ *        over LEDS_POWER_BUDGET_MW all the duty cycles are scaled down by the same 
+ *        factor. All the changed LEDs are committed together and their state is 
+ *        published, the leveled ones are applied right after with set_LED_level. It 
+ *        is mandatory to hold lamps_writer_mutex.
+ *
+ * @param lamps Mask of the lamps whose state changed.
+ * 
+ * @param leveled Mask of the changed lamps driven by their level, the other changed 
+ *                lamps go back to their percentage.
+ *
+ * @return void
+ */
+static void update_lamps_outputs(const uint32_t lamps, const uint32_t leveled);
+
+/**
+ * @brief Publishes the state of the given lamps to the readers of the snapshots. It is
+ *        mandatory to hold lamps_writer_mutex.
+ *
+ * @param lamps Mask of the lamps to publish.
+ *
+ * @return void
+ */
+static void publish_lamps_snapshots(uint32_t lamps);
+
+/**
+ * @brief Classifies the button edges of a given lamp and performs the actions of the 
+ *        detected gestures:
+ *
+ *          - Press: turns on the lamp, so it lights up after the debounce window.
+ *          - Single click: turns off the lamp, unless its press turned it on.
+ *          - Double click: sets the maximum PWM duty cycle.
+ *          - Triple click: sets the minimum PWM duty cycle.
+ *          - Long press: turns off all the lamps.
+ *          - Hold: starts a dimming ramp at a fixed rate until the button is released,
+ *            the direction reverses on every hold.
+ *
+ * @param ID Identifier of the lamp.
+ *
+ * @return Ticks to wait for the next button edge before calling it again.
+ */
+static TickType_t process_lamp_gestures(const Lamp_ID ID);
+
+/**
+ * @brief Performs a group command and records it in the journal.
+ *
+ * @param payload Bytes of the command, it must contain a Lamp_group_command.
+ * 
+ * @param len Number of bytes of the payload.
+ * 
+ * @param source Source of the command.
+ * 
+ * @param client_IP IPv4 address of the client that sent the command, 0 if it did not 
+ *                  come from the network.
+ *
+ * @return CORE_LAMP_OK if the command was performed,
+ *         otherwise:
+ * 
+ *           - CORE_LAMP_UNKOWN_ID_ERR: 
+ *               The group of the command does not exist.
+ * 
+ *           - CORE_LAMP_INVALID_CMD_ERR: 
+ *               The length or the action of the command are not valid.
+ */
+static Lamp_return process_group_command(const uint8_t *payload, const uint8_t len,
+  const Journal_source source, const uint32_t client_IP);
+
+/**
+ * @brief Performs a sequenced command once per session and sequence number, the 
+ *        retries get the reply of the first time without performing it again.
+ *
+ * @param payload Bytes of the command, it must contain a Lamp_seq_command.
+ * 
+ * @param len Number of bytes of the payload.
+ * 
+ * @param client_IP IPv4 address of the client that sent the command.
+ * 
+ * @param reply Buffer where the Lamp_seq_reply is written.
+ * 
+ * @param reply_size Size in bytes of the reply buffer.
+ *
+ * @return Number of bytes of the reply, 0 if the payload was not a sequenced command.
+ */
+static uint8_t process_seq_command(const uint8_t *payload, const uint8_t len,
+  const uint32_t client_IP, uint8_t *reply, const uint8_t reply_size);
+
+/**
+ * @brief Finds the entry of a session of the sequenced commands. It is mandatory to 
+ *        hold seq_mutex.
+ *
+ * @param client_IP IPv4 address of the client.
+ * 
+ * @param session Session chosen by the client.
+ *
+ * @return Entry of the session, NULL if it is not remembered.
+ */
+static seq_client_info *find_seq_client(const uint32_t client_IP, 
+  const uint16_t session);
+
+/**
+ * @brief Records a processed command in the journal.
+ *
+ * @param source Source of the command.
+ * 
+ * @param target Lamp or group of lamps targeted by the command.
+ * 
+ * @param action Action of the command.
+ * 
+ * @param pwm PWM duty cycle in percentage terms of the command.
+ * 
+ * @param client_IP IPv4 address of the client that sent the command, 0 if it did not 
+ *                  come from the network.
+ * 
+ * @param start_us Time in microseconds when the command was received.
+ *
+ * @return void
+ */
+static void journal_command(const Journal_source source, const uint8_t target, 
+  const uint8_t action, const uint8_t pwm, const uint32_t client_IP, 
+  const int64_t start_us);
+
+/**
+ * @brief Callback of the dimming ramp timer, it signals a step to the lamp task.
+ *
+ * @param args Identifier of the lamp.
+ *
+ * @return void
+ */
+static void ramp_timer_callback(void *args);
+
+/**
+ * @brief Applies the ramp steps signaled by the timer to a given lamp and measures
+ *        their cadence.
+ *
+ * @param ID Identifier of the lamp.
+ *
+ * @return Mask of the lamps whose state changed.
+ */
+static uint32_t apply_ramp_steps(const Lamp_ID ID);
+
+/**
+ * @brief Performs the action of a gesture over a given lamp.
+ *
+ * @param ID Identifier of the lamp.
+ * 
+ * @param gesture Detected gesture.
+ *
+ * @return Mask of the lamps whose state changed.
+ */
+static uint32_t perform_gesture_action(const Lamp_ID ID, const Gesture gesture);
+
 /***************************************************************************************
  * Functions
  ***************************************************************************************/
@@ -94,6 +458,35 @@ Lamp_return Lamp_init(const Lamp_ID lamp,const Button_ID button, const LED_ID LE
     return CORE_LAMP_UNKOWN_ID_ERR;
   }
 
+  /* The first lamp creates the mutexes, before the button interrupt and the lamp task
+   * that take them exist.
+   */
+  if(lamps_writer_mutex == NULL)
+  {
+    lamps_writer_mutex = xSemaphoreCreateMutexStatic(&lamps_writer_mutex_buffer);
+    seq_mutex = xSemaphoreCreateMutexStatic(&seq_mutex_buffer);
+    if(lamps_writer_mutex == NULL || seq_mutex == NULL)
+    {
+      return CORE_LAMP_INIT_SEMAPHORE_ERR;
+    }
+  }
+
+  /* Read the level of the button with the connection of the hardware map. */
+  Hardware_map_button button_connection;
+  if(core_hardware_map_LOG(get_hardware_map_button(button, &button_connection)) != 
+     CORE_HARDWARE_MAP_OK)
+  {
+    return CORE_LAMP_INIT_ERR;
+  }
+  buttons_levels[button].GPIO = (gpio_num_t)button_connection.GPIO;
+  buttons_levels[button].pressed_level = 
+    (button_connection.pull_mode == GPIO_PULLDOWN_ONLY) ? 1 : 0;
+
+  /* The lamp task reads them as soon as the button is pressed. */
+  lamps_infos[lamp].button = button;
+  lamps_infos[lamp].LED = LED;
+  lamps_infos[lamp].PWM_percentage = MIN_DUTY_CYCLE_PERC;
+
   /* Initialize button. */
   if(BPS_button_LOG(init_button(button)) != BSP_BUTTON_OK)
   {
@@ -106,22 +499,41 @@ Lamp_return Lamp_init(const Lamp_ID lamp,const Button_ID button, const LED_ID LE
     return CORE_LAMP_INIT_ERR;
   }
 
+  gesture_init(&lamps_infos[lamp].gestures);
+  lamps_infos[lamp].dimming_up = true;
+
+  /* Create the timer of the dimming ramp, it only runs while the button is held. */
+  const esp_timer_create_args_t ramp_timer_args =
+  {
+    .callback = ramp_timer_callback,
+    .arg = (void *)(uintptr_t)lamp,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "lamp_ramp",
+    .skip_unhandled_events = true,
+  };
+  if(esp_timer_create(&ramp_timer_args, &lamps_infos[lamp].ramp_timer) != ESP_OK)
+  {
+    return CORE_LAMP_INIT_TIMER_ERR;
+  }
+
   /* Create the sempahore of the lamp. */
   switch(lamp)
   {
     case LAMP_0:
     {
-      lamps_infos[lamp].lamp_semaphore = xSemaphoreCreateCounting(1, 0);
+      lamps_infos[lamp].lamp_semaphore = xSemaphoreCreateCountingStatic(1, 0, 
+        &lamps_semaphores_buffers[lamp]);
       if(lamps_infos[lamp].lamp_semaphore == NULL)
       {
-        vSemaphoreDelete(lamps_infos[lamp].lamp_semaphore);
         return CORE_LAMP_INIT_SEMAPHORE_ERR;
       }
     
-      /* Create the task of the lamp. */
-      const BaseType_t ret = xTaskCreate(lamp_0_handler_func, "lamp_0_handler_func", 2048,
-        (void *) 0, configMAX_PRIORITIES-1, &lamps_infos[lamp].lamp_handler);
-      if(ret != pdPASS)
+      /* Create the task of the lamp in the lighting core. */
+      lamps_infos[lamp].lamp_handler = xTaskCreateStaticPinnedToCore(lamp_0_handler_func,
+        SYSTEM_TASK_NAME(SYSTEM_TASK_LAMP), SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_LAMP), 
+        (void *) 0, SYSTEM_TASK_PRIORITY(SYSTEM_TASK_LAMP), lamps_stacks[lamp], 
+        &lamps_tasks_buffers[lamp], SYSTEM_TASK_CORE(SYSTEM_TASK_LAMP));
+      if(lamps_infos[lamp].lamp_handler == NULL)
       {
         return CORE_LAMP_INIT_TASK_ERR;
       }
@@ -132,9 +544,9 @@ Lamp_return Lamp_init(const Lamp_ID lamp,const Button_ID button, const LED_ID LE
       return CORE_LAMP_INIT_ERR;
   }
 
-  lamps_infos[lamp].button = button;
-  lamps_infos[lamp].LED = LED;
-  lamps_infos[lamp].PWM_percentage = MIN_DUTY_CYCLE_PERC;
+  xSemaphoreTake(lamps_writer_mutex, portMAX_DELAY);
+  publish_lamps_snapshots(LAMP_MASK(lamp));
+  xSemaphoreGive(lamps_writer_mutex);
 
   return CORE_LAMP_OK;
 }
@@ -162,11 +574,20 @@ Lamp_return de_init_lamp(const Lamp_ID lamp)
   if(lamps_infos[lamp].lamp_handler != NULL)
   {
     vTaskDelete(lamps_infos[lamp].lamp_handler);
+    lamps_infos[lamp].lamp_handler = NULL;
   }
   
   if(lamps_infos[lamp].lamp_semaphore != NULL)
   {
     vSemaphoreDelete(lamps_infos[lamp].lamp_semaphore);
+    lamps_infos[lamp].lamp_semaphore = NULL;
+  }
+
+  if(lamps_infos[lamp].ramp_timer != NULL)
+  {
+    esp_timer_stop(lamps_infos[lamp].ramp_timer);
+    esp_timer_delete(lamps_infos[lamp].ramp_timer);
+    lamps_infos[lamp].ramp_timer = NULL;
   }
   
   return CORE_LAMP_OK;
@@ -239,87 +660,1046 @@ static bool toogle_LED_lamp(const Lamp_ID ID)
     return false;
   }
 
-  if(!lamps_infos[ID].state)
+  lamps_infos[ID].state = !lamps_infos[ID].state;
+
+  return true;
+}
+
+static bool perform_lamp_action(const Lamp_ID ID, const Lamp_action action, 
+  const uint8_t pwm)
+{
+  switch(action)
   {
-    BSP_LED_LOG(set_LED_state(lamps_infos[ID].LED, lamps_infos[ID].PWM_percentage));
+    case LAMP_ACTION_TOGGLE:
+      return toogle_LED_lamp(ID);
+
+    case LAMP_ACTION_SET_PWM:
+      if(lamps_infos[ID].state)
+      {
+        lamps_infos[ID].PWM_percentage = pwm;
+      }
+      return true;
+
+    case LAMP_ACTION_SET_ON:
+    case LAMP_ACTION_SET_OFF:
+      if(!check_lamp_ID(ID))
+      {
+        return false;
+      }
+      lamps_infos[ID].state = (action == LAMP_ACTION_SET_ON);
+      return true;
+
+    default:
+      return false;
   }
-  else
+}
+
+static bool perform_group_action(const Lamp_group_ID group, const Lamp_action action,
+  const uint8_t pwm)
+{
+  if(group >= NUM_OF_LAMP_GROUPS)
   {
-    BSP_LED_LOG(turn_off_LED(lamps_infos[ID].LED));
+    return false;
   }
 
-  lamps_infos[ID].state = !lamps_infos[ID].state;
+  bool ret = true;
+  uint32_t members = lamp_groups_masks[group];
+  while(members != 0u)
+  {
+    /* Visit only the set bits, lowest lamp first. */
+    const Lamp_ID ID = (Lamp_ID)__builtin_ctzl(members);
+    members &= members - 1u;
 
-  return true;
+    if(!perform_lamp_action(ID, action, pwm))
+    {
+      ret = false;
+    }
+  }
+
+  return ret;
 }
 
-/* Implemtation of the TCP server received callback. */
-void __attribute__((weak)) RX_command_frame(const TCP_COMMAND_TYPE cmd)
+static void update_lamps_outputs(const uint32_t lamps, const uint32_t leveled)
 {
 
-  bool LED_ID_is_valid = false;
-  switch(cmd.ID)
+  /* Update the requested power with the changed lamps only. */
+  uint32_t pending = lamps;
+  while(pending != 0u)
   {
-    case LED_0:
-      LED_ID_is_valid = true;
-      break;
-    default:
-      ESP_LOGE(TAG, "Received invalid LED identifier.");
-      break;
-  }
+    const Lamp_ID ID = (Lamp_ID)__builtin_ctzl(pending);
+    pending &= pending - 1u;
 
-  if(LED_ID_is_valid)
-  {
-    Lamp_ID ID = 0u;
-    while(ID < NUM_OF_LAMPS && lamps_infos[ID].LED != cmd.ID)
+    /* Any other command takes the lamp back to percentages. */
+    if((leveled & LAMP_MASK(ID)) == 0u)
     {
-      ID++;
+      lamps_infos[ID].level = 0u;
     }
 
-    switch(cmd.action)
+    uint32_t percentage = 0u;
+    if(lamps_infos[ID].state)
     {
-      case TOOGLE_LED:
-        if(!toogle_LED_lamp(ID))
+      /* Same limits that the LED BSP applies. */
+      percentage = (lamps_infos[ID].level != 0u) ? 
+        LEVEL_TO_PERCENTAGE(lamps_infos[ID].level) : lamps_infos[ID].PWM_percentage;
+      if(percentage > MAX_DUTY_CYCLE_PERC)
+      {
+        percentage = MAX_DUTY_CYCLE_PERC;
+      }
+      else if(percentage < MIN_DUTY_CYCLE_PERC)
+      {
+        percentage = MIN_DUTY_CYCLE_PERC;
+      }
+    }
+
+    const uint32_t draw = LEDs_power_mW[lamps_infos[ID].LED] * percentage;
+    lamps_infos[ID].requested_percentage = (uint8_t)percentage;
+    total_requested_draw = total_requested_draw - lamps_infos[ID].requested_draw + draw;
+    lamps_infos[ID].requested_draw = draw;
+  }
+
+  /* Scale factor that fits the requested power in the budget. The lamps that the scale
+   * would take under MIN_DUTY_CYCLE_PERC are kept at it, so their draw at the minimum 
+   * is taken from the budget and the scale is computed again for the rest, until no 
+   * other lamp goes under it. The budget covers all the LEDs at the minimum.
+   */
+  uint32_t scale = POWER_SCALE_ONE;
+  if(total_requested_draw > POWER_BUDGET_DRAW)
+  {
+    uint32_t budget = POWER_BUDGET_DRAW;
+    uint32_t scaled_draw = total_requested_draw;
+    uint32_t clamped = 0u;
+    bool clamped_more = true;
+    while(clamped_more && scaled_draw > 0u)
+    {
+      scale = (uint32_t)(((uint64_t)budget << 16u) / scaled_draw);
+      clamped_more = false;
+      for(Lamp_ID ID = 0u; ID < NUM_OF_LAMPS; ID++)
+      {
+        if(lamps_infos[ID].requested_draw != 0u && (clamped & LAMP_MASK(ID)) == 0u &&
+           ((lamps_infos[ID].requested_percentage * scale) >> 16u) < MIN_DUTY_CYCLE_PERC)
         {
-          /* Imposible to reach this line as it was cheked before. */
+          clamped |= LAMP_MASK(ID);
+          clamped_more = true;
+          budget -= LEDs_power_mW[lamps_infos[ID].LED] * MIN_DUTY_CYCLE_PERC;
+          scaled_draw -= lamps_infos[ID].requested_draw;
         }
-        break;
+      }
+    }
+  }
 
-      case SET_PWM:
-        if(lamps_infos[ID].state)
+  /* If the scale changes every lamp that is on changes, otherwise only the given ones. */
+  pending = lamps;
+  if(scale != power_scale)
+  {
+    power_scale = scale;
+    pending = (NUM_OF_LAMPS == 32u) ? UINT32_MAX : ((1ul << NUM_OF_LAMPS) - 1u);
+  }
+  const uint32_t visited = pending;
+
+  /* Events of the lamps whose applied duty cycle changed. */
+  Notifier_event events[NUM_OF_LAMPS];
+  uint8_t num_of_events = 0u;
+  uint32_t staged = 0u;
+  uint32_t applied_levels = 0u;
+  while(pending != 0u)
+  {
+    const Lamp_ID ID = (Lamp_ID)__builtin_ctzl(pending);
+    pending &= pending - 1u;
+
+    /* LEDs without power information do not draw from the budget, so they are not
+     * scaled.
+     */
+    uint32_t percentage = lamps_infos[ID].requested_percentage;
+    uint32_t level = 0u;
+    if(lamps_infos[ID].level != 0u && lamps_infos[ID].state)
+    {
+      /* The level keeps its resolution through the budget, with the same limits. */
+      level = (lamps_infos[ID].level < MIN_LEVEL) ? MIN_LEVEL : lamps_infos[ID].level;
+      if(lamps_infos[ID].requested_draw != 0u)
+      {
+        level = (level * scale) >> 16u;
+        if(level < MIN_LEVEL)
         {
-          lamps_infos[ID].PWM_percentage = cmd.pwm;
-          set_LED_state(ID, lamps_infos[ID].PWM_percentage);
+          level = MIN_LEVEL;
         }
-        break;
-      default:
-        ESP_LOGE(TAG, "Received invalid action.");
-        break;
+      }
+      percentage = LEVEL_TO_PERCENTAGE(level);
+    }
+    else if(lamps_infos[ID].requested_draw != 0u)
+    {
+      percentage = (percentage * scale) >> 16u;
+      if(percentage < MIN_DUTY_CYCLE_PERC)
+      {
+        percentage = MIN_DUTY_CYCLE_PERC;
+      }
+    }
+
+    if(percentage == lamps_infos[ID].applied_percentage && 
+       level == lamps_infos[ID].applied_level)
+    {
+      continue;
+    }
+
+    #if LED_DITHERING_ENABLE == 1
+      if(level != 0u)
+      {
+        applied_levels |= LAMP_MASK(ID);
+      }
+      else
+    #endif
+    if(percentage != 0u)
+    {
+      BSP_LED_LOG(stage_LED_state(lamps_infos[ID].LED, (uint8_t)percentage));
+      staged++;
+    }
+    else
+    {
+      BSP_LED_LOG(stage_turn_off_LED(lamps_infos[ID].LED));
+      staged++;
     }
+    lamps_infos[ID].applied_level = (uint16_t)level;
+    total_applied_draw = total_applied_draw - 
+      LEDs_power_mW[lamps_infos[ID].LED] * lamps_infos[ID].applied_percentage + 
+      LEDs_power_mW[lamps_infos[ID].LED] * percentage;
+    lamps_infos[ID].applied_percentage = (uint8_t)percentage;
+    events[num_of_events++] = (Notifier_event)
+    {
+      .lamp = (uint8_t)ID,
+      .on = lamps_infos[ID].state ? 1u : 0u,
+      .duty = (uint8_t)percentage,
+    };
+  }
+
+  if(staged > 0u)
+  {
+    BSP_LED_LOG(commit_LED_states());
+  }
+
+  /* The levels are committed one by one, set_LED_level starts their dithering. */
+  while(applied_levels != 0u)
+  {
+    const Lamp_ID ID = (Lamp_ID)__builtin_ctzl(applied_levels);
+    applied_levels &= applied_levels - 1u;
+    #if LED_DITHERING_ENABLE == 1
+      BSP_LED_LOG(set_LED_level(lamps_infos[ID].LED, lamps_infos[ID].applied_level));
+    #endif
   }
+
+  if(num_of_events > 0u)
+  {
+    notifier_publish(events, num_of_events);
+  }
+
+  publish_lamps_snapshots(visited);
 }
 
-/* Implemtation of the button callbacks. */
-void __attribute__((weak)) button_CB(const Button_ID ID)
+static void publish_lamps_snapshots(uint32_t lamps)
 {
-  BaseType_t higher_priority_task_woken = pdFALSE;
-  xSemaphoreGiveFromISR(lamps_infos[LAMP_0].lamp_semaphore, 
-    &higher_priority_task_woken);
+  while(lamps != 0u)
+  {
+    const Lamp_ID ID = (Lamp_ID)__builtin_ctzl(lamps);
+    lamps &= lamps - 1u;
+
+    /* The only writer is the holder of the mutex, so the counter is read plainly. */
+    lamp_snapshot *snapshot = &lamps_snapshots[ID];
+    const uint32_t seq = snapshot->seq;
+
+    taskENTER_CRITICAL(&snapshots_lock);
+    __atomic_store_n(&snapshot->seq, seq + 1u, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    snapshot->state = (Lamp_state_entry)
+    {
+      .lamp = (uint8_t)ID,
+      .on = lamps_infos[ID].state ? 1u : 0u,
+      .pwm = lamps_infos[ID].PWM_percentage,
+      .applied_pwm = lamps_infos[ID].applied_percentage,
+    };
+    __atomic_store_n(&snapshot->seq, seq + 2u, __ATOMIC_RELEASE);
+    taskEXIT_CRITICAL(&snapshots_lock);
+  }
 }
 
-static void lamp_0_handler_func(void *args)
+void get_lamps_power_draw(uint32_t *requested_mW, uint32_t *applied_mW)
 {
-  while(true)
+  if(requested_mW != NULL)
   {
+    *requested_mW = total_requested_draw / 100u;
+  }
 
-    if(xSemaphoreTake(lamps_infos[LAMP_0].lamp_semaphore, portMAX_DELAY) == pdTRUE)
-    {
-      if(!toogle_LED_lamp(LAMP_0))
-      {
-        /* TODO: Handle this corner case. */
-      }
-    }
+  if(applied_mW != NULL)
+  {
+    *applied_mW = total_applied_draw / 100u;
+  }
+}
 
+Lamp_return get_lamp_state(const Lamp_ID lamp, Lamp_state_entry *state)
+{
+  if(!check_lamp_ID(lamp))
+  {
+    return CORE_LAMP_UNKOWN_ID_ERR;
   }
+
+  /* The copy is retried if a publication started or ended while it was taken. */
+  const lamp_snapshot *snapshot = &lamps_snapshots[lamp];
+  uint32_t seq;
+  do
+  {
+    seq = __atomic_load_n(&snapshot->seq, __ATOMIC_ACQUIRE);
+    *state = snapshot->state;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while((seq & 1u) != 0u || seq != __atomic_load_n(&snapshot->seq, __ATOMIC_RELAXED));
+
+  return CORE_LAMP_OK;
 }
 
+Lamp_return get_lamp_button_stats(const Lamp_ID lamp, Lamp_button_stats *stats)
+{
+  if(!check_lamp_ID(lamp))
+  {
+    return CORE_LAMP_UNKOWN_ID_ERR;
+  }
+
+  *stats = lamps_infos[lamp].button_stats;
+
+  return CORE_LAMP_OK;
+}
+
+Lamp_return get_lamp_ramp_stats(const Lamp_ID lamp, Lamp_ramp_stats *stats)
+{
+  if(!check_lamp_ID(lamp))
+  {
+    return CORE_LAMP_UNKOWN_ID_ERR;
+  }
+
+  *stats = lamps_infos[lamp].ramp_stats;
+
+  return CORE_LAMP_OK;
+}
+
+/* Implemtation of the TCP server received callback. */
+void __attribute__((weak)) RX_command_frame(const TCP_COMMAND_TYPE cmd)
+{
+
+  const int64_t start_us = esp_timer_get_time();
+  bool LED_ID_is_valid = false;
+  switch(cmd.ID)
+  {
+    case LED_0:
+      LED_ID_is_valid = true;
+      break;
+    default:
+      ESP_LOGE(TAG, "Received invalid LED identifier.");
+      break;
+  }
+
+  if(LED_ID_is_valid)
+  {
+    Lamp_ID ID = 0u;
+    while(ID < NUM_OF_LAMPS && lamps_infos[ID].LED != cmd.ID)
+    {
+      ID++;
+    }
+
+    Lamp_action action = NUM_OF_LAMP_ACTIONS;
+    xSemaphoreTake(lamps_writer_mutex, portMAX_DELAY);
+    switch(cmd.action)
+    {
+      case TOOGLE_LED:
+        action = LAMP_ACTION_TOGGLE;
+        if(!perform_lamp_action(ID, LAMP_ACTION_TOGGLE, 0u))
+        {
+          /* Imposible to reach this line as it was cheked before. */
+        }
+        break;
+
+      case SET_PWM:
+        action = LAMP_ACTION_SET_PWM;
+        perform_lamp_action(ID, LAMP_ACTION_SET_PWM, cmd.pwm);
+        break;
+      default:
+        ESP_LOGE(TAG, "Received invalid action.");
+        break;
+    }
+
+    update_lamps_outputs(LAMP_MASK(ID), 0u);
+    xSemaphoreGive(lamps_writer_mutex);
+
+    journal_command(JOURNAL_SOURCE_TCP_LEGACY, (uint8_t)ID, (uint8_t)action, cmd.pwm,
+      get_TCP_client_IP(), start_us);
+  }
+}
+
+/* Implemtation of the TCP server extended frames callback. */
+uint8_t __attribute__((weak)) RX_ext_command_frame(const Ext_frame_type type, 
+  const uint8_t *payload, const uint8_t len, uint8_t *reply, const uint8_t reply_size)
+{
+  switch(type)
+  {
+    case EXT_FRAME_GROUP_COMMAND:
+      process_group_command(payload, len, JOURNAL_SOURCE_TCP_GROUP, get_TCP_client_IP());
+      break;
+    case EXT_FRAME_GET_PROFILE:
+    {
+      /* The optional byte of the payload selects the first task of the report. */
+      const uint8_t first_task = (len > 0u) ? payload[0] : 0u;
+      return get_profile_report(first_task, reply, reply_size);
+    }
+    case EXT_FRAME_GET_JOURNAL:
+    {
+      /* The optional 4 bytes of the payload select the first entry of the dump. */
+      uint32_t first_seq = 0u;
+      if(len >= sizeof(first_seq))
+      {
+        memcpy(&first_seq, payload, sizeof(first_seq));
+      }
+      return get_journal_dump(first_seq, reply, reply_size);
+    }
+    case EXT_FRAME_SCHEDULE:
+    {
+      Lamp_schedule_command cmd;
+      Lamp_schedule_reply schedule_reply =
+      {
+        .handle = SCHEDULER_INVALID_HANDLE,
+        .now_us = esp_timer_get_time(),
+      };
+      schedule_reply.synced_now_us = get_synced_time_us();
+
+      if(len < sizeof(cmd) || reply_size < sizeof(schedule_reply))
+      {
+        ESP_LOGE(TAG, "Received invalid schedule command.");
+        break;
+      }
+      memcpy(&cmd, payload, sizeof(cmd));
+
+      /* Only the frames that do not reply can be executed later. */
+      if(cmd.type == EXT_FRAME_GROUP_COMMAND && 
+         cmd.len == sizeof(Lamp_group_command) && len == sizeof(cmd) + cmd.len)
+      {
+        /* The scheduler works with the local clock. */
+        int64_t time_us = cmd.time_us;
+        bool valid_clock = true;
+        switch(cmd.clock)
+        {
+          case LAMP_SCHEDULE_CLOCK_LOCAL:
+            break;
+          case LAMP_SCHEDULE_CLOCK_RELATIVE:
+            time_us += schedule_reply.now_us;
+            break;
+          case LAMP_SCHEDULE_CLOCK_SYNCED:
+            /* An unsynchronized lamp would execute the frame at a wrong time. */
+            valid_clock = is_time_synced();
+            time_us = synced_to_local_time_us(time_us);
+            break;
+          default:
+            valid_clock = false;
+            break;
+        }
+
+        if(valid_clock)
+        {
+          schedule_reply.handle = schedule_command(time_us, cmd.type, 
+            &payload[sizeof(cmd)], cmd.len);
+        }
+      }
+
+      memcpy(reply, &schedule_reply, sizeof(schedule_reply));
+      return sizeof(schedule_reply);
+    }
+    case EXT_FRAME_CANCEL:
+    {
+      uint32_t handle = SCHEDULER_INVALID_HANDLE;
+      if(len != sizeof(handle) || reply_size < 1u)
+      {
+        ESP_LOGE(TAG, "Received invalid cancel command.");
+        break;
+      }
+      memcpy(&handle, payload, sizeof(handle));
+
+      reply[0] = cancel_scheduled_command(handle) ? 1u : 0u;
+      return 1u;
+    }
+    case EXT_FRAME_GET_STATE:
+    {
+      if(reply_size < NUM_OF_LAMPS * sizeof(Lamp_state_entry))
+      {
+        break;
+      }
+      for(Lamp_ID ID = 0u; ID < NUM_OF_LAMPS; ID++)
+      {
+        Lamp_state_entry entry;
+        get_lamp_state(ID, &entry);
+        memcpy(&reply[ID * sizeof(entry)], &entry, sizeof(entry));
+      }
+      return NUM_OF_LAMPS * sizeof(Lamp_state_entry);
+    }
+    case EXT_FRAME_GET_STREAM_STATS:
+    {
+      Stream_stats stats;
+      if(reply_size < sizeof(stats))
+      {
+        break;
+      }
+      get_stream_stats(&stats);
+      memcpy(reply, &stats, sizeof(stats));
+      return sizeof(stats);
+    }
+    case EXT_FRAME_GET_DMX_STATS:
+    {
+      Dmx_stats stats;
+      if(reply_size < sizeof(stats))
+      {
+        break;
+      }
+      get_dmx_stats(&stats);
+      memcpy(reply, &stats, sizeof(stats));
+      return sizeof(stats);
+    }
+    case EXT_FRAME_SEQ_COMMAND:
+      return process_seq_command(payload, len, get_TCP_client_IP(), reply, reply_size);
+    case EXT_FRAME_GET_BUTTON_STATS:
+    {
+      if(reply_size < NUM_OF_LAMPS * sizeof(Lamp_button_stats))
+      {
+        break;
+      }
+      for(Lamp_ID ID = 0u; ID < NUM_OF_LAMPS; ID++)
+      {
+        Lamp_button_stats stats;
+        get_lamp_button_stats(ID, &stats);
+        memcpy(&reply[ID * sizeof(stats)], &stats, sizeof(stats));
+      }
+      return NUM_OF_LAMPS * sizeof(Lamp_button_stats);
+    }
+    case EXT_FRAME_GET_SERVER_STATS:
+    {
+      TCP_server_stats stats;
+      if(reply_size < sizeof(stats))
+      {
+        break;
+      }
+      get_TCP_server_stats(&stats);
+      memcpy(reply, &stats, sizeof(stats));
+      return sizeof(stats);
+    }
+    case EXT_FRAME_GET_INGRESS_STATS:
+    {
+      TCP_ingress_stats stats;
+      if(reply_size < sizeof(stats))
+      {
+        break;
+      }
+      get_TCP_ingress_stats(&stats);
+      memcpy(reply, &stats, sizeof(stats));
+      return sizeof(stats);
+    }
+    default:
+      ESP_LOGE(TAG, "Received invalid extended frame.");
+      break;
+  }
+
+  return 0u;
+}
+
+/* Implemtation of the fleet commands callback. */
+void __attribute__((weak)) RX_fleet_commands(const Fleet_command *cmds, 
+  const uint8_t num_of_cmds, const uint32_t client_IP)
+{
+  const int64_t start_us = esp_timer_get_time();
+  Lamp_ID IDs[FLEET_MAX_COMMANDS];
+  Lamp_action actions[FLEET_MAX_COMMANDS];
+
+  /* All the commands are applied before committing the LEDs once. */
+  uint32_t changed = 0u;
+  xSemaphoreTake(lamps_writer_mutex, portMAX_DELAY);
+  for(uint8_t i = 0u; i < num_of_cmds; i++)
+  {
+    IDs[i] = 0u;
+    while(IDs[i] < NUM_OF_LAMPS && lamps_infos[IDs[i]].LED != cmds[i].LED)
+    {
+      IDs[i]++;
+    }
+
+    switch(cmds[i].action)
+    {
+      case TOOGLE_LED:
+        actions[i] = LAMP_ACTION_TOGGLE;
+        break;
+      case SET_PWM:
+        actions[i] = LAMP_ACTION_SET_PWM;
+        break;
+      default:
+        actions[i] = NUM_OF_LAMP_ACTIONS;
+        break;
+    }
+
+    if(IDs[i] < NUM_OF_LAMPS && perform_lamp_action(IDs[i], actions[i], cmds[i].pwm))
+    {
+      changed |= LAMP_MASK(IDs[i]);
+    }
+  }
+
+  if(changed != 0u)
+  {
+    update_lamps_outputs(changed, 0u);
+  }
+  xSemaphoreGive(lamps_writer_mutex);
+
+  for(uint8_t i = 0u; i < num_of_cmds; i++)
+  {
+    journal_command(JOURNAL_SOURCE_UDP_FLEET, (uint8_t)IDs[i], (uint8_t)actions[i], 
+      cmds[i].pwm, client_IP, start_us);
+  }
+}
+
+/* Implemtation of the stream callback. */
+void __attribute__((weak)) stream_frame_CB(const uint8_t *levels, 
+  const uint32_t channels)
+{
+  /* The channel N drives the lamp of the LED N, only the lamps of the changed channels
+   * are touched. The frames are not journaled, at the stream rate they would flush the
+   * journal in a few seconds.
+   */
+  uint32_t changed = 0u;
+  xSemaphoreTake(lamps_writer_mutex, portMAX_DELAY);
+  for(Lamp_ID ID = 0u; ID < NUM_OF_LAMPS; ID++)
+  {
+    if(lamps_infos[ID].LED < STREAM_MAX_CHANNELS && 
+       (channels & (1ul << lamps_infos[ID].LED)) != 0u)
+    {
+      const uint8_t level = levels[lamps_infos[ID].LED];
+      lamps_infos[ID].state = (level > 0u);
+      if(level > 0u)
+      {
+        lamps_infos[ID].PWM_percentage = (level > MAX_DUTY_CYCLE_PERC) ? 
+          MAX_DUTY_CYCLE_PERC : level;
+      }
+      changed |= LAMP_MASK(ID);
+    }
+  }
+
+  if(changed != 0u)
+  {
+    update_lamps_outputs(changed, 0u);
+  }
+  xSemaphoreGive(lamps_writer_mutex);
+}
+
+/* Implemtation of the DMX callback. */
+void __attribute__((weak)) dmx_levels_CB(const uint16_t *levels, 
+  const uint8_t num_of_channels)
+{
+  /* The channel N drives the lamp of the LED N. The levels keep their 16 bits through
+   * the power budget and are applied with set_LED_level, the percentage is only the 
+   * published state of the lamp.
+   */
+  uint32_t changed = 0u;
+  uint32_t leveled = 0u;
+  xSemaphoreTake(lamps_writer_mutex, portMAX_DELAY);
+  for(Lamp_ID ID = 0u; ID < NUM_OF_LAMPS; ID++)
+  {
+    if(lamps_infos[ID].LED < num_of_channels)
+    {
+      const uint16_t level = levels[lamps_infos[ID].LED];
+      lamps_infos[ID].state = (level > 0u);
+      if(level > 0u)
+      {
+        lamps_infos[ID].PWM_percentage = (uint8_t)LEVEL_TO_PERCENTAGE(level);
+        lamps_infos[ID].level = level;
+        leveled |= LAMP_MASK(ID);
+      }
+      changed |= LAMP_MASK(ID);
+    }
+  }
+
+  if(changed != 0u)
+  {
+    update_lamps_outputs(changed, leveled);
+  }
+  xSemaphoreGive(lamps_writer_mutex);
+}
+
+/* Implemtation of the scheduler callback. */
+void __attribute__((weak)) scheduled_command_CB(const uint8_t type, 
+  const uint8_t *payload, const uint8_t len)
+{
+  switch(type)
+  {
+    case EXT_FRAME_GROUP_COMMAND:
+      process_group_command(payload, len, JOURNAL_SOURCE_SCHEDULER, 0u);
+      break;
+    default:
+      ESP_LOGE(TAG, "Scheduled invalid frame.");
+      break;
+  }
+}
+
+/* Implemtation of the button callbacks. */
+void __attribute__((weak)) button_CB(const Button_ID ID)
+{
+  BaseType_t higher_priority_task_woken = pdFALSE;
+
+  /* The edge is timestamped here, the lamp task classifies it later. */
+  const uint32_t now_us = (uint32_t)esp_timer_get_time();
+  const bool pressed = 
+    gpio_get_level(buttons_levels[ID].GPIO) == buttons_levels[ID].pressed_level;
+
+  for(Lamp_ID lamp = 0u; lamp < NUM_OF_LAMPS; lamp++)
+  {
+    if(lamps_infos[lamp].button == ID && lamps_infos[lamp].lamp_semaphore != NULL)
+    {
+      gesture_record_edge_from_ISR(&lamps_infos[lamp].gestures, pressed, now_us);
+
+      /* Only the first edge before the task runs is measured, 0 means no edge. */
+      uint32_t no_edge = 0u;
+      __atomic_compare_exchange_n(&lamps_infos[lamp].pending_edge_us, &no_edge, 
+        now_us | 1u, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+      xSemaphoreGiveFromISR(lamps_infos[lamp].lamp_semaphore, 
+        &higher_priority_task_woken);
+    }
+  }
+
+  portYIELD_FROM_ISR(higher_priority_task_woken);
+}
+
+static void lamp_0_handler_func(void *args)
+{
+  TickType_t timeout = portMAX_DELAY;
+  while(true)
+  {
+    /* Wakes up with a new edge or when a gesture can finish by time. */
+    xSemaphoreTake(lamps_infos[LAMP_0].lamp_semaphore, timeout);
+    timeout = process_lamp_gestures(LAMP_0);
+  }
+}
+
+static TickType_t process_lamp_gestures(const Lamp_ID ID)
+{
+  const int64_t start_us = esp_timer_get_time();
+  Gesture gestures[GESTURE_MAX_EVENTS];
+  uint32_t num_of_gestures = 0u;
+  const Button_ID button = lamps_infos[ID].button;
+  const bool pressed_now = 
+    gpio_get_level(buttons_levels[button].GPIO) == buttons_levels[button].pressed_level;
+
+  const uint32_t timeout_ms = gesture_process(&lamps_infos[ID].gestures, pressed_now, 
+    (uint32_t)esp_timer_get_time(), gestures, &num_of_gestures);
+
+  uint32_t changed = 0u;
+  xSemaphoreTake(lamps_writer_mutex, portMAX_DELAY);
+  for(uint32_t i = 0u; i < num_of_gestures; i++)
+  {
+    changed |= perform_gesture_action(ID, gestures[i]);
+  }
+
+  changed |= apply_ramp_steps(ID);
+
+  if(changed != 0u)
+  {
+    update_lamps_outputs(changed, 0u);
+  }
+  xSemaphoreGive(lamps_writer_mutex);
+
+  /* Latency from the button edge until the LEDs were committed. */
+  const uint32_t edge_us = 
+    __atomic_exchange_n(&lamps_infos[ID].pending_edge_us, 0u, __ATOMIC_RELAXED);
+  if(edge_us != 0u)
+  {
+    Lamp_button_stats *stats = &lamps_infos[ID].button_stats;
+    const uint32_t latency_us = (uint32_t)esp_timer_get_time() - edge_us;
+    stats->edges++;
+    stats->last_latency_us = latency_us;
+    stats->avg_latency_us = (stats->edges == 1u) ? latency_us :
+      stats->avg_latency_us - (stats->avg_latency_us >> LAMP_AVG_SHIFT) + 
+      (latency_us >> LAMP_AVG_SHIFT);
+    if(latency_us > stats->max_latency_us)
+    {
+      stats->max_latency_us = latency_us;
+    }
+  }
+
+  /* The ramp steps are not recorded, the hold start and end already describe them. */
+  for(uint32_t i = 0u; i < num_of_gestures; i++)
+  {
+    journal_command(JOURNAL_SOURCE_BUTTON, (uint8_t)ID, (uint8_t)gestures[i], 
+      lamps_infos[ID].PWM_percentage, 0u, start_us);
+  }
+
+  if(timeout_ms == GESTURE_NO_TIMEOUT)
+  {
+    return portMAX_DELAY;
+  }
+
+  /* Round up so the gesture deadline has passed when the task wakes up. */
+  return (TickType_t)((timeout_ms + portTICK_PERIOD_MS - 1u) / portTICK_PERIOD_MS);
+}
+
+static Lamp_return process_group_command(const uint8_t *payload, const uint8_t len,
+  const Journal_source source, const uint32_t client_IP)
+{
+  if(len != sizeof(Lamp_group_command))
+  {
+    ESP_LOGE(TAG, "Received invalid group command.");
+    return CORE_LAMP_INVALID_CMD_ERR;
+  }
+
+  const int64_t start_us = esp_timer_get_time();
+  const Lamp_group_command *cmd = (const Lamp_group_command *)payload;
+  Lamp_return ret = CORE_LAMP_OK;
+  xSemaphoreTake(lamps_writer_mutex, portMAX_DELAY);
+  if(cmd->group >= NUM_OF_LAMP_GROUPS)
+  {
+    ret = CORE_LAMP_UNKOWN_ID_ERR;
+  }
+  else if(!perform_group_action((Lamp_group_ID)cmd->group, (Lamp_action)cmd->action, 
+      cmd->pwm))
+  {
+    ret = CORE_LAMP_INVALID_CMD_ERR;
+  }
+
+  if(ret != CORE_LAMP_OK)
+  {
+    ESP_LOGE(TAG, "Received invalid group or action.");
+  }
+  else
+  {
+    update_lamps_outputs(lamp_groups_masks[cmd->group], 0u);
+  }
+  xSemaphoreGive(lamps_writer_mutex);
+
+  journal_command(source, cmd->group, cmd->action, cmd->pwm, client_IP, start_us);
+
+  return ret;
+}
+
+static uint8_t process_seq_command(const uint8_t *payload, const uint8_t len,
+  const uint32_t client_IP, uint8_t *reply, const uint8_t reply_size)
+{
+  Lamp_seq_command cmd;
+  if(len != sizeof(cmd) || reply_size < sizeof(Lamp_seq_reply))
+  {
+    ESP_LOGE(TAG, "Received invalid sequenced command.");
+    return 0u;
+  }
+  memcpy(&cmd, payload, sizeof(cmd));
+
+  Lamp_seq_reply seq_reply =
+  {
+    .seq = cmd.seq,
+    .status = LAMP_SEQ_NAK,
+    .result = CORE_LAMP_STALE_SEQ_ERR,
+    .duplicate = 0u,
+  };
+  const uint32_t slot = cmd.seq & (LAMP_SEQ_WINDOW - 1u);
+
+  xSemaphoreTake(seq_mutex, portMAX_DELAY);
+  seq_clock++;
+  seq_client_info *client = find_seq_client(client_IP, cmd.session);
+  if(client == NULL)
+  {
+    /* The least recently used session is forgotten, free entries have never been 
+     * used. A restarted client starts a new session, so it does not inherit the 
+     * sequence numbers of the previous one.
+     */
+    client = &seq_clients[0];
+    for(uint8_t i = 1u; i < LAMP_SEQ_CLIENTS; i++)
+    {
+      if(seq_clients[i].last_use < client->last_use)
+      {
+        client = &seq_clients[i];
+      }
+    }
+    client->client_IP = client_IP;
+    client->session = cmd.session;
+    client->valid_replies = 0u;
+  }
+  client->last_use = seq_clock;
+
+  if((client->valid_replies & (1ul << slot)) != 0u && 
+     client->replies[slot].seq == cmd.seq)
+  {
+    /* A retry of a performed command. */
+    seq_reply = client->replies[slot];
+    seq_reply.duplicate = 1u;
+  }
+  else if(client->valid_replies == 0u || 
+          (int16_t)(cmd.seq - client->newest_seq) > -(int16_t)LAMP_SEQ_WINDOW)
+  {
+    /* A new command. The older ones than the window are rejected as stale, their 
+     * reply was forgotten and it is unknown if they were performed.
+     */
+    seq_reply.result = (uint8_t)process_group_command((const uint8_t *)&cmd.cmd, 
+      sizeof(cmd.cmd), JOURNAL_SOURCE_TCP_SEQ, client_IP);
+    seq_reply.status = (seq_reply.result == CORE_LAMP_OK) ? LAMP_SEQ_ACK : LAMP_SEQ_NAK;
+
+    if(client->valid_replies == 0u || (int16_t)(cmd.seq - client->newest_seq) > 0)
+    {
+      client->newest_seq = cmd.seq;
+    }
+    client->replies[slot] = seq_reply;
+    client->valid_replies |= (1ul << slot);
+  }
+  xSemaphoreGive(seq_mutex);
+
+  memcpy(reply, &seq_reply, sizeof(seq_reply));
+  return sizeof(seq_reply);
+}
+
+static seq_client_info *find_seq_client(const uint32_t client_IP, 
+  const uint16_t session)
+{
+  for(uint8_t i = 0u; i < LAMP_SEQ_CLIENTS; i++)
+  {
+    if(seq_clients[i].last_use != 0u && seq_clients[i].client_IP == client_IP &&
+       seq_clients[i].session == session)
+    {
+      return &seq_clients[i];
+    }
+  }
+
+  return NULL;
+}
+
+static void journal_command(const Journal_source source, const uint8_t target, 
+  const uint8_t action, const uint8_t pwm, const uint32_t client_IP, 
+  const int64_t start_us)
+{
+  const int64_t processing_us = esp_timer_get_time() - start_us;
+  const Journal_entry entry =
+  {
+    .time_us = (uint32_t)start_us,
+    .client_IP = client_IP,
+    .processing_us = (processing_us > UINT16_MAX) ? UINT16_MAX : (uint16_t)processing_us,
+    .source = (uint8_t)source,
+    .target = target,
+    .action = action,
+    .pwm = pwm,
+  };
+
+  journal_record(&entry);
+}
+
+static void ramp_timer_callback(void *args)
+{
+  const Lamp_ID ID = (Lamp_ID)(uintptr_t)args;
+
+  __atomic_fetch_add(&lamps_infos[ID].ramp_pending_steps, 1u, __ATOMIC_RELAXED);
+  xSemaphoreGive(lamps_infos[ID].lamp_semaphore);
+}
+
+static uint32_t apply_ramp_steps(const Lamp_ID ID)
+{
+  lamp_info *lamp = &lamps_infos[ID];
+
+  const uint32_t steps = __atomic_exchange_n(&lamp->ramp_pending_steps, 0u, 
+    __ATOMIC_RELAXED);
+  if(steps == 0u || !lamp->gestures.holding)
+  {
+    return 0u;
+  }
+
+  /* The jitter is measured against the ideal time of the last signaled step. */
+  lamp->ramp_steps += steps;
+  const int64_t ideal_us = lamp->ramp_start_us + 
+                             (int64_t)lamp->ramp_steps * LAMP_DIMMING_PERIOD_US;
+  const int64_t jitter_us = esp_timer_get_time() - ideal_us;
+  lamp->ramp_stats.last_jitter_us = (uint32_t)((jitter_us < 0) ? -jitter_us : jitter_us);
+  if(lamp->ramp_stats.last_jitter_us > lamp->ramp_stats.max_jitter_us)
+  {
+    lamp->ramp_stats.max_jitter_us = lamp->ramp_stats.last_jitter_us;
+  }
+  lamp->ramp_stats.steps += steps;
+  lamp->ramp_stats.merged_steps += steps - 1u;
+
+  /* Late steps are applied together, so the ramp keeps its rate. */
+  const uint32_t delta = steps * LAMP_DIMMING_STEP_PERC;
+  const uint8_t previous = lamp->PWM_percentage;
+  if(lamp->dimming_up)
+  {
+    lamp->PWM_percentage = (previous + delta < MAX_DUTY_CYCLE_PERC) ? 
+                             (uint8_t)(previous + delta) : MAX_DUTY_CYCLE_PERC;
+  }
+  else
+  {
+    lamp->PWM_percentage = (previous > MIN_DUTY_CYCLE_PERC + delta) ? 
+                             (uint8_t)(previous - delta) : MIN_DUTY_CYCLE_PERC;
+  }
+
+  return (lamp->PWM_percentage != previous) ? LAMP_MASK(ID) : 0u;
+}
+
+static uint32_t perform_gesture_action(const Lamp_ID ID, const Gesture gesture)
+{
+  lamp_info *lamp = &lamps_infos[ID];
+
+  switch(gesture)
+  {
+    case GESTURE_PRESS:
+      lamp->turned_on_by_press = !lamp->state;
+      if(!lamp->state)
+      {
+        lamp->state = true;
+        return LAMP_MASK(ID);
+      }
+      break;
+
+    case GESTURE_SINGLE_CLICK:
+      if(!lamp->turned_on_by_press)
+      {
+        lamp->state = false;
+        return LAMP_MASK(ID);
+      }
+      break;
+
+    case GESTURE_DOUBLE_CLICK:
+      lamp->state = true;
+      lamp->PWM_percentage = MAX_DUTY_CYCLE_PERC;
+      return LAMP_MASK(ID);
+
+    case GESTURE_TRIPLE_CLICK:
+      lamp->state = true;
+      lamp->PWM_percentage = MIN_DUTY_CYCLE_PERC;
+      return LAMP_MASK(ID);
+
+    case GESTURE_LONG_PRESS:
+    {
+      uint32_t changed = 0u;
+      uint32_t members = lamp_groups_masks[LAMP_GROUP_ALL];
+      while(members != 0u)
+      {
+        const Lamp_ID member = (Lamp_ID)__builtin_ctzl(members);
+        members &= members - 1u;
+
+        if(lamps_infos[member].state)
+        {
+          lamps_infos[member].state = false;
+          changed |= LAMP_MASK(member);
+        }
+      }
+      return changed;
+    }
+
+    case GESTURE_HOLD_START:
+      __atomic_store_n(&lamp->ramp_pending_steps, 0u, __ATOMIC_RELAXED);
+      lamp->ramp_steps = 0u;
+      lamp->ramp_start_us = esp_timer_get_time();
+      if(esp_timer_start_periodic(lamp->ramp_timer, LAMP_DIMMING_PERIOD_US) != ESP_OK)
+      {
+        core_lamp_LOG(CORE_LAMP_RAMP_TIMER_ERR);
+      }
+      lamp->state = true;
+      return LAMP_MASK(ID);
+
+    case GESTURE_HOLD_END:
+      if(esp_timer_stop(lamp->ramp_timer) != ESP_OK)
+      {
+        core_lamp_LOG(CORE_LAMP_RAMP_TIMER_ERR);
+      }
+      lamp->dimming_up = !lamp->dimming_up;
+      break;
+
+    default:
+      break;
+  }
+
+  return 0u;
+}
@@ -15,6 +15,15 @@
 #include <Button.h>
 #include <LED.h>
 #include <TCP_server.h>
+#include <Gesture.h>
+#include <Profiler.h>
+#include <Journal.h>
+#include <Scheduler.h>
+#include <Time_sync.h>
+#include <Stream.h>
+#include <Dmx.h>
+#include <GUI_server.h>
+#include <Notifier.h>
 
 /***************************************************************************************
  * Defines
@@ -26,6 +35,70 @@
 #define LAMPS  \
   LAMP(LAMP_0)  
 
+/* Macro that describes the compiled physical connections of the lamps, the hardware map
+ * (Hardware_map.h) can replace them.
+ *
+ * Parameters:
+ * 
+ *   1) Identifier of the lamp, it is mandatory to put a value defined inside LAMPS.
+ *   2) Button of the lamp, it is mandatory to put a value defined inside BUTTONS.
+ *   3) LED of the lamp, it is mandatory to put a value defined inside LEDS.
+ *   
+ */
+#define LAMPS_CONNECTIONS                    \
+  LAMP_CONNECTION(LAMP_0, BUTTON_0, LED_0)
+
+/* Macro that enlist the groups of lamps that can be controlled with a single command.
+ * It is mandatory to not set values to the enumerates.
+ *
+ * Parameters:
+ * 
+ *   1) Identifier of the group.
+ *   2) Lamps that belong to the group. It is mandatory to join with | the LAMP_MASK
+ *      of lamps defined inside LAMPS.
+ *   
+ */
+#define LAMP_GROUPS                              \
+  LAMP_GROUP(LAMP_GROUP_ALL, LAMP_MASK(LAMP_0))
+
+/* Returns the bit that represents a lamp inside a group mask. */
+#define LAMP_MASK(lamp) (1ul << (lamp))
+
+/* Macro that enlist the actions that a command can perform over a lamp. It is 
+ * mandatory to not set values to the enumerates.
+ */
+#define LAMP_ACTIONS              \
+  LAMP_ACTION(LAMP_ACTION_TOGGLE)  \
+  LAMP_ACTION(LAMP_ACTION_SET_PWM) \
+  LAMP_ACTION(LAMP_ACTION_SET_ON)  \
+  LAMP_ACTION(LAMP_ACTION_SET_OFF)
+
+/* Macro that enlist the statuses of the reply of a sequenced command. It is mandatory 
+ * to not set values to the enumerates.
+ */
+#define LAMP_SEQ_STATUSES       \
+  LAMP_SEQ_STATUS(LAMP_SEQ_ACK) \
+  LAMP_SEQ_STATUS(LAMP_SEQ_NAK)
+
+/* Number of sessions whose sequenced commands are remembered, the least recently used 
+ * one is forgotten to make room for a new one. A session is a client address and the
+ * session number that the client chose.
+ */
+#define LAMP_SEQ_CLIENTS 4u
+
+/* Number of replies remembered per client. A client can have up to this number of 
+ * sequenced commands outstanding, the retries of older ones are rejected as stale.
+ */
+#define LAMP_SEQ_WINDOW 16u
+
+/* Macro that enlist the clocks that the time of a scheduled frame can refer to. It is
+ * mandatory to not set values to the enumerates.
+ */
+#define LAMP_SCHEDULE_CLOCKS                         \
+  LAMP_SCHEDULE_CLOCK(LAMP_SCHEDULE_CLOCK_LOCAL)     \
+  LAMP_SCHEDULE_CLOCK(LAMP_SCHEDULE_CLOCK_RELATIVE)  \
+  LAMP_SCHEDULE_CLOCK(LAMP_SCHEDULE_CLOCK_SYNCED)
+
 /* List of the possible return codes that module button can return. */
 #define LAMP_RETURNS                        \
   /* Info codes */                          \
@@ -35,9 +108,13 @@
   LAMP_RETURN(CORE_LAMP_INIT_SEMAPHORE_ERR) \
   LAMP_RETURN(CORE_LAMP_UNKOWN_ID_ERR)      \
   LAMP_RETURN(CORE_LAMP_INIT_TASK_ERR)      \
+  LAMP_RETURN(CORE_LAMP_INIT_TIMER_ERR)     \
   LAMP_RETURN(CORE_LAMP_DE_INIT_ERR)        \
   LAMP_RETURN(CORE_LAMP_START_SERVER_ERR)   \
-  LAMP_RETURN(CORE_LAMP_STOP_SERVER_ERR)         
+  LAMP_RETURN(CORE_LAMP_STOP_SERVER_ERR)    \
+  LAMP_RETURN(CORE_LAMP_INVALID_CMD_ERR)    \
+  LAMP_RETURN(CORE_LAMP_STALE_SEQ_ERR)      \
+  LAMP_RETURN(CORE_LAMP_RAMP_TIMER_ERR)
        
 /***************************************************************************************
  * Data Type Definitions
@@ -53,6 +130,159 @@ typedef enum
   NUM_OF_LAMPS,
 } Lamp_ID;
 
+/* Enumerate that enlist the groups of lamps. */
+typedef enum
+{
+  #define LAMP_GROUP(enumerate, mask) enumerate,
+    LAMP_GROUPS
+  #undef LAMP_GROUP
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_LAMP_GROUPS,
+} Lamp_group_ID;
+
+/* Enumerate that enlist the actions that can be performed over a lamp. */
+typedef enum
+{
+  #define LAMP_ACTION(enumerate) enumerate,
+    LAMP_ACTIONS
+  #undef LAMP_ACTION
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_LAMP_ACTIONS,
+} Lamp_action;
+
+/* Payload of the EXT_FRAME_GROUP_COMMAND frame. */
+typedef struct __attribute__((packed))
+{
+  /* Group of lamps to control, it is mandatory to use a value of Lamp_group_ID. */
+  uint8_t group;
+  /* Action to perform, it is mandatory to use a value of Lamp_action. */
+  uint8_t action;
+  /* PWM duty cycle in percentage terms, only used by LAMP_ACTION_SET_PWM. */
+  uint8_t pwm;
+} Lamp_group_command;
+
+/* Enumerate that enlist the statuses of the reply of a sequenced command. */
+typedef enum
+{
+  #define LAMP_SEQ_STATUS(enumerate) enumerate,
+    LAMP_SEQ_STATUSES
+  #undef LAMP_SEQ_STATUS
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_LAMP_SEQ_STATUSES,
+} Lamp_seq_status;
+
+/* Payload of the EXT_FRAME_SEQ_COMMAND frame. */
+typedef struct __attribute__((packed))
+{
+  /* Sequence number of the command, chosen by the client and increased by one for 
+   * every new command. A retry uses the same number.
+   */
+  uint16_t seq;
+  /* Session of the command, chosen at random by the client every time it starts. The 
+   * sequence numbers of a restarted client are not compared with the ones it used 
+   * before.
+   */
+  uint16_t session;
+  /* Command to perform. */
+  Lamp_group_command cmd;
+} Lamp_seq_command;
+
+/* Reply of the EXT_FRAME_SEQ_COMMAND frame. */
+typedef struct __attribute__((packed))
+{
+  /* Sequence number of the acknowledged command. */
+  uint16_t seq;
+  /* LAMP_SEQ_ACK if the command was performed, otherwise LAMP_SEQ_NAK. */
+  uint8_t status;
+  /* Return code of the command, it is a value of Lamp_return. */
+  uint8_t result;
+  /* 1 if the command was already performed and this is the reply of the first time, 
+   * otherwise 0.
+   */
+  uint8_t duplicate;
+} Lamp_seq_reply;
+
+/* Enumerate that enlist the clocks of the scheduled frames. */
+typedef enum
+{
+  #define LAMP_SCHEDULE_CLOCK(enumerate) enumerate,
+    LAMP_SCHEDULE_CLOCKS
+  #undef LAMP_SCHEDULE_CLOCK
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_LAMP_SCHEDULE_CLOCKS,
+} Lamp_schedule_clock;
+
+/* Header of the payload of the EXT_FRAME_SCHEDULE frame, it is followed by "len" bytes
+ * of the payload of the scheduled frame.
+ */
+typedef struct __attribute__((packed))
+{
+  /* Time in microseconds when the frame is executed. */
+  int64_t time_us;
+  /* Clock of time_us, it is mandatory to use a value of Lamp_schedule_clock. The 
+   * synchronized clock lets several lamps execute the frame at the same time, a lamp
+   * that is not synchronized yet rejects it.
+   */
+  uint8_t clock;
+  /* Type of the scheduled frame, only EXT_FRAME_GROUP_COMMAND can be scheduled. */
+  uint8_t type;
+  /* Number of bytes of the payload of the scheduled frame. */
+  uint8_t len;
+} Lamp_schedule_command;
+
+/* Reply of the EXT_FRAME_SCHEDULE frame. */
+typedef struct __attribute__((packed))
+{
+  /* Handle to cancel the frame, SCHEDULER_INVALID_HANDLE if it was rejected. */
+  uint32_t handle;
+  /* Time in microseconds of the device clock when the frame was received. */
+  int64_t now_us;
+  /* Time in microseconds of the synchronized clock when the frame was received. */
+  int64_t synced_now_us;
+} Lamp_schedule_reply;
+
+/* State of a lamp, the reply of the EXT_FRAME_GET_STATE frame has one per lamp. */
+typedef struct __attribute__((packed))
+{
+  /* Identifier of the lamp. */
+  uint8_t lamp;
+  /* 1 if the lamp is on, otherwise 0. */
+  uint8_t on;
+  /* PWM duty cycle in percentage terms requested for the lamp. */
+  uint8_t pwm;
+  /* PWM duty cycle in percentage terms applied after the power budget, 0 when off. */
+  uint8_t applied_pwm;
+} Lamp_state_entry;
+
+/* Structure that contains the cadence statistics of the dimming ramp of a lamp. */
+typedef struct
+{
+  /* Number of ramp steps applied since the lamp was initialized. */
+  uint32_t steps;
+  /* Number of ramp steps that were applied late together with the next one. */
+  uint32_t merged_steps;
+  /* Difference in microseconds between the last step and its ideal time. */
+  uint32_t last_jitter_us;
+  /* Maximum difference in microseconds between a step and its ideal time. */
+  uint32_t max_jitter_us;
+} Lamp_ramp_stats;
+
+/* Structure that contains the latency statistics of the button of a lamp, from the 
+ * edge in the ISR until the LEDs were committed by the lamp task. The reply of the 
+ * EXT_FRAME_GET_BUTTON_STATS frame has one per lamp.
+ */
+typedef struct __attribute__((packed))
+{
+  /* Number of button edges measured. */
+  uint32_t edges;
+  /* Latency in microseconds of the last edge. */
+  uint32_t last_latency_us;
+  /* Exponential average of the latency in microseconds. */
+  uint32_t avg_latency_us;
+  /* Maximum latency in microseconds. */
+  uint32_t max_latency_us;
+} Lamp_button_stats;
+
 /* Enumerate that lists the posible return codes that the module can return. */
 typedef enum
 {
@@ -91,6 +321,9 @@ typedef enum
  * 
  *           - CORE_LAMP_INIT_TASK_ERR: 
  *               Error trying to create the lamp task.
+ * 
+ *           - CORE_LAMP_INIT_TIMER_ERR: 
+ *               Error trying to create the dimming ramp timer.
  *                                      
  */
 Lamp_return Lamp_init(const Lamp_ID lamp,const Button_ID button, const LED_ID LED);
@@ -141,6 +374,69 @@ Lamp_return lamp_start_server(void);
  */
 Lamp_return lamp_stop_server(void);
 
+/**
+ * @brief Gets the power that the lamps would draw with the duty cycles requested by the
+ *        commands and the power that they draw after the budget scaling and the 
+ *        minimum duty cycle.
+ *
+ * @param requested_mW Return power in milliwatts requested by the commands.
+ * 
+ * @param applied_mW Return power in milliwatts applied to the LEDs.
+ *
+ * @return void
+ */
+void get_lamps_power_draw(uint32_t *requested_mW, uint32_t *applied_mW);
+
+/**
+ * @brief Gets a consistent snapshot of the state of a lamp. It never blocks nor takes 
+ *        a lock, so it can be called at any rate from any task while the lamp changes.
+ *
+ * @param lamp Identifier of the lamp.
+ * 
+ * @param state Return state of the lamp.
+ *
+ * @return CORE_LAMP_OK if the operation went well,
+ *         otherwise:
+ * 
+ *           - CORE_LAMP_UNKOWN_ID_ERR: 
+ *               Given lamp identifier does not exists. 
+ * 
+ */
+Lamp_return get_lamp_state(const Lamp_ID lamp, Lamp_state_entry *state);
+
+/**
+ * @brief Gets the latency statistics of the button of a lamp. They measure the effect 
+ *        of the task plan of System_tasks.h on the lighting path.
+ *
+ * @param lamp Identifier of the lamp.
+ * 
+ * @param stats Return statistics.
+ *
+ * @return CORE_LAMP_OK if the operation went well,
+ *         otherwise:
+ * 
+ *           - CORE_LAMP_UNKOWN_ID_ERR: 
+ *               Given lamp identifier does not exists. 
+ * 
+ */
+Lamp_return get_lamp_button_stats(const Lamp_ID lamp, Lamp_button_stats *stats);
+
+/**
+ * @brief Gets the cadence statistics of the dimming ramp of a lamp.
+ *
+ * @param lamp Identifier of the lamp.
+ * 
+ * @param stats Return statistics.
+ *
+ * @return CORE_LAMP_OK if the operation went well,
+ *         otherwise:
+ * 
+ *           - CORE_LAMP_UNKOWN_ID_ERR: 
+ *               Given lamp identifier does not exists. 
+ * 
+ */
+Lamp_return get_lamp_ramp_stats(const Lamp_ID lamp, Lamp_ramp_stats *stats);
+
 /**
  * @brief Prints the return of a lamp module function if the system was configured 
  *        in debug mode.
@@ -0,0 +1,195 @@
+/**
+ * @file      Notifier.c
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This source file defines the functions to fan out the changes of the 
+ *            lamps to the subscribed clients through bounded queues.
+ */
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <Notifier.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <freertos/FreeRTOS.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Index of the queue slot of a position. */
+#define QUEUE_INDEX(position) ((position) & (NOTIFIER_QUEUE_SIZE - 1u))
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Structure that contains a subscriber. */
+typedef struct
+{
+  /* Queue of events, head is the next event to take and tail the next free slot. */
+  Notifier_event queue[NOTIFIER_QUEUE_SIZE];
+  uint32_t head;
+  uint32_t tail;
+  /* Events dropped since the last take. */
+  uint32_t dropped;
+  /* Function that wakes up the subscriber and its argument. */
+  Notifier_wake_CB wake;
+  void *arg;
+  /* True if the subscriber is in use. */
+  bool active;
+} notifier_subscriber;
+
+/***************************************************************************************
+ * Global Variables
+ ***************************************************************************************/
+
+/* Subscribers of the notifier. */
+static notifier_subscriber subscribers[NOTIFIER_MAX_SUBSCRIBERS];
+
+/* Statistics of the notifier. */
+static Notifier_stats notifier_stats;
+
+/* Lock that protects the subscribers and the statistics, it is held while copying a 
+ * few bytes only.
+ */
+static portMUX_TYPE notifier_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+uint8_t notifier_subscribe(const Notifier_wake_CB wake, void *arg)
+{
+  uint8_t ID = NOTIFIER_INVALID_SUBSCRIBER;
+
+  taskENTER_CRITICAL(&notifier_lock);
+  for(uint8_t i = 0u; i < NOTIFIER_MAX_SUBSCRIBERS; i++)
+  {
+    if(!subscribers[i].active)
+    {
+      subscribers[i].head = 0u;
+      subscribers[i].tail = 0u;
+      subscribers[i].dropped = 0u;
+      subscribers[i].wake = wake;
+      subscribers[i].arg = arg;
+      subscribers[i].active = true;
+      notifier_stats.subscribers++;
+      ID = i;
+      break;
+    }
+  }
+  taskEXIT_CRITICAL(&notifier_lock);
+
+  return ID;
+}
+
+void notifier_unsubscribe(const uint8_t ID)
+{
+  if(ID >= NOTIFIER_MAX_SUBSCRIBERS)
+  {
+    return;
+  }
+
+  taskENTER_CRITICAL(&notifier_lock);
+  if(subscribers[ID].active)
+  {
+    subscribers[ID].active = false;
+    notifier_stats.subscribers--;
+  }
+  taskEXIT_CRITICAL(&notifier_lock);
+}
+
+void notifier_publish(const Notifier_event *events, const uint8_t num_of_events)
+{
+  Notifier_wake_CB wakes[NOTIFIER_MAX_SUBSCRIBERS];
+  void *args[NOTIFIER_MAX_SUBSCRIBERS];
+  uint8_t num_of_wakes = 0u;
+
+  if(num_of_events == 0u)
+  {
+    return;
+  }
+
+  taskENTER_CRITICAL(&notifier_lock);
+  for(uint8_t i = 0u; i < NOTIFIER_MAX_SUBSCRIBERS; i++)
+  {
+    notifier_subscriber *subscriber = &subscribers[i];
+    if(!subscriber->active)
+    {
+      continue;
+    }
+
+    for(uint8_t j = 0u; j < num_of_events; j++)
+    {
+      /* Drop the oldest event instead of waiting for the subscriber. */
+      if(subscriber->tail - subscriber->head == NOTIFIER_QUEUE_SIZE)
+      {
+        subscriber->head++;
+        subscriber->dropped++;
+        notifier_stats.dropped++;
+      }
+      subscriber->queue[QUEUE_INDEX(subscriber->tail)] = events[j];
+      subscriber->tail++;
+    }
+
+    if(subscriber->wake != NULL)
+    {
+      wakes[num_of_wakes] = subscriber->wake;
+      args[num_of_wakes] = subscriber->arg;
+      num_of_wakes++;
+    }
+  }
+  notifier_stats.published += num_of_events;
+  taskEXIT_CRITICAL(&notifier_lock);
+
+  /* The subscribers are woken up out of the lock. */
+  for(uint8_t i = 0u; i < num_of_wakes; i++)
+  {
+    wakes[i](args[i]);
+  }
+}
+
+uint8_t notifier_take(const uint8_t ID, Notifier_event *events, 
+  const uint8_t max_events, uint32_t *dropped)
+{
+  uint8_t num_of_events = 0u;
+
+  if(dropped != NULL)
+  {
+    *dropped = 0u;
+  }
+
+  if(ID >= NOTIFIER_MAX_SUBSCRIBERS)
+  {
+    return 0u;
+  }
+
+  taskENTER_CRITICAL(&notifier_lock);
+  notifier_subscriber *subscriber = &subscribers[ID];
+  if(subscriber->active)
+  {
+    while(num_of_events < max_events && subscriber->head != subscriber->tail)
+    {
+      events[num_of_events++] = subscriber->queue[QUEUE_INDEX(subscriber->head)];
+      subscriber->head++;
+    }
+    if(dropped != NULL)
+    {
+      *dropped = subscriber->dropped;
+    }
+    subscriber->dropped = 0u;
+  }
+  taskEXIT_CRITICAL(&notifier_lock);
+
+  return num_of_events;
+}
+
+void get_notifier_stats(Notifier_stats *stats)
+{
+  taskENTER_CRITICAL(&notifier_lock);
+  *stats = notifier_stats;
+  taskEXIT_CRITICAL(&notifier_lock);
+}
@@ -0,0 +1,132 @@
+/**
+ * @file      Notifier.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This header file declares the functions to fan out the changes of the 
+ *            lamps to the subscribed clients through bounded queues.
+ */
+
+#ifndef CORE_NOTIFIER_H_
+#define CORE_NOTIFIER_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <stdint.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Maximum number of subscribers at the same time. */
+#define NOTIFIER_MAX_SUBSCRIBERS 8u
+
+/* Number of events of the queue of every subscriber, the oldest events are dropped 
+ * when it is full. It is mandatory to use a power of 2.
+ */
+#define NOTIFIER_QUEUE_SIZE 16u
+
+#if (NOTIFIER_QUEUE_SIZE & (NOTIFIER_QUEUE_SIZE - 1u)) != 0u
+  #error "Invalid notifier queue size, it must be a power of 2:"
+  #error "refer to (NOTIFIER_QUEUE_SIZE)"
+#endif
+
+/* Identifier returned when there are no free subscribers. */
+#define NOTIFIER_INVALID_SUBSCRIBER UINT8_MAX
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Event of a change of a lamp. */
+typedef struct __attribute__((packed))
+{
+  /* Identifier of the lamp. */
+  uint8_t lamp;
+  /* 1 if the lamp is on, otherwise 0. */
+  uint8_t on;
+  /* PWM duty cycle in percentage terms applied to the lamp, 0 when it is off. */
+  uint8_t duty;
+} Notifier_event;
+
+/* Function that wakes up a subscriber when it has new events. It is called from the 
+ * task that publishes the events, so it must not block.
+ */
+typedef void (*Notifier_wake_CB)(void *arg);
+
+/* Structure that contains the statistics of the notifier. */
+typedef struct
+{
+  /* Number of events published. */
+  uint32_t published;
+  /* Number of events dropped from the full queues. */
+  uint32_t dropped;
+  /* Number of current subscribers. */
+  uint8_t subscribers;
+} Notifier_stats;
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Adds a subscriber with an empty queue.
+ *
+ * @param wake Function called when the subscriber has new events, NULL to poll.
+ * 
+ * @param arg Argument of the wake function.
+ *
+ * @return Identifier of the subscriber, NOTIFIER_INVALID_SUBSCRIBER if there are no
+ *         free subscribers.
+ */
+uint8_t notifier_subscribe(const Notifier_wake_CB wake, void *arg);
+
+/**
+ * @brief Removes a subscriber, its pending events are discarded.
+ *
+ * @param ID Identifier of the subscriber.
+ *
+ * @return void
+ */
+void notifier_unsubscribe(const uint8_t ID);
+
+/**
+ * @brief Adds events to the queues of all the subscribers and wakes them up. It never
+ *        blocks, if a queue is full its oldest event is dropped.
+ *
+ * @param events Events to publish.
+ * 
+ * @param num_of_events Number of events.
+ *
+ * @return void
+ */
+void notifier_publish(const Notifier_event *events, const uint8_t num_of_events);
+
+/**
+ * @brief Takes the pending events of a subscriber, the oldest first.
+ *
+ * @param ID Identifier of the subscriber.
+ * 
+ * @param events Buffer where the events are returned.
+ * 
+ * @param max_events Maximum number of events to take.
+ * 
+ * @param dropped Returns the number of events dropped from the queue since the last 
+ *                call, NULL to ignore it.
+ *
+ * @return Number of events taken.
+ */
+uint8_t notifier_take(const uint8_t ID, Notifier_event *events, 
+  const uint8_t max_events, uint32_t *dropped);
+
+/**
+ * @brief Gets the statistics of the notifier.
+ *
+ * @param stats Return statistics.
+ *
+ * @return void
+ */
+void get_notifier_stats(Notifier_stats *stats);
+
+#endif /* CORE_NOTIFIER_H_ */
@@ -0,0 +1,348 @@
+/**
+ * @file      Profiler.c
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This source file defines the functions to sample the stack, CPU and heap 
+ *            usage of the system over a rolling window.
+ */
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <Profiler.h>
+#include <Debug.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_heap_caps.h>
+#include <System_memory.h>
+#include <System_tasks.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+#if DEBUG_MODE_ENABLE == 1
+/* Tag to show traces in profiler module. */
+  #define TAG "CORE_PROFILER"
+#endif
+
+/* Heap that is profiled, the one used by malloc. */
+#define PROFILED_HEAP_CAPS MALLOC_CAP_8BIT
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Structure that contains the samples of a tracked task. */
+typedef struct
+{
+  /* Handler of the task, NULL if the slot is free. */
+  TaskHandle_t handle;
+  /* Name of the task. */
+  char name[PROFILER_TASK_NAME_SIZE];
+  /* Minimum free stack in bytes at the last sample. */
+  uint32_t stack_free;
+  /* Priority of the task at the last sample. */
+  UBaseType_t priority;
+  /* Run time counter of the task along the window. */
+  uint32_t run_time[PROFILER_WINDOW_SIZE];
+  /* True if the task was found in the last sample. */
+  bool alive;
+} task_samples;
+
+/***************************************************************************************
+ * Global Variables
+ ***************************************************************************************/
+
+/* Samples of the tracked tasks. */
+static task_samples tasks_samples[PROFILER_MAX_TASKS];
+
+/* Total run time counter along the window. */
+static uint32_t total_run_time[PROFILER_WINDOW_SIZE];
+
+/* Free heap in bytes along the window. */
+static uint32_t heap_free[PROFILER_WINDOW_SIZE];
+
+/* Largest free heap block in bytes at the last sample. */
+static uint32_t heap_largest_block;
+
+/* Index of the window where the last sample was stored. */
+static uint32_t newest_sample;
+
+/* Number of valid samples of the window. */
+static uint32_t num_of_samples;
+
+/* Status of the tasks, static to keep it out of the profiler stack. */
+static TaskStatus_t tasks_status[PROFILER_MAX_TASKS];
+
+/* Mutex that protects the samples between the profiler task and the reports. */
+static SemaphoreHandle_t profile_mutex;
+static StaticSemaphore_t profile_mutex_buffer;
+
+/* Handler of the profiler task. */
+static TaskHandle_t profiler_task_handler;
+
+/* Storage of the profiler task, there is no heap allocation for it. */
+static StackType_t profiler_task_stack[SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_PROFILER)];
+static StaticTask_t profiler_task_buffer;
+
+/* RAM reserved by the RTOS objects of the profiler. */
+_Static_assert(sizeof(profiler_task_stack) + sizeof(profiler_task_buffer) + 
+  sizeof(profile_mutex_buffer) <= PROFILER_STATIC_RAM_BUDGET, 
+  "Profiler RTOS objects go over PROFILER_STATIC_RAM_BUDGET");
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Function that will sample the system every PROFILER_PERIOD_MS.
+ *
+ * @param args arguments to pass to the function.
+ *
+ * @return void
+ */
+static void profiler_task_func(void *args);
+
+/**
+ * @brief Takes a sample of the tasks and the heap and stores it in the window.
+ *
+ * @param void
+ *
+ * @return void
+ */
+static void take_sample(void);
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+Profiler_return init_profiler(void)
+{
+  profile_mutex = xSemaphoreCreateMutexStatic(&profile_mutex_buffer);
+  if(profile_mutex == NULL)
+  {
+    return CORE_PROFILER_INIT_ERR;
+  }
+
+  /* Lowest priority above idle, the profiler must not disturb the measured tasks. */
+  profiler_task_handler = xTaskCreateStaticPinnedToCore(profiler_task_func, 
+    SYSTEM_TASK_NAME(SYSTEM_TASK_PROFILER), SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_PROFILER),
+    (void *) 0, SYSTEM_TASK_PRIORITY(SYSTEM_TASK_PROFILER), profiler_task_stack, 
+    &profiler_task_buffer, SYSTEM_TASK_CORE(SYSTEM_TASK_PROFILER));
+  if(profiler_task_handler == NULL)
+  {
+    return CORE_PROFILER_INIT_TASK_ERR;
+  }
+
+  return CORE_PROFILER_OK;
+}
+
+uint8_t get_profile_report(const uint8_t first_task, uint8_t *report, const uint8_t size)
+{
+  if(size < sizeof(Profile_report_header))
+  {
+    return 0u;
+  }
+
+  Profile_report_header header;
+  memset(&header, 0, sizeof(header));
+  header.first_task = first_task;
+
+  uint8_t len = sizeof(Profile_report_header);
+
+  xSemaphoreTake(profile_mutex, portMAX_DELAY);
+
+  const uint32_t newest = newest_sample;
+  const uint32_t oldest = (num_of_samples > 0u) ? 
+    (newest + PROFILER_WINDOW_SIZE - (num_of_samples - 1u)) % PROFILER_WINDOW_SIZE : newest;
+
+  header.samples = (uint8_t)num_of_samples;
+  header.heap_free = heap_free[newest];
+  header.heap_min_free = (uint32_t)heap_caps_get_minimum_free_size(PROFILED_HEAP_CAPS);
+  header.heap_largest_block = heap_largest_block;
+  header.heap_window_min_free = heap_free[newest];
+  for(uint32_t i = 0u; i < num_of_samples; i++)
+  {
+    const uint32_t sample = (oldest + i) % PROFILER_WINDOW_SIZE;
+    if(heap_free[sample] < header.heap_window_min_free)
+    {
+      header.heap_window_min_free = heap_free[sample];
+    }
+  }
+  if(heap_free[newest] != 0u)
+  {
+    header.heap_fragmentation_permille = (uint16_t)(1000u - 
+      (uint32_t)(((uint64_t)heap_largest_block * 1000u) / heap_free[newest]));
+  }
+
+  /* The run time of all the cores is the time of the window times the cores. */
+  const uint64_t window_run_time = 
+    (uint64_t)(total_run_time[newest] - total_run_time[oldest]) * portNUM_PROCESSORS;
+
+  for(uint32_t slot = 0u; slot < PROFILER_MAX_TASKS; slot++)
+  {
+    const task_samples *task = &tasks_samples[slot];
+    if(task->handle == NULL)
+    {
+      continue;
+    }
+
+    /* Entries before the requested page or that do not fit are only counted. */
+    if(header.num_of_tasks++ < first_task || 
+       len + sizeof(Profile_task_entry) > size)
+    {
+      continue;
+    }
+
+    Profile_task_entry entry;
+    memcpy(entry.name, task->name, sizeof(entry.name));
+    entry.stack_free = (task->stack_free > UINT16_MAX) ? UINT16_MAX : 
+                         (uint16_t)task->stack_free;
+    entry.priority = (uint8_t)task->priority;
+    entry.cpu_permille = 0u;
+    if(window_run_time != 0u)
+    {
+      entry.cpu_permille = (uint16_t)(((uint64_t)(task->run_time[newest] - 
+        task->run_time[oldest]) * 1000u) / window_run_time);
+    }
+
+    memcpy(&report[len], &entry, sizeof(entry));
+    len += sizeof(entry);
+    header.tasks_in_report++;
+  }
+
+  xSemaphoreGive(profile_mutex);
+
+  memcpy(report, &header, sizeof(header));
+
+  return len;
+}
+
+inline Profiler_return core_profiler_LOG(const Profiler_return ret)
+{
+  #if DEBUG_MODE_ENABLE == 1
+    switch(ret)
+    {
+      #define PROFILER_RETURN(enumerate) \
+        case enumerate:                  \
+          if(ret > 0)                    \
+          {                              \
+            ESP_LOGE(TAG, #enumerate);   \
+          }                              \
+          else                           \
+          {                              \
+            ESP_LOGI(TAG, #enumerate);   \
+          }                              \
+          break;       
+        PROFILER_RETURNS
+      #undef PROFILER_RETURN
+      default:
+        ESP_LOGE(TAG, "Unkown return.");
+        break;
+    }
+  #endif
+  return ret;
+}
+
+static void profiler_task_func(void *args)
+{
+  TickType_t last_wake = xTaskGetTickCount();
+  while(true)
+  {
+    take_sample();
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(PROFILER_PERIOD_MS));
+  }
+}
+
+static void take_sample(void)
+{
+  uint32_t total = 0u;
+  UBaseType_t num_of_tasks = 0u;
+
+  /* The system state is read before taking the mutex, it suspends the scheduler. */
+  #if configUSE_TRACE_FACILITY == 1
+    num_of_tasks = uxTaskGetSystemState(tasks_status, PROFILER_MAX_TASKS, &total);
+  #endif
+
+  const uint32_t free_bytes = (uint32_t)heap_caps_get_free_size(PROFILED_HEAP_CAPS);
+  const uint32_t largest_block = 
+    (uint32_t)heap_caps_get_largest_free_block(PROFILED_HEAP_CAPS);
+
+  xSemaphoreTake(profile_mutex, portMAX_DELAY);
+
+  const uint32_t sample = (num_of_samples == 0u) ? 
+                            0u : (newest_sample + 1u) % PROFILER_WINDOW_SIZE;
+
+  for(uint32_t slot = 0u; slot < PROFILER_MAX_TASKS; slot++)
+  {
+    tasks_samples[slot].alive = false;
+  }
+
+  for(UBaseType_t i = 0u; i < num_of_tasks; i++)
+  {
+    const TaskStatus_t *status = &tasks_status[i];
+    uint32_t run_time = 0u;
+    #if configGENERATE_RUN_TIME_STATS == 1
+      run_time = status->ulRunTimeCounter;
+    #endif
+
+    /* Find the slot of the task or a free one for a new task. */
+    uint32_t slot = 0u;
+    uint32_t free_slot = PROFILER_MAX_TASKS;
+    while(slot < PROFILER_MAX_TASKS && tasks_samples[slot].handle != status->xHandle)
+    {
+      if(free_slot == PROFILER_MAX_TASKS && tasks_samples[slot].handle == NULL)
+      {
+        free_slot = slot;
+      }
+      slot++;
+    }
+
+    if(slot == PROFILER_MAX_TASKS)
+    {
+      if(free_slot == PROFILER_MAX_TASKS)
+      {
+        continue;
+      }
+
+      /* A new task has no history, its usage is counted from now. */
+      slot = free_slot;
+      tasks_samples[slot].handle = status->xHandle;
+      strncpy(tasks_samples[slot].name, status->pcTaskName, PROFILER_TASK_NAME_SIZE);
+      for(uint32_t j = 0u; j < PROFILER_WINDOW_SIZE; j++)
+      {
+        tasks_samples[slot].run_time[j] = run_time;
+      }
+    }
+
+    tasks_samples[slot].alive = true;
+    tasks_samples[slot].stack_free = 
+      (uint32_t)status->usStackHighWaterMark * sizeof(StackType_t);
+    tasks_samples[slot].priority = status->uxCurrentPriority;
+    tasks_samples[slot].run_time[sample] = run_time;
+  }
+
+  /* Deleted tasks free their slots. */
+  for(uint32_t slot = 0u; slot < PROFILER_MAX_TASKS; slot++)
+  {
+    if(!tasks_samples[slot].alive)
+    {
+      tasks_samples[slot].handle = NULL;
+    }
+  }
+
+  total_run_time[sample] = total;
+  heap_free[sample] = free_bytes;
+  heap_largest_block = largest_block;
+  newest_sample = sample;
+  if(num_of_samples < PROFILER_WINDOW_SIZE)
+  {
+    num_of_samples++;
+  }
+
+  xSemaphoreGive(profile_mutex);
+}
@@ -0,0 +1,149 @@
+/**
+ * @file      Profiler.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This header file declares the functions to sample the stack, CPU and heap 
+ *            usage of the system over a rolling window.
+ */
+
+#ifndef CORE_PROFILER_H_
+#define CORE_PROFILER_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <stdint.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Period in milliseconds between two samples of the profiler. */
+#define PROFILER_PERIOD_MS 1000u
+
+/* Number of samples of the rolling window. The CPU usage and the heap minimum of the 
+ * reports are computed over the last PROFILER_WINDOW_SIZE periods.
+ */
+#define PROFILER_WINDOW_SIZE 10u
+
+/* Maximum number of tasks that the profiler tracks. It must not be lower than the number
+ * of tasks of the system, FreeRTOS does not report any task otherwise.
+ */
+#define PROFILER_MAX_TASKS 20u
+
+/* Number of characters of the task names in the reports, longer names are truncated. */
+#define PROFILER_TASK_NAME_SIZE 12u
+
+#if PROFILER_WINDOW_SIZE < 2
+  #error "Invalid profiler window, it needs at least 2 samples:"
+  #error "refer to (PROFILER_WINDOW_SIZE)"
+#endif
+
+/* List of the possible return codes that module profiler can return. */
+#define PROFILER_RETURNS                        \
+  /* Info codes */                              \
+  PROFILER_RETURN(CORE_PROFILER_OK)             \
+  /* Error codes */                             \
+  PROFILER_RETURN(CORE_PROFILER_INIT_ERR)       \
+  PROFILER_RETURN(CORE_PROFILER_INIT_TASK_ERR)
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Header of a profile report, it is followed by "tasks_in_report" task entries. */
+typedef struct __attribute__((packed))
+{
+  /* Number of tracked tasks. */
+  uint8_t num_of_tasks;
+  /* Index of the first task entry of the report. */
+  uint8_t first_task;
+  /* Number of task entries that follow the header. */
+  uint8_t tasks_in_report;
+  /* Number of samples of the window used for the report. */
+  uint8_t samples;
+  /* Free heap in bytes at the last sample. */
+  uint32_t heap_free;
+  /* Minimum free heap in bytes since boot. */
+  uint32_t heap_min_free;
+  /* Minimum free heap in bytes along the window. */
+  uint32_t heap_window_min_free;
+  /* Largest free heap block in bytes at the last sample. */
+  uint32_t heap_largest_block;
+  /* Part of the free heap in per mille that is not in the largest block. */
+  uint16_t heap_fragmentation_permille;
+} Profile_report_header;
+
+/* Entry of a task inside a profile report. */
+typedef struct __attribute__((packed))
+{
+  /* Name of the task, not null terminated if it fills the array. */
+  char name[PROFILER_TASK_NAME_SIZE];
+  /* Minimum free stack in bytes since the task was created. */
+  uint16_t stack_free;
+  /* CPU time in per mille of all the cores used by the task along the window. */
+  uint16_t cpu_permille;
+  /* Current priority of the task. */
+  uint8_t priority;
+} Profile_task_entry;
+
+/* Enumerate that lists the posible return codes that the module can return. */
+typedef enum
+{
+  #define PROFILER_RETURN(enumerate) enumerate,
+    PROFILER_RETURNS
+  #undef PROFILER_RETURN
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_PROFILER_RETURNS,
+} Profiler_return;
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Starts the profiler task, that samples the system every PROFILER_PERIOD_MS.
+ *        The CPU usage needs CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS and the task 
+ *        information needs CONFIG_FREERTOS_USE_TRACE_FACILITY, otherwise they are 
+ *        reported as 0.
+ *
+ * @param void
+ *
+ * @return CORE_PROFILER_OK if the operation went well,
+ *         otherwise:
+ * 
+ *           - CORE_PROFILER_INIT_ERR: 
+ *               Error trying to create the mutex of the profile.
+ * 
+ *           - CORE_PROFILER_INIT_TASK_ERR: 
+ *               Error trying to create the profiler task.
+ *                                      
+ */
+Profiler_return init_profiler(void);
+
+/**
+ * @brief Writes a report of the rolling window. If the tasks do not fit in the given 
+ *        buffer the report is split in pages, starting by the given task entry.
+ *
+ * @param first_task Index of the first task entry to write.
+ * 
+ * @param report Buffer where the report is written.
+ * 
+ * @param size Size in bytes of the buffer.
+ *
+ * @return Number of bytes written, 0 if the buffer can not hold the header.
+ */
+uint8_t get_profile_report(const uint8_t first_task, uint8_t *report, const uint8_t size);
+
+/**
+ * @brief Prints the return of a profiler module function if the system was configured 
+ *        in debug mode.
+ *
+ * @param ret Received return from a profiler module function.
+ *
+ * @return The given return.
+ */
+Profiler_return core_profiler_LOG(const Profiler_return ret);
+
+#endif /* CORE_PROFILER_H_ */
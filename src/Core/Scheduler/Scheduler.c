@@ -0,0 +1,557 @@
+/**
+ * @file      Scheduler.c
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This source file defines the functions to execute commands at a given 
+ *            time with a hashed timer wheel.
+ */
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <Scheduler.h>
+#include <Debug.h>
+#include <System_memory.h>
+#include <System_tasks.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+#if DEBUG_MODE_ENABLE == 1
+/* Tag to show traces in scheduler module. */
+  #define TAG "CORE_SCHEDULER"
+#endif
+
+/* Index that marks the end of a list of the pool. */
+#define NIL UINT16_MAX
+
+/* Time in microseconds that the timer is not armed. */
+#define NOT_ARMED INT64_MAX
+
+/* Returns the tick of the wheel that contains a given time. */
+#define TICK_OF(time_us) ((uint32_t)((time_us) / SCHEDULER_TICK_US))
+
+/* Returns the slot of the wheel of a given tick. */
+#define SLOT_OF(tick) ((tick) % SCHEDULER_SLOTS)
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Structure that contains a scheduled command. */
+typedef struct
+{
+  /* Time in microseconds when the command is executed. */
+  int64_t time_us;
+  /* Tick of the wheel where the command is stored. */
+  uint32_t tick;
+  /* Previous and next commands of the slot list, or of the free list for "next". */
+  uint16_t prev;
+  uint16_t next;
+  /* Incremented every time the entry is reused, it invalidates the old handles. */
+  uint16_t generation;
+  /* True if the entry contains a scheduled command. */
+  bool in_use;
+  /* Type of the command. */
+  uint8_t type;
+  /* Number of bytes of the payload. */
+  uint8_t len;
+  /* Bytes of the command. */
+  uint8_t payload[SCHEDULER_MAX_PAYLOAD_SIZE];
+} scheduled_entry;
+
+/***************************************************************************************
+ * Global Variables
+ ***************************************************************************************/
+
+/* Pool of the scheduled commands, there is no allocation after the initialization. */
+static scheduled_entry pool[SCHEDULER_POOL_SIZE];
+
+/* First free entry of the pool. */
+static uint16_t free_head;
+
+/* First command of every slot of the wheel. */
+static uint16_t slots_heads[SCHEDULER_SLOTS];
+
+/* One bit per slot of the wheel, set if the slot contains commands. */
+static uint32_t busy_slots[SCHEDULER_SLOTS / 32u];
+
+/* Last tick of the wheel whose commands were all executed. */
+static uint32_t processed_tick;
+
+/* Number of scheduled commands. */
+static uint32_t num_of_scheduled;
+
+/* Time in microseconds when the timer of the wheel expires. */
+static int64_t armed_us = NOT_ARMED;
+
+/* One shot timer of the wheel, it is armed to the time of the next command and it is 
+ * stopped while there are no commands.
+ */
+static esp_timer_handle_t wheel_timer;
+
+/* Mutex that protects the wheel between the tasks that schedule and execute commands. */
+static SemaphoreHandle_t wheel_mutex;
+static StaticSemaphore_t wheel_mutex_buffer;
+
+/* Statistics of the scheduler. */
+static Scheduler_stats scheduler_stats;
+
+/* Storage of the scheduler task, there is no heap allocation for it. */
+static StackType_t scheduler_task_stack[SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_SCHEDULER)];
+static StaticTask_t scheduler_task_buffer;
+
+/* Handler of the task that executes the commands, the timer only wakes it up. */
+static TaskHandle_t scheduler_task_handler;
+
+/* RAM reserved by the RTOS objects of the scheduler. */
+_Static_assert(sizeof(scheduler_task_stack) + sizeof(scheduler_task_buffer) + 
+  sizeof(wheel_mutex_buffer) <= SCHEDULER_STATIC_RAM_BUDGET, 
+  "Scheduler RTOS objects go over SCHEDULER_STATIC_RAM_BUDGET");
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Callback of the wheel timer, it wakes up the scheduler task. It does not take
+ *        any lock, so the shared esp_timer task is never blocked by the commands.
+ *
+ * @param args Not used.
+ *
+ * @return void
+ */
+static void wheel_timer_callback(void *args);
+
+/**
+ * @brief Function of the scheduler task, every time that the timer wakes it up it 
+ *        executes the commands whose time has passed and arms the timer for the next 
+ *        one.
+ *
+ * @param args arguments to pass to the function.
+ *
+ * @return void
+ */
+static void scheduler_task_func(void *args);
+
+/**
+ * @brief Executes the commands whose time has passed and arms the timer for the next 
+ *        one.
+ *
+ * @param void
+ *
+ * @return void
+ */
+static void execute_due_commands(void);
+
+/**
+ * @brief Removes a command from its slot list. The wheel mutex must be taken.
+ *
+ * @param index Index of the command in the pool.
+ *
+ * @return void
+ */
+static void unlink_entry(const uint16_t index);
+
+/**
+ * @brief Returns the offset of the first slot with commands from a given tick, using 
+ *        the bitmap of busy slots to skip the empty ones.
+ *
+ * @param from_tick First tick to check.
+ * 
+ * @param max_offset Number of ticks to check.
+ *
+ * @return Offset from from_tick of the first busy slot, max_offset if there is none.
+ */
+static uint32_t next_busy_offset(const uint32_t from_tick, const uint32_t max_offset);
+
+/**
+ * @brief Arms the wheel timer to expire at a given time. The wheel mutex must be taken.
+ *
+ * @param time_us Time in microseconds when the timer expires.
+ *
+ * @return void
+ */
+static void arm_wheel_timer(const int64_t time_us);
+
+/**
+ * @brief Arms the wheel timer to the time of the next command, or stops it if there 
+ *        are no commands. The wheel mutex must be taken.
+ *
+ * @param void
+ *
+ * @return void
+ */
+static void rearm_wheel_timer(void);
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+Scheduler_return init_scheduler(void)
+{
+  wheel_mutex = xSemaphoreCreateMutexStatic(&wheel_mutex_buffer);
+  if(wheel_mutex == NULL)
+  {
+    return CORE_SCHEDULER_INIT_ERR;
+  }
+
+  const esp_timer_create_args_t timer_args =
+  {
+    .callback = wheel_timer_callback,
+    .arg = NULL,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "scheduler",
+    .skip_unhandled_events = false,
+  };
+  if(esp_timer_create(&timer_args, &wheel_timer) != ESP_OK)
+  {
+    return CORE_SCHEDULER_INIT_TIMER_ERR;
+  }
+
+  for(uint16_t i = 0u; i < SCHEDULER_POOL_SIZE; i++)
+  {
+    pool[i].next = (i + 1u < SCHEDULER_POOL_SIZE) ? i + 1u : NIL;
+  }
+  free_head = 0u;
+
+  for(uint32_t slot = 0u; slot < SCHEDULER_SLOTS; slot++)
+  {
+    slots_heads[slot] = NIL;
+  }
+
+  /* The current tick is not processed yet, it can still receive commands. */
+  processed_tick = TICK_OF(esp_timer_get_time()) - 1u;
+
+  scheduler_task_handler = xTaskCreateStaticPinnedToCore(scheduler_task_func, 
+    SYSTEM_TASK_NAME(SYSTEM_TASK_SCHEDULER), 
+    SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_SCHEDULER), (void *) 0, 
+    SYSTEM_TASK_PRIORITY(SYSTEM_TASK_SCHEDULER), scheduler_task_stack, 
+    &scheduler_task_buffer, SYSTEM_TASK_CORE(SYSTEM_TASK_SCHEDULER));
+  if(scheduler_task_handler == NULL)
+  {
+    return CORE_SCHEDULER_INIT_TASK_ERR;
+  }
+
+  return CORE_SCHEDULER_OK;
+}
+
+uint32_t schedule_command(const int64_t time_us, const uint8_t type, 
+  const uint8_t *payload, const uint8_t len)
+{
+  if(len > SCHEDULER_MAX_PAYLOAD_SIZE)
+  {
+    return SCHEDULER_INVALID_HANDLE;
+  }
+
+  xSemaphoreTake(wheel_mutex, portMAX_DELAY);
+
+  /* A command beyond the range of the ticks would look due and run at once. */
+  if(free_head == NIL || time_us - esp_timer_get_time() > SCHEDULER_MAX_DELAY_US)
+  {
+    scheduler_stats.rejected++;
+    xSemaphoreGive(wheel_mutex);
+    return SCHEDULER_INVALID_HANDLE;
+  }
+
+  const uint16_t index = free_head;
+  scheduled_entry *entry = &pool[index];
+  free_head = entry->next;
+
+  entry->time_us = time_us;
+  entry->type = type;
+  entry->len = len;
+  memcpy(entry->payload, payload, len);
+  entry->in_use = true;
+  entry->generation++;
+
+  /* Commands of ticks already processed go to the next one, it is visited first. */
+  entry->tick = TICK_OF(time_us);
+  if((int32_t)(entry->tick - processed_tick) <= 0)
+  {
+    entry->tick = processed_tick + 1u;
+  }
+
+  /* Push at the head of the slot list. */
+  const uint32_t slot = SLOT_OF(entry->tick);
+  entry->prev = NIL;
+  entry->next = slots_heads[slot];
+  if(entry->next != NIL)
+  {
+    pool[entry->next].prev = index;
+  }
+  slots_heads[slot] = index;
+  busy_slots[slot / 32u] |= 1ul << (slot % 32u);
+
+  num_of_scheduled++;
+  scheduler_stats.scheduled++;
+
+  /* Only an earlier command moves the timer, otherwise it is already armed before. */
+  if(time_us < armed_us)
+  {
+    arm_wheel_timer(time_us);
+  }
+
+  const uint32_t handle = ((uint32_t)entry->generation << 16u) | (index + 1u);
+
+  xSemaphoreGive(wheel_mutex);
+
+  return handle;
+}
+
+bool cancel_scheduled_command(const uint32_t handle)
+{
+  const uint32_t index = (handle & UINT16_MAX) - 1u;
+  if(index >= SCHEDULER_POOL_SIZE)
+  {
+    return false;
+  }
+
+  xSemaphoreTake(wheel_mutex, portMAX_DELAY);
+
+  scheduled_entry *entry = &pool[index];
+  if(!entry->in_use || entry->generation != (uint16_t)(handle >> 16u))
+  {
+    xSemaphoreGive(wheel_mutex);
+    return false;
+  }
+
+  unlink_entry((uint16_t)index);
+  entry->in_use = false;
+  entry->next = free_head;
+  free_head = (uint16_t)index;
+  num_of_scheduled--;
+  scheduler_stats.cancelled++;
+
+  /* The timer is left armed, if it expires without commands it looks for the next. */
+  if(num_of_scheduled == 0u)
+  {
+    esp_timer_stop(wheel_timer);
+    armed_us = NOT_ARMED;
+  }
+
+  xSemaphoreGive(wheel_mutex);
+
+  return true;
+}
+
+void get_scheduler_stats(Scheduler_stats *stats)
+{
+  xSemaphoreTake(wheel_mutex, portMAX_DELAY);
+  *stats = scheduler_stats;
+  xSemaphoreGive(wheel_mutex);
+}
+
+inline Scheduler_return core_scheduler_LOG(const Scheduler_return ret)
+{
+  #if DEBUG_MODE_ENABLE == 1
+    switch(ret)
+    {
+      #define SCHEDULER_RETURN(enumerate) \
+        case enumerate:                   \
+          if(ret > 0)                     \
+          {                               \
+            ESP_LOGE(TAG, #enumerate);    \
+          }                               \
+          else                            \
+          {                               \
+            ESP_LOGI(TAG, #enumerate);    \
+          }                               \
+          break;       
+        SCHEDULER_RETURNS
+      #undef SCHEDULER_RETURN
+      default:
+        ESP_LOGE(TAG, "Unkown return.");
+        break;
+    }
+  #endif
+  return ret;
+}
+
+static void wheel_timer_callback(void *args)
+{
+  xTaskNotifyGive(scheduler_task_handler);
+}
+
+static void scheduler_task_func(void *args)
+{
+  while(true)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    execute_due_commands();
+  }
+}
+
+static void execute_due_commands(void)
+{
+  /* The command is copied out of the pool to execute it without the mutex. */
+  uint8_t type;
+  uint8_t len;
+  uint8_t payload[SCHEDULER_MAX_PAYLOAD_SIZE];
+
+  while(true)
+  {
+    xSemaphoreTake(wheel_mutex, portMAX_DELAY);
+
+    const int64_t now_us = esp_timer_get_time();
+    const uint32_t now_tick = TICK_OF(now_us);
+
+    /* Look for a command whose time has passed in the ticks not processed yet, a full 
+     * revolution covers all the slots.
+     */
+    uint32_t pending_ticks = now_tick - processed_tick;
+    if(pending_ticks > SCHEDULER_SLOTS)
+    {
+      pending_ticks = SCHEDULER_SLOTS;
+    }
+
+    uint16_t due = NIL;
+    uint32_t offset = next_busy_offset(processed_tick + 1u, pending_ticks);
+    while(due == NIL && offset < pending_ticks)
+    {
+      uint16_t index = slots_heads[SLOT_OF(processed_tick + 1u + offset)];
+      while(index != NIL && pool[index].time_us > now_us)
+      {
+        index = pool[index].next;
+      }
+      due = index;
+
+      offset = next_busy_offset(processed_tick + 1u + offset + 1u, 
+                 pending_ticks - offset - 1u) + offset + 1u;
+    }
+
+    if(due == NIL)
+    {
+      /* Commands of the current tick may still be in the future. */
+      processed_tick = now_tick - 1u;
+      rearm_wheel_timer();
+      xSemaphoreGive(wheel_mutex);
+      break;
+    }
+
+    scheduled_entry *entry = &pool[due];
+    unlink_entry(due);
+    entry->in_use = false;
+    entry->next = free_head;
+    free_head = due;
+    num_of_scheduled--;
+
+    type = entry->type;
+    len = entry->len;
+    memcpy(payload, entry->payload, len);
+
+    const int64_t late_us = now_us - entry->time_us;
+    scheduler_stats.fired++;
+    scheduler_stats.last_late_us = (late_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)late_us;
+    if(scheduler_stats.last_late_us > scheduler_stats.max_late_us)
+    {
+      scheduler_stats.max_late_us = scheduler_stats.last_late_us;
+    }
+
+    xSemaphoreGive(wheel_mutex);
+
+    scheduled_command_CB(type, payload, len);
+  }
+}
+
+static void unlink_entry(const uint16_t index)
+{
+  const scheduled_entry *entry = &pool[index];
+  const uint32_t slot = SLOT_OF(entry->tick);
+
+  if(entry->prev != NIL)
+  {
+    pool[entry->prev].next = entry->next;
+  }
+  else
+  {
+    slots_heads[slot] = entry->next;
+  }
+
+  if(entry->next != NIL)
+  {
+    pool[entry->next].prev = entry->prev;
+  }
+
+  if(slots_heads[slot] == NIL)
+  {
+    busy_slots[slot / 32u] &= ~(1ul << (slot % 32u));
+  }
+}
+
+static uint32_t next_busy_offset(const uint32_t from_tick, const uint32_t max_offset)
+{
+  uint32_t offset = 0u;
+  while(offset < max_offset)
+  {
+    /* The slots are multiple of 32, so a word never crosses the end of the wheel. */
+    const uint32_t slot = SLOT_OF(from_tick + offset);
+    const uint32_t bits = busy_slots[slot / 32u] >> (slot % 32u);
+    if(bits != 0u)
+    {
+      offset += (uint32_t)__builtin_ctzl(bits);
+      return (offset < max_offset) ? offset : max_offset;
+    }
+    offset += 32u - (slot % 32u);
+  }
+
+  return max_offset;
+}
+
+static void arm_wheel_timer(const int64_t time_us)
+{
+  const int64_t delay_us = time_us - esp_timer_get_time();
+
+  esp_timer_stop(wheel_timer);
+  esp_timer_start_once(wheel_timer, (delay_us > 0) ? (uint64_t)delay_us : 0u);
+  armed_us = time_us;
+}
+
+static void rearm_wheel_timer(void)
+{
+  if(num_of_scheduled == 0u)
+  {
+    esp_timer_stop(wheel_timer);
+    armed_us = NOT_ARMED;
+    return;
+  }
+
+  /* The first slot with a command of its own revolution contains the next one. */
+  const uint32_t from_tick = processed_tick + 1u;
+  uint32_t offset = next_busy_offset(from_tick, SCHEDULER_SLOTS);
+  while(offset < SCHEDULER_SLOTS)
+  {
+    int64_t next_us = NOT_ARMED;
+    for(uint16_t index = slots_heads[SLOT_OF(from_tick + offset)]; index != NIL;
+        index = pool[index].next)
+    {
+      if(pool[index].tick == from_tick + offset && pool[index].time_us < next_us)
+      {
+        next_us = pool[index].time_us;
+      }
+    }
+
+    if(next_us != NOT_ARMED)
+    {
+      arm_wheel_timer(next_us);
+      return;
+    }
+
+    offset = next_busy_offset(from_tick + offset + 1u, SCHEDULER_SLOTS - offset - 1u) + 
+               offset + 1u;
+  }
+
+  /* All the commands are more than a revolution away, check again at the beginning of
+   * the tick that closes it.
+   */
+  const int64_t now_us = esp_timer_get_time();
+  arm_wheel_timer(now_us - (now_us % SCHEDULER_TICK_US) + 
+                    (int64_t)SCHEDULER_SLOTS * SCHEDULER_TICK_US);
+}
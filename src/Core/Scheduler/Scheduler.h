@@ -0,0 +1,187 @@
+/**
+ * @file      Scheduler.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This header file declares the functions to execute commands at a given 
+ *            time with a hashed timer wheel.
+ */
+
+#ifndef CORE_SCHEDULER_H_
+#define CORE_SCHEDULER_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Number of commands that can be scheduled at the same time. */
+#define SCHEDULER_POOL_SIZE 64u
+
+/* Number of slots of the timer wheel. It is mandatory to use a multiple of 32. */
+#define SCHEDULER_SLOTS 256u
+
+/* Time in microseconds covered by each slot of the timer wheel. */
+#define SCHEDULER_TICK_US 1000u
+
+/* Maximum size in bytes of the payload of a scheduled command. */
+#define SCHEDULER_MAX_PAYLOAD_SIZE 8u
+
+/* Maximum time in microseconds from now at which a command can be scheduled. The ticks
+ * of the wheel are compared with 32 bits arithmetic, so a command can not be further 
+ * than half of their range, with the other half as margin.
+ */
+#define SCHEDULER_MAX_DELAY_US ((int64_t)(INT32_MAX / 2) * SCHEDULER_TICK_US)
+
+/* Handle that never identifies a scheduled command. */
+#define SCHEDULER_INVALID_HANDLE 0u
+
+#if (SCHEDULER_SLOTS % 32u) != 0u
+  #error "Invalid number of slots, it must be a multiple of 32:"
+  #error "refer to (SCHEDULER_SLOTS)"
+#endif
+
+#if SCHEDULER_POOL_SIZE >= UINT16_MAX
+  #error "Invalid pool size, it must be lower than 65535:"
+  #error "refer to (SCHEDULER_POOL_SIZE)"
+#endif
+
+/* List of the possible return codes that module scheduler can return. */
+#define SCHEDULER_RETURNS                       \
+  /* Info codes */                              \
+  SCHEDULER_RETURN(CORE_SCHEDULER_OK)           \
+  /* Error codes */                             \
+  SCHEDULER_RETURN(CORE_SCHEDULER_INIT_ERR)     \
+  SCHEDULER_RETURN(CORE_SCHEDULER_INIT_TIMER_ERR) \
+  SCHEDULER_RETURN(CORE_SCHEDULER_INIT_TASK_ERR)
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Structure that contains the statistics of the scheduler. */
+typedef struct
+{
+  /* Number of commands scheduled. */
+  uint32_t scheduled;
+  /* Number of commands executed. */
+  uint32_t fired;
+  /* Number of commands cancelled. */
+  uint32_t cancelled;
+  /* Number of commands rejected because the pool was full or they were beyond 
+   * SCHEDULER_MAX_DELAY_US.
+   */
+  uint32_t rejected;
+  /* Delay in microseconds of the last executed command from its time. */
+  uint32_t last_late_us;
+  /* Maximum delay in microseconds of an executed command from its time. */
+  uint32_t max_late_us;
+} Scheduler_stats;
+
+/* Enumerate that lists the posible return codes that the module can return. */
+typedef enum
+{
+  #define SCHEDULER_RETURN(enumerate) enumerate,
+    SCHEDULER_RETURNS
+  #undef SCHEDULER_RETURN
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_SCHEDULER_RETURNS,
+} Scheduler_return;
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Initializes the scheduler. It is mandatory to call this function before any 
+ *        other function of this module.
+ *
+ * @param void
+ *
+ * @return CORE_SCHEDULER_OK if the operation went well,
+ *         otherwise:
+ * 
+ *           - CORE_SCHEDULER_INIT_ERR: 
+ *               Error trying to create the mutex of the wheel.
+ * 
+ *           - CORE_SCHEDULER_INIT_TIMER_ERR: 
+ *               Error trying to create the timer of the wheel.
+ * 
+ *           - CORE_SCHEDULER_INIT_TASK_ERR: 
+ *               Error trying to create the task that executes the commands.
+ *                                      
+ */
+Scheduler_return init_scheduler(void);
+
+/**
+ * @brief Schedules a command. The insertion does not depend on the number of scheduled
+ *        commands and the command is copied, so the payload can be released after the 
+ *        call. Commands whose time has passed are executed as soon as possible.
+ *
+ * @param time_us Time in microseconds of esp_timer_get_time when the command is 
+ *                executed.
+ * 
+ * @param type Type of the command, it is given back to scheduled_command_CB.
+ * 
+ * @param payload Bytes of the command.
+ * 
+ * @param len Number of bytes of the payload.
+ *
+ * @return Handle of the scheduled command, SCHEDULER_INVALID_HANDLE if the pool is full,
+ *         the payload is too long or the time is beyond SCHEDULER_MAX_DELAY_US.
+ */
+uint32_t schedule_command(const int64_t time_us, const uint8_t type, 
+  const uint8_t *payload, const uint8_t len);
+
+/**
+ * @brief Cancels a scheduled command. The cancellation does not depend on the number of
+ *        scheduled commands.
+ *
+ * @param handle Handle returned by schedule_command.
+ *
+ * @return True if the command was cancelled, false if it does not exist or it was
+ *         already executed.
+ */
+bool cancel_scheduled_command(const uint32_t handle);
+
+/**
+ * @brief Gets the statistics of the scheduler.
+ *
+ * @param stats Return statistics.
+ *
+ * @return void
+ */
+void get_scheduler_stats(Scheduler_stats *stats);
+
+/**
+ * @brief Prints the return of a scheduler module function if the system was configured 
+ *        in debug mode.
+ *
+ * @param ret Received return from a scheduler module function.
+ *
+ * @return The given return.
+ */
+Scheduler_return core_scheduler_LOG(const Scheduler_return ret);
+
+/**
+ * @brief Function that will be called when a scheduled command must be executed. This 
+ *        function should be implemented in other application module. It is called 
+ *        from the scheduler task, so it can block without delaying the timers.
+ *
+ * @param type Type of the command.
+ * 
+ * @param payload Bytes of the command.
+ * 
+ * @param len Number of bytes of the payload.
+ *
+ * @return void
+ */
+void __attribute__((weak)) scheduled_command_CB(const uint8_t type, 
+  const uint8_t *payload, const uint8_t len);
+
+#endif /* CORE_SCHEDULER_H_ */
@@ -0,0 +1,732 @@
+/**
+ * @file      Stream.c
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This source file defines the functions to receive a stream of frames with
+ *            a value for every LED and to present them at a fixed rate.
+ */
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <Stream.h>
+#include <Time_sync.h>
+#include <Debug.h>
+#include <System_memory.h>
+#include <System_tasks.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include <esp_cpu.h>
+#include "lwip/sockets.h"
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+#if DEBUG_MODE_ENABLE == 1
+/* Tag to show traces in stream module. */
+  #define TAG "CORE_STREAM"
+#endif
+
+/* Weight of the last frame in the average latency, 1/2^STREAM_AVG_SHIFT. */
+#define STREAM_AVG_SHIFT 3u
+
+/* Size of the bitmap of the STREAM_ENCODING_DELTA payloads. */
+#define STREAM_DELTA_BITMAP_SIZE 4u
+
+/* Mask of the first "num" channels. */
+#define STREAM_CHANNELS_MASK(num) (((num) >= 32u) ? UINT32_MAX : ((1ul << (num)) - 1u))
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Structure that contains a frame of the jitter buffer. */
+typedef struct
+{
+  /* Sequence number of the frame. */
+  uint32_t seq;
+  /* Time in microseconds of the local clock when the frame must be presented. */
+  int64_t presentation_us;
+  /* Time in microseconds of the local clock when the frame was received. */
+  int64_t received_us;
+  /* Number of channels of the frame. */
+  uint8_t num_of_channels;
+  /* Encoding of the payload. */
+  uint8_t encoding;
+  /* Encoded payload, it is decoded when the frame is presented. */
+  uint8_t payload[STREAM_MAX_PAYLOAD_SIZE];
+  /* True if the frame changes all the channels, so it does not depend on the previous
+   * frame.
+   */
+  bool key;
+  /* True if the frame has no presentation time, it is presented at the next tick and
+   * it is never late.
+   */
+  bool immediate;
+  /* True if the slot contains a frame pending to be presented. */
+  bool valid;
+} stream_slot;
+
+/***************************************************************************************
+ * Global Variables
+ ***************************************************************************************/
+
+/* Jitter buffer, frames are kept unordered and the tick looks for the due ones. */
+static stream_slot jitter_buffer[STREAM_BUFFER_SIZE];
+
+/* Frames being presented in order, they are copied out of the buffer to decode them 
+ * without the lock. The tick only fills them when the present task has applied the 
+ * previous ones, while num_of_presented is not 0 they belong to the present task.
+ */
+static stream_slot presented_frames[STREAM_BUFFER_SIZE];
+static uint8_t num_of_presented;
+
+/* Level of every channel, the presented frames only write their changed channels. */
+static uint8_t stream_levels[STREAM_MAX_CHANNELS];
+
+/* True while the frames that depend on the previous one can not be presented, until
+ * a key frame arrives.
+ */
+static bool waiting_key = true;
+
+/* Sequence number of the last presented frame and true if there is one. */
+static uint32_t last_presented_seq;
+static bool any_presented;
+
+/* Local time in microseconds of the last received and presented frames. */
+static int64_t last_received_us;
+static int64_t last_presented_us;
+
+/* True if the current gap without frames to present was already counted. */
+static bool underrun_counted;
+
+/* Statistics of the stream. */
+static Stream_stats stream_stats;
+
+/* Lock that protects the jitter buffer and the statistics. */
+static portMUX_TYPE stream_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Periodic timer that presents the frames and true while it should run. The flag is
+ * decided under the lock and the timer API is called after leaving it, the timer can
+ * lag the flag for a moment but never stays stopped while the flag is set.
+ */
+static esp_timer_handle_t tick_timer;
+static bool tick_running;
+
+/* Buffer of the received datagrams, static to keep it out of the stream stack. */
+static uint8_t stream_buf[sizeof(Stream_frame_header) + STREAM_MAX_PAYLOAD_SIZE];
+
+/* Storage of the stream task, there is no heap allocation for it. */
+static StackType_t stream_task_stack[SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_STREAM)];
+static StaticTask_t stream_task_buffer;
+
+/* Handler of the stream task. */
+static TaskHandle_t stream_task_handler;
+
+/* Storage of the present task, there is no heap allocation for it. */
+static StackType_t 
+  present_task_stack[SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_STREAM_PRESENT)];
+static StaticTask_t present_task_buffer;
+
+/* Handler of the present task, the tick notifies it when there are frames to apply. */
+static TaskHandle_t present_task_handler;
+
+/* RAM reserved by the RTOS objects of the stream. */
+_Static_assert(sizeof(stream_task_stack) + sizeof(stream_task_buffer) + 
+  sizeof(present_task_stack) + sizeof(present_task_buffer) <= 
+  STREAM_STATIC_RAM_BUDGET, "Stream RTOS objects go over STREAM_STATIC_RAM_BUDGET");
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Function that will receive the stream frames and add them to the jitter 
+ *        buffer.
+ *
+ * @param args arguments to pass to the function.
+ *
+ * @return void
+ */
+static void stream_task_func(void *args);
+
+/**
+ * @brief Function that will decode the frames selected by the tick and apply them to
+ *        the lamps, on the lighting core.
+ *
+ * @param args arguments to pass to the function.
+ *
+ * @return void
+ */
+static void present_task_func(void *args);
+
+/**
+ * @brief Selects the due frames of the jitter buffer and notifies the present task. 
+ *        It runs in the esp_timer task, so it does not decode the frames nor waits for
+ *        the lamps. It stops itself when no frames are received.
+ *
+ * @param args arguments to pass to the function.
+ *
+ * @return void
+ */
+static void tick_timer_callback(void *args);
+
+/**
+ * @brief Moves the newest due frame of the jitter buffer to presented_frames and drops
+ *        the older ones. If that frame depends on the previous ones, they are moved in
+ *        order since the last key frame. The frames more than STREAM_LATE_TOLERANCE_US
+ *        past their presentation time are dropped. It is mandatory to hold stream_lock.
+ *
+ * @param now_us Time in microseconds of the local clock.
+ *
+ * @return Number of frames moved to presented_frames.
+ */
+static uint8_t select_due_frames(const int64_t now_us);
+
+/**
+ * @brief Checks that the payload of a frame is consistent with its encoding.
+ *
+ * @param header Header of the frame.
+ * 
+ * @param payload Bytes of the payload.
+ * 
+ * @param size Number of bytes of the payload.
+ * 
+ * @param key Returns true if the frame changes all the channels.
+ *
+ * @return True if the payload is valid, otherwise false.
+ */
+static bool check_stream_payload(const Stream_frame_header *header, 
+  const uint8_t *payload, const uint32_t size, bool *key);
+
+/**
+ * @brief Decodes a frame straight into stream_levels, only the changed channels are
+ *        touched.
+ *
+ * @param frame Frame to decode, its payload was checked on reception.
+ *
+ * @return Mask of the changed channels.
+ */
+static uint32_t decode_stream_frame(const stream_slot *frame);
+
+/**
+ * @brief Updates the latency and jitter statistics with the presented frames.
+ *
+ * @param num_of_frames Number of presented frames.
+ * 
+ * @param decode_cycles CPU cycles spent decoding the presented frames.
+ * 
+ * @param lit_us Time in microseconds of the local clock when the frames were lit.
+ *
+ * @return void
+ */
+static void measure_presented_frames(const uint8_t num_of_frames, 
+  const uint32_t decode_cycles, const int64_t lit_us);
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+Stream_return init_stream(void)
+{
+  const esp_timer_create_args_t tick_timer_args =
+  {
+    .callback = tick_timer_callback,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "stream_tick",
+  };
+  if(esp_timer_create(&tick_timer_args, &tick_timer) != ESP_OK)
+  {
+    return CORE_STREAM_INIT_TIMER_ERR;
+  }
+
+  present_task_handler = xTaskCreateStaticPinnedToCore(present_task_func, 
+    SYSTEM_TASK_NAME(SYSTEM_TASK_STREAM_PRESENT), 
+    SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_STREAM_PRESENT), (void *) 0, 
+    SYSTEM_TASK_PRIORITY(SYSTEM_TASK_STREAM_PRESENT), present_task_stack, 
+    &present_task_buffer, SYSTEM_TASK_CORE(SYSTEM_TASK_STREAM_PRESENT));
+  if(present_task_handler == NULL)
+  {
+    return CORE_STREAM_INIT_TASK_ERR;
+  }
+
+  stream_task_handler = xTaskCreateStaticPinnedToCore(stream_task_func, 
+    SYSTEM_TASK_NAME(SYSTEM_TASK_STREAM), SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_STREAM), 
+    (void *) 0, SYSTEM_TASK_PRIORITY(SYSTEM_TASK_STREAM), stream_task_stack,
+    &stream_task_buffer, SYSTEM_TASK_CORE(SYSTEM_TASK_STREAM));
+  if(stream_task_handler == NULL)
+  {
+    return CORE_STREAM_INIT_TASK_ERR;
+  }
+
+  return CORE_STREAM_OK;
+}
+
+bool push_stream_frame(const uint8_t *frame, const uint32_t len)
+{
+  Stream_frame_header header;
+
+  if(len < sizeof(header))
+  {
+    return false;
+  }
+  memcpy(&header, frame, sizeof(header));
+
+  const uint32_t payload_size = len - sizeof(header);
+  bool key = false;
+  if(header.magic != STREAM_MAGIC || header.num_of_channels > STREAM_MAX_CHANNELS ||
+     payload_size > STREAM_MAX_PAYLOAD_SIZE || 
+     !check_stream_payload(&header, &frame[sizeof(header)], payload_size, &key))
+  {
+    return false;
+  }
+
+  const int64_t now_us = esp_timer_get_time();
+  bool start_tick = false;
+  /* The conversion is done on reception so the tick only compares local times. */
+  const bool immediate = (header.presentation_us == 0);
+  const int64_t presentation_us = immediate ? 
+    now_us : synced_to_local_time_us(header.presentation_us);
+
+  taskENTER_CRITICAL(&stream_lock);
+
+  /* A frame older than the presented one would move the light backwards, and a frame
+   * that arrives after its time would be out of sync with the video.
+   */
+  if((any_presented && (int32_t)(header.seq - last_presented_seq) <= 0) ||
+     (!immediate && presentation_us + STREAM_LATE_TOLERANCE_US < now_us))
+  {
+    stream_stats.late++;
+    taskEXIT_CRITICAL(&stream_lock);
+    return false;
+  }
+
+  /* Look for a free slot, or for the oldest frame to drop if the buffer is full. */
+  stream_slot *slot = NULL;
+  stream_slot *oldest = NULL;
+  for(uint8_t i = 0u; i < STREAM_BUFFER_SIZE; i++)
+  {
+    if(!jitter_buffer[i].valid)
+    {
+      slot = (slot == NULL) ? &jitter_buffer[i] : slot;
+    }
+    else if(jitter_buffer[i].seq == header.seq)
+    {
+      /* Duplicated frame. */
+      taskEXIT_CRITICAL(&stream_lock);
+      return false;
+    }
+    else if(oldest == NULL || (int32_t)(jitter_buffer[i].seq - oldest->seq) < 0)
+    {
+      oldest = &jitter_buffer[i];
+    }
+  }
+
+  if(slot == NULL)
+  {
+    stream_stats.overruns++;
+    if((int32_t)(header.seq - oldest->seq) < 0)
+    {
+      taskEXIT_CRITICAL(&stream_lock);
+      return false;
+    }
+    slot = oldest;
+  }
+
+  slot->seq = header.seq;
+  slot->presentation_us = presentation_us;
+  slot->received_us = now_us;
+  slot->num_of_channels = header.num_of_channels;
+  slot->encoding = header.encoding;
+  memcpy(slot->payload, &frame[sizeof(header)], payload_size);
+  slot->key = key;
+  slot->immediate = immediate;
+  slot->valid = true;
+
+  stream_stats.received++;
+  stream_stats.received_bytes += len;
+  stream_stats.full_bytes += sizeof(header) + header.num_of_channels;
+  last_received_us = now_us;
+  if(!tick_running)
+  {
+    /* The gap before the first frame of the stream is not an underrun. */
+    last_presented_us = now_us;
+    underrun_counted = false;
+    tick_running = true;
+    start_tick = true;
+  }
+
+  taskEXIT_CRITICAL(&stream_lock);
+
+  /* If the tick is still stopping the start fails, the tick starts it again when it
+   * sees the flag set.
+   */
+  if(start_tick)
+  {
+    esp_timer_start_periodic(tick_timer, STREAM_TICK_US);
+  }
+
+  return true;
+}
+
+void get_stream_stats(Stream_stats *stats)
+{
+  taskENTER_CRITICAL(&stream_lock);
+  *stats = stream_stats;
+  taskEXIT_CRITICAL(&stream_lock);
+}
+
+inline Stream_return core_stream_LOG(const Stream_return ret)
+{
+  #if DEBUG_MODE_ENABLE == 1
+    switch(ret)
+    {
+      #define STREAM_RETURN(enumerate) \
+        case enumerate:                \
+          if(ret > 0)                  \
+          {                            \
+            ESP_LOGE(TAG, #enumerate); \
+          }                            \
+          else                         \
+          {                            \
+            ESP_LOGI(TAG, #enumerate); \
+          }                            \
+          break;       
+        STREAM_RETURNS
+      #undef STREAM_RETURN
+      default:
+        ESP_LOGE(TAG, "Unkown return.");
+        break;
+    }
+  #endif
+  return ret;
+}
+
+static void stream_task_func(void *args)
+{
+  struct sockaddr_in addr =
+  {
+    .sin_family = AF_INET,
+    .sin_addr.s_addr = htonl(INADDR_ANY),
+    .sin_port = htons(STREAM_UDP_PORT),
+  };
+
+  while(true)
+  {
+    /* The socket is created again if the network fails. */
+    const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if(sock >= 0 && bind(sock, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+    {
+      ssize_t received;
+      while((received = recv(sock, stream_buf, sizeof(stream_buf), 0)) >= 0)
+      {
+        push_stream_frame(stream_buf, (uint32_t)received);
+      }
+    }
+
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Stream socket failed: errno %d", errno);
+    #endif
+    if(sock >= 0)
+    {
+      close(sock);
+    }
+    vTaskDelay(pdMS_TO_TICKS(1000u));
+  }
+}
+
+static void present_task_func(void *args)
+{
+  while(true)
+  {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    taskENTER_CRITICAL(&stream_lock);
+    const uint8_t num_of_frames = num_of_presented;
+    taskEXIT_CRITICAL(&stream_lock);
+
+    if(num_of_frames > 0u)
+    {
+      /* The frames are decoded over the previous levels, so only the changes are 
+       * passed to the callback in one pass.
+       */
+      const uint32_t start_cycles = esp_cpu_get_cycle_count();
+      uint32_t channels = 0u;
+      for(uint8_t i = 0u; i < num_of_frames; i++)
+      {
+        channels |= decode_stream_frame(&presented_frames[i]);
+      }
+      const uint32_t decode_cycles = esp_cpu_get_cycle_count() - start_cycles;
+
+      if(channels != 0u)
+      {
+        stream_frame_CB(stream_levels, channels);
+      }
+      measure_presented_frames(num_of_frames, decode_cycles, esp_timer_get_time());
+
+      /* The tick can fill the frames again. */
+      taskENTER_CRITICAL(&stream_lock);
+      num_of_presented = 0u;
+      taskEXIT_CRITICAL(&stream_lock);
+    }
+  }
+}
+
+static void tick_timer_callback(void *args)
+{
+  const int64_t now_us = esp_timer_get_time();
+  bool present = false;
+  bool stop_tick = false;
+
+  taskENTER_CRITICAL(&stream_lock);
+
+  /* While the present task applies the previous frames the due ones wait in the 
+   * buffer, STREAM_LATE_TOLERANCE_US lets them be presented at the next tick.
+   */
+  const bool presenting = (num_of_presented > 0u);
+  if(!presenting)
+  {
+    num_of_presented = select_due_frames(now_us);
+    present = (num_of_presented > 0u);
+  }
+
+  if(present)
+  {
+    last_presented_seq = presented_frames[num_of_presented - 1u].seq;
+    any_presented = true;
+    last_presented_us = now_us;
+    underrun_counted = false;
+  }
+  else if(!presenting && !underrun_counted && 
+          now_us - last_presented_us > STREAM_MAX_FRAME_GAP_US)
+  {
+    stream_stats.underruns++;
+    underrun_counted = true;
+  }
+
+  if(now_us - last_received_us > STREAM_IDLE_TIMEOUT_US)
+  {
+    tick_running = false;
+    stop_tick = true;
+  }
+
+  taskEXIT_CRITICAL(&stream_lock);
+
+  if(present)
+  {
+    xTaskNotifyGive(present_task_handler);
+  }
+
+  if(stop_tick)
+  {
+    esp_timer_stop(tick_timer);
+
+    /* A frame received while the timer stopped could not start it. */
+    taskENTER_CRITICAL(&stream_lock);
+    const bool restart_tick = tick_running;
+    taskEXIT_CRITICAL(&stream_lock);
+    if(restart_tick)
+    {
+      esp_timer_start_periodic(tick_timer, STREAM_TICK_US);
+    }
+  }
+}
+
+static uint8_t select_due_frames(const int64_t now_us)
+{
+  /* Frames are presented at the closest tick to their presentation time. */
+  const int64_t due_us = now_us + STREAM_TICK_US / 2u;
+  stream_slot *due[STREAM_BUFFER_SIZE];
+  uint8_t num_of_due = 0u;
+  uint8_t num_of_frames = 0u;
+
+  /* Due frames ordered by sequence number, the ones that missed their time are late. */
+  for(uint8_t i = 0u; i < STREAM_BUFFER_SIZE; i++)
+  {
+    if(!jitter_buffer[i].valid || jitter_buffer[i].presentation_us > due_us)
+    {
+      continue;
+    }
+    if(!jitter_buffer[i].immediate && 
+       jitter_buffer[i].presentation_us + STREAM_LATE_TOLERANCE_US < now_us)
+    {
+      jitter_buffer[i].valid = false;
+      stream_stats.late++;
+      continue;
+    }
+    uint8_t j = num_of_due++;
+    while(j > 0u && (int32_t)(jitter_buffer[i].seq - due[j - 1u]->seq) < 0)
+    {
+      due[j] = due[j - 1u];
+      j--;
+    }
+    due[j] = &jitter_buffer[i];
+  }
+
+  /* The frames older than the newest due key frame are not needed. */
+  uint8_t first = 0u;
+  for(uint8_t i = num_of_due; i > 0u; i--)
+  {
+    if(due[i - 1u]->key)
+    {
+      first = i - 1u;
+      break;
+    }
+  }
+  for(uint8_t i = 0u; i < first; i++)
+  {
+    due[i]->valid = false;
+    stream_stats.late++;
+  }
+
+  /* The rest are presented in order while every frame follows the previous one. */
+  uint32_t expected_seq = last_presented_seq + 1u;
+  for(uint8_t i = first; i < num_of_due; i++)
+  {
+    if(due[i]->key || (!waiting_key && due[i]->seq == expected_seq))
+    {
+      presented_frames[num_of_frames++] = *due[i];
+      expected_seq = due[i]->seq + 1u;
+      waiting_key = false;
+    }
+    else
+    {
+      stream_stats.broken++;
+      waiting_key = true;
+    }
+    due[i]->valid = false;
+  }
+
+  return num_of_frames;
+}
+
+static bool check_stream_payload(const Stream_frame_header *header, 
+  const uint8_t *payload, const uint32_t size, bool *key)
+{
+  const uint32_t all_channels = STREAM_CHANNELS_MASK(header->num_of_channels);
+
+  switch(header->encoding)
+  {
+    case STREAM_ENCODING_FULL:
+      *key = true;
+      return (size == header->num_of_channels);
+
+    case STREAM_ENCODING_DELTA:
+    {
+      if(size < STREAM_DELTA_BITMAP_SIZE)
+      {
+        return false;
+      }
+      const uint32_t bitmap = (uint32_t)payload[0] | ((uint32_t)payload[1] << 8u) | 
+        ((uint32_t)payload[2] << 16u) | ((uint32_t)payload[3] << 24u);
+      *key = (bitmap == all_channels);
+      return ((bitmap & ~all_channels) == 0u && 
+              size == STREAM_DELTA_BITMAP_SIZE + (uint32_t)__builtin_popcountl(bitmap));
+    }
+
+    case STREAM_ENCODING_RLE:
+    {
+      /* The runs must cover exactly all the channels. */
+      uint32_t num_of_channels = 0u;
+      *key = true;
+      for(uint32_t i = 0u; i + 1u < size; i += 2u)
+      {
+        if(payload[i] == 0u)
+        {
+          return false;
+        }
+        num_of_channels += payload[i];
+        *key = *key && (payload[i + 1u] != STREAM_RLE_KEEP);
+      }
+      return ((size % 2u) == 0u && num_of_channels == header->num_of_channels);
+    }
+
+    default:
+      return false;
+  }
+}
+
+static uint32_t decode_stream_frame(const stream_slot *frame)
+{
+  uint32_t channels = 0u;
+
+  switch(frame->encoding)
+  {
+    case STREAM_ENCODING_FULL:
+      memcpy(stream_levels, frame->payload, frame->num_of_channels);
+      channels = STREAM_CHANNELS_MASK(frame->num_of_channels);
+      break;
+
+    case STREAM_ENCODING_DELTA:
+    {
+      channels = (uint32_t)frame->payload[0] | ((uint32_t)frame->payload[1] << 8u) | 
+        ((uint32_t)frame->payload[2] << 16u) | ((uint32_t)frame->payload[3] << 24u);
+      const uint8_t *value = &frame->payload[STREAM_DELTA_BITMAP_SIZE];
+      uint32_t pending = channels;
+      while(pending != 0u)
+      {
+        stream_levels[__builtin_ctzl(pending)] = *value++;
+        pending &= pending - 1u;
+      }
+      break;
+    }
+
+    case STREAM_ENCODING_RLE:
+    {
+      uint8_t channel = 0u;
+      for(uint8_t i = 0u; channel < frame->num_of_channels; i += 2u)
+      {
+        const uint8_t run = frame->payload[i];
+        const uint8_t level = frame->payload[i + 1u];
+        if(level != STREAM_RLE_KEEP)
+        {
+          memset(&stream_levels[channel], level, run);
+          channels |= STREAM_CHANNELS_MASK(run) << channel;
+        }
+        channel += run;
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+
+  return channels;
+}
+
+static void measure_presented_frames(const uint8_t num_of_frames, 
+  const uint32_t decode_cycles, const int64_t lit_us)
+{
+  /* The newest frame is the one that is seen. */
+  const stream_slot *frame = &presented_frames[num_of_frames - 1u];
+  const uint32_t latency_us = (uint32_t)(lit_us - frame->received_us);
+  const int64_t deviation_us = lit_us - frame->presentation_us;
+  const uint32_t jitter_us = (uint32_t)((deviation_us < 0) ? -deviation_us : deviation_us);
+
+  taskENTER_CRITICAL(&stream_lock);
+  stream_stats.presented += num_of_frames;
+  stream_stats.last_decode_cycles = decode_cycles;
+  if(decode_cycles > stream_stats.max_decode_cycles)
+  {
+    stream_stats.max_decode_cycles = decode_cycles;
+  }
+  stream_stats.last_latency_us = latency_us;
+  stream_stats.avg_latency_us = (stream_stats.presented == num_of_frames) ? latency_us :
+    stream_stats.avg_latency_us - (stream_stats.avg_latency_us >> STREAM_AVG_SHIFT) +
+    (latency_us >> STREAM_AVG_SHIFT);
+  if(latency_us > stream_stats.max_latency_us)
+  {
+    stream_stats.max_latency_us = latency_us;
+  }
+  stream_stats.last_jitter_us = jitter_us;
+  if(jitter_us > stream_stats.max_jitter_us)
+  {
+    stream_stats.max_jitter_us = jitter_us;
+  }
+  taskEXIT_CRITICAL(&stream_lock);
+}
@@ -0,0 +1,234 @@
+/**
+ * @file      Stream.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This header file declares the functions to receive a stream of frames with
+ *            a value for every LED and to present them at a fixed rate.
+ */
+
+#ifndef CORE_STREAM_H_
+#define CORE_STREAM_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* UDP port where the stream frames are received. */
+#define STREAM_UDP_PORT 3340u
+
+/* First field of every stream frame, "LSTR". */
+#define STREAM_MAGIC 0x4C535452ul
+
+/* Maximum number of channels of a frame, channel N drives the LED N. */
+#define STREAM_MAX_CHANNELS 32u
+
+/* Maximum number of bytes of the payload of a frame, the worst case of the run-length
+ * encoding.
+ */
+#define STREAM_MAX_PAYLOAD_SIZE (2u * STREAM_MAX_CHANNELS)
+
+/* Value of a run-length encoded run that keeps the channels of the run unchanged. */
+#define STREAM_RLE_KEEP 0xFFu
+
+/* Number of frames that the jitter buffer can hold. */
+#define STREAM_BUFFER_SIZE 4u
+
+/* Period in microseconds of the presentation tick, 60 frames per second. */
+#define STREAM_TICK_US 16667u
+
+/* Time in microseconds that a frame can be past its presentation time and still be
+ * presented, at the first tick after it. One tick, so a frame that arrives after its
+ * tick, or that waits because the lamps were still applying the previous frames, is
+ * presented at the next one. Later frames are dropped and counted as late, the frames
+ * without presentation time are never late.
+ */
+#define STREAM_LATE_TOLERANCE_US STREAM_TICK_US
+
+/* Time in microseconds without applying a frame that counts as an underrun. */
+#define STREAM_MAX_FRAME_GAP_US 40000u
+
+/* Time in microseconds without receiving frames that stops the presentation tick. */
+#define STREAM_IDLE_TIMEOUT_US 1000000u
+
+/* Macro that enlist the encodings of the frame payloads. It is mandatory to not set 
+ * values to the enumerates:
+ *
+ *   - STREAM_ENCODING_FULL: One level per channel.
+ *   - STREAM_ENCODING_DELTA: Little endian bitmap of 4 bytes of the changed channels, 
+ *     followed by the level of every changed channel in order.
+ *   - STREAM_ENCODING_RLE: Pairs of bytes, number of channels of the run and level of 
+ *     the run, that cover all the channels in order. The runs with STREAM_RLE_KEEP 
+ *     level do not change their channels.
+ *
+ * The frames that do not change all the channels depend on the previous frame, if it
+ * is lost they are dropped until the next frame that changes all of them.
+ */
+#define STREAM_ENCODINGS                        \
+  STREAM_ENCODING(STREAM_ENCODING_FULL)         \
+  STREAM_ENCODING(STREAM_ENCODING_DELTA)        \
+  STREAM_ENCODING(STREAM_ENCODING_RLE)
+
+/* List of the possible return codes that module stream can return. */
+#define STREAM_RETURNS                         \
+  /* Info codes */                             \
+  STREAM_RETURN(CORE_STREAM_OK)                \
+  /* Error codes */                            \
+  STREAM_RETURN(CORE_STREAM_INIT_TIMER_ERR)    \
+  STREAM_RETURN(CORE_STREAM_INIT_TASK_ERR)
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Enumerate that enlist the encodings of the frame payloads. */
+typedef enum
+{
+  #define STREAM_ENCODING(enumerate) enumerate,
+    STREAM_ENCODINGS
+  #undef STREAM_ENCODING
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_STREAM_ENCODINGS,
+} Stream_encoding;
+
+/* Header of a stream frame, it is followed by the payload of its encoding. The levels 
+ * are in percentage terms.
+ */
+typedef struct __attribute__((packed))
+{
+  /* Always STREAM_MAGIC. */
+  uint32_t magic;
+  /* Sequence number of the frame, it must increase with every frame. */
+  uint32_t seq;
+  /* Time in microseconds of the synchronized clock when the frame must be presented, 
+   * 0 to present it at the next tick.
+   */
+  int64_t presentation_us;
+  /* Number of channels of the frame. */
+  uint8_t num_of_channels;
+  /* Encoding of the payload, it is mandatory to use a value of Stream_encoding. */
+  uint8_t encoding;
+} Stream_frame_header;
+
+/* Structure that contains the statistics of the stream. */
+typedef struct
+{
+  /* Number of valid frames received. */
+  uint32_t received;
+  /* Number of frames presented. */
+  uint32_t presented;
+  /* Number of frames dropped because a newer frame was presented before them or 
+   * because they were more than STREAM_LATE_TOLERANCE_US past their presentation time.
+   */
+  uint32_t late;
+  /* Number of frames dropped because the jitter buffer was full. */
+  uint32_t overruns;
+  /* Number of gaps longer than STREAM_MAX_FRAME_GAP_US without frames to present. */
+  uint32_t underruns;
+  /* Number of frames dropped because the frame they depend on was lost. */
+  uint32_t broken;
+  /* Number of bytes of the received frames, and the number of bytes that they would 
+   * have taken with STREAM_ENCODING_FULL.
+   */
+  uint32_t received_bytes;
+  uint32_t full_bytes;
+  /* CPU cycles to decode the frames of the last tick, and its maximum. */
+  uint32_t last_decode_cycles;
+  uint32_t max_decode_cycles;
+  /* Time in microseconds from the reception to the light of the last frame. */
+  uint32_t last_latency_us;
+  /* Average and maximum time in microseconds from the reception to the light. */
+  uint32_t avg_latency_us;
+  uint32_t max_latency_us;
+  /* Difference in microseconds between the light and the presentation time of the last
+   * frame, and its maximum.
+   */
+  uint32_t last_jitter_us;
+  uint32_t max_jitter_us;
+} Stream_stats;
+
+/* Enumerate that lists the posible return codes that the module can return. */
+typedef enum
+{
+  #define STREAM_RETURN(enumerate) enumerate,
+    STREAM_RETURNS
+  #undef STREAM_RETURN
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_STREAM_RETURNS,
+} Stream_return;
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Starts the tasks that receive and present the stream. The presentation tick 
+ *        only runs while frames are being received. It is mandatory to start the 
+ *        network before.
+ *
+ * @param void
+ *
+ * @return CORE_STREAM_OK if the operation went well,
+ *         otherwise:
+ * 
+ *           - CORE_STREAM_INIT_TIMER_ERR: 
+ *               Error trying to create the presentation timer.
+ * 
+ *           - CORE_STREAM_INIT_TASK_ERR: 
+ *               Error trying to create the stream tasks.
+ *                                      
+ */
+Stream_return init_stream(void);
+
+/**
+ * @brief Adds a frame to the jitter buffer.
+ *
+ * @param frame Bytes of the frame, header and levels.
+ * 
+ * @param len Number of bytes of the frame.
+ *
+ * @return True if the frame was added, otherwise false.
+ */
+bool push_stream_frame(const uint8_t *frame, const uint32_t len);
+
+/**
+ * @brief Gets the statistics of the stream.
+ *
+ * @param stats Return statistics.
+ *
+ * @return void
+ */
+void get_stream_stats(Stream_stats *stats);
+
+/**
+ * @brief Prints the return of a stream module function if the system was configured 
+ *        in debug mode.
+ *
+ * @param ret Received return from a stream module function.
+ *
+ * @return The given return.
+ */
+Stream_return core_stream_LOG(const Stream_return ret);
+
+/**
+ * @brief Function that will be called on the presentation tick with the channels that
+ *        change. This function should be implemented in other application module. It
+ *        is called from the present task of the stream, on the lighting core.
+ *
+ * @param levels Level of every channel in percentage terms, only the levels of the 
+ *               changed channels are valid.
+ * 
+ * @param channels Mask of the changed channels, the bit N is the channel N.
+ *
+ * @return void
+ */
+void __attribute__((weak)) stream_frame_CB(const uint8_t *levels, 
+  const uint32_t channels);
+
+#endif /* CORE_STREAM_H_ */
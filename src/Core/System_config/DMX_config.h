@@ -0,0 +1,50 @@
+/**
+ * @file      DMX_config.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     File that declares macros to map a DMX universe received over IP onto the
+ *            LEDs of the system.
+ */
+
+#ifndef DMX_CONFIG_H_
+#define DMX_CONFIG_H_
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Set to 1 to receive the universe over Art-Net. */
+#define DMX_ARTNET_ENABLE 1
+
+/* Set to 1 to receive the universe over sACN (E1.31). */
+#define DMX_E131_ENABLE 1
+
+/* Art-Net port address (net, sub-net and universe) of the received universe. */
+#define DMX_ARTNET_PORT_ADDRESS 0u
+
+/* E1.31 universe of the received universe, from 1 to 63999. */
+#define DMX_E131_UNIVERSE 1u
+
+/* Slot of the universe that drives the LED 0, from 1 to 512. The LED N is driven by 
+ * the slot DMX_START_ADDRESS + N * DMX_SLOT_SIZE.
+ */
+#define DMX_START_ADDRESS 1u
+
+/* Set to 1 to drive every LED with two slots, coarse and fine, instead of one. */
+#define DMX_16_BIT_SLOTS 0
+
+/* Checks the mapping at compile time. */
+#if DMX_ARTNET_PORT_ADDRESS > 0x7FFFu
+  #error "DMX_ARTNET_PORT_ADDRESS must fit in 15 bits."
+#endif
+
+#if DMX_E131_UNIVERSE < 1u || DMX_E131_UNIVERSE > 63999u
+  #error "DMX_E131_UNIVERSE must be between 1 and 63999."
+#endif
+
+#if DMX_START_ADDRESS < 1u || DMX_START_ADDRESS > 512u
+  #error "DMX_START_ADDRESS must be between 1 and 512."
+#endif
+
+#endif /* DMX_CONFIG_H_ */
@@ -19,6 +19,23 @@
 #define LEDS \
   LED(LED_0)
 
+/* Macro that describes the power drawn by the system LEDs. 
+ *
+ * Parameters:
+ * 
+ *   1) Identifier of the LED, it is mandatory to put a value defined inside LEDS.
+ *   2) Power in milliwatts that the LED draws at 100% of duty cycle.
+ *   
+ */
+#define LEDS_POWER           \
+  LED_POWER(LED_0, 3000u)
+
+/* Maximum power in milliwatts that all the LEDs together can draw from the supply. If
+ * the commands would go over it, the duty cycles of all the LEDs are scaled down 
+ * proportionally.
+ */
+#define LEDS_POWER_BUDGET_MW 10000u
+
 /* Maximum and minimun duty cycle that can be set to the PWM LED's in terms of
  * percentage.
  */
@@ -33,6 +50,61 @@
   #error "refer to (MAX_DUTY_CYCLE_PERCENTAGE, MIN_DUTY_CYCLE_PERCENTAGE)"
 #endif
 
+/* Period in microseconds and step in percentage terms of the dimming ramp while a lamp
+ * button is held. A ramp from MIN_DUTY_CYCLE_PERC to MAX_DUTY_CYCLE_PERC takes 
+ * (MAX - MIN) / LAMP_DIMMING_STEP_PERC periods.
+ */
+#define LAMP_DIMMING_PERIOD_US 20000u
+#define LAMP_DIMMING_STEP_PERC 1u
+
+/* Set to 1 to spread the on-times of the LEDs that share a timer along the PWM period,
+ * instead of turning all of them on at the beginning of it. It lowers the peak current.
+ */
+#define LED_PHASE_STAGGER_ENABLE 1
+
+/* Set to 1 to enable the temporal dithering of the LEDs driven by set_LED_level. It 
+ * alternates between adjacent duty values to reach fractions of a duty step.
+ */
+#define LED_DITHERING_ENABLE 1
+
+/* Number of bits of the fraction of a duty step that the dithering reproduces. The 
+ * average of every 2^LED_DITHER_FRACTION_BITS ticks is within a step of the level.
+ */
+#define LED_DITHER_FRACTION_BITS 4u
+
+/* Lowest frequency in Hertz at which the dithering can modulate the light. Slower
+ * modulations are visible flicker.
+ */
+#define LED_DITHER_MIN_CYCLE_HZ 100u
+
+/* Period in microseconds of the dithering tick and the maximum period that it can reach
+ * when it goes over its CPU budget. 2^LED_DITHER_FRACTION_BITS ticks of the maximum 
+ * period must be faster than LED_DITHER_MIN_CYCLE_HZ.
+ */
+#define LED_DITHER_PERIOD_US     500u
+#define LED_DITHER_MAX_PERIOD_US 625u
+
+/* Maximum CPU load in per mille that the dithering tick can consume. The tick period
+ * is doubled every time the measured load goes over it.
+ */
+#define LED_DITHER_MAX_LOAD_PERMILLE 20u
+
+#if LED_DITHER_FRACTION_BITS < 1 || LED_DITHER_FRACTION_BITS > 8
+  #error "Invalid dithering fraction: [1-8]:"
+  #error "refer to (LED_DITHER_FRACTION_BITS)"
+#endif
+
+#if ((1ul << LED_DITHER_FRACTION_BITS) * LED_DITHER_MAX_PERIOD_US) > \
+    (1000000ul / LED_DITHER_MIN_CYCLE_HZ)
+  #error "The dithering cycle is slower than the flicker threshold:"
+  #error "refer to (LED_DITHER_MAX_PERIOD_US)"
+#endif
+
+#if LED_DITHER_PERIOD_US > LED_DITHER_MAX_PERIOD_US
+  #error "Invalid dithering period, it must not exceed the maximum one:"
+  #error "refer to (LED_DITHER_PERIOD_US)"
+#endif
+
 /***************************************************************************************
  * Data Type Definitions
  ***************************************************************************************/
@@ -0,0 +1,43 @@
+/**
+ * @file      System_memory.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     File that declares macros to size the memory reserved at compile time by
+ *            the system modules.
+ */
+
+#ifndef SYSTEM_MEMORY_H_
+#define SYSTEM_MEMORY_H_
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Stack sizes in bytes of the system tasks. ESP-IDF counts the task stacks in bytes. */
+#define LAMP_TASK_STACK_SIZE       2048u
+#define SERVER_TASK_STACK_SIZE     2048u
+#define FLEET_TASK_STACK_SIZE      2560u
+#define PROFILER_TASK_STACK_SIZE   2048u
+#define TIME_SYNC_TASK_STACK_SIZE  2560u
+#define STREAM_TASK_STACK_SIZE     2560u
+#define STREAM_PRESENT_TASK_STACK_SIZE 2560u
+#define SCHEDULER_TASK_STACK_SIZE  2560u
+#define DMX_TASK_STACK_SIZE        2560u
+#define INGRESS_TASK_STACK_SIZE    2048u
+/* Stack of the HTTP server task of the GUI, it is allocated by the HTTP server. */
+#define HTTPD_TASK_STACK_SIZE      4096u
+
+/* Maximum RAM in bytes that every module can reserve for its RTOS objects (task stacks,
+ * task control blocks and semaphores). Every module checks its own budget when it is
+ * compiled.
+ */
+#define LAMP_STATIC_RAM_BUDGET       4096u
+#define TCP_SERVER_STATIC_RAM_BUDGET 7168u
+#define PROFILER_STATIC_RAM_BUDGET   3072u
+#define TIME_SYNC_STATIC_RAM_BUDGET  3072u
+#define STREAM_STATIC_RAM_BUDGET     6144u
+#define SCHEDULER_STATIC_RAM_BUDGET  3072u
+#define DMX_STATIC_RAM_BUDGET        3072u
+
+#endif /* SYSTEM_MEMORY_H_ */
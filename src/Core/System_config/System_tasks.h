@@ -0,0 +1,112 @@
+/**
+ * @file      System_tasks.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     File that declares the plan of the system tasks: the core, the priority
+ *            and the stack of every task created by the system modules.
+ */
+
+#ifndef SYSTEM_TASKS_H_
+#define SYSTEM_TASKS_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <freertos/FreeRTOS.h>
+#include <esp_task.h>
+#include <System_memory.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Cores of the plan. The WiFi driver and the lwIP thread run in the network core, so
+ * the lighting path gets the other one for itself. The single core builds run all the
+ * tasks in the same core.
+ */
+#if CONFIG_FREERTOS_UNICORE
+  #define NETWORK_CORE  0
+  #define LIGHTING_CORE 0
+#else
+  #define NETWORK_CORE  0
+  #define LIGHTING_CORE 1
+#endif
+
+/* Set to 1 to create every task with the core and the priority of the plan, set to 0
+ * to create them as they were before the plan, without affinity and with the baseline
+ * priority, to measure what the plan gives. The baseline build also takes the default
+ * affinities of the lwIP and esp_timer tasks from sdkconfig.baseline, see the baseline
+ * environment of platformio.ini.
+ */
+#ifndef SYSTEM_TASKS_PLAN_ENABLE
+  #define SYSTEM_TASKS_PLAN_ENABLE 1
+#endif
+
+/* Plan of the system tasks, every module creates its tasks with the row of the task.
+ *
+ * Columns:
+ *
+ *   1) Name of the task.
+ *   2) Core where the task runs, NETWORK_CORE, LIGHTING_CORE or tskNO_AFFINITY.
+ *   3) Priority of the task. The tasks of the network core run below the lwIP thread
+ *      (priority 18) and the WiFi driver (priority 23), so a flood of frames is
+ *      processed at the pace of the stack instead of starving it. The ingress task
+ *      runs the flood in the lighting core, so it runs below the esp_timer task
+ *      (ESP_TASK_TIMER_PRIO) to not delay the dithering and the stream ticks.
+ *   4) Stack size in bytes of the task.
+ *   5) Priority of the task in the baseline.
+ *
+ */
+#define SYSTEM_TASK_LAMP      \
+  ("lamp_task", LIGHTING_CORE, configMAX_PRIORITIES - 1, LAMP_TASK_STACK_SIZE, \
+   configMAX_PRIORITIES - 1)
+#define SYSTEM_TASK_SCHEDULER \
+  ("scheduler_task", LIGHTING_CORE, configMAX_PRIORITIES - 2,                  \
+   SCHEDULER_TASK_STACK_SIZE, configMAX_PRIORITIES - 2)
+#define SYSTEM_TASK_DMX       \
+  ("dmx_task", LIGHTING_CORE, configMAX_PRIORITIES - 2, DMX_TASK_STACK_SIZE, \
+   configMAX_PRIORITIES - 2)
+#define SYSTEM_TASK_STREAM_PRESENT \
+  ("stream_present", LIGHTING_CORE, configMAX_PRIORITIES - 2,                  \
+   STREAM_PRESENT_TASK_STACK_SIZE, configMAX_PRIORITIES - 2)
+#define SYSTEM_TASK_STREAM    \
+  ("stream_task", NETWORK_CORE, 7, STREAM_TASK_STACK_SIZE, configMAX_PRIORITIES - 2)
+#define SYSTEM_TASK_TIME_SYNC \
+  ("time_sync_task", NETWORK_CORE, 6, TIME_SYNC_TASK_STACK_SIZE,                \
+   configMAX_PRIORITIES - 2)
+#define SYSTEM_TASK_SERVER    \
+  ("server_task", NETWORK_CORE, 5, SERVER_TASK_STACK_SIZE, configMAX_PRIORITIES - 1)
+#define SYSTEM_TASK_FLEET     \
+  ("fleet_task", NETWORK_CORE, 5, FLEET_TASK_STACK_SIZE, configMAX_PRIORITIES - 1)
+#define SYSTEM_TASK_INGRESS   \
+  ("ingress_task", LIGHTING_CORE, ESP_TASK_TIMER_PRIO - 1, INGRESS_TASK_STACK_SIZE,   \
+   configMAX_PRIORITIES - 1)
+#define SYSTEM_TASK_HTTPD     \
+  ("httpd", NETWORK_CORE, 4, HTTPD_TASK_STACK_SIZE, tskIDLE_PRIORITY + 5)
+#define SYSTEM_TASK_PROFILER  \
+  ("profiler_task", tskNO_AFFINITY, tskIDLE_PRIORITY + 1, PROFILER_TASK_STACK_SIZE, \
+   tskIDLE_PRIORITY + 1)
+
+/* Return the columns of a row of the plan. */
+#define SYSTEM_TASK_NAME(task)       SYSTEM_TASK_NAME_ task
+#define SYSTEM_TASK_CORE(task)       SYSTEM_TASK_CORE_ task
+#define SYSTEM_TASK_PRIORITY(task)   SYSTEM_TASK_PRIORITY_ task
+#define SYSTEM_TASK_STACK_SIZE(task) SYSTEM_TASK_STACK_SIZE_ task
+
+/* Helpers of the column macros, do not use them directly. */
+#define SYSTEM_TASK_NAME_(name, core, priority, stack, baseline)       (name)
+#define SYSTEM_TASK_STACK_SIZE_(name, core, priority, stack, baseline) (stack)
+#if SYSTEM_TASKS_PLAN_ENABLE == 1
+  #define SYSTEM_TASK_CORE_(name, core, priority, stack, baseline)     \
+    ((BaseType_t)(core))
+  #define SYSTEM_TASK_PRIORITY_(name, core, priority, stack, baseline) \
+    ((UBaseType_t)(priority))
+#else
+  #define SYSTEM_TASK_CORE_(name, core, priority, stack, baseline)     \
+    ((BaseType_t)tskNO_AFFINITY)
+  #define SYSTEM_TASK_PRIORITY_(name, core, priority, stack, baseline) \
+    ((UBaseType_t)(baseline))
+#endif
+
+#endif /* SYSTEM_TASKS_H_ */
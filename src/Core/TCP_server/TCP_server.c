@@ -14,16 +14,30 @@
 #include <Debug.h>
 #include <WiFi.h>
 #include <string.h>
+#include <System_memory.h>
+#include <System_tasks.h>
+#include <Notifier.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
 #include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "nvs_flash.h"
+#include "esp_vfs_eventfd.h"
+#include <sys/eventfd.h>
 #include "lwip/inet.h"
 #include "lwip/netdb.h"
 #include "lwip/sockets.h"
 #include "lwip/ip_addr.h"
+#include "lwip/tcp.h"
+#include "lwip/tcpip.h"
+#include "lwip/netif.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/tcp.h"
 
 /***************************************************************************************
  * Defines
@@ -34,208 +48,2301 @@
   #define TAG "CORE_TCP_SERVER"
 #endif
 
+/* Size of the header of the extended frames. */
+#define EXT_FRAME_HEADER_SIZE sizeof(Ext_frame_header)
+
+/* Size of the buffer that receives the frames, it must fit any kind of frame. */
+#define RX_BUFFER_SIZE                                                       \
+  ((TCP_COMMAND_SIZE > (EXT_FRAME_HEADER_SIZE + EXT_FRAME_MAX_PAYLOAD_SIZE)) ? \
+    TCP_COMMAND_SIZE : (EXT_FRAME_HEADER_SIZE + EXT_FRAME_MAX_PAYLOAD_SIZE))
+
+/* Maximum number of connections open at the same time, one per station. */
+#define TCP_SERVER_MAX_CONNECTIONS MAX_STA_CONN
+
+/* RAM reserved by the server task, or by the ingress task and its queues in the raw 
+ * ingress.
+ */
+#if TCP_SERVER_RAW_INGRESS_ENABLE == 0
+  #define SERVER_TASK_STATIC_RAM                                          \
+    (SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_SERVER) * sizeof(StackType_t) + \
+     sizeof(StaticTask_t))
+#else
+  #define SERVER_TASK_STATIC_RAM                                             \
+    (SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_INGRESS) * sizeof(StackType_t) +   \
+     sizeof(StaticTask_t) + sizeof(raw_frames_storage) +                   \
+     sizeof(raw_replies_storage) + 2u * sizeof(StaticQueue_t))
+#endif
+
+/* Number of segments of a connection whose arrival time is kept until their bytes are
+ * processed.
+ */
+#define ARRIVAL_RING_SIZE 8u
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+#if TCP_SERVER_RAW_INGRESS_ENABLE == 0
+/* Structure that contains an open connection of the server. */
+typedef struct
+{
+  /* Descriptor of the connection, negative if it is free. */
+  int fd;
+  /* IPv4 address of the client in network order. */
+  uint32_t IP;
+  /* Received bytes of the frames that are not processed yet. */
+  uint8_t buf[RX_BUFFER_SIZE];
+  size_t received;
+  /* Subscriber of the connection, NOTIFIER_INVALID_SUBSCRIBER if it is not subscribed. */
+  uint8_t subscriber;
+  /* TCP port of the client in network order and number of processed bytes, to find 
+   * the arrival of the frames.
+   */
+  uint16_t port;
+  uint32_t consumed;
+} server_connection;
+#else
+/* Structure that contains an open connection of the raw ingress. */
+typedef struct
+{
+  /* Control block of the connection, NULL if it is free. */
+  struct tcp_pcb *pcb;
+  /* IPv4 address of the client in network order. */
+  uint32_t IP;
+  /* Received pbufs of the frames that are not processed yet, NULL if there are none. */
+  struct pbuf *pending;
+  /* Subscriber of the connection, NOTIFIER_INVALID_SUBSCRIBER if it is not subscribed. */
+  uint8_t subscriber;
+  /* Number of times that the connection was accepted, the frames and the replies of a
+   * previous client are not mixed with the ones of the current one.
+   */
+  uint8_t generation;
+  /* True once the client closed its side, the connection is closed after its frames. */
+  bool closing;
+  /* TCP port of the client in network order and number of processed bytes, to find 
+   * the arrival of the frames.
+   */
+  uint16_t port;
+  uint32_t consumed;
+} raw_connection;
+
+/* Frame of the raw ingress, copied out of the pbufs by the lwIP thread and dispatched 
+ * by the ingress task.
+ */
+typedef struct
+{
+  /* Time in microseconds when the frame arrived, negative if it is not known. */
+  int64_t arrival_us;
+  /* IPv4 address of the client in network order. */
+  uint32_t IP;
+  /* CPU cycles spent by the lwIP thread in the frame. */
+  uint32_t cycles;
+  /* Connection that received the frame and its generation. */
+  uint8_t conn;
+  uint8_t generation;
+  /* Bytes of the frame, an extended frame or a legacy one. */
+  uint8_t buf[RX_BUFFER_SIZE];
+} raw_frame;
+
+/* Reply of the raw ingress, sent by the lwIP thread. */
+typedef struct
+{
+  /* Connection of the reply and its generation. */
+  uint8_t conn;
+  uint8_t generation;
+  /* Number of bytes of the reply, header included. */
+  uint16_t len;
+  uint8_t buf[EXT_FRAME_HEADER_SIZE + EXT_FRAME_MAX_REPLY_SIZE];
+} raw_reply;
+#endif
+
+/* Arrival of the segments of a connection of the server, taken when the IP layer of 
+ * lwIP receives them.
+ */
+typedef struct
+{
+  /* IPv4 address and TCP port of the client in network order, 0 if it is free. */
+  uint32_t IP;
+  uint16_t port;
+  /* Number of segments in the ring and position of the oldest one. */
+  uint8_t count;
+  uint8_t head;
+  /* Sequence number of the first byte of data and the end of the newest segment. */
+  uint32_t first_seq;
+  uint32_t last_end;
+  /* Time in microseconds of the newest segment, the oldest connection is replaced. */
+  int64_t last_us;
+  /* End sequence numbers and arrival times of the segments not processed yet. */
+  uint32_t ends[ARRIVAL_RING_SIZE];
+  int64_t arrivals_us[ARRIVAL_RING_SIZE];
+} arrival_track;
+
 /***************************************************************************************
  * Global Variables
  ***************************************************************************************/
 
-/* Handler of the task that initialized the server and listen to new messages. */
-TaskHandle_t server_task_handler;
+/* Handler of the task that initialized the server and listen to new messages. */
+TaskHandle_t server_task_handler;
+
+/* IPv4 address of the client of the current connection in network order. It is kept 
+ * per task, so the servers of other modules can process frames at the same time.
+ */
+static _Thread_local uint32_t client_IP;
+
+/* Buffer of the replies to the extended frames and of the pushed events, static to 
+ * keep it out of the server stack.
+ */
+static uint8_t reply_buf[EXT_FRAME_HEADER_SIZE + EXT_FRAME_MAX_REPLY_SIZE];
+
+#if TCP_SERVER_RAW_INGRESS_ENABLE == 0
+/* Listening socket of the server, the server task closes it when it stops. */
+static int listening_sock = -1;
+
+/* Open connections of the server, they stay open while the clients send extended 
+ * frames.
+ */
+static server_connection connections[TCP_SERVER_MAX_CONNECTIONS] =
+{
+  [0 ... TCP_SERVER_MAX_CONNECTIONS - 1u] = 
+  { 
+    .fd = -1, 
+    .subscriber = NOTIFIER_INVALID_SUBSCRIBER, 
+  },
+};
+
+/* Event descriptor that wakes up the server when there are events to push. */
+static int wake_fd = -1;
+
+/* Consecutive failed accepts of the listening socket, and tick when it accepts again. */
+static uint32_t accept_errors;
+static TickType_t accept_resume_tick;
+
+/* Storage of the server task, there is no heap allocation for it. */
+static StackType_t server_task_stack[SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_SERVER)];
+static StaticTask_t server_task_buffer;
+#else
+/* Listener of the server, NULL while it is not listening. */
+static struct tcp_pcb *raw_listener;
+
+/* Open connections of the server, they are only used from the lwIP thread. */
+static raw_connection raw_connections[TCP_SERVER_MAX_CONNECTIONS] =
+{
+  [0 ... TCP_SERVER_MAX_CONNECTIONS - 1u] = 
+  { 
+    .subscriber = NOTIFIER_INVALID_SUBSCRIBER, 
+  },
+};
+
+/* Frames queued for the ingress task and replies queued for the lwIP thread. */
+static uint8_t raw_frames_storage[TCP_SERVER_INGRESS_QUEUE_SIZE * sizeof(raw_frame)];
+static StaticQueue_t raw_frames_buffer;
+static QueueHandle_t raw_frames;
+static uint8_t raw_replies_storage[TCP_SERVER_REPLY_QUEUE_SIZE * sizeof(raw_reply)];
+static StaticQueue_t raw_replies_buffer;
+static QueueHandle_t raw_replies;
+
+/* Frame being queued by the lwIP thread and reply being sent by it, static to keep 
+ * them out of the lwIP stack.
+ */
+static raw_frame raw_rx_frame;
+static raw_reply raw_tx_reply;
+
+/* Frame being dispatched by the ingress task and its reply. */
+static raw_frame ingress_frame;
+static raw_reply ingress_reply;
+
+/* True while the lwIP thread waits for room in the frames queue. */
+static bool raw_ingress_blocked;
+
+/* True while a send of the replies is queued in the lwIP thread. */
+static bool raw_reply_pending;
+
+/* Handler and storage of the ingress task, there is no heap allocation for it. */
+static TaskHandle_t ingress_task_handler;
+static StackType_t ingress_task_stack[SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_INGRESS)];
+static StaticTask_t ingress_task_buffer;
+
+/* Timer that opens again the listener after a failure, and its current wait. */
+static esp_timer_handle_t raw_restart_timer;
+static uint32_t raw_backoff_ms = TCP_SERVER_RESTART_MIN_MS;
+
+/* True while a push of the events is queued in the lwIP thread. */
+static bool raw_push_pending;
+
+/* True once the start of the listener is queued in the lwIP thread. */
+static bool raw_start_queued;
+#endif
+
+/* True while the access point is started. */
+static bool ap_started;
+
+/* True while the server tasks must leave their loops because the access point stopped,
+ * and true once every task left its loop without locks nor sockets and is about to
+ * suspend itself. They are read and written with the atomic builtins.
+ */
+static bool server_tasks_stopping;
+#if TCP_SERVER_RAW_INGRESS_ENABLE == 0
+static bool server_task_parked;
+#endif
+static bool fleet_task_parked;
+
+/* Timer that starts again the server tasks that could not be started with the access
+ * point.
+ */
+static esp_timer_handle_t start_retry_timer;
+
+/* Mutex of the start and the stop of the server tasks, they are started from the 
+ * event loop and from the retry timer.
+ */
+static SemaphoreHandle_t server_tasks_mutex;
+static StaticSemaphore_t server_tasks_mutex_buffer;
+
+/* Arrival of the segments of the open connections, written from the lwIP thread. */
+static arrival_track arrivals[TCP_SERVER_MAX_CONNECTIONS];
+static portMUX_TYPE arrivals_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Availability statistics of the server. */
+static TCP_server_stats server_stats;
+
+/* Time in microseconds when the server stopped listening, or when the access point 
+ * started before listening for the first time.
+ */
+static int64_t server_down_us;
+
+/* Cost of receiving the frames of the server. */
+static TCP_ingress_stats ingress_stats =
+{
+  .raw = TCP_SERVER_RAW_INGRESS_ENABLE,
+};
+
+/* Lock of the statistics, they are written by the server and read from other tasks. */
+static portMUX_TYPE server_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/* Handler of the task that receives the fleet datagrams. */
+static TaskHandle_t fleet_task_handler;
+
+/* Storage of the fleet task, there is no heap allocation for it. */
+static StackType_t fleet_task_stack[SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_FLEET)];
+static StaticTask_t fleet_task_buffer;
+
+/* Socket of the fleet datagrams, the fleet task closes it when it stops. */
+static int fleet_sock = -1;
+
+/* Buffer of the fleet datagrams and of the commands addressed to this device, static to
+ * keep them out of the fleet stack.
+ */
+static uint8_t fleet_buf[sizeof(Fleet_datagram_header) + 
+                         FLEET_MAX_COMMANDS * sizeof(Fleet_command)];
+static Fleet_command fleet_cmds[FLEET_MAX_COMMANDS];
+
+/* Identifier of this device inside the fleet. */
+static uint16_t fleet_device_ID = FLEET_DEVICE_ID;
+
+/* RAM reserved by the RTOS objects of the server. */
+_Static_assert(SERVER_TASK_STATIC_RAM + sizeof(fleet_task_stack) + sizeof(fleet_task_buffer) 
+  + sizeof(server_tasks_mutex_buffer) <= TCP_SERVER_STATIC_RAM_BUDGET, 
+  "Server RTOS objects go over TCP_SERVER_STATIC_RAM_BUDGET");
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Handler of the WiFi events.
+ * 
+ * @param event_handler_arg Arguments to pass to the handler.
+ * 
+ * @param event_base Which events should wait this function.
+ * 
+ * @param event_id Which event happened.
+ * 
+ * @param event_data Data associated to happened event.
+ *
+ * @return void
+ */
+static void WiFi_event_handler(void *event_handler_arg, esp_event_base_t event_base,
+  int32_t event_id, void *event_data);
+
+/**
+ * @brief Updates the statistics when the listener of the server starts or stops 
+ *        listening.
+ *
+ * @param listening True if the listener started to listen, false if it failed.
+ * 
+ * @param error Value of errno of the failure, not used if it started to listen.
+ *
+ * @return void
+ */
+static void update_server_stats(const bool listening, const int32_t error);
+
+/**
+ * @brief Starts the server tasks that are not running while the access point is 
+ *        started. If one of them can not be started it is tried again after 
+ *        TCP_SERVER_RESTART_MIN_MS.
+ *
+ * @return void
+ */
+static void start_server_tasks(void);
+
+/**
+ * @brief Suspends the calling server task once it left its loop, so it is deleted at a
+ *        point where it does not hold any lock nor socket.
+ *
+ * @param parked Parked flag of the calling task.
+ *
+ * @return void
+ */
+static void park_server_task(bool *parked);
+
+/**
+ * @brief Waits until a server task parks itself and deletes it, so its static storage 
+ *        can be used again. It is mandatory to hold server_tasks_mutex and to set 
+ *        server_tasks_stopping before.
+ *
+ * @param handler Handler of the task, it is set to NULL.
+ * 
+ * @param parked Parked flag of the task.
+ *
+ * @return void
+ */
+static void delete_parked_task(TaskHandle_t *handler, bool *parked);
+
+/**
+ * @brief Callback of the retry timer of the server tasks.
+ *
+ * @param args Not used.
+ *
+ * @return void
+ */
+static void start_retry_timer_callback(void *args);
+
+/**
+ * @brief Subscribes or unsubscribes a connection to the changes of the lamps, the 
+ *        payload of an EXT_FRAME_SUBSCRIBE frame.
+ *
+ * @param subscriber Subscriber of the connection, it is updated.
+ * 
+ * @param payload Payload of the frame.
+ * 
+ * @param len Number of bytes of the payload.
+ *
+ * @return Reply of the frame, 1 if it was done, otherwise 0.
+ */
+static uint8_t subscribe_connection(uint8_t *subscriber, const uint8_t *payload, 
+  const uint8_t len);
+
+/**
+ * @brief Adds a reception of frames to the ingress statistics.
+ *
+ * @param cycles CPU cycles spent receiving and dispatching the frames.
+ * 
+ * @param commands Number of received frames.
+ * 
+ * @param received Number of received bytes.
+ * 
+ * @param copied Number of bytes copied before processing them.
+ *
+ * @return void
+ */
+static void record_ingress(const uint32_t cycles, const uint32_t commands, 
+  const size_t received, const size_t copied);
+
+/**
+ * @brief Adds the latency of a dispatched frame to the ingress statistics.
+ *
+ * @param arrival_us Time in microseconds when the frame arrived, negative if it is not
+ *                   known.
+ *
+ * @return void
+ */
+static void record_latency(const int64_t arrival_us);
+
+#if CONFIG_LWIP_HOOK_IP4_INPUT_CUSTOM
+/**
+ * @brief Records the arrival of a TCP segment addressed to the server. A SYN starts 
+ *        to track the connection, replacing the oldest one. The retransmitted segments
+ *        are skipped, and when the ring is full the newest segment is extended, so a
+ *        frame never looks younger than it is.
+ *
+ * @param IP IPv4 address of the client in network order.
+ * 
+ * @param port TCP port of the client in network order.
+ * 
+ * @param seq Sequence number of the segment.
+ * 
+ * @param len Number of bytes of data of the segment.
+ * 
+ * @param syn True if the segment opens the connection.
+ *
+ * @return void
+ */
+static void record_arrival(const uint32_t IP, const uint16_t port, const uint32_t seq,
+  const uint32_t len, const bool syn);
+#endif
+
+/**
+ * @brief Takes the arrival time of a frame of a connection, the one of the segment 
+ *        that carried its last byte, and forgets the segments before it.
+ *
+ * @param IP IPv4 address of the client in network order.
+ * 
+ * @param port TCP port of the client in network order.
+ * 
+ * @param consumed Number of bytes of the connection up to the end of the frame.
+ *
+ * @return Time in microseconds when the frame arrived, -1 if it is not known.
+ */
+static int64_t take_arrival_us(const uint32_t IP, const uint16_t port, 
+  const uint32_t consumed);
+
+/**
+ * @brief Wakes up the server to push the events, it is the wake function of the
+ *        subscribed connections.
+ *
+ * @param arg Not used.
+ *
+ * @return void
+ */
+static void wake_server(void *arg);
+
+/**
+ * @brief Function that will receive the fleet datagrams and pass the commands addressed
+ *        to this device.
+ *
+ * @param args arguments to pass to the function.
+ *
+ * @return void
+ */
+static void fleet_task_func(void *args);
+
+/**
+ * @brief Filters the commands of a fleet datagram addressed to this device and passes
+ *        them in a single call.
+ *
+ * @param len Number of bytes of the datagram stored in fleet_buf.
+ * 
+ * @param client_IP IPv4 address of the sender in network order.
+ *
+ * @return void
+ */
+static void process_fleet_datagram(const size_t len, const uint32_t client_IP);
+
+#if TCP_SERVER_RAW_INGRESS_ENABLE == 0
+
+/**
+ * @brief Function that supervises the server. It opens the listening socket and serves
+ *        the connections, and when the socket fails it closes everything and opens it 
+ *        again after a backoff, so the device is never left without a listener.
+ *
+ * @param args arguments to pass to the function.
+ *
+ * @return void
+ */
+static void server_task_func(void *args);
+
+/**
+ * @brief Opens the listening socket of the server. The address is reused, so it can be
+ *        bound again right after a failure.
+ *
+ * @param void
+ *
+ * @return True if the socket is listening, otherwise false.
+ */
+static bool open_listening_socket(void);
+
+/**
+ * @brief Waits on the listening socket and all the open connections at once, and pushes
+ *        the events of the subscribed ones when it is woken up.
+ *
+ * @param void
+ *
+ * @return void, it returns when the listening socket failed or when the access point
+ *         stopped.
+ */
+static void serve_connections(void);
+
+/**
+ * @brief Closes all the connections and the listening socket.
+ *
+ * @param void
+ *
+ * @return void
+ */
+static void close_server_sockets(void);
+
+/**
+ * @brief Accepts a new connection if there is a free one.
+ *
+ * @param void
+ *
+ * @return False if the listening socket failed, otherwise true.
+ */
+static bool accept_connection(void);
+
+/**
+ * @brief Closes a connection and removes its subscription.
+ *
+ * @param conn Connection to close.
+ *
+ * @return void
+ */
+static void close_connection(server_connection *conn);
+
+/**
+ * @brief Reads the available bytes of a connection and processes its complete frames.
+ *        A legacy frame closes the connection after processing it.
+ *
+ * @param conn Connection to read.
+ * 
+ * @param received_bytes Return number of read bytes.
+ * 
+ * @param copied_bytes Return number of bytes copied before processing them.
+ *
+ * @return Number of processed frames.
+ */
+static uint32_t receive_frames(server_connection *conn, size_t *received_bytes, 
+  size_t *copied_bytes);
+
+/**
+ * @brief Processes an extended frame of a connection and sends its reply.
+ *
+ * @param conn Connection that received the frame, its buffer starts with the frame.
+ * 
+ * @param header Header of the frame.
+ * 
+ * @param arrival_us Time in microseconds when the frame arrived, negative if it is not
+ *                   known.
+ *
+ * @return True if the operation went well, false if the connection failed.
+ */
+static bool process_ext_frame(server_connection *conn, const Ext_frame_header *header,
+  const int64_t arrival_us);
+
+/**
+ * @brief Sends the pending events of every subscribed connection. The events never 
+ *        wait for a slow subscriber, a connection that can not take a whole frame at 
+ *        once is closed, so the others keep receiving theirs.
+ *
+ * @param void
+ *
+ * @return void
+ */
+static void push_events(void);
+
+/**
+ * @brief Writes all the given bytes to a connection.
+ *
+ * @param conn_fd Descriptor of the connection to write.
+ * 
+ * @param buf Bytes to write.
+ * 
+ * @param len Number of bytes to write.
+ *
+ * @return True if all the bytes were written, otherwise false.
+ */
+static bool write_all(const int conn_fd, const uint8_t *buf, const size_t len);
+
+#else
+
+/**
+ * @brief Callback of the restart timer of the listener, it opens the listener again in
+ *        the lwIP thread.
+ *
+ * @param args Not used.
+ *
+ * @return void
+ */
+static void raw_restart_timer_callback(void *args);
+
+/**
+ * @brief Opens the listener of the server with the raw API. If it fails it is opened 
+ *        again after a backoff, so the device is never left without a listener. It 
+ *        runs in the lwIP thread.
+ *
+ * @param ctx Not used.
+ *
+ * @return void
+ */
+static void start_raw_listener(void *ctx);
+
+/**
+ * @brief Closes all the connections and the listener of the server. It runs in the 
+ *        lwIP thread.
+ *
+ * @param ctx Not used.
+ *
+ * @return void
+ */
+static void stop_raw_listener(void *ctx);
+
+/**
+ * @brief Accepts a new connection if there is a free one.
+ *
+ * @param arg Not used.
+ * 
+ * @param pcb Control block of the new connection.
+ * 
+ * @param err Result of the accept.
+ *
+ * @return ERR_OK if the connection was accepted, ERR_ABRT if it was aborted.
+ */
+static err_t raw_accept_callback(void *arg, struct tcp_pcb *pcb, err_t err);
+
+/**
+ * @brief Chains the received bytes of a connection to its pending ones and queues its
+ *        complete frames.
+ *
+ * @param arg Connection that received the bytes.
+ * 
+ * @param pcb Control block of the connection.
+ * 
+ * @param p Received bytes, NULL if the client closed the connection.
+ * 
+ * @param err Result of the reception.
+ *
+ * @return ERR_OK, or ERR_ABRT if the connection was aborted.
+ */
+static err_t raw_recv_callback(void *arg, struct tcp_pcb *pcb, struct pbuf *p, 
+  err_t err);
+
+/**
+ * @brief Releases a connection that lwIP already freed after a fatal error.
+ *
+ * @param arg Connection that failed.
+ * 
+ * @param err Error of the connection.
+ *
+ * @return void
+ */
+static void raw_err_callback(void *arg, err_t err);
+
+/**
+ * @brief Copies the complete frames chained in a connection to the ingress queue. 
+ *        While the queue is full the rest of the frames stay in the pbufs, without 
+ *        acknowledging them to TCP, until the ingress task resumes them. A legacy 
+ *        frame, or the close of the client, closes the connection once its frames are
+ *        queued.
+ *
+ * @param conn Connection to process.
+ * 
+ * @param copied Return number of bytes copied out of the pbufs.
+ *
+ * @return ERR_OK, or ERR_ABRT if the connection was aborted.
+ */
+static err_t process_raw_frames(raw_connection *conn, size_t *copied);
+
+/**
+ * @brief Queues a frame for the ingress task without blocking.
+ *
+ * @param frame Frame to queue, it is copied.
+ *
+ * @return True if the frame was queued, false if the queue is full. In that case the 
+ *         ingress task resumes the frames when it takes the next one.
+ */
+static bool queue_raw_frame(const raw_frame *frame);
+
+/**
+ * @brief Goes on with the frames left in the pbufs of the connections when the ingress
+ *        queue was full. It runs in the lwIP thread.
+ *
+ * @param ctx Not used.
+ *
+ * @return void
+ */
+static void resume_raw_frames(void *ctx);
+
+/**
+ * @brief Sends the replies queued by the ingress task. The replies of the connections 
+ *        that were closed are dropped. It runs in the lwIP thread.
+ *
+ * @param ctx Not used.
+ *
+ * @return void
+ */
+static void send_raw_replies(void *ctx);
+
+/**
+ * @brief Function of the ingress task. It dispatches the frames of the raw ingress in 
+ *        the lighting core, so the frame handlers can block without stopping lwIP.
+ *
+ * @param args Not used.
+ *
+ * @return void
+ */
+static void ingress_task_func(void *args);
+
+/**
+ * @brief Dispatches an extended frame of the raw ingress and queues its reply for the 
+ *        lwIP thread. The subscriptions belong to the connection, so the frame itself 
+ *        is queued and the lwIP thread subscribes the connection when it replies.
+ *
+ * @param frame Frame to dispatch.
+ *
+ * @return void
+ */
+static void dispatch_raw_ext_frame(const raw_frame *frame);
+
+/**
+ * @brief Sends the pending events of every subscribed connection. It runs in the lwIP
+ *        thread.
+ *
+ * @param ctx Not used.
+ *
+ * @return void
+ */
+static void push_raw_events(void *ctx);
+
+/**
+ * @brief Queues bytes in a connection and sends them.
+ *
+ * @param conn Connection to write.
+ * 
+ * @param buf Bytes to write, they are copied.
+ * 
+ * @param len Number of bytes to write.
+ *
+ * @return True if the bytes were queued, otherwise false.
+ */
+static bool raw_write(raw_connection *conn, const uint8_t *buf, const size_t len);
+
+/**
+ * @brief Closes a connection and removes its subscription.
+ *
+ * @param conn Connection to close.
+ *
+ * @return ERR_OK, or ERR_ABRT if the connection had to be aborted.
+ */
+static err_t close_raw_connection(raw_connection *conn);
+
+#endif
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+TCP_server_return init_TCP_server(void)
+{
+
+  /* Confiuration of the WiFi peripheral. */
+  const wifi_config_t config = 
+  {
+    .ap =
+    {
+      .ssid = WIFI_SSID,
+      .ssid_len = strlen(WIFI_SSID),
+      .channel = WIFI_CHANNEL,
+      .password = WIFI_PASS,
+      .max_connection = MAX_STA_CONN,
+      .authmode = WIFI_AUTH_MODE,
+      .pmf_cfg = 
+      {
+        .required = false,
+      },
+    },
+  };
+
+  /* WiFi and IP events handlers. */
+  const event_handlers AP_handlers =
+  {
+    .WiFi_events_to_handle = ESP_EVENT_ANY_ID,
+    .WiFi_event_handler = WiFi_event_handler,
+    
+    .IP_event_handler = NULL,
+  };
+
+  #if TCP_SERVER_RAW_INGRESS_ENABLE == 0
+    /* Event descriptor that wakes up the server from the tasks that publish events. */
+    const esp_vfs_eventfd_config_t eventfd_config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+    if(wake_fd < 0)
+    {
+      /* It is already registered if the server was initialized before. */
+      const esp_err_t ret = esp_vfs_eventfd_register(&eventfd_config);
+      if(ret != ESP_OK && ret != ESP_ERR_INVALID_STATE)
+      {
+        return CORE_TCP_SERVER_INIT_ERR;
+      }
+      wake_fd = eventfd(0, 0);
+      if(wake_fd < 0)
+      {
+        return CORE_TCP_SERVER_INIT_ERR;
+      }
+    }
+  #else
+    /* Timer that opens again the listener after a failure. */
+    const esp_timer_create_args_t restart_timer_args =
+    {
+      .callback = raw_restart_timer_callback,
+      .dispatch_method = ESP_TIMER_TASK,
+      .name = "server_restart",
+    };
+    if(raw_restart_timer == NULL && 
+       esp_timer_create(&restart_timer_args, &raw_restart_timer) != ESP_OK)
+    {
+      return CORE_TCP_SERVER_INIT_ERR;
+    }
+
+    /* Queues of the frames and the replies and task that dispatches the frames, their 
+     * storage is static so they can not run out of heap.
+     */
+    if(ingress_task_handler == NULL)
+    {
+      raw_frames = xQueueCreateStatic(TCP_SERVER_INGRESS_QUEUE_SIZE, sizeof(raw_frame),
+        raw_frames_storage, &raw_frames_buffer);
+      raw_replies = xQueueCreateStatic(TCP_SERVER_REPLY_QUEUE_SIZE, sizeof(raw_reply),
+        raw_replies_storage, &raw_replies_buffer);
+      ingress_task_handler = xTaskCreateStaticPinnedToCore(ingress_task_func, 
+        SYSTEM_TASK_NAME(SYSTEM_TASK_INGRESS), 
+        SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_INGRESS), (void *) 0, 
+        SYSTEM_TASK_PRIORITY(SYSTEM_TASK_INGRESS), ingress_task_stack, 
+        &ingress_task_buffer, SYSTEM_TASK_CORE(SYSTEM_TASK_INGRESS));
+      if(ingress_task_handler == NULL)
+      {
+        return CORE_TCP_SERVER_INIT_ERR;
+      }
+    }
+  #endif
+
+  /* Mutex of the server tasks and timer that retries their start. */
+  if(server_tasks_mutex == NULL)
+  {
+    server_tasks_mutex = xSemaphoreCreateMutexStatic(&server_tasks_mutex_buffer);
+  }
+  const esp_timer_create_args_t start_retry_timer_args =
+  {
+    .callback = start_retry_timer_callback,
+    .dispatch_method = ESP_TIMER_TASK,
+    .name = "server_start",
+  };
+  if(start_retry_timer == NULL && 
+     esp_timer_create(&start_retry_timer_args, &start_retry_timer) != ESP_OK)
+  {
+    return CORE_TCP_SERVER_INIT_ERR;
+  }
+
+  /* Start WiFi in AP and station mode. */
+  if(core_WiFi_LOG(WiFi_init(WIFI_MODE_AP, config, AP_handlers) != CORE_WIFI_OK))
+  {
+    return CORE_TCP_SERVER_INIT_ERR;
+  }
+
+  return CORE_TCP_SERVER_OK;
+}
+
+TCP_server_return de_init_TCP_server(void)
+{
+  if(core_WiFi_LOG(de_init_WiFi()) != ESP_OK)
+  {
+    return CORE_TCP_SERVER_DE_INIT_ERR;
+  }
+  return CORE_TCP_SERVER_OK;
+}
+
+uint32_t get_TCP_client_IP(void)
+{
+  return client_IP;
+}
+
+void set_TCP_client_IP(const uint32_t IP)
+{
+  client_IP = IP;
+}
+
+size_t build_state_events_frame(const uint8_t subscriber, uint8_t *frame, 
+  const size_t size)
+{
+  uint32_t dropped;
+
+  if(size < EXT_FRAME_HEADER_SIZE + 1u)
+  {
+    return 0u;
+  }
+
+  /* The events are taken straight into the frame, after the dropped events byte. */
+  size_t max_events = (size - EXT_FRAME_HEADER_SIZE - 1u) / sizeof(Notifier_event);
+  if(max_events > (EXT_FRAME_MAX_REPLY_SIZE - 1u) / sizeof(Notifier_event))
+  {
+    max_events = (EXT_FRAME_MAX_REPLY_SIZE - 1u) / sizeof(Notifier_event);
+  }
+  const uint8_t num_of_events = notifier_take(subscriber, 
+    (Notifier_event *)&frame[EXT_FRAME_HEADER_SIZE + 1u], (uint8_t)max_events, &dropped);
+  if(num_of_events == 0u && dropped == 0u)
+  {
+    return 0u;
+  }
+
+  const Ext_frame_header header =
+  {
+    .start = EXT_FRAME_START_BYTE,
+    .type = EXT_FRAME_STATE_EVENTS,
+    .len = (uint8_t)(1u + num_of_events * sizeof(Notifier_event)),
+  };
+  memcpy(frame, &header, EXT_FRAME_HEADER_SIZE);
+  frame[EXT_FRAME_HEADER_SIZE] = (dropped > UINT8_MAX) ? UINT8_MAX : (uint8_t)dropped;
+
+  return EXT_FRAME_HEADER_SIZE + header.len;
+}
+
+void get_TCP_server_stats(TCP_server_stats *stats)
+{
+  taskENTER_CRITICAL(&server_stats_lock);
+  *stats = server_stats;
+  taskEXIT_CRITICAL(&server_stats_lock);
+}
+
+void get_TCP_ingress_stats(TCP_ingress_stats *stats)
+{
+  taskENTER_CRITICAL(&server_stats_lock);
+  *stats = ingress_stats;
+  taskEXIT_CRITICAL(&server_stats_lock);
+}
+
+uint16_t get_fleet_device_ID(void)
+{
+  if(fleet_device_ID == FLEET_DEVICE_ID_FROM_MAC)
+  {
+    uint8_t mac[6];
+    if(esp_read_mac(mac, ESP_MAC_WIFI_SOFTAP) == ESP_OK)
+    {
+      fleet_device_ID = ((uint16_t)mac[4] << 8u) | mac[5];
+    }
+  }
+
+  return fleet_device_ID;
+}
+
+inline TCP_server_return core_TCP_server_LOG(const TCP_server_return ret)
+{
+  #if DEBUG_MODE_ENABLE == 1
+    switch(ret)
+    {
+      #define TCP_SERVER_RETURN(enumerate) \
+        case enumerate:                    \
+          if(ret > 0)                      \
+          {                                \
+            ESP_LOGE(TAG, #enumerate);     \
+          }                                \
+          else                             \
+          {                                \
+            ESP_LOGI(TAG, #enumerate);     \
+          }                                \
+          break;       
+        TCP_SERVER_RETURNS
+      #undef TCP_SERVER_RETURN
+      default:
+        ESP_LOGE(TAG, "Unkown return.");
+        break;
+    }
+  #endif
+  return ret;
+}
+
+static void update_server_stats(const bool listening, const int32_t error)
+{
+  const int64_t now_us = esp_timer_get_time();
+
+  taskENTER_CRITICAL(&server_stats_lock);
+  if(listening)
+  {
+    const uint32_t downtime_ms = (uint32_t)((now_us - server_down_us) / 1000);
+    server_stats.downtime_ms += downtime_ms;
+    server_stats.last_downtime_ms = downtime_ms;
+    if(downtime_ms > server_stats.max_downtime_ms)
+    {
+      server_stats.max_downtime_ms = downtime_ms;
+    }
+    if(server_stats.starts > 0u)
+    {
+      server_stats.restarts++;
+    }
+    server_stats.starts++;
+    server_stats.listening = 1u;
+  }
+  else
+  {
+    /* The downtime starts when the socket fails, not at every failed attempt. */
+    if(server_stats.listening != 0u)
+    {
+      server_down_us = now_us;
+    }
+    server_stats.failed_starts++;
+    server_stats.last_errno = error;
+    server_stats.listening = 0u;
+  }
+  taskEXIT_CRITICAL(&server_stats_lock);
+}
+
+static void start_server_tasks(void)
+{
+  bool started;
+
+  xSemaphoreTake(server_tasks_mutex, portMAX_DELAY);
+  if(!ap_started)
+  {
+    xSemaphoreGive(server_tasks_mutex);
+    return;
+  }
+  __atomic_store_n(&server_tasks_stopping, false, __ATOMIC_RELEASE);
+
+  #if TCP_SERVER_RAW_INGRESS_ENABLE == 0
+    /* Create the server task, its storage is static so it can not run out of heap. 
+     * The task supervises the server itself, so it is only created here.
+     */
+    if(server_task_handler == NULL)
+    {
+      server_task_parked = false;
+      server_task_handler = xTaskCreateStaticPinnedToCore(server_task_func, 
+        SYSTEM_TASK_NAME(SYSTEM_TASK_SERVER), 
+        SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_SERVER), (void *) 0, 
+        SYSTEM_TASK_PRIORITY(SYSTEM_TASK_SERVER), server_task_stack, 
+        &server_task_buffer, SYSTEM_TASK_CORE(SYSTEM_TASK_SERVER));
+    }
+    started = (server_task_handler != NULL);
+  #else
+    /* Open the listener in the lwIP thread, it opens itself again if it fails. */
+    if(!raw_start_queued)
+    {
+      raw_start_queued = (tcpip_callback(start_raw_listener, NULL) == ERR_OK);
+    }
+    started = raw_start_queued;
+  #endif
+
+  /* Create the fleet task. */
+  if(fleet_task_handler == NULL)
+  {
+    fleet_task_parked = false;
+    fleet_task_handler = xTaskCreateStaticPinnedToCore(fleet_task_func, 
+      SYSTEM_TASK_NAME(SYSTEM_TASK_FLEET), SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_FLEET),
+      (void *) 0, SYSTEM_TASK_PRIORITY(SYSTEM_TASK_FLEET), fleet_task_stack,
+      &fleet_task_buffer, SYSTEM_TASK_CORE(SYSTEM_TASK_FLEET));
+  }
+  started = started && (fleet_task_handler != NULL);
+  xSemaphoreGive(server_tasks_mutex);
+
+  if(!started)
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Unable to start the server tasks, retrying.");
+    #endif
+    esp_timer_start_once(start_retry_timer, TCP_SERVER_RESTART_MIN_MS * 1000ull);
+  }
+}
+
+static void start_retry_timer_callback(void *args)
+{
+  start_server_tasks();
+}
+
+static void park_server_task(bool *parked)
+{
+  __atomic_store_n(parked, true, __ATOMIC_RELEASE);
+  vTaskSuspend(NULL);
+}
+
+static void delete_parked_task(TaskHandle_t *handler, bool *parked)
+{
+  if(*handler == NULL)
+  {
+    return;
+  }
+
+  /* It cuts a backoff short, the blocking calls of the task return by themselves. */
+  xTaskNotifyGive(*handler);
+
+  /* Once it is parked and suspended it is not running in the other core either. */
+  while(!__atomic_load_n(parked, __ATOMIC_ACQUIRE) || 
+        eTaskGetState(*handler) != eSuspended)
+  {
+    vTaskDelay(1u);
+  }
+  vTaskDelete(*handler);
+  *handler = NULL;
+}
+
+static uint8_t subscribe_connection(uint8_t *subscriber, const uint8_t *payload, 
+  const uint8_t len)
+{
+  const bool subscribe = (len > 0u && payload[0] != 0u);
+  if(subscribe && *subscriber == NOTIFIER_INVALID_SUBSCRIBER)
+  {
+    *subscriber = notifier_subscribe(wake_server, NULL);
+  }
+  else if(!subscribe)
+  {
+    notifier_unsubscribe(*subscriber);
+    *subscriber = NOTIFIER_INVALID_SUBSCRIBER;
+  }
+
+  return (subscribe == (*subscriber != NOTIFIER_INVALID_SUBSCRIBER)) ? 1u : 0u;
+}
+
+static void record_ingress(const uint32_t cycles, const uint32_t commands, 
+  const size_t received, const size_t copied)
+{
+  const uint32_t cycles_per_command = (commands > 0u) ? cycles / commands : 0u;
+
+  taskENTER_CRITICAL(&server_stats_lock);
+  ingress_stats.received_bytes += (uint32_t)received;
+  ingress_stats.copied_bytes += (uint32_t)copied;
+  if(commands > 0u)
+  {
+    ingress_stats.commands += commands;
+    ingress_stats.last_cycles = cycles_per_command;
+    ingress_stats.avg_cycles = (ingress_stats.commands == commands) ? cycles_per_command :
+      ingress_stats.avg_cycles - (ingress_stats.avg_cycles >> TCP_SERVER_AVG_SHIFT) + 
+      (cycles_per_command >> TCP_SERVER_AVG_SHIFT);
+    if(cycles_per_command > ingress_stats.max_cycles)
+    {
+      ingress_stats.max_cycles = cycles_per_command;
+    }
+  }
+  taskEXIT_CRITICAL(&server_stats_lock);
+}
+
+static void record_latency(const int64_t arrival_us)
+{
+  if(arrival_us < 0)
+  {
+    return;
+  }
+  const uint32_t latency_us = (uint32_t)(esp_timer_get_time() - arrival_us);
+
+  taskENTER_CRITICAL(&server_stats_lock);
+  ingress_stats.latency_samples++;
+  ingress_stats.last_latency_us = latency_us;
+  ingress_stats.avg_latency_us = (ingress_stats.latency_samples == 1u) ? latency_us :
+    ingress_stats.avg_latency_us - (ingress_stats.avg_latency_us >> TCP_SERVER_AVG_SHIFT)
+    + (latency_us >> TCP_SERVER_AVG_SHIFT);
+  if(latency_us > ingress_stats.max_latency_us)
+  {
+    ingress_stats.max_latency_us = latency_us;
+  }
+  taskEXIT_CRITICAL(&server_stats_lock);
+}
+
+#if CONFIG_LWIP_HOOK_IP4_INPUT_CUSTOM
+static void record_arrival(const uint32_t IP, const uint16_t port, const uint32_t seq,
+  const uint32_t len, const bool syn)
+{
+  const int64_t now_us = esp_timer_get_time();
+  arrival_track *track = NULL;
+  arrival_track *oldest = &arrivals[0];
+
+  taskENTER_CRITICAL(&arrivals_lock);
+  for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
+  {
+    if(arrivals[i].IP == IP && arrivals[i].port == port)
+    {
+      track = &arrivals[i];
+    }
+    if(arrivals[i].last_us < oldest->last_us)
+    {
+      oldest = &arrivals[i];
+    }
+  }
+
+  if(syn)
+  {
+    track = (track != NULL) ? track : oldest;
+    track->IP = IP;
+    track->port = port;
+    track->count = 0u;
+    track->head = 0u;
+    track->first_seq = seq + 1u;
+    track->last_end = seq + 1u;
+    track->last_us = now_us;
+  }
+
+  /* Only the new bytes count, a retransmission does not move the arrival. */
+  const uint32_t end = seq + (syn ? 1u : 0u) + len;
+  if(track != NULL && len > 0u && (int32_t)(end - track->last_end) > 0)
+  {
+    track->last_end = end;
+    track->last_us = now_us;
+    if(track->count == ARRIVAL_RING_SIZE)
+    {
+      track->ends[(track->head + track->count - 1u) % ARRIVAL_RING_SIZE] = end;
+    }
+    else
+    {
+      const uint8_t slot = (track->head + track->count) % ARRIVAL_RING_SIZE;
+      track->ends[slot] = end;
+      track->arrivals_us[slot] = now_us;
+      track->count++;
+    }
+  }
+  taskEXIT_CRITICAL(&arrivals_lock);
+}
+#endif
+
+static int64_t take_arrival_us(const uint32_t IP, const uint16_t port, 
+  const uint32_t consumed)
+{
+  int64_t arrival_us = -1;
+
+  taskENTER_CRITICAL(&arrivals_lock);
+  for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
+  {
+    arrival_track *track = &arrivals[i];
+    if(track->IP != IP || track->port != port)
+    {
+      continue;
+    }
+
+    /* The segments before the frame are done, the one with its last byte is kept 
+     * while it carries more bytes.
+     */
+    const uint32_t end = track->first_seq + consumed;
+    while(track->count > 0u && (int32_t)(track->ends[track->head] - end) < 0)
+    {
+      track->head = (track->head + 1u) % ARRIVAL_RING_SIZE;
+      track->count--;
+    }
+    if(track->count > 0u)
+    {
+      arrival_us = track->arrivals_us[track->head];
+      if(track->ends[track->head] == end)
+      {
+        track->head = (track->head + 1u) % ARRIVAL_RING_SIZE;
+        track->count--;
+      }
+    }
+    break;
+  }
+  taskEXIT_CRITICAL(&arrivals_lock);
+
+  return arrival_us;
+}
+
+#if CONFIG_LWIP_HOOK_IP4_INPUT_CUSTOM
+int lwip_hook_ip4_input(struct pbuf *p, struct netif *input_netif)
+{
+  /* The arrival is taken for the segments of the server before TCP processes them, it
+   * is the same point for the sockets and for the raw ingress. The packet always goes
+   * on to lwIP.
+   */
+  const struct ip_hdr *iphdr = (const struct ip_hdr *)p->payload;
+  const uint16_t iphdr_len = IPH_HL_BYTES(iphdr);
+  if(p->len < iphdr_len + TCP_HLEN || IPH_PROTO(iphdr) != IP_PROTO_TCP)
+  {
+    return 0;
+  }
+
+  const struct tcp_hdr *tcphdr = (const struct tcp_hdr *)((const uint8_t *)p->payload + 
+    iphdr_len);
+  const int32_t len = (int32_t)lwip_ntohs(IPH_LEN(iphdr)) - iphdr_len - 
+    TCPH_HDRLEN_BYTES(tcphdr);
+  if(lwip_ntohs(tcphdr->dest) != TCP_IP_PORT || len < 0)
+  {
+    return 0;
+  }
+
+  record_arrival(iphdr->src.addr, tcphdr->src, lwip_ntohl(tcphdr->seqno), 
+    (uint32_t)len, (TCPH_FLAGS(tcphdr) & TCP_SYN) != 0u);
+  return 0;
+}
+#endif
+
+static void fleet_task_func(void *args)
+{
+  struct sockaddr_in addr =
+  {
+    .sin_family = AF_INET,
+    .sin_addr.s_addr = htonl(INADDR_ANY),
+    .sin_port = htons(FLEET_UDP_PORT),
+  };
+  /* The receive returns every TCP_SERVER_STOP_POLL_MS to see if the access point 
+   * stopped.
+   */
+  const struct timeval timeout =
+  {
+    .tv_sec = TCP_SERVER_STOP_POLL_MS / 1000u,
+    .tv_usec = (TCP_SERVER_STOP_POLL_MS % 1000u) * 1000u,
+  };
+  struct sockaddr_in source_addr;
+
+  get_fleet_device_ID();
+
+  /* The socket is opened again with the same backoff than the server until it works. */
+  uint32_t backoff_ms = TCP_SERVER_RESTART_MIN_MS;
+  fleet_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  while(fleet_sock < 0 || 
+        bind(fleet_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        setsockopt(fleet_sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Unable to open the fleet socket: errno %d", errno);
+    #endif
+    if(fleet_sock >= 0)
+    {
+      close(fleet_sock);
+      fleet_sock = -1;
+    }
+    if(__atomic_load_n(&server_tasks_stopping, __ATOMIC_ACQUIRE))
+    {
+      break;
+    }
+
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(backoff_ms));
+    backoff_ms = (backoff_ms * 2u > TCP_SERVER_RESTART_MAX_MS) ? 
+      TCP_SERVER_RESTART_MAX_MS : backoff_ms * 2u;
+    fleet_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  }
+
+  if(fleet_sock >= 0)
+  {
+    /* Broadcast datagrams arrive without joining, multicast ones need the group. */
+    struct ip_mreq group =
+    {
+      .imr_interface.s_addr = htonl(INADDR_ANY),
+    };
+    inet_pton(AF_INET, FLEET_MULTICAST_IP, &group.imr_multiaddr);
+    if(setsockopt(fleet_sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) != 0)
+    {
+      #if DEBUG_MODE_ENABLE == 1
+        ESP_LOGE(TAG, "Unable to join the fleet group: errno %d", errno);
+      #endif
+    }
+
+    while(!__atomic_load_n(&server_tasks_stopping, __ATOMIC_ACQUIRE))
+    {
+      socklen_t source_addr_len = sizeof(source_addr);
+      const ssize_t received = recvfrom(fleet_sock, fleet_buf, sizeof(fleet_buf), 0,
+        (struct sockaddr *)&source_addr, &source_addr_len);
+      if(received > 0)
+      {
+        process_fleet_datagram((size_t)received, source_addr.sin_addr.s_addr);
+      }
+    }
+
+    close(fleet_sock);
+    fleet_sock = -1;
+  }
+
+  park_server_task(&fleet_task_parked);
+}
+
+static void process_fleet_datagram(const size_t len, const uint32_t client_IP)
+{
+  Fleet_datagram_header header;
+  if(len < sizeof(header))
+  {
+    return;
+  }
+  memcpy(&header, fleet_buf, sizeof(header));
+
+  if(header.magic != FLEET_MAGIC || header.num_of_commands > FLEET_MAX_COMMANDS ||
+     len != sizeof(header) + header.num_of_commands * sizeof(Fleet_command))
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Received invalid fleet datagram.");
+    #endif
+    return;
+  }
+
+  /* Single pass over the datagram, keeping only the commands of this device. */
+  uint8_t num_of_cmds = 0u;
+  for(uint8_t i = 0u; i < header.num_of_commands; i++)
+  {
+    memcpy(&fleet_cmds[num_of_cmds], 
+      &fleet_buf[sizeof(header) + i * sizeof(Fleet_command)], sizeof(Fleet_command));
+    if(fleet_cmds[num_of_cmds].first_device <= fleet_device_ID && 
+       fleet_device_ID <= fleet_cmds[num_of_cmds].last_device)
+    {
+      num_of_cmds++;
+    }
+  }
+
+  if(num_of_cmds > 0u)
+  {
+    RX_fleet_commands(fleet_cmds, num_of_cmds, client_IP);
+  }
+}
+
+#if TCP_SERVER_RAW_INGRESS_ENABLE == 0
+
+static void server_task_func(void *args)
+{
+  uint32_t backoff_ms = TCP_SERVER_RESTART_MIN_MS;
+
+  while(!__atomic_load_n(&server_tasks_stopping, __ATOMIC_ACQUIRE))
+  {
+    if(open_listening_socket())
+    {
+      update_server_stats(true, 0);
+      backoff_ms = TCP_SERVER_RESTART_MIN_MS;
+
+      serve_connections();
+    }
+
+    /* The access point stopped, the socket did not fail. */
+    if(__atomic_load_n(&server_tasks_stopping, __ATOMIC_ACQUIRE))
+    {
+      break;
+    }
+
+    /* The clients reconnect to the new socket, nothing of the failed one is kept. */
+    update_server_stats(false, errno);
+    close_server_sockets();
+
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(backoff_ms));
+    backoff_ms = (backoff_ms * 2u > TCP_SERVER_RESTART_MAX_MS) ? 
+      TCP_SERVER_RESTART_MAX_MS : backoff_ms * 2u;
+  }
+
+  close_server_sockets();
+  park_server_task(&server_task_parked);
+}
+
+static bool open_listening_socket(void)
+{
+  const int reuse = 1;
+  const struct sockaddr_in addrs_to_listen =
+  {
+    /* Set IPV4. */
+    .sin_family = AF_INET,
+    /* Accept any IP. */
+    .sin_addr.s_addr = htonl(INADDR_ANY),
+    /* Set the port defined in Network_config.h */
+    .sin_port = htons(TCP_IP_PORT),
+  };
+
+  /* Create listening socket and verify the initialization . */
+  listening_sock = socket(AF_INET, SOCK_STREAM, 0);
+  if(listening_sock < 0) 
+  { 
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Unable tto create socket: errno %d", errno);
+    #endif
+    return false;
+  }
+
+  /* The port of the failed socket can be in TIME_WAIT, it is bound again anyway. */
+  if(setsockopt(listening_sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0)
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Unable to reuse the address: errno %d", errno);
+    #endif
+  }
+
+  /* Binding newly created socket to given IP, verification. */
+  if(bind(listening_sock, (struct sockaddr*)&addrs_to_listen, 
+     sizeof(addrs_to_listen)) != 0) 
+  { 
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Socket bind failed: errno %d", errno);
+    #endif
+    return false;
+  } 
+
+  /* At this point server is ready to listen, verification. */
+  if(listen(listening_sock, MAX_STA_CONN) != 0) 
+  { 
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Listen socket failed: errno %d", errno);
+    #endif
+    return false;
+  } 
+
+  return true;
+}
+
+static void serve_connections(void)
+{
+  fd_set read_fds;
+
+  /* The stop of the access point writes wake_fd after setting the flag, so the select
+   * returns if the flag was set after this check.
+   */
+  while(!__atomic_load_n(&server_tasks_stopping, __ATOMIC_ACQUIRE))
+  {
+    /* Wait for new connections, frames of the open ones or events to push. After a 
+     * failed accept the listening socket is left out until its backoff is over.
+     */
+    struct timeval backoff;
+    struct timeval *timeout = NULL;
+    const TickType_t backoff_ticks = accept_resume_tick - xTaskGetTickCount();
+    FD_ZERO(&read_fds);
+    if(accept_errors > 0u && (int32_t)backoff_ticks > 0)
+    {
+      const uint32_t backoff_ms = backoff_ticks * portTICK_PERIOD_MS;
+      backoff.tv_sec = backoff_ms / 1000u;
+      backoff.tv_usec = (backoff_ms % 1000u) * 1000u;
+      timeout = &backoff;
+    }
+    else
+    {
+      FD_SET(listening_sock, &read_fds);
+    }
+    int max_fd = listening_sock;
+    if(wake_fd >= 0)
+    {
+      FD_SET(wake_fd, &read_fds);
+      max_fd = (wake_fd > max_fd) ? wake_fd : max_fd;
+    }
+    for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
+    {
+      if(connections[i].fd >= 0)
+      {
+        FD_SET(connections[i].fd, &read_fds);
+        max_fd = (connections[i].fd > max_fd) ? connections[i].fd : max_fd;
+      }
+    }
+
+    if(select(max_fd + 1, &read_fds, NULL, NULL, timeout) < 0)
+    {
+      #if DEBUG_MODE_ENABLE == 1
+        ESP_LOGE(TAG, "Select failed: errno %d", errno);
+      #endif
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      return;
+    }
+
+    if(wake_fd >= 0 && FD_ISSET(wake_fd, &read_fds))
+    {
+      uint64_t wakes;
+      read(wake_fd, &wakes, sizeof(wakes));
+      push_events();
+    }
+
+    if(FD_ISSET(listening_sock, &read_fds) && !accept_connection())
+    {
+      return;
+    }
+
+    for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
+    {
+      if(connections[i].fd >= 0 && FD_ISSET(connections[i].fd, &read_fds))
+      {
+        size_t received = 0u;
+        size_t copied = 0u;
+        const uint32_t start_cycles = esp_cpu_get_cycle_count();
+        const uint32_t commands = receive_frames(&connections[i], &received, &copied);
+        record_ingress(esp_cpu_get_cycle_count() - start_cycles, commands, received, 
+          copied);
+      }
+    }
+  }
+}
+
+static void close_server_sockets(void)
+{
+  for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
+  {
+    if(connections[i].fd >= 0)
+    {
+      close_connection(&connections[i]);
+    }
+  }
+
+  if(listening_sock >= 0)
+  {
+    close(listening_sock);
+    listening_sock = -1;
+  }
+  accept_errors = 0u;
+}
+
+static bool accept_connection(void)
+{
+  struct sockaddr_in source_addr;
+  socklen_t source_addr_len = sizeof(source_addr);
+
+  const int conn_fd = accept(listening_sock, (struct sockaddr*)&source_addr, 
+    &source_addr_len); 
+  if(conn_fd < 0) 
+  { 
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Accept socket failed: errno %d", errno);
+    #endif
+
+    /* A broken listening socket needs a restart. The rest of the errors are 
+     * transient, the socket rests a while after each one so they do not spin the 
+     * server, and too many in a row restart it anyway.
+     */
+    accept_errors++;
+    if(errno == EBADF || errno == EINVAL || errno == ENOTSOCK || 
+       accept_errors >= TCP_SERVER_ACCEPT_MAX_ERRORS)
+    {
+      return false;
+    }
+    accept_resume_tick = xTaskGetTickCount() + 
+      pdMS_TO_TICKS(accept_errors * TCP_SERVER_ACCEPT_BACKOFF_MS);
+    return true;
+  }
+  accept_errors = 0u;
+
+  for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
+  {
+    if(connections[i].fd < 0)
+    {
+      connections[i].fd = conn_fd;
+      connections[i].IP = source_addr.sin_addr.s_addr;
+      connections[i].port = source_addr.sin_port;
+      connections[i].consumed = 0u;
+      connections[i].received = 0u;
+      connections[i].subscriber = NOTIFIER_INVALID_SUBSCRIBER;
+      return true;
+    }
+  }
+
+  #if DEBUG_MODE_ENABLE == 1
+    ESP_LOGE(TAG, "No free connections.");
+  #endif
+  close(conn_fd);
+  return true;
+}
+
+static void close_connection(server_connection *conn)
+{
+  notifier_unsubscribe(conn->subscriber);
+  conn->subscriber = NOTIFIER_INVALID_SUBSCRIBER;
+  shutdown(conn->fd, 0);
+  close(conn->fd);
+  conn->fd = -1;
+  conn->received = 0u;
+}
+
+static uint32_t receive_frames(server_connection *conn, size_t *received_bytes, 
+  size_t *copied_bytes)
+{
+  uint32_t commands = 0u;
+
+  const ssize_t received = read(conn->fd, (void*)&conn->buf[conn->received], 
+    sizeof(conn->buf) - conn->received);
+  if(received <= 0)
+  {
+    close_connection(conn);
+    return commands;
+  }
+  conn->received += (size_t)received;
+  *received_bytes = (size_t)received;
+  *copied_bytes = (size_t)received;
+  client_IP = conn->IP;
+
+  /* Process all the complete frames, a partial one waits for the rest of its bytes. */
+  while(conn->received > 0u)
+  {
+    size_t frame_size;
+
+    if(conn->buf[0] == EXT_FRAME_START_BYTE)
+    {
+      Ext_frame_header header;
+      if(conn->received < EXT_FRAME_HEADER_SIZE)
+      {
+        return commands;
+      }
+      memcpy(&header, conn->buf, EXT_FRAME_HEADER_SIZE);
+      *copied_bytes += EXT_FRAME_HEADER_SIZE;
+
+      if(header.type >= NUM_OF_EXT_FRAMES || header.len > EXT_FRAME_MAX_PAYLOAD_SIZE)
+      {
+        #if DEBUG_MODE_ENABLE == 1
+          ESP_LOGE(TAG, "Received invalid extended frame.");
+        #endif
+        close_connection(conn);
+        return commands;
+      }
+
+      frame_size = EXT_FRAME_HEADER_SIZE + header.len;
+      if(conn->received < frame_size)
+      {
+        return commands;
+      }
+
+      conn->consumed += frame_size;
+      if(!process_ext_frame(conn, &header, 
+         take_arrival_us(conn->IP, conn->port, conn->consumed)))
+      {
+        close_connection(conn);
+        return commands;
+      }
+    }
+    else
+    {
+      TCP_COMMAND_TYPE cmd;
+      if(conn->received < TCP_COMMAND_SIZE)
+      {
+        return commands;
+      }
+      memcpy((void*)&cmd, conn->buf, TCP_COMMAND_SIZE);
+      *copied_bytes += TCP_COMMAND_SIZE;
+      conn->consumed += TCP_COMMAND_SIZE;
+      const int64_t arrival_us = take_arrival_us(conn->IP, conn->port, conn->consumed);
+      RX_command_frame(cmd);
+      record_latency(arrival_us);
+      commands++;
+
+      /* The legacy clients expect the server to close the connection after the 
+       * command, only the extended frames keep it open.
+       */
+      close_connection(conn);
+      return commands;
+    }
+
+    commands++;
+    conn->received -= frame_size;
+    memmove(conn->buf, &conn->buf[frame_size], conn->received);
+    *copied_bytes += conn->received;
+  }
+
+  return commands;
+}
+
+static bool process_ext_frame(server_connection *conn, const Ext_frame_header *header,
+  const int64_t arrival_us)
+{
+  const uint8_t *payload = &conn->buf[EXT_FRAME_HEADER_SIZE];
+  uint8_t reply_len;
+
+  /* The subscriptions belong to the connection, the rest of frames to the application. */
+  if(header->type == EXT_FRAME_SUBSCRIBE)
+  {
+    reply_buf[EXT_FRAME_HEADER_SIZE] = 
+      subscribe_connection(&conn->subscriber, payload, header->len);
+    reply_len = 1u;
+  }
+  else
+  {
+    reply_len = RX_ext_command_frame((Ext_frame_type)header->type, payload, 
+      header->len, &reply_buf[EXT_FRAME_HEADER_SIZE], EXT_FRAME_MAX_REPLY_SIZE);
+  }
+  record_latency(arrival_us);
+
+  if(reply_len == 0u)
+  {
+    return true;
+  }
+
+  const Ext_frame_header reply_header =
+  {
+    .start = EXT_FRAME_START_BYTE,
+    .type = header->type,
+    .len = reply_len,
+  };
+  memcpy(reply_buf, &reply_header, EXT_FRAME_HEADER_SIZE);
+
+  if(!write_all(conn->fd, reply_buf, EXT_FRAME_HEADER_SIZE + reply_len))
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Write socket failed: errno %d", errno);
+    #endif
+    return false;
+  }
+
+  return true;
+}
+
+static void push_events(void)
+{
+  for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
+  {
+    server_connection *conn = &connections[i];
+    if(conn->fd < 0 || conn->subscriber == NOTIFIER_INVALID_SUBSCRIBER)
+    {
+      continue;
+    }
+
+    const size_t len = build_state_events_frame(conn->subscriber, reply_buf, 
+      sizeof(reply_buf));
+    if(len == 0u)
+    {
+      continue;
+    }
+
+    /* A part of a frame would break the stream and the events are already taken from 
+     * the notifier, so a full socket closes the connection.
+     */
+    const ssize_t ret = send(conn->fd, reply_buf, len, MSG_DONTWAIT);
+    if(ret != (ssize_t)len)
+    {
+      #if DEBUG_MODE_ENABLE == 1
+        ESP_LOGE(TAG, "Event push failed: errno %d", (ret < 0) ? errno : EAGAIN);
+      #endif
+      close_connection(conn);
+    }
+  }
+}
+
+static void wake_server(void *arg)
+{
+  const uint64_t wake = 1u;
+  if(wake_fd >= 0)
+  {
+    write(wake_fd, &wake, sizeof(wake));
+  }
+}
+
+static bool write_all(const int conn_fd, const uint8_t *buf, const size_t len)
+{
+  size_t sent = 0u;
+  while(sent < len)
+  {
+    const ssize_t ret = write(conn_fd, (const void*)&buf[sent], len - sent);
+    if(ret <= 0)
+    {
+      return false;
+    }
+    sent += (size_t)ret;
+  }
+
+  return true;
+}
+
+#else
+
+static void wake_server(void *arg)
+{
+  /* Only one push is queued at a time, it takes all the pending events. It never 
+   * blocks, the events can be published from the lwIP thread.
+   */
+  if(!__atomic_exchange_n(&raw_push_pending, true, __ATOMIC_ACQ_REL) &&
+     tcpip_try_callback(push_raw_events, NULL) != ERR_OK)
+  {
+    __atomic_store_n(&raw_push_pending, false, __ATOMIC_RELEASE);
+  }
+}
+
+static void raw_restart_timer_callback(void *args)
+{
+  tcpip_callback(start_raw_listener, NULL);
+}
+
+static void start_raw_listener(void *ctx)
+{
+  int32_t error = 0;
+
+  if(raw_listener != NULL)
+  {
+    return;
+  }
+
+  struct tcp_pcb *pcb = tcp_new_ip_type(IPADDR_TYPE_V4);
+  if(pcb == NULL)
+  {
+    error = ENOMEM;
+  }
+  else
+  {
+    /* The port of the failed listener can be in TIME_WAIT, it is bound again anyway. */
+    ip_set_option(pcb, SOF_REUSEADDR);
+    if(tcp_bind(pcb, IP_ADDR_ANY, TCP_IP_PORT) != ERR_OK)
+    {
+      error = EADDRINUSE;
+    }
+    else
+    {
+      /* On success the listener replaces the pcb, that is freed. */
+      raw_listener = tcp_listen_with_backlog(pcb, MAX_STA_CONN);
+      error = (raw_listener == NULL) ? ENOMEM : 0;
+    }
+
+    if(raw_listener == NULL)
+    {
+      tcp_close(pcb);
+    }
+  }
 
-/***************************************************************************************
- * Functions Prototypes
- ***************************************************************************************/
+  if(raw_listener == NULL)
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Unable to open the listener: errno %d", (int)error);
+    #endif
+    update_server_stats(false, error);
+    esp_timer_start_once(raw_restart_timer, raw_backoff_ms * 1000ull);
+    raw_backoff_ms = (raw_backoff_ms * 2u > TCP_SERVER_RESTART_MAX_MS) ? 
+      TCP_SERVER_RESTART_MAX_MS : raw_backoff_ms * 2u;
+    return;
+  }
 
-/**
- * @brief Handler of the WiFi events.
- * 
- * @param event_handler_arg Arguments to pass to the handler.
- * 
- * @param event_base Which events should wait this function.
- * 
- * @param event_id Which event happened.
- * 
- * @param event_data Data associated to happened event.
- *
- * @return void
- */
-static void WiFi_event_handler(void *event_handler_arg, esp_event_base_t event_base,
-  int32_t event_id, void *event_data);
+  tcp_accept(raw_listener, raw_accept_callback);
+  update_server_stats(true, 0);
+  raw_backoff_ms = TCP_SERVER_RESTART_MIN_MS;
+}
 
-/**
- * @brief Function that will initialize the server and wait for messages.
- *
- * @param args arguments to pass to the function.
- *
- * @return void
- */
-static void server_task_func(void *args);
+static void stop_raw_listener(void *ctx)
+{
+  esp_timer_stop(raw_restart_timer);
+  raw_backoff_ms = TCP_SERVER_RESTART_MIN_MS;
 
-/***************************************************************************************
- * Functions
- ***************************************************************************************/
+  for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
+  {
+    if(raw_connections[i].pcb != NULL)
+    {
+      close_raw_connection(&raw_connections[i]);
+    }
+  }
 
-TCP_server_return init_TCP_server(void)
+  if(raw_listener != NULL)
+  {
+    tcp_close(raw_listener);
+    raw_listener = NULL;
+  }
+}
+
+static err_t raw_accept_callback(void *arg, struct tcp_pcb *pcb, err_t err)
 {
+  if(err != ERR_OK || pcb == NULL)
+  {
+    return err;
+  }
 
-  /* Confiuration of the WiFi peripheral. */
-  const wifi_config_t config = 
+  for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
   {
-    .ap =
+    raw_connection *conn = &raw_connections[i];
+    if(conn->pcb == NULL)
     {
-      .ssid = WIFI_SSID,
-      .ssid_len = strlen(WIFI_SSID),
-      .channel = WIFI_CHANNEL,
-      .password = WIFI_PASS,
-      .max_connection = MAX_STA_CONN,
-      .authmode = WIFI_AUTH_MODE,
-      .pmf_cfg = 
-      {
-        .required = false,
-      },
-    },
-  };
+      conn->pcb = pcb;
+      conn->pending = NULL;
+      conn->IP = ip4_addr_get_u32(ip_2_ip4(&pcb->remote_ip));
+      conn->port = lwip_htons(pcb->remote_port);
+      conn->consumed = 0u;
+      conn->closing = false;
+      conn->generation++;
+      conn->subscriber = NOTIFIER_INVALID_SUBSCRIBER;
+      tcp_arg(pcb, conn);
+      tcp_recv(pcb, raw_recv_callback);
+      tcp_err(pcb, raw_err_callback);
+      return ERR_OK;
+    }
+  }
 
-  /* WiFi and IP events handlers. */
-  const event_handlers AP_handlers =
+  #if DEBUG_MODE_ENABLE == 1
+    ESP_LOGE(TAG, "No free connections.");
+  #endif
+  tcp_abort(pcb);
+  return ERR_ABRT;
+}
+
+static err_t raw_recv_callback(void *arg, struct tcp_pcb *pcb, struct pbuf *p, 
+  err_t err)
+{
+  raw_connection *conn = (raw_connection *)arg;
+
+  /* The client closed its side, the frames that it sent before are still queued. */
+  if(p == NULL)
   {
-    .WiFi_events_to_handle = ESP_EVENT_ANY_ID,
-    .WiFi_event_handler = WiFi_event_handler,
-    
-    .IP_event_handler = NULL,
-  };
+    conn->closing = true;
+    size_t copied = 0u;
+    const err_t ret = process_raw_frames(conn, &copied);
+    record_ingress(0u, 0u, 0u, copied);
+    return ret;
+  }
 
-  /* Start WiFi in AP and station mode. */
-  if(core_WiFi_LOG(WiFi_init(WIFI_MODE_AP, config, AP_handlers) != CORE_WIFI_OK))
+  if(err != ERR_OK)
   {
-    return CORE_TCP_SERVER_INIT_ERR;
+    pbuf_free(p);
+    return err;
   }
 
-  return CORE_TCP_SERVER_OK;
+  const size_t received = p->tot_len;
+  if(conn->pending == NULL)
+  {
+    conn->pending = p;
+  }
+  else
+  {
+    pbuf_cat(conn->pending, p);
+  }
+
+  size_t copied = 0u;
+  const err_t ret = process_raw_frames(conn, &copied);
+  record_ingress(0u, 0u, received, copied);
+
+  return ret;
 }
 
-TCP_server_return de_init_TCP_server(void)
+static void raw_err_callback(void *arg, err_t err)
 {
-  if(core_WiFi_LOG(de_init_WiFi()) != ESP_OK)
+  raw_connection *conn = (raw_connection *)arg;
+  if(conn == NULL)
   {
-    return CORE_TCP_SERVER_DE_INIT_ERR;
+    return;
   }
-  return CORE_TCP_SERVER_OK;
+
+  notifier_unsubscribe(conn->subscriber);
+  conn->subscriber = NOTIFIER_INVALID_SUBSCRIBER;
+  if(conn->pending != NULL)
+  {
+    pbuf_free(conn->pending);
+    conn->pending = NULL;
+  }
+  conn->pcb = NULL;
 }
 
-inline TCP_server_return core_TCP_server_LOG(const TCP_server_return ret)
+static err_t process_raw_frames(raw_connection *conn, size_t *copied)
 {
-  #if DEBUG_MODE_ENABLE == 1
-    switch(ret)
+  /* Queue all the complete frames, a partial one waits for the rest of its bytes. */
+  while(conn->pending != NULL)
+  {
+    const uint32_t start_cycles = esp_cpu_get_cycle_count();
+    struct pbuf *p = conn->pending;
+    uint16_t frame_size;
+
+    if(pbuf_get_at(p, 0u) == EXT_FRAME_START_BYTE)
     {
-      #define TCP_SERVER_RETURN(enumerate) \
-        case enumerate:                    \
-          if(ret > 0)                      \
-          {                                \
-            ESP_LOGE(TAG, #enumerate);     \
-          }                                \
-          else                             \
-          {                                \
-            ESP_LOGI(TAG, #enumerate);     \
-          }                                \
-          break;       
-        TCP_SERVER_RETURNS
-      #undef TCP_SERVER_RETURN
-      default:
-        ESP_LOGE(TAG, "Unkown return.");
+      Ext_frame_header header;
+      if(p->tot_len < EXT_FRAME_HEADER_SIZE)
+      {
         break;
+      }
+      pbuf_copy_partial(p, &header, EXT_FRAME_HEADER_SIZE, 0u);
+
+      if(header.type >= NUM_OF_EXT_FRAMES || header.len > EXT_FRAME_MAX_PAYLOAD_SIZE)
+      {
+        #if DEBUG_MODE_ENABLE == 1
+          ESP_LOGE(TAG, "Received invalid extended frame.");
+        #endif
+        return close_raw_connection(conn);
+      }
+      frame_size = EXT_FRAME_HEADER_SIZE + header.len;
     }
-  #endif
-  return ret;
+    else
+    {
+      frame_size = TCP_COMMAND_SIZE;
+    }
+    if(p->tot_len < frame_size)
+    {
+      break;
+    }
+
+    /* The frame is copied, the ingress task dispatches it after the pbuf is freed. */
+    pbuf_copy_partial(p, raw_rx_frame.buf, frame_size, 0u);
+    raw_rx_frame.arrival_us = take_arrival_us(conn->IP, conn->port, 
+      conn->consumed + frame_size);
+    raw_rx_frame.IP = conn->IP;
+    raw_rx_frame.conn = (uint8_t)(conn - raw_connections);
+    raw_rx_frame.generation = conn->generation;
+    raw_rx_frame.cycles = esp_cpu_get_cycle_count() - start_cycles;
+    if(!queue_raw_frame(&raw_rx_frame))
+    {
+      return ERR_OK;
+    }
+    *copied += frame_size + ((raw_rx_frame.buf[0] == EXT_FRAME_START_BYTE) ? 
+      EXT_FRAME_HEADER_SIZE : 0u);
+    conn->consumed += frame_size;
+    conn->pending = pbuf_free_header(p, frame_size);
+    tcp_recved(conn->pcb, frame_size);
+
+    /* The legacy clients expect the server to close the connection after the 
+     * command, only the extended frames keep it open.
+     */
+    if(raw_rx_frame.buf[0] != EXT_FRAME_START_BYTE)
+    {
+      return close_raw_connection(conn);
+    }
+  }
+
+  if(conn->closing)
+  {
+    return close_raw_connection(conn);
+  }
+
+  return ERR_OK;
 }
 
-static void server_task_func(void *args)
+static bool queue_raw_frame(const raw_frame *frame)
 {
+  if(xQueueSend(raw_frames, frame, 0u) == pdTRUE)
+  {
+    return true;
+  }
 
-  int conn_fd, listening_sock;
-  struct sockaddr_in addrs_to_listen, source_addr;
-  socklen_t source_addr_len = sizeof(source_addr);
-  TCP_COMMAND_TYPE cmd;
-  char buf[TCP_COMMAND_SIZE] = "";
+  /* The flag is raised before trying again, so a frame taken in between by the 
+   * ingress task is never missed.
+   */
+  __atomic_store_n(&raw_ingress_blocked, true, __ATOMIC_RELEASE);
+  if(xQueueSend(raw_frames, frame, 0u) == pdTRUE)
+  {
+    return true;
+  }
 
-  /** Set which kind of addresses server will listen. **/
-  /* Set IPV4. */
-  addrs_to_listen.sin_family = AF_INET;
-  /* Accept any IP. */
-  addrs_to_listen.sin_addr.s_addr = htonl(INADDR_ANY);
-  /* Set the port defined in Network_config.h */
-  addrs_to_listen.sin_port = htons(TCP_IP_PORT);
+  taskENTER_CRITICAL(&server_stats_lock);
+  ingress_stats.queue_full++;
+  taskEXIT_CRITICAL(&server_stats_lock);
+  return false;
+}
 
-  /* Create listening socket and verify the initialization . */
-  listening_sock = socket(AF_INET, SOCK_STREAM, 0);
-  if(listening_sock < 0) 
-  { 
-    #if DEBUG_MODE_ENABLE == 1
-      ESP_LOGE(TAG, "Unable tto create socket: errno %d", errno);
-    #endif
-    vTaskDelete(NULL);
+static void resume_raw_frames(void *ctx)
+{
+  for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
+  {
+    raw_connection *conn = &raw_connections[i];
+    if(conn->pcb != NULL && conn->pending != NULL)
+    {
+      size_t copied = 0u;
+      process_raw_frames(conn, &copied);
+      record_ingress(0u, 0u, 0u, copied);
+    }
   }
+}
 
-  /* Binding newly created socket to given IP, verification. */
-  if(bind(listening_sock, (struct sockaddr*)&addrs_to_listen, 
-     sizeof(addrs_to_listen)) != 0) 
-  { 
-    #if DEBUG_MODE_ENABLE == 1
-      ESP_LOGE(TAG, "Socket bind failed: errno %d", errno);
-    #endif
-    vTaskDelete(NULL);
-  } 
-
-  /* At this point server is ready to listen, verification. */
-  if(listen(listening_sock, MAX_STA_CONN) != 0) 
-  { 
-    #if DEBUG_MODE_ENABLE == 1
-      ESP_LOGE(TAG, "Listen socket failed: errno %d", errno);
-    #endif
-    vTaskDelete(NULL);
-  } 
+static void send_raw_replies(void *ctx)
+{
+  /* The replies queued from now on need another send. */
+  __atomic_store_n(&raw_reply_pending, false, __ATOMIC_RELEASE);
 
-  while(true)
+  while(xQueueReceive(raw_replies, &raw_tx_reply, 0u) == pdTRUE)
   {
-    bzero((void*)&cmd, sizeof(cmd));
+    raw_connection *conn = &raw_connections[raw_tx_reply.conn];
+    if(conn->pcb == NULL || conn->generation != raw_tx_reply.generation)
+    {
+      continue;
+    }
 
-    /* Accept the data packet from client and verification. */
-    conn_fd = accept(listening_sock, (struct sockaddr*)&source_addr, &source_addr_len); 
-    if(conn_fd < 0) 
-    { 
-      #if DEBUG_MODE_ENABLE == 1
-        ESP_LOGE(TAG, "Accept socket failed: errno %d", errno);
-      #endif
+    /* A subscription is queued as the frame itself, its reply is built here. */
+    Ext_frame_header header;
+    memcpy(&header, raw_tx_reply.buf, EXT_FRAME_HEADER_SIZE);
+    if(header.type == EXT_FRAME_SUBSCRIBE)
+    {
+      raw_tx_reply.buf[EXT_FRAME_HEADER_SIZE] = subscribe_connection(&conn->subscriber, 
+        &raw_tx_reply.buf[EXT_FRAME_HEADER_SIZE], header.len);
+      header.len = 1u;
+      memcpy(raw_tx_reply.buf, &header, EXT_FRAME_HEADER_SIZE);
+      raw_tx_reply.len = EXT_FRAME_HEADER_SIZE + 1u;
     }
 
-    if(read(conn_fd, (void*)buf, TCP_COMMAND_SIZE) < 0)
+    if(!raw_write(conn, raw_tx_reply.buf, raw_tx_reply.len))
     {
-      #if DEBUG_MODE_ENABLE == 1
-        ESP_LOGE(TAG, "Read socket failed: errno %d", errno);
-      #endif
+      close_raw_connection(conn);
     }
+  }
+}
 
-    /* Means GUI want to toggle the LED. */
-    /* TODO: Allow GUI to do more actions. */
-    if(memcmp((void*)buf, "GUI", 3) == 0)
-    {  
-      cmd.ID = LED_0;
-      cmd.action = TOOGLE_LED;
-      RX_command_frame(cmd);
+static void ingress_task_func(void *args)
+{
+  while(true)
+  {
+    xQueueReceive(raw_frames, &ingress_frame, portMAX_DELAY);
+
+    /* There is room in the queue again, the lwIP thread goes on with its frames. */
+    if(__atomic_exchange_n(&raw_ingress_blocked, false, __ATOMIC_ACQ_REL) &&
+       tcpip_callback(resume_raw_frames, NULL) != ERR_OK)
+    {
+      __atomic_store_n(&raw_ingress_blocked, true, __ATOMIC_RELEASE);
+    }
+
+    const uint32_t start_cycles = esp_cpu_get_cycle_count();
+    client_IP = ingress_frame.IP;
+    if(ingress_frame.buf[0] == EXT_FRAME_START_BYTE)
+    {
+      dispatch_raw_ext_frame(&ingress_frame);
     }
     else
     {
-      memcpy((void*)&cmd, (void*)buf, TCP_COMMAND_SIZE);
+      /* The legacy command is an enum based structure, it is copied to align it. */
+      TCP_COMMAND_TYPE cmd;
+      memcpy((void*)&cmd, ingress_frame.buf, TCP_COMMAND_SIZE);
       RX_command_frame(cmd);
+      record_latency(ingress_frame.arrival_us);
+    }
+    record_ingress(ingress_frame.cycles + (esp_cpu_get_cycle_count() - start_cycles), 1u,
+      0u, 0u);
+  }
+}
+
+static void dispatch_raw_ext_frame(const raw_frame *frame)
+{
+  Ext_frame_header header;
+  memcpy(&header, frame->buf, EXT_FRAME_HEADER_SIZE);
+
+  ingress_reply.conn = frame->conn;
+  ingress_reply.generation = frame->generation;
+  if(header.type == EXT_FRAME_SUBSCRIBE)
+  {
+    memcpy(ingress_reply.buf, frame->buf, EXT_FRAME_HEADER_SIZE + header.len);
+    ingress_reply.len = EXT_FRAME_HEADER_SIZE + header.len;
+    record_latency(frame->arrival_us);
+  }
+  else
+  {
+    const uint8_t reply_len = RX_ext_command_frame((Ext_frame_type)header.type, 
+      &frame->buf[EXT_FRAME_HEADER_SIZE], header.len, 
+      &ingress_reply.buf[EXT_FRAME_HEADER_SIZE], EXT_FRAME_MAX_REPLY_SIZE);
+    record_latency(frame->arrival_us);
+    if(reply_len == 0u)
+    {
+      return;
+    }
+
+    const Ext_frame_header reply_header =
+    {
+      .start = EXT_FRAME_START_BYTE,
+      .type = header.type,
+      .len = reply_len,
+    };
+    memcpy(ingress_reply.buf, &reply_header, EXT_FRAME_HEADER_SIZE);
+    ingress_reply.len = EXT_FRAME_HEADER_SIZE + reply_len;
+  }
+
+  /* Only one send is queued at a time in the lwIP thread, it takes all the replies. */
+  xQueueSend(raw_replies, &ingress_reply, portMAX_DELAY);
+  if(!__atomic_exchange_n(&raw_reply_pending, true, __ATOMIC_ACQ_REL) &&
+     tcpip_callback(send_raw_replies, NULL) != ERR_OK)
+  {
+    __atomic_store_n(&raw_reply_pending, false, __ATOMIC_RELEASE);
+  }
+}
+
+static void push_raw_events(void *ctx)
+{
+  /* The events published from now on need another push. */
+  __atomic_store_n(&raw_push_pending, false, __ATOMIC_RELEASE);
+
+  for(uint8_t i = 0u; i < TCP_SERVER_MAX_CONNECTIONS; i++)
+  {
+    raw_connection *conn = &raw_connections[i];
+    if(conn->pcb == NULL || conn->subscriber == NOTIFIER_INVALID_SUBSCRIBER)
+    {
+      continue;
+    }
+
+    const size_t len = build_state_events_frame(conn->subscriber, reply_buf, 
+      sizeof(reply_buf));
+    if(len > 0u && !raw_write(conn, reply_buf, len))
+    {
+      close_raw_connection(conn);
     }
-    shutdown(conn_fd, 0);
-    close(conn_fd);
   }
+}
+
+static bool raw_write(raw_connection *conn, const uint8_t *buf, const size_t len)
+{
+  if(tcp_write(conn->pcb, buf, (uint16_t)len, TCP_WRITE_FLAG_COPY) != ERR_OK)
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Unable to queue the reply.");
+    #endif
+    return false;
+  }
+
+  tcp_output(conn->pcb);
+  return true;
+}
+
+static err_t close_raw_connection(raw_connection *conn)
+{
+  err_t ret = ERR_OK;
+  struct tcp_pcb *pcb = conn->pcb;
+
+  raw_err_callback(conn, ERR_OK);
 
-  close(listening_sock);
-  vTaskDelete(NULL);
+  tcp_arg(pcb, NULL);
+  tcp_recv(pcb, NULL);
+  tcp_err(pcb, NULL);
+  if(tcp_close(pcb) != ERR_OK)
+  {
+    tcp_abort(pcb);
+    ret = ERR_ABRT;
+  }
 
+  return ret;
 }
 
+#endif
+
 static void WiFi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id,
   void* event_data)
 {
@@ -261,23 +2368,43 @@ static void WiFi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
 
     case WIFI_EVENT_AP_START:
     {
-      /* Create the server task. */
-      const BaseType_t ret = xTaskCreate(server_task_func, "server_task", 2048,
-        (void *) 0, configMAX_PRIORITIES-1, &server_task_handler);
-      if(ret != pdPASS)
-      {
-        /* TODO: Implement mechanisim to handle this corner case */
-      }
+      /* The server is down until its socket listens for the first time. */
+      taskENTER_CRITICAL(&server_stats_lock);
+      server_down_us = esp_timer_get_time();
+      server_stats.listening = 0u;
+      taskEXIT_CRITICAL(&server_stats_lock);
+
+      xSemaphoreTake(server_tasks_mutex, portMAX_DELAY);
+      ap_started = true;
+      xSemaphoreGive(server_tasks_mutex);
+      start_server_tasks();
     }
     break;
     case WIFI_EVENT_AP_STOP:
     {
-      /* Delete the server task. */
-      if(server_task_handler != NULL)
-      {
-        vTaskDelete(server_task_handler);
-        server_task_handler = NULL;
-      }
+      /* A pending retry does not start the tasks again once they are deleted. */
+      xSemaphoreTake(server_tasks_mutex, portMAX_DELAY);
+      ap_started = false;
+      esp_timer_stop(start_retry_timer);
+
+      /* The tasks leave their loops, close their sockets and park themselves, so they 
+       * are never deleted holding a lock or inside lwIP.
+       */
+      __atomic_store_n(&server_tasks_stopping, true, __ATOMIC_RELEASE);
+      #if TCP_SERVER_RAW_INGRESS_ENABLE == 0
+        wake_server(NULL);
+        delete_parked_task(&server_task_handler, &server_task_parked);
+      #else
+        tcpip_callback(stop_raw_listener, NULL);
+        raw_start_queued = false;
+      #endif
+      taskENTER_CRITICAL(&server_stats_lock);
+      server_stats.listening = 0u;
+      taskEXIT_CRITICAL(&server_stats_lock);
+
+      /* The fleet task sees the flag within TCP_SERVER_STOP_POLL_MS. */
+      delete_parked_task(&fleet_task_handler, &fleet_task_parked);
+      xSemaphoreGive(server_tasks_mutex);
     }
     break;
     default:
@@ -285,4 +2412,3 @@ static void WiFi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
   }
 }
 
-
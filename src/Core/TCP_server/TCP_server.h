@@ -13,6 +13,7 @@
 /***************************************************************************************
  * Includes
  ***************************************************************************************/
+#include <stddef.h>
 #include <Network_config.h>
 
 /***************************************************************************************
@@ -26,11 +27,209 @@
   /* Error codes */                              \
   TCP_SERVER_RETURN(CORE_TCP_SERVER_INIT_ERR)    \
   TCP_SERVER_RETURN(CORE_TCP_SERVER_DE_INIT_ERR)                          
+
+/* First byte of an extended command frame. Legacy frames start with the LED identifier
+ * (TCP_COMMAND_TYPE), so they never start with this value.
+ */
+#define EXT_FRAME_START_BYTE 0xA5u
+
+/* Maximum size in bytes of the payload of an extended command frame. */
+#define EXT_FRAME_MAX_PAYLOAD_SIZE 64u
+
+/* Maximum size in bytes of the payload of a reply, the length of a frame is one byte. */
+#define EXT_FRAME_MAX_REPLY_SIZE UINT8_MAX
+
+/* Minimum and maximum time in milliseconds that the supervisor waits before opening 
+ * again a listening socket that failed. The wait doubles after every failed attempt
+ * and goes back to the minimum once the socket is listening.
+ */
+#define TCP_SERVER_RESTART_MIN_MS 50u
+#define TCP_SERVER_RESTART_MAX_MS 2000u
+
+/* Time in milliseconds that the listening socket rests after a failed accept, times 
+ * the number of consecutive failures. After TCP_SERVER_ACCEPT_MAX_ERRORS failures in a
+ * row the listening socket is opened again.
+ */
+#define TCP_SERVER_ACCEPT_BACKOFF_MS 10u
+#define TCP_SERVER_ACCEPT_MAX_ERRORS 8u
+
+/* Maximum time in milliseconds that the fleet task waits for a datagram before it 
+ * checks if the access point stopped, so the stop waits at most this for the task.
+ */
+#define TCP_SERVER_STOP_POLL_MS 100u
+
+/* Set to 1 to receive the frames of the server with the raw API of lwIP, set to 0 to 
+ * receive them with the sockets of the server task. The raw ingress parses the frames 
+ * in the received pbufs from the lwIP thread and copies every one of them to a queue, 
+ * the ingress task dispatches them in the lighting core, so the lwIP thread never 
+ * waits for the lamps. The raw-ingress environment of platformio.ini builds it, 
+ * compare EXT_FRAME_GET_INGRESS_STATS of both builds to measure them.
+ */
+#ifndef TCP_SERVER_RAW_INGRESS_ENABLE
+  #define TCP_SERVER_RAW_INGRESS_ENABLE 0
+#endif
+
+/* Number of frames that the raw ingress queues for the ingress task, and number of 
+ * replies that the ingress task queues for the lwIP thread. While the frames queue is 
+ * full the lwIP thread stops reading, so the TCP window throttles the clients.
+ */
+#define TCP_SERVER_INGRESS_QUEUE_SIZE 8u
+#define TCP_SERVER_REPLY_QUEUE_SIZE   2u
+
+/* Weight, as a power of two, of the previous average of the ingress cycles. */
+#define TCP_SERVER_AVG_SHIFT 3u
+
+/* UDP port where the fleet datagrams are received, by broadcast or by multicast. */
+#define FLEET_UDP_PORT 3339u
+
+/* Multicast group of the fleet datagrams. */
+#define FLEET_MULTICAST_IP "239.255.76.1"
+
+/* First field of every fleet datagram, "LFLT". */
+#define FLEET_MAGIC 0x4C464C54ul
+
+/* Maximum number of commands of a fleet datagram. */
+#define FLEET_MAX_COMMANDS 64u
+
+/* Value of FLEET_DEVICE_ID that derives the identifier from the MAC address. */
+#define FLEET_DEVICE_ID_FROM_MAC UINT16_MAX
+
+/* Identifier of this device inside the fleet. By default it is the last two bytes of
+ * the access point MAC address, set a value to give a fixed one.
+ */
+#define FLEET_DEVICE_ID FLEET_DEVICE_ID_FROM_MAC
+
+/* Macro that enlist the extended command frames. It is mandatory to not set values to 
+ * the enumerates. The connections that send extended frames stay open, so they can 
+ * send EXT_FRAME_SUBSCRIBE with a payload of 1 byte, 1 to subscribe to the changes of 
+ * the lamps and 0 to unsubscribe, that replies 1 if it was done. The subscribed 
+ * connections receive EXT_FRAME_STATE_EVENTS frames, whose payload is the number of 
+ * events dropped since the previous one (saturated to 255) followed by the events 
+ * (Notifier_event). EXT_FRAME_SEQ_COMMAND always replies a Lamp_seq_reply, so the 
+ * clients can keep several commands outstanding and retry them without performing 
+ * them twice.
+ */
+#define EXT_FRAMES                      \
+  EXT_FRAME(EXT_FRAME_GROUP_COMMAND)    \
+  EXT_FRAME(EXT_FRAME_GET_PROFILE)      \
+  EXT_FRAME(EXT_FRAME_GET_JOURNAL)      \
+  EXT_FRAME(EXT_FRAME_SCHEDULE)         \
+  EXT_FRAME(EXT_FRAME_CANCEL)           \
+  EXT_FRAME(EXT_FRAME_GET_STREAM_STATS) \
+  EXT_FRAME(EXT_FRAME_GET_DMX_STATS)    \
+  EXT_FRAME(EXT_FRAME_GET_STATE)        \
+  EXT_FRAME(EXT_FRAME_SUBSCRIBE)        \
+  EXT_FRAME(EXT_FRAME_STATE_EVENTS)     \
+  EXT_FRAME(EXT_FRAME_SEQ_COMMAND)      \
+  EXT_FRAME(EXT_FRAME_GET_BUTTON_STATS) \
+  EXT_FRAME(EXT_FRAME_GET_SERVER_STATS) \
+  EXT_FRAME(EXT_FRAME_GET_INGRESS_STATS)
  
 /***************************************************************************************
  * Data Type Definitions
  ***************************************************************************************/
 
+/* Enumerate that enlist the extended command frames. */
+typedef enum
+{
+  #define EXT_FRAME(enumerate) enumerate,
+    EXT_FRAMES
+  #undef EXT_FRAME
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_EXT_FRAMES,
+} Ext_frame_type;
+
+/* Header of an extended command frame, it is followed by "len" bytes of payload. */
+typedef struct __attribute__((packed))
+{
+  /* Always EXT_FRAME_START_BYTE. */
+  uint8_t start;
+  /* Type of the frame, it is mandatory to use a value of Ext_frame_type. */
+  uint8_t type;
+  /* Number of bytes of the payload. */
+  uint8_t len;
+} Ext_frame_header;
+
+/* Header of a fleet datagram, it is followed by "num_of_commands" commands. */
+typedef struct __attribute__((packed))
+{
+  /* Always FLEET_MAGIC. */
+  uint32_t magic;
+  /* Number of commands that follow the header. */
+  uint8_t num_of_commands;
+} Fleet_datagram_header;
+
+/* Command of a fleet datagram, it is applied by the devices inside its range. */
+typedef struct __attribute__((packed))
+{
+  /* First and last device identifiers, both included, that apply the command. */
+  uint16_t first_device;
+  uint16_t last_device;
+  /* Identifier of the LED of the device, it is mandatory to use a value of LED_ID. */
+  uint8_t LED;
+  /* Action to perform, it uses the actions of the legacy frames, TCP_COMMAND_TYPE. */
+  uint8_t action;
+  /* PWM duty cycle in percentage terms, only used by the SET_PWM action. */
+  uint8_t pwm;
+} Fleet_command;
+
+/* Structure that contains the availability statistics of the server, the reply of the
+ * EXT_FRAME_GET_SERVER_STATS frame.
+ */
+typedef struct __attribute__((packed))
+{
+  /* Number of times that the listening socket started to listen. */
+  uint32_t starts;
+  /* Number of times that the listening socket was opened again after failing. */
+  uint32_t restarts;
+  /* Number of attempts to open the listening socket that failed. */
+  uint32_t failed_starts;
+  /* Value of errno of the last failure of the listening socket. */
+  int32_t last_errno;
+  /* Time in milliseconds without listening socket since the access point started. */
+  uint32_t downtime_ms;
+  /* Time in milliseconds of the last and the longest periods without listening 
+   * socket.
+   */
+  uint32_t last_downtime_ms;
+  uint32_t max_downtime_ms;
+  /* 1 if the server is listening, otherwise 0. */
+  uint8_t listening;
+} TCP_server_stats;
+
+/* Structure that contains the cost of receiving the frames, the reply of the 
+ * EXT_FRAME_GET_INGRESS_STATS frame. The cycles are measured from the reception of the
+ * bytes to the end of their dispatch, in the raw ingress they add the ones of the lwIP
+ * thread and the ones of the ingress task. The latency is measured in both builds from
+ * the arrival of the segment at the IP layer of lwIP, it needs 
+ * CONFIG_LWIP_HOOK_IP4_INPUT_CUSTOM.
+ */
+typedef struct __attribute__((packed))
+{
+  /* 1 if the frames are received with the raw API, 0 if with the sockets. */
+  uint8_t raw;
+  /* Number of received frames. */
+  uint32_t commands;
+  /* CPU cycles per frame of the last reception, their average and their maximum. */
+  uint32_t last_cycles;
+  uint32_t avg_cycles;
+  uint32_t max_cycles;
+  /* Number of received bytes. */
+  uint32_t received_bytes;
+  /* Number of received bytes copied before processing them. */
+  uint32_t copied_bytes;
+  /* Number of frames with a known arrival time, and microseconds from the arrival of 
+   * the last byte of a frame to the end of its dispatch: the last one, their average 
+   * and their maximum.
+   */
+  uint32_t latency_samples;
+  uint32_t last_latency_us;
+  uint32_t avg_latency_us;
+  uint32_t max_latency_us;
+  /* Number of times that the raw ingress found its queue full and stopped reading. */
+  uint32_t queue_full;
+} TCP_ingress_stats;
+
 /* Enumerate that lists the posible return codes that the module can return. */
 typedef enum
 {
@@ -74,6 +273,69 @@ TCP_server_return init_TCP_server(void);
  */
 TCP_server_return de_init_TCP_server(void);
 
+/**
+ * @brief Gets the address of the client whose frame is being processed. It is meant to
+ *        be called from the received frames callbacks.
+ *
+ * @param void
+ *
+ * @return IPv4 address of the client in network order.
+ */
+uint32_t get_TCP_client_IP(void);
+
+/**
+ * @brief Sets the address of the client whose frame is going to be processed. It is 
+ *        meant to be called by other servers before calling the received frames 
+ *        callbacks. The address is kept per task.
+ *
+ * @param IP IPv4 address of the client in network order.
+ *
+ * @return void
+ */
+void set_TCP_client_IP(const uint32_t IP);
+
+/**
+ * @brief Builds an EXT_FRAME_STATE_EVENTS frame with the pending events of a 
+ *        subscriber. It is meant to be used by the servers that push the events.
+ *
+ * @param subscriber Identifier of the subscriber.
+ * 
+ * @param frame Buffer where the frame is written.
+ * 
+ * @param size Size in bytes of the buffer.
+ *
+ * @return Number of bytes of the frame, 0 if there was nothing to push.
+ */
+size_t build_state_events_frame(const uint8_t subscriber, uint8_t *frame, 
+  const size_t size);
+
+/**
+ * @brief Gets the availability statistics of the server.
+ *
+ * @param stats Return statistics.
+ *
+ * @return void
+ */
+void get_TCP_server_stats(TCP_server_stats *stats);
+
+/**
+ * @brief Gets the ingress statistics of the server.
+ *
+ * @param stats Return statistics.
+ *
+ * @return void
+ */
+void get_TCP_ingress_stats(TCP_ingress_stats *stats);
+
+/**
+ * @brief Gets the identifier of this device inside the fleet.
+ *
+ * @param void
+ *
+ * @return Identifier of the device.
+ */
+uint16_t get_fleet_device_ID(void);
+
 /**
  * @brief Prints the return of a TCP server module function if the system was configured 
  *        in debug mode.
@@ -94,5 +356,41 @@ TCP_server_return core_TCP_server_LOG(const TCP_server_return ret);
  */
 void __attribute__((weak)) RX_command_frame(const TCP_COMMAND_TYPE cmd); 
 
+/**
+ * @brief Function that will be called if an extended frame is received. This function
+ *        should be implemented in other application module. If it writes a reply, it
+ *        is sent back to the client as an extended frame of the same type.
+ *
+ * @param type Type of the received frame.
+ * 
+ * @param payload Bytes of the frame that follow the header.
+ * 
+ * @param len Number of bytes of the payload.
+ * 
+ * @param reply Buffer where the payload of the reply is written.
+ * 
+ * @param reply_size Size in bytes of the reply buffer.
+ *
+ * @return Number of bytes of the reply, 0 to not reply.
+ */
+uint8_t __attribute__((weak)) RX_ext_command_frame(const Ext_frame_type type, 
+  const uint8_t *payload, const uint8_t len, uint8_t *reply, const uint8_t reply_size);
+
+/**
+ * @brief Function that will be called with the commands of a fleet datagram addressed 
+ *        to this device, all of them in a single call. This function should be 
+ *        implemented in other application module.
+ *
+ * @param cmds Commands addressed to this device, in the order of the datagram.
+ * 
+ * @param num_of_cmds Number of commands.
+ * 
+ * @param client_IP IPv4 address of the sender in network order.
+ *
+ * @return void
+ */
+void __attribute__((weak)) RX_fleet_commands(const Fleet_command *cmds, 
+  const uint8_t num_of_cmds, const uint32_t client_IP);
+
 #endif /* CORE_TCP_SERVER_H_ */
  
\ No newline at end of file
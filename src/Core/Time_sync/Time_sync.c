@@ -0,0 +1,526 @@
+/**
+ * @file      Time_sync.c
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This source file defines the functions to synchronize the clock of the 
+ *            lamps with a master lamp over UDP.
+ */
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <Time_sync.h>
+#include <Debug.h>
+#include <System_memory.h>
+#include <System_tasks.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <esp_timer.h>
+#include "lwip/inet.h"
+#include "lwip/sockets.h"
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+#if DEBUG_MODE_ENABLE == 1
+/* Tag to show traces in time sync module. */
+  #define TAG "CORE_TIME_SYNC"
+#endif
+
+/* First field of every packet of the protocol, "LTSY". */
+#define TIME_SYNC_MAGIC 0x4C545359ul
+
+/* Parts per billion of a whole. */
+#define PPB 1000000000ll
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Packet of the protocol. The slave sends t1 and the master answers with the same 
+ * packet adding t2 and t3.
+ */
+typedef struct __attribute__((packed))
+{
+  /* Always TIME_SYNC_MAGIC. */
+  uint32_t magic;
+  /* Sequence number of the request, the answer repeats it. */
+  uint32_t seq;
+  /* Time in microseconds of the slave clock when the request was sent. */
+  int64_t t1;
+  /* Time in microseconds of the master clock when the request was received. */
+  int64_t t2;
+  /* Time in microseconds of the master clock when the answer was sent. */
+  int64_t t3;
+} time_sync_packet;
+
+/* Structure that contains an exchange of the filter. */
+typedef struct
+{
+  /* Offset in microseconds measured by the exchange. */
+  int64_t offset_us;
+  /* Round trip delay in microseconds of the exchange. */
+  uint32_t delay_us;
+  /* Time in microseconds of the local clock when the exchange ended. */
+  int64_t local_us;
+  /* True if the exchange contains a measurement. */
+  bool valid;
+} time_sync_exchange;
+
+/***************************************************************************************
+ * Global Variables
+ ***************************************************************************************/
+
+/* State of the synchronization. */
+static Time_sync_status sync_status = 
+{
+  .synced = (TIME_SYNC_ROLE == TIME_SYNC_MASTER),
+};
+
+/* Time in microseconds of the local clock when the offset of the state was valid, the
+ * drift is applied from it.
+ */
+static int64_t offset_local_us;
+
+/* Lock that protects the state, the 64 bits offset is not read atomically. */
+static portMUX_TYPE sync_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if TIME_SYNC_ROLE == TIME_SYNC_SLAVE
+/* Last exchanges of the slave. */
+static time_sync_exchange exchanges[TIME_SYNC_FILTER_SIZE];
+
+/* First exchange of the next drift measurement, the last chosen one. */
+static time_sync_exchange drift_anchor;
+
+/* Error in parts per billion of the measured drift, the exchanges age with it. */
+static uint32_t drift_error_ppb = TIME_SYNC_MAX_DRIFT_PPM * 1000u;
+#endif
+
+/* Storage of the synchronization task, there is no heap allocation for it. */
+static StackType_t time_sync_task_stack[SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_TIME_SYNC)];
+static StaticTask_t time_sync_task_buffer;
+
+/* Handler of the synchronization task. */
+static TaskHandle_t time_sync_task_handler;
+
+/* RAM reserved by the RTOS objects of the synchronization. */
+_Static_assert(sizeof(time_sync_task_stack) + sizeof(time_sync_task_buffer) <= 
+  TIME_SYNC_STATIC_RAM_BUDGET, "Time sync RTOS objects go over TIME_SYNC_STATIC_RAM_BUDGET");
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Function that will answer the requests of the slaves or send requests to the 
+ *        master, depending on TIME_SYNC_ROLE.
+ *
+ * @param args arguments to pass to the function.
+ *
+ * @return void
+ */
+static void time_sync_task_func(void *args);
+
+/**
+ * @brief Creates the UDP socket of the protocol.
+ *
+ * @param void
+ *
+ * @return Descriptor of the socket, negative if it could not be created.
+ */
+static int open_time_sync_socket(void);
+
+/**
+ * @brief Gets the offset of the synchronized clock at a time of the local clock, the
+ *        offset of the last exchange slewed with the drift.
+ *
+ * @param local_us Time in microseconds of the local clock.
+ *
+ * @return Offset in microseconds added to the local clock to get the master clock.
+ */
+static int64_t get_offset_us(const int64_t local_us);
+
+#if TIME_SYNC_ROLE == TIME_SYNC_MASTER
+/**
+ * @brief Answers the requests of the slaves with the master clock. It only returns if 
+ *        the socket fails.
+ *
+ * @param sock Descriptor of the socket.
+ *
+ * @return void
+ */
+static void serve_master(const int sock);
+#else
+/**
+ * @brief Sends requests to the master and adjusts the offset with the answers. It only 
+ *        returns if the socket fails.
+ *
+ * @param sock Descriptor of the socket.
+ *
+ * @return void
+ */
+static void follow_master(const int sock);
+
+/**
+ * @brief Adds an exchange to the filter and updates the offset with the exchange of
+ *        the lowest error bound, projected to now with the drift. The drift is measured
+ *        between exchanges chosen at least TIME_SYNC_DRIFT_INTERVAL_MS apart.
+ *
+ * @param offset_us Offset in microseconds measured by the exchange.
+ * 
+ * @param delay_us Round trip delay in microseconds of the exchange.
+ *
+ * @param local_us Time in microseconds of the local clock when the exchange ended.
+ *
+ * @return void
+ */
+static void filter_exchange(const int64_t offset_us, const uint32_t delay_us,
+  const int64_t local_us);
+#endif
+
+/***************************************************************************************
+ * Functions
+ ***************************************************************************************/
+
+Time_sync_return init_time_sync(void)
+{
+  time_sync_task_handler = xTaskCreateStaticPinnedToCore(time_sync_task_func, 
+    SYSTEM_TASK_NAME(SYSTEM_TASK_TIME_SYNC), 
+    SYSTEM_TASK_STACK_SIZE(SYSTEM_TASK_TIME_SYNC), (void *) 0, 
+    SYSTEM_TASK_PRIORITY(SYSTEM_TASK_TIME_SYNC), time_sync_task_stack, 
+    &time_sync_task_buffer, SYSTEM_TASK_CORE(SYSTEM_TASK_TIME_SYNC));
+  if(time_sync_task_handler == NULL)
+  {
+    return CORE_TIME_SYNC_INIT_TASK_ERR;
+  }
+
+  return CORE_TIME_SYNC_OK;
+}
+
+int64_t get_synced_time_us(void)
+{
+  const int64_t now_us = esp_timer_get_time();
+
+  return now_us + get_offset_us(now_us);
+}
+
+bool is_time_synced(void)
+{
+  taskENTER_CRITICAL(&sync_lock);
+  const bool synced = sync_status.synced;
+  taskEXIT_CRITICAL(&sync_lock);
+
+  return synced;
+}
+
+int64_t synced_to_local_time_us(const int64_t synced_us)
+{
+  /* The offset changes a few microseconds per second, so it is taken at the local time
+   * given by the last offset.
+   */
+  taskENTER_CRITICAL(&sync_lock);
+  const int64_t local_us = synced_us - sync_status.offset_us;
+  taskEXIT_CRITICAL(&sync_lock);
+
+  return synced_us - get_offset_us(local_us);
+}
+
+void get_time_sync_status(Time_sync_status *status)
+{
+  taskENTER_CRITICAL(&sync_lock);
+  *status = sync_status;
+  taskEXIT_CRITICAL(&sync_lock);
+}
+
+inline Time_sync_return core_time_sync_LOG(const Time_sync_return ret)
+{
+  #if DEBUG_MODE_ENABLE == 1
+    switch(ret)
+    {
+      #define TIME_SYNC_RETURN(enumerate) \
+        case enumerate:                   \
+          if(ret > 0)                     \
+          {                               \
+            ESP_LOGE(TAG, #enumerate);    \
+          }                               \
+          else                            \
+          {                               \
+            ESP_LOGI(TAG, #enumerate);    \
+          }                               \
+          break;       
+        TIME_SYNC_RETURNS
+      #undef TIME_SYNC_RETURN
+      default:
+        ESP_LOGE(TAG, "Unkown return.");
+        break;
+    }
+  #endif
+  return ret;
+}
+
+static void time_sync_task_func(void *args)
+{
+  while(true)
+  {
+    /* The socket is created again if the network fails. */
+    const int sock = open_time_sync_socket();
+    if(sock >= 0)
+    {
+      #if TIME_SYNC_ROLE == TIME_SYNC_MASTER
+        serve_master(sock);
+      #else
+        follow_master(sock);
+      #endif
+      close(sock);
+    }
+
+    vTaskDelay(pdMS_TO_TICKS(TIME_SYNC_PERIOD_MS));
+  }
+}
+
+static int64_t get_offset_us(const int64_t local_us)
+{
+  taskENTER_CRITICAL(&sync_lock);
+  const int64_t offset_us = sync_status.offset_us + 
+    ((local_us - offset_local_us) * sync_status.drift_ppb) / PPB;
+  taskEXIT_CRITICAL(&sync_lock);
+
+  return offset_us;
+}
+
+static int open_time_sync_socket(void)
+{
+  const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if(sock < 0)
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+    #endif
+    return -1;
+  }
+
+  #if TIME_SYNC_ROLE == TIME_SYNC_MASTER
+    struct sockaddr_in addr =
+    {
+      .sin_family = AF_INET,
+      .sin_addr.s_addr = htonl(INADDR_ANY),
+      .sin_port = htons(TIME_SYNC_PORT),
+    };
+    if(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+      #if DEBUG_MODE_ENABLE == 1
+        ESP_LOGE(TAG, "Socket bind failed: errno %d", errno);
+      #endif
+      close(sock);
+      return -1;
+    }
+  #else
+    const struct timeval timeout =
+    {
+      .tv_sec = TIME_SYNC_TIMEOUT_MS / 1000u,
+      .tv_usec = (TIME_SYNC_TIMEOUT_MS % 1000u) * 1000u,
+    };
+    /* Without the timeout a lost answer would block the slave forever. */
+    if(setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0)
+    {
+      #if DEBUG_MODE_ENABLE == 1
+        ESP_LOGE(TAG, "Socket timeout failed: errno %d", errno);
+      #endif
+      close(sock);
+      return -1;
+    }
+  #endif
+
+  return sock;
+}
+
+#if TIME_SYNC_ROLE == TIME_SYNC_MASTER
+static void serve_master(const int sock)
+{
+  time_sync_packet packet;
+  struct sockaddr_in source_addr;
+
+  while(true)
+  {
+    socklen_t source_addr_len = sizeof(source_addr);
+    const ssize_t received = recvfrom(sock, &packet, sizeof(packet), 0, 
+      (struct sockaddr *)&source_addr, &source_addr_len);
+    const int64_t t2 = esp_timer_get_time();
+
+    if(received < 0)
+    {
+      return;
+    }
+
+    if(received != sizeof(packet) || packet.magic != TIME_SYNC_MAGIC)
+    {
+      continue;
+    }
+
+    /* The answer is sent right after taking t3 to keep it close to the real send. */
+    packet.t2 = t2;
+    packet.t3 = esp_timer_get_time();
+    sendto(sock, &packet, sizeof(packet), 0, (struct sockaddr *)&source_addr, 
+      source_addr_len);
+  }
+}
+
+#else
+static void follow_master(const int sock)
+{
+  struct sockaddr_in master_addr =
+  {
+    .sin_family = AF_INET,
+    .sin_port = htons(TIME_SYNC_PORT),
+  };
+  inet_pton(AF_INET, TIME_SYNC_MASTER_IP, &master_addr.sin_addr);
+
+  uint32_t seq = 0u;
+  TickType_t last_wake = xTaskGetTickCount();
+
+  while(true)
+  {
+    time_sync_packet packet =
+    {
+      .magic = TIME_SYNC_MAGIC,
+      .seq = ++seq,
+      .t1 = esp_timer_get_time(),
+    };
+
+    if(sendto(sock, &packet, sizeof(packet), 0, (struct sockaddr *)&master_addr, 
+       sizeof(master_addr)) < 0)
+    {
+      return;
+    }
+
+    /* Late answers of older requests are discarded by the sequence number. */
+    bool answered = false;
+    while(!answered)
+    {
+      const ssize_t received = recvfrom(sock, &packet, sizeof(packet), 0, NULL, NULL);
+      const int64_t t4 = esp_timer_get_time();
+      if(received < 0)
+      {
+        break;
+      }
+
+      if(received == sizeof(packet) && packet.magic == TIME_SYNC_MAGIC && 
+         packet.seq == seq)
+      {
+        answered = true;
+        const int64_t delay_us = (t4 - packet.t1) - (packet.t3 - packet.t2);
+        const int64_t offset_us = ((packet.t2 - packet.t1) + (packet.t3 - t4)) / 2;
+        if(delay_us >= 0 && delay_us <= TIME_SYNC_MAX_DELAY_US)
+        {
+          filter_exchange(offset_us, (uint32_t)delay_us, t4);
+        }
+        else
+        {
+          answered = false;
+          break;
+        }
+      }
+    }
+
+    if(!answered)
+    {
+      taskENTER_CRITICAL(&sync_lock);
+      sync_status.lost++;
+      taskEXIT_CRITICAL(&sync_lock);
+    }
+
+    vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(TIME_SYNC_PERIOD_MS));
+  }
+}
+
+static void filter_exchange(const int64_t offset_us, const uint32_t delay_us,
+  const int64_t local_us)
+{
+  static uint32_t next_exchange;
+
+  exchanges[next_exchange].offset_us = offset_us;
+  exchanges[next_exchange].delay_us = delay_us;
+  exchanges[next_exchange].local_us = local_us;
+  exchanges[next_exchange].valid = true;
+  next_exchange = (next_exchange + 1u) % TIME_SYNC_FILTER_SIZE;
+
+  taskENTER_CRITICAL(&sync_lock);
+  int64_t drift_ppb = sync_status.drift_ppb;
+  taskEXIT_CRITICAL(&sync_lock);
+
+  /* Every exchange ages with the error of the drift, an old exchange with a low delay 
+   * does not win over a recent one whose offset is closer to the current one.
+   */
+  const time_sync_exchange *best = NULL;
+  uint64_t best_error_us = UINT64_MAX;
+  for(uint32_t i = 0u; i < TIME_SYNC_FILTER_SIZE; i++)
+  {
+    if(!exchanges[i].valid)
+    {
+      continue;
+    }
+
+    const uint64_t age_us = (uint64_t)(local_us - exchanges[i].local_us);
+    const uint64_t error_us = exchanges[i].delay_us / 2u + 
+      (age_us * drift_error_ppb + PPB - 1) / PPB;
+    if(error_us < best_error_us)
+    {
+      best = &exchanges[i];
+      best_error_us = error_us;
+    }
+  }
+
+  /* Measure the drift between chosen exchanges far enough, the error of their offsets
+   * is divided by the time between them.
+   */
+  const int64_t interval_us = best->local_us - drift_anchor.local_us;
+  if(!drift_anchor.valid)
+  {
+    drift_anchor = *best;
+  }
+  else if(interval_us >= (int64_t)TIME_SYNC_DRIFT_INTERVAL_MS * 1000)
+  {
+    const int64_t max_drift_ppb = (int64_t)TIME_SYNC_MAX_DRIFT_PPM * 1000;
+    int64_t measured_ppb = ((best->offset_us - drift_anchor.offset_us) * PPB) / 
+      interval_us;
+    const uint64_t error_ppb = 
+      (((uint64_t)best->delay_us + drift_anchor.delay_us) / 2u * PPB) / 
+        (uint64_t)interval_us;
+    measured_ppb = (measured_ppb > max_drift_ppb) ? max_drift_ppb : 
+      ((measured_ppb < -max_drift_ppb) ? -max_drift_ppb : measured_ppb);
+
+    /* The first measurement is taken as it is, the next ones are averaged. */
+    if(drift_error_ppb >= TIME_SYNC_MAX_DRIFT_PPM * 1000u)
+    {
+      drift_ppb = measured_ppb;
+      drift_error_ppb = (uint32_t)((error_ppb < drift_error_ppb) ? error_ppb : 
+        drift_error_ppb);
+    }
+    else
+    {
+      drift_ppb += (measured_ppb - drift_ppb) / 4;
+      drift_error_ppb = (uint32_t)(((uint64_t)drift_error_ppb * 3u + 
+        ((error_ppb < drift_error_ppb) ? error_ppb : drift_error_ppb)) / 4u);
+    }
+    drift_anchor = *best;
+  }
+
+  /* The offset of the chosen exchange is slewed until now. */
+  const int64_t offset_now_us = best->offset_us + 
+    ((local_us - best->local_us) * drift_ppb) / PPB;
+
+  taskENTER_CRITICAL(&sync_lock);
+  sync_status.synced = true;
+  sync_status.offset_us = offset_now_us;
+  offset_local_us = local_us;
+  sync_status.drift_ppb = (int32_t)drift_ppb;
+  sync_status.delay_us = best->delay_us;
+  sync_status.error_us = (best_error_us > UINT32_MAX) ? UINT32_MAX : 
+    (uint32_t)best_error_us;
+  sync_status.exchanges++;
+  taskEXIT_CRITICAL(&sync_lock);
+}
+#endif
@@ -0,0 +1,179 @@
+/**
+ * @file      Time_sync.h
+ * @authors   Álvaro Velasco García
+ * @date      October 18, 2026
+ *
+ * @brief     This header file declares the functions to synchronize the clock of the 
+ *            lamps with a master lamp over UDP.
+ */
+
+#ifndef CORE_TIME_SYNC_H_
+#define CORE_TIME_SYNC_H_
+
+/***************************************************************************************
+ * Includes
+ ***************************************************************************************/
+#include <stdint.h>
+#include <stdbool.h>
+
+/***************************************************************************************
+ * Defines
+ ***************************************************************************************/
+
+/* Roles of a lamp in the synchronization. The master answers the requests with its own
+ * clock and the slaves adjust an offset to follow it.
+ */
+#define TIME_SYNC_MASTER 0
+#define TIME_SYNC_SLAVE  1
+
+/* Role of this lamp. */
+#define TIME_SYNC_ROLE TIME_SYNC_MASTER
+
+/* IPv4 address of the master lamp, only used by the slaves. */
+#define TIME_SYNC_MASTER_IP "192.168.4.1"
+
+/* UDP port of the synchronization protocol. */
+#define TIME_SYNC_PORT 3338u
+
+/* Period in milliseconds between two requests of a slave. */
+#define TIME_SYNC_PERIOD_MS 1000u
+
+/* Time in milliseconds that a slave waits for the answer of a request. */
+#define TIME_SYNC_TIMEOUT_MS 200u
+
+/* Number of exchanges of the filter. The offset is taken from the exchange with the 
+ * lowest error bound: half of its round trip delay, the part least disturbed by the
+ * network queues, plus what the clocks can have drifted since it was measured.
+ */
+#define TIME_SYNC_FILTER_SIZE 8u
+
+/* Maximum drift in parts per million between the clocks of two lamps. It ages the 
+ * exchanges until the drift is measured and it bounds the measured drift.
+ */
+#define TIME_SYNC_MAX_DRIFT_PPM 100u
+
+/* Minimum time in milliseconds between the two exchanges of a drift measurement, the
+ * longer it is the less the error of the offsets weights in the measured drift.
+ */
+#define TIME_SYNC_DRIFT_INTERVAL_MS 16000u
+
+/* Exchanges with a round trip delay in microseconds above this value are discarded. */
+#define TIME_SYNC_MAX_DELAY_US 50000u
+
+#if TIME_SYNC_ROLE != TIME_SYNC_MASTER && TIME_SYNC_ROLE != TIME_SYNC_SLAVE
+  #error "Invalid synchronization role:"
+  #error "refer to (TIME_SYNC_ROLE)"
+#endif
+
+/* List of the possible return codes that module time sync can return. */
+#define TIME_SYNC_RETURNS                        \
+  /* Info codes */                               \
+  TIME_SYNC_RETURN(CORE_TIME_SYNC_OK)            \
+  /* Error codes */                              \
+  TIME_SYNC_RETURN(CORE_TIME_SYNC_INIT_TASK_ERR)
+
+/***************************************************************************************
+ * Data Type Definitions
+ ***************************************************************************************/
+
+/* Structure that contains the state of the synchronization. */
+typedef struct
+{
+  /* True if the clock follows the master, always true in the master. */
+  bool synced;
+  /* Offset in microseconds added to the local clock to get the master clock. */
+  int64_t offset_us;
+  /* Round trip delay in microseconds of the exchange used for the offset. */
+  uint32_t delay_us;
+  /* Maximum error in microseconds of the offset when it was updated, half of the round
+   * trip delay plus the drift since the exchange.
+   */
+  uint32_t error_us;
+  /* Drift in parts per billion of the master clock against the local one. The
+   * synchronized clock slews with it between the exchanges.
+   */
+  int32_t drift_ppb;
+  /* Number of valid exchanges. */
+  uint32_t exchanges;
+  /* Number of requests without a valid answer. */
+  uint32_t lost;
+} Time_sync_status;
+
+/* Enumerate that lists the posible return codes that the module can return. */
+typedef enum
+{
+  #define TIME_SYNC_RETURN(enumerate) enumerate,
+    TIME_SYNC_RETURNS
+  #undef TIME_SYNC_RETURN
+  /* Last enumerate always, indicates the number of elements. Do not delete */
+  NUM_OF_TIME_SYNC_RETURNS,
+} Time_sync_return;
+
+/***************************************************************************************
+ * Functions Prototypes
+ ***************************************************************************************/
+
+/**
+ * @brief Starts the synchronization task with the role TIME_SYNC_ROLE. It is mandatory
+ *        to start the network before.
+ *
+ * @param void
+ *
+ * @return CORE_TIME_SYNC_OK if the operation went well,
+ *         otherwise:
+ * 
+ *           - CORE_TIME_SYNC_INIT_TASK_ERR: 
+ *               Error trying to create the synchronization task.
+ *                                      
+ */
+Time_sync_return init_time_sync(void);
+
+/**
+ * @brief Gets the time of the synchronized clock, the clock of the master.
+ *
+ * @param void
+ *
+ * @return Time in microseconds of the synchronized clock.
+ */
+int64_t get_synced_time_us(void);
+
+/**
+ * @brief Checks if the clock follows the master. A slave is not synchronized until its
+ *        first valid exchange, the master always is.
+ *
+ * @param void
+ *
+ * @return True if the synchronized clock is valid, otherwise false.
+ */
+bool is_time_synced(void);
+
+/**
+ * @brief Converts a time of the synchronized clock to the local clock, the clock of
+ *        esp_timer_get_time.
+ *
+ * @param synced_us Time in microseconds of the synchronized clock.
+ *
+ * @return Time in microseconds of the local clock.
+ */
+int64_t synced_to_local_time_us(const int64_t synced_us);
+
+/**
+ * @brief Gets the state of the synchronization.
+ *
+ * @param status Return state.
+ *
+ * @return void
+ */
+void get_time_sync_status(Time_sync_status *status);
+
+/**
+ * @brief Prints the return of a time sync module function if the system was configured
+ *        in debug mode.
+ *
+ * @param ret Received return from a time sync module function.
+ *
+ * @return The given return.
+ */
+Time_sync_return core_time_sync_LOG(const Time_sync_return ret);
+
+#endif /* CORE_TIME_SYNC_H_ */
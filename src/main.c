@@ -10,6 +10,7 @@
  * Includes
  ***************************************************************************************/
 #include <Lamp.h>
+#include <Hardware_map.h>
 #include <Debug.h>
 
 /***************************************************************************************
@@ -20,6 +21,18 @@ void app_main()
 {
 
   bool error = false;
+  Button_ID lamp_button;
+  LED_ID lamp_LED;
+
+  /* The map of the installation replaces the compiled connections before the BSP 
+   * modules use them. Without a valid map the compiled ones are kept.
+   */
+  if(core_hardware_map_LOG(init_hardware_map()) != CORE_HARDWARE_MAP_OK)
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGW("MAIN", "Using the compiled hardware map.");
+    #endif
+  }
 
   /** Initialize BSP modules **/
   if(BPS_button_LOG(init_BSP_button_module()) != BSP_BUTTON_OK)
@@ -38,10 +51,27 @@ void app_main()
     #endif
   }
 
+  if(!error && core_scheduler_LOG(init_scheduler()) != CORE_SCHEDULER_OK)
+  {
+    error = true;
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE("MAIN", "Can not initialize the scheduler.");
+    #endif
+  }
+
+  /* The profiler only observes the system, the lamp works without it. */
+  if(!error && core_profiler_LOG(init_profiler()) != CORE_PROFILER_OK)
+  {
+    #if DEBUG_MODE_ENABLE == 1
+      ESP_LOGE("MAIN", "Can not initialize the profiler.");
+    #endif
+  }
+
   if(!error)
   {
   
-    if(core_lamp_LOG(Lamp_init(LAMP_0, BUTTON_0, LED_0) == CORE_LAMP_OK))
+    get_hardware_map_lamp(LAMP_0, &lamp_button, &lamp_LED);
+    if(core_lamp_LOG(Lamp_init(LAMP_0, lamp_button, lamp_LED) == CORE_LAMP_OK))
     {
 
       if(core_lamp_LOG(lamp_start_server()) != CORE_LAMP_OK)
@@ -50,6 +80,30 @@ void app_main()
           ESP_LOGE("MAIN", "Failed to initialize server LAMP.");
         #endif
       }
+      else if(core_time_sync_LOG(init_time_sync()) != CORE_TIME_SYNC_OK)
+      {
+        #if DEBUG_MODE_ENABLE == 1
+          ESP_LOGE("MAIN", "Failed to initialize the clock synchronization.");
+        #endif
+      }
+      else if(core_stream_LOG(init_stream()) != CORE_STREAM_OK)
+      {
+        #if DEBUG_MODE_ENABLE == 1
+          ESP_LOGE("MAIN", "Failed to initialize the stream.");
+        #endif
+      }
+      else if(core_dmx_LOG(init_dmx()) != CORE_DMX_OK)
+      {
+        #if DEBUG_MODE_ENABLE == 1
+          ESP_LOGE("MAIN", "Failed to initialize the DMX receiver.");
+        #endif
+      }
+      else if(core_GUI_server_LOG(init_GUI_server()) != CORE_GUI_SERVER_OK)
+      {
+        #if DEBUG_MODE_ENABLE == 1
+          ESP_LOGE("MAIN", "Failed to initialize the GUI server.");
+        #endif
+      }
       
     }
     else
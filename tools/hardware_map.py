@@ -0,0 +1,271 @@
+#!/usr/bin/env python3
+#
+# @file      hardware_map.py
+# @authors   Álvaro Velasco García
+# @date      October 18, 2026
+#
+# @brief     Host tool that builds and checks the hardware map of an installation, the
+#            blob of the hw_map partition (src/Core/Hardware_map/Hardware_map.h).
+#
+# Usage:
+#
+#   hardware_map.py build <map.csv> <map.bin>   Builds the blob of a description.
+#   hardware_map.py check <map.bin>             Checks a blob and prints its records.
+#
+# Every line of the description is a record, the fields are the parameters of the
+# compiled macros with the numeric values of the ESP-IDF enumerates:
+#
+#   led,    ID, GPIO, pull_mode, timer, speed_mode, channel, resolution, freq_hz, clock
+#   button, ID, GPIO, pull_mode, intr_type, debounce_ms
+#   lamp,   ID, button, LED
+#
+# Empty lines and lines that start with # are ignored. The blob is checked like the
+# firmware checks it, against the compiled connections of src and the ranges of the
+# ESP32 of platformio.ini: the ranges and the PWM of the records, the identifiers, the
+# buttons, which must be the compiled ones, and the channels and timers of the LEDs.
+# Flash the blob with:
+#
+#   parttool.py write_partition --partition-name hw_map --input map.bin
+
+import os
+import re
+import struct
+import sys
+import zlib
+
+# Format of the map, it must match Hardware_map.h.
+MAGIC = 0x4C48574D
+VERSION = 1
+HEADER = struct.Struct("<IBHI")
+RECORD_SIZE = 2 + 11
+
+# Kind, format and field names of every record, in the order of HARDWARE_MAP_RECORDS.
+RECORDS = {
+  "led":    (0, "<BBBBBBBI", ("GPIO", "pull_mode", "timer", "speed_mode", "channel",
+                              "resolution", "clock", "freq_hz")),
+  "button": (1, "<BBBH",     ("GPIO", "pull_mode", "intr_type", "debounce_ms")),
+  "lamp":   (2, "<BB",       ("button", "LED")),
+}
+
+# Size of the partition in partitions.csv.
+PARTITION_SIZE = 0x1000
+
+# Sources of the compiled connections.
+SOURCES = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir, "src")
+HEADERS = (os.path.join("Core", "System_config", "System_lights.h"),
+           os.path.join("Core", "Lamp", "Lamp.h"),
+           os.path.join("BSP", "BSP_physical_connection", "LED_physical_connection.h"),
+           os.path.join("BSP", "BSP_physical_connection", "Button_physical_connection.h"))
+
+# Ranges of the ESP32, the ESP-IDF checks of Hardware_map.c and LED.c.
+INVALID_GPIOS = (24, 28, 29, 30, 31)
+GPIO_NUM_MAX = 40
+FIRST_INPUT_ONLY_GPIO = 34
+GPIO_FLOATING = 3
+LEDC_TIMER_MAX = 4
+LEDC_SPEED_MODE_MAX = 2
+LEDC_CHANNEL_MAX = 8
+LEDC_TIMER_MAX_RESOLUTION = 20
+LEDC_TIMER_MAX_DIVIDER = 1023
+LED_PWM_MIN_FREQUENCY_HZ = 1000
+
+# Frequency in Hertz of the clock sources, by value of ledc_clk_cfg_t of the ESP32
+# (soc_module_clk_t of ESP-IDF 5). LEDC_AUTO_CLK is solved with the APB clock.
+CLOCKS = {0: 80000000, 4: 80000000, 9: 8000000, 12: 1000000}
+
+# Values of the ESP-IDF enumerates used by the compiled connections.
+ENUMERATES = {
+  "GPIO_PULLUP_ONLY": 0, "GPIO_PULLDOWN_ONLY": 1, "GPIO_PULLUP_PULLDOWN": 2,
+  "GPIO_FLOATING": 3, "GPIO_INTR_DISABLE": 0, "GPIO_INTR_POSEDGE": 1,
+  "GPIO_INTR_NEGEDGE": 2, "GPIO_INTR_ANYEDGE": 3, "GPIO_INTR_LOW_LEVEL": 4,
+  "GPIO_INTR_HIGH_LEVEL": 5, "LEDC_HIGH_SPEED_MODE": 0, "LEDC_LOW_SPEED_MODE": 1,
+  "LED_PWM_RESOLUTION_AUTO": 0, "LED_PWM_FREQUENCY_AUTO": 0, "LEDC_AUTO_CLK": 0,
+  "LEDC_USE_APB_CLK": 4, "LEDC_USE_RC_FAST_CLK": 9, "LEDC_USE_REF_TICK": 12,
+}
+ENUMERATE_PATTERNS = (r"GPIO_NUM_(\d+)", r"LEDC_TIMER_(\d+)_BIT", r"LEDC_TIMER_(\d+)",
+  r"LEDC_CHANNEL_(\d+)", r"(\d+)u?l?")
+
+
+def pack_record(kind, ID, values):
+  code, fmt, names = RECORDS[kind]
+  if len(values) != len(names):
+    raise ValueError("%s needs %d fields: %s" % (kind, len(names), ", ".join(names)))
+  if kind == "led":
+    # The frequency is the last field of the record but the last but one of the line.
+    values = values[:6] + [values[7], values[6]]
+  body = struct.pack(fmt, *values)
+  return struct.pack("<BB", code, ID) + body.ljust(RECORD_SIZE - 2, b"\0")
+
+
+def value_of(name):
+  if name in ENUMERATES:
+    return ENUMERATES[name]
+  for pattern in ENUMERATE_PATTERNS:
+    match = re.fullmatch(pattern, name)
+    if match:
+      return int(match.group(1))
+  raise ValueError("unknown value %s of the compiled connections" % name)
+
+
+def compiled_connections():
+  # Returns the identifiers of the LEDs, the buttons and the lamps, and the compiled
+  # connections of the LEDs and the buttons.
+  text = ""
+  for header in HEADERS:
+    with open(os.path.join(SOURCES, header)) as source:
+      text += source.read().replace("\\\n", " ")
+
+  def calls(macro):
+    return [[field.strip() for field in fields.split(",")]
+            for fields in re.findall(r"\b%s\(([^()]*)\)" % macro, text)
+            if "," in fields or macro in ("LED", "BUTTON", "LAMP")]
+
+  IDs = {kind: {name: ID for ID, name in enumerate(
+                  fields[0] for fields in calls(macro) if fields[0] != "enumerate")}
+         for kind, macro in (("led", "LED"), ("button", "BUTTON"), ("lamp", "LAMP"))}
+  LEDs = {IDs["led"][fields[0]]: [value_of(field) for field in fields[1:]]
+          for fields in calls("LED_CONFIG") if fields[0] in IDs["led"]}
+  buttons = {IDs["button"][fields[0]]: [value_of(field) for field in fields[1:]]
+             for fields in calls("BUTTON_CONFIG") if fields[0] in IDs["button"]}
+  return IDs, LEDs, buttons
+
+
+def valid_gpio(GPIO, output):
+  return (GPIO < GPIO_NUM_MAX and GPIO not in INVALID_GPIOS and
+          (not output or GPIO < FIRST_INPUT_ONLY_GPIO))
+
+
+def solve_pwm(clock, freq_hz, resolution):
+  # Returns the frequency and the resolution of a PWM like solve_pwm_config of LED.c, or
+  # None if the PWM can not be generated.
+  if clock not in CLOCKS or (freq_hz == 0 and resolution == 0):
+    return None
+  clock_hz = CLOCKS[clock]
+  if resolution == 0:
+    if freq_hz > clock_hz:
+      return None
+    resolution = min((clock_hz // freq_hz).bit_length() - 1, LEDC_TIMER_MAX_RESOLUTION)
+  elif freq_hz == 0:
+    if resolution > LEDC_TIMER_MAX_RESOLUTION:
+      return None
+    freq_hz = clock_hz >> resolution
+  if (resolution == 0 or resolution > LEDC_TIMER_MAX_RESOLUTION or
+      freq_hz < LED_PWM_MIN_FREQUENCY_HZ):
+    return None
+  divider = (clock_hz << 8) // (freq_hz << resolution)
+  if divider < (1 << 8) or divider > (LEDC_TIMER_MAX_DIVIDER << 8):
+    return None
+  return freq_hz, resolution
+
+
+def check_record(kind, ID, record, IDs, buttons):
+  # Returns the error of a record or None, the same checks as check_record of
+  # Hardware_map.c.
+  if ID >= len(IDs[kind]):
+    return "unknown %s %d" % (kind, ID)
+  if kind == "led":
+    if not valid_gpio(record["GPIO"], True):
+      return "GPIO %d is not an output" % record["GPIO"]
+    if (record["pull_mode"] > GPIO_FLOATING or record["timer"] >= LEDC_TIMER_MAX or
+        record["speed_mode"] >= LEDC_SPEED_MODE_MAX or
+        record["channel"] >= LEDC_CHANNEL_MAX or
+        record["resolution"] > LEDC_TIMER_MAX_RESOLUTION):
+      return "pull mode, timer, speed mode, channel or resolution out of range"
+    if solve_pwm(record["clock"], record["freq_hz"], record["resolution"]) is None:
+      return "the clock source can not generate the PWM"
+  elif kind == "button":
+    if [record[field] for field in RECORDS["button"][2]] != buttons[ID]:
+      return ("the GPIO, pull mode, interruption mode and debounce must be the "
+              "compiled ones (%d, %d, %d, %d)" % tuple(buttons[ID]))
+  elif record["button"] >= len(IDs["button"]) or record["LED"] >= len(IDs["led"]):
+    return "unknown button or LED"
+  return None
+
+
+def check_LEDs(LEDs):
+  # Returns the error of the resulting LEDs or None, the same checks as check_LEDs_map
+  # of Hardware_map.c.
+  pwms = {}
+  for ID, (GPIO, pull_mode, timer, speed_mode, channel, resolution, freq_hz,
+           clock) in sorted(LEDs.items()):
+    pwm = (clock,) + (solve_pwm(clock, freq_hz, resolution) or (None, None))
+    for other, (other_pwm, other_timer, other_channel) in pwms.items():
+      if other_channel == (speed_mode, channel):
+        return "LEDs %d and %d share the channel %d" % (other, ID, channel)
+      if other_timer == (speed_mode, timer) and other_pwm != pwm:
+        return "LEDs %d and %d share the timer %d with other PWM" % (other, ID, timer)
+    pwms[ID] = (pwm, (speed_mode, timer), (speed_mode, channel))
+  return None
+
+
+def build(csv_path, bin_path):
+  records = b""
+  num_of_records = 0
+  with open(csv_path) as description:
+    for number, line in enumerate(description, 1):
+      line = line.split("#", 1)[0].strip()
+      if not line:
+        continue
+      fields = [field.strip() for field in line.split(",")]
+      try:
+        if fields[0] not in RECORDS:
+          raise ValueError("unknown record %s" % fields[0])
+        records += pack_record(fields[0], int(fields[1], 0),
+                               [int(field, 0) for field in fields[2:]])
+      except (ValueError, IndexError, struct.error) as error:
+        sys.exit("%s:%d: %s" % (csv_path, number, error))
+      num_of_records += 1
+
+  blob = HEADER.pack(MAGIC, VERSION, num_of_records, zlib.crc32(records)) + records
+  if len(blob) > PARTITION_SIZE:
+    sys.exit("The map does not fit in the partition (%d bytes)." % len(blob))
+  with open(bin_path, "wb") as output:
+    output.write(blob)
+  check(bin_path)
+
+
+def check(bin_path):
+  with open(bin_path, "rb") as blob_file:
+    blob = blob_file.read()
+
+  if len(blob) < HEADER.size:
+    sys.exit("The map is shorter than its header.")
+  magic, version, num_of_records, crc = HEADER.unpack_from(blob)
+  records = blob[HEADER.size:HEADER.size + num_of_records * RECORD_SIZE]
+  if magic != MAGIC or version != VERSION:
+    sys.exit("Unknown magic or version.")
+  if len(records) != num_of_records * RECORD_SIZE:
+    sys.exit("The map is shorter than its records.")
+  if zlib.crc32(records) != crc:
+    sys.exit("Invalid CRC.")
+
+  IDs, LEDs, buttons = compiled_connections()
+  names = {code: kind for kind, (code, _, _) in RECORDS.items()}
+  for offset in range(0, len(records), RECORD_SIZE):
+    code, ID = struct.unpack_from("<BB", records, offset)
+    if code not in names:
+      sys.exit("Record %d has an unknown kind." % (offset // RECORD_SIZE))
+    _, fmt, fields = RECORDS[names[code]]
+    values = struct.unpack_from(fmt, records, offset + 2)
+    print("%-6s %3d  %s" % (names[code], ID,
+          "  ".join("%s=%d" % field for field in zip(fields, values))))
+    error = check_record(names[code], ID, dict(zip(fields, values)), IDs, buttons)
+    if error:
+      sys.exit("Record %d is invalid: %s." % (offset // RECORD_SIZE, error))
+    if names[code] == "led":
+      # The frequency is the last field of the record but the last but one of a LED.
+      LEDs[ID] = list(values[:6]) + [values[7], values[6]]
+
+  error = check_LEDs(LEDs)
+  if error:
+    sys.exit("Invalid LEDs: %s." % error)
+  print("%d records, %d bytes." % (num_of_records, len(blob)))
+
+
+if __name__ == "__main__":
+  if len(sys.argv) == 4 and sys.argv[1] == "build":
+    build(sys.argv[2], sys.argv[3])
+  elif len(sys.argv) == 3 and sys.argv[1] == "check":
+    check(sys.argv[2])
+  else:
+    sys.exit("usage: hardware_map.py build <map.csv> <map.bin> | check <map.bin>")
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+#
+# @file      ingress_bench.py
+# @authors   Álvaro Velasco García
+# @date      October 18, 2026
+#
+# @brief     Host tool that measures the ingress of the TCP server of a lamp
+#            (src/Core/TCP_server). It sends a burst of EXT_FRAME_GET_STATE frames with
+#            several of them outstanding and reports the round trip seen by the host
+#            and the EXT_FRAME_GET_INGRESS_STATS of the lamp for the burst.
+#
+# Usage:
+#
+#   ingress_bench.py <host> <port> [<frames>] [<window>]
+#       2000 frames with 4 outstanding by default.
+#
+# Run it once against the default build and once against the raw-ingress environment
+# of platformio.ini, with the same load on the lamp, to compare the sockets and the raw
+# ingress. The latency of the lamp is measured from the arrival of the segments at the
+# IP layer, it is 0 samples when the firmware is built without
+# CONFIG_LWIP_HOOK_IP4_INPUT_CUSTOM.
+
+import collections
+import socket
+import struct
+import sys
+import time
+
+# Format of the frames, it must match TCP_server.h and Lamp.h.
+EXT_FRAME_START_BYTE = 0xA5
+EXT_FRAME_HEADER = struct.Struct("<BBB")
+EXT_FRAME_GET_STATE = 7
+EXT_FRAME_STATE_EVENTS = 9
+EXT_FRAME_GET_INGRESS_STATS = 13
+INGRESS_STATS = struct.Struct("<B11I")
+INGRESS_FIELDS = ("raw", "commands", "last_cycles", "avg_cycles", "max_cycles",
+                  "received_bytes", "copied_bytes", "latency_samples", "last_latency_us",
+                  "avg_latency_us", "max_latency_us", "queue_full")
+
+
+def receive_exactly(sock, size):
+  data = b""
+  while len(data) < size:
+    chunk = sock.recv(size - len(data))
+    if not chunk:
+      raise ConnectionError("The lamp closed the connection.")
+    data += chunk
+  return data
+
+
+def receive_reply(sock):
+  # Returns the type and the payload of the next reply, the state events are skipped.
+  while True:
+    start, reply_type, length = EXT_FRAME_HEADER.unpack(
+      receive_exactly(sock, EXT_FRAME_HEADER.size))
+    reply = receive_exactly(sock, length)
+    if start != EXT_FRAME_START_BYTE:
+      raise ConnectionError("Invalid reply.")
+    if reply_type != EXT_FRAME_STATE_EVENTS:
+      return reply_type, reply
+
+
+def frame(frame_type):
+  return EXT_FRAME_HEADER.pack(EXT_FRAME_START_BYTE, frame_type, 0)
+
+
+def ingress_stats(sock):
+  sock.sendall(frame(EXT_FRAME_GET_INGRESS_STATS))
+  reply_type, reply = receive_reply(sock)
+  if reply_type != EXT_FRAME_GET_INGRESS_STATS or len(reply) < INGRESS_STATS.size:
+    raise ConnectionError("Invalid ingress statistics, check the firmware version.")
+  return dict(zip(INGRESS_FIELDS, INGRESS_STATS.unpack(reply[:INGRESS_STATS.size])))
+
+
+def percentiles(values):
+  values = sorted(values)
+  return "p50 %7.0f  p99 %7.0f  max %7.0f" % (
+    values[len(values) // 2], values[max(0, (len(values) * 99) // 100 - 1)], values[-1])
+
+
+def main(host, port, frames, window):
+  sock = socket.create_connection((host, port))
+  sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+  before = ingress_stats(sock)
+
+  # The frames are sent while fewer than the window are outstanding, the replies come
+  # back in order.
+  sent_at = collections.deque()
+  round_trips = []
+  start = time.perf_counter()
+  while len(round_trips) < frames:
+    while len(sent_at) < window and len(round_trips) + len(sent_at) < frames:
+      sent_at.append(time.perf_counter())
+      sock.sendall(frame(EXT_FRAME_GET_STATE))
+    reply_type, _ = receive_reply(sock)
+    if reply_type != EXT_FRAME_GET_STATE:
+      raise ConnectionError("Unexpected reply %d." % reply_type)
+    round_trips.append((time.perf_counter() - sent_at.popleft()) * 1e6)
+  elapsed = time.perf_counter() - start
+
+  after = ingress_stats(sock)
+  sock.close()
+
+  # The frames of the lamp include the first read of the statistics, the second one is
+  # counted after its reply.
+  commands = after["commands"] - before["commands"] - 1
+  samples = after["latency_samples"] - before["latency_samples"]
+  print("%s ingress, %d frames, %d outstanding, %.0f frames/s." %
+        ("raw" if after["raw"] else "sockets", frames, window, frames / elapsed))
+  print("host round trip (us)  %s" % percentiles(round_trips))
+  print("lamp cycles/frame     avg %7d  max %7d" % (after["avg_cycles"],
+                                                    after["max_cycles"]))
+  print("lamp latency (us)     avg %7d  max %7d  samples %d" %
+        (after["avg_latency_us"], after["max_latency_us"], samples))
+  print("lamp frames %d  received %d B  copied %d B  queue full %d" %
+        (commands, after["received_bytes"] - before["received_bytes"],
+         after["copied_bytes"] - before["copied_bytes"],
+         after["queue_full"] - before["queue_full"]))
+  return 0
+
+
+if __name__ == "__main__":
+  try:
+    if not 3 <= len(sys.argv) <= 5:
+      raise ValueError
+    args = [int(arg) for arg in sys.argv[2:]]
+    args += [2000, 4][len(args) - 1:]
+    if args[1] < 1 or args[2] < 1:
+      raise ValueError
+    sys.exit(main(sys.argv[1], *args))
+  except ValueError:
+    sys.exit("usage: ingress_bench.py <host> <port> [<frames>] [<window>]")
@@ -0,0 +1,292 @@
+#!/usr/bin/env python3
+#
+# @file      journal_replay.py
+# @authors   Álvaro Velasco García
+# @date      October 18, 2026
+#
+# @brief     Host tool that dumps the command journal of a lamp (EXT_FRAME_GET_JOURNAL,
+#            src/Core/Journal/Journal.h) and replays it against a lamp, at the original
+#            speed or accelerated, measuring the processing time of every command.
+#
+# Usage:
+#
+#   journal_replay.py dump <host> <port> <journal.bin>   Saves the journal of a lamp.
+#   journal_replay.py show <journal.bin>                 Prints a saved journal.
+#   journal_replay.py replay <journal.bin> <host> <port> [<speed>]
+#       Replays the network commands of a saved journal. The speed multiplies the
+#       original pace, 1 by default, 0 sends every command as soon as the previous one
+#       is done, see below.
+#
+# Every command is replayed with the frame that brought it, so it runs the same code of
+# the lamp: the legacy commands as legacy frames, each one on a new connection because
+# the lamp closes it after the command, the group commands as EXT_FRAME_GROUP_COMMAND,
+# the sequenced ones as EXT_FRAME_SEQ_COMMAND and the fleet commands as a fleet
+# datagram for all the devices. The legacy and fleet frames address a LED, the lamp of
+# the journal is translated with the compiled LAMPS_CONNECTIONS of src, a hardware map
+# that changes them is not known by the tool. The button and scheduler entries are not
+# replayed, they are not network traffic.
+#
+# The report gives, for each source, the processing time recorded by the lamp in its
+# own journal for the replayed commands and the round trip seen by the host for the
+# commands that have one: the legacy ones until the lamp closes the connection and the
+# sequenced ones until their acknowledgement. The group and fleet commands have no
+# reply, with speed 0 they are sent one after other.
+
+import os
+import random
+import re
+import socket
+import struct
+import sys
+import time
+
+# Format of the frames and the journal, it must match TCP_server.h, Journal.h and
+# Lamp.h.
+EXT_FRAME_START_BYTE = 0xA5
+EXT_FRAME_HEADER = struct.Struct("<BBB")
+EXT_FRAME_GROUP_COMMAND = 0
+EXT_FRAME_GET_JOURNAL = 2
+EXT_FRAME_SEQ_COMMAND = 10
+JOURNAL_DUMP_HEADER = struct.Struct("<IIB")
+JOURNAL_ENTRY = struct.Struct("<IIHBBBB")
+SEQ_COMMAND = struct.Struct("<HHBBB")
+SEQ_REPLY = struct.Struct("<HBBB")
+GROUP_COMMAND = struct.Struct("<BBB")
+LAMP_SEQ_ACK = 0
+
+# Legacy frame, TCP_COMMAND_TYPE of the WiFi module: the LED and the action are 32 bits
+# enumerates and the duty cycle a byte, padded to 4 bytes.
+LEGACY_COMMAND = struct.Struct("<IIB3x")
+
+# Fleet datagram, Fleet_datagram_header and Fleet_command of TCP_server.h. The command
+# is sent to every device identifier.
+FLEET_UDP_PORT = 3339
+FLEET_MAGIC = 0x4C464C54
+FLEET_HEADER = struct.Struct("<IB")
+FLEET_COMMAND = struct.Struct("<HHBBB")
+FLEET_ALL_DEVICES = (0, 0xFFFF)
+
+# Values of Journal_source.
+SOURCES = ("tcp_legacy", "tcp_group", "button", "scheduler", "udp_fleet", "tcp_seq")
+SOURCE_TCP_LEGACY = 0
+SOURCE_TCP_GROUP = 1
+SOURCE_UDP_FLEET = 4
+SOURCE_TCP_SEQ = 5
+REPLAYED_SOURCES = (SOURCE_TCP_LEGACY, SOURCE_TCP_GROUP, SOURCE_UDP_FLEET,
+                    SOURCE_TCP_SEQ)
+
+# Values of Lamp_action.
+ACTIONS = ("toggle", "set_pwm", "set_on", "set_off")
+
+# Actions of the legacy and fleet frames, TOOGLE_LED and SET_PWM, by Lamp_action.
+LEGACY_ACTIONS = {0: 0, 1: 1}
+
+# Sources of the compiled connections of the lamps.
+SOURCES_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir, "src")
+LIGHTS_HEADER = os.path.join("Core", "System_config", "System_lights.h")
+LAMP_HEADER = os.path.join("Core", "Lamp", "Lamp.h")
+
+
+def receive_exactly(sock, size):
+  data = b""
+  while len(data) < size:
+    chunk = sock.recv(size - len(data))
+    if not chunk:
+      raise ConnectionError("The lamp closed the connection.")
+    data += chunk
+  return data
+
+
+def request(sock, frame_type, payload):
+  # Sends an extended frame and returns the payload of its reply, the state events of
+  # a subscription are skipped.
+  sock.sendall(EXT_FRAME_HEADER.pack(EXT_FRAME_START_BYTE, frame_type, len(payload)) +
+               payload)
+  while True:
+    start, reply_type, length = EXT_FRAME_HEADER.unpack(
+      receive_exactly(sock, EXT_FRAME_HEADER.size))
+    reply = receive_exactly(sock, length)
+    if start != EXT_FRAME_START_BYTE:
+      raise ConnectionError("Invalid reply.")
+    if reply_type == frame_type:
+      return reply
+
+
+def read_journal(sock, first_seq):
+  # Reads the journal in pages, it returns the entries and the next sequence number.
+  entries = []
+  seq = first_seq
+  while True:
+    dump = request(sock, EXT_FRAME_GET_JOURNAL, struct.pack("<I", seq))
+    page_seq, next_seq, num_of_entries = JOURNAL_DUMP_HEADER.unpack_from(dump)
+    if page_seq != seq and seq != first_seq:
+      print("%d entries were overwritten while dumping." % (page_seq - seq))
+    for i in range(num_of_entries):
+      entries.append(JOURNAL_ENTRY.unpack_from(dump, JOURNAL_DUMP_HEADER.size +
+                                               i * JOURNAL_ENTRY.size))
+    if num_of_entries == 0:
+      return entries, next_seq
+    seq = next_seq
+
+
+def load(path):
+  with open(path, "rb") as journal_file:
+    blob = journal_file.read()
+  if len(blob) % JOURNAL_ENTRY.size != 0:
+    sys.exit("%s is not a journal." % path)
+  return [JOURNAL_ENTRY.unpack_from(blob, offset)
+          for offset in range(0, len(blob), JOURNAL_ENTRY.size)]
+
+
+def dump(host, port, path):
+  with socket.create_connection((host, port), timeout=5) as sock:
+    entries, _ = read_journal(sock, 0)
+  with open(path, "wb") as journal_file:
+    for entry in entries:
+      journal_file.write(JOURNAL_ENTRY.pack(*entry))
+  print("%d entries saved in %s." % (len(entries), path))
+
+
+def show(path):
+  entries = load(path)
+  first_us = entries[0][0] if entries else 0
+  for time_us, client_IP, processing_us, source, target, action, pwm in entries:
+    print("%10.3f ms  %-10s %-15s target %3d  %-8s pwm %3d  %5d us" %
+          (((time_us - first_us) & 0xFFFFFFFF) / 1000.0,
+           SOURCES[source] if source < len(SOURCES) else source,
+           socket.inet_ntoa(struct.pack("<I", client_IP)), target,
+           ACTIONS[action] if action < len(ACTIONS) else action, pwm, processing_us))
+  print("%d entries." % len(entries))
+
+
+def percentiles(name, values):
+  if not values:
+    print("%-22s no samples" % name)
+    return
+  values = sorted(values)
+  print("%-22s n %5d  mean %8.1f  p50 %8.1f  p99 %8.1f  max %8.1f" %
+        (name, len(values), sum(values) / len(values), values[len(values) // 2],
+         values[max(0, (len(values) * 99) // 100 - 1)], values[-1]))
+
+
+def lamps_LEDs():
+  # Returns the LED of every lamp in the compiled LAMPS_CONNECTIONS.
+  text = ""
+  for header in (LIGHTS_HEADER, LAMP_HEADER):
+    with open(os.path.join(SOURCES_DIR, header)) as source:
+      text += source.read().replace("\\\n", " ")
+
+  def names(macro):
+    return [name for name in re.findall(r"\b%s\((\w+)\)" % macro, text)
+            if name != "enumerate"]
+
+  LEDs = {name: ID for ID, name in enumerate(names("LED"))}
+  lamps = {name: ID for ID, name in enumerate(names("LAMP"))}
+  return {lamps[lamp]: LEDs[LED]
+          for lamp, _, LED in re.findall(r"\bLAMP_CONNECTION\((\w+),\s*(\w+),\s*(\w+)\)",
+                                         text)
+          if lamp in lamps and LED in LEDs}
+
+
+def send_legacy(host, port, LED, action, pwm):
+  # Sends a legacy frame on a new connection and waits until the lamp closes it.
+  with socket.create_connection((host, port), timeout=5) as sock:
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    sock.sendall(LEGACY_COMMAND.pack(LED, action, pwm))
+    while sock.recv(64):
+      pass
+
+
+def replay(path, host, port, speed):
+  commands = [entry for entry in load(path) if entry[3] in REPLAYED_SOURCES]
+  if not commands:
+    sys.exit("The journal has no network commands.")
+  LEDs = lamps_LEDs()
+
+  round_trips_us = {source: [] for source in REPLAYED_SOURCES}
+  late_us = []
+  naks = 0
+  skipped = 0
+  seq = random.randint(0, 0xFFFF)
+  # Every replay is a new session, so the lamp does not compare its sequence numbers
+  # with the ones of a previous replay.
+  session = random.randint(0, 0xFFFF)
+
+  with socket.create_connection((host, port), timeout=5) as sock, \
+       socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as fleet_sock:
+    sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    _, first_lamp_seq = read_journal(sock, 0)
+    client_IP = struct.unpack("<I", socket.inet_aton(sock.getsockname()[0]))[0]
+
+    first_us = commands[0][0]
+    start = time.perf_counter()
+    for time_us, _, _, source, target, action, pwm in commands:
+      # The legacy and fleet frames only carry a LED and their own actions.
+      if source in (SOURCE_TCP_LEGACY, SOURCE_UDP_FLEET) and (
+         target not in LEDs or action not in LEGACY_ACTIONS):
+        skipped += 1
+        continue
+
+      if speed > 0:
+        due = start + ((time_us - first_us) & 0xFFFFFFFF) / 1e6 / speed
+        now = time.perf_counter()
+        if due > now:
+          time.sleep(due - now)
+        else:
+          late_us.append((now - due) * 1e6)
+
+      sent = time.perf_counter()
+      if source == SOURCE_TCP_LEGACY:
+        send_legacy(host, port, LEDs[target], LEGACY_ACTIONS[action], pwm)
+      elif source == SOURCE_TCP_GROUP:
+        sock.sendall(EXT_FRAME_HEADER.pack(EXT_FRAME_START_BYTE, EXT_FRAME_GROUP_COMMAND,
+                                           GROUP_COMMAND.size) +
+                     GROUP_COMMAND.pack(target, action, pwm))
+        continue
+      elif source == SOURCE_UDP_FLEET:
+        fleet_sock.sendto(FLEET_HEADER.pack(FLEET_MAGIC, 1) +
+                          FLEET_COMMAND.pack(*FLEET_ALL_DEVICES, LEDs[target],
+                                             LEGACY_ACTIONS[action], pwm),
+                          (host, FLEET_UDP_PORT))
+        continue
+      else:
+        reply = request(sock, EXT_FRAME_SEQ_COMMAND,
+                        SEQ_COMMAND.pack(seq, session, target, action, pwm))
+        if SEQ_REPLY.unpack(reply)[1] != LAMP_SEQ_ACK:
+          naks += 1
+        seq = (seq + 1) & 0xFFFF
+      round_trips_us[source].append((time.perf_counter() - sent) * 1e6)
+    elapsed = time.perf_counter() - start
+
+    # The dump is answered after the frames sent before it, the fleet datagrams go
+    # through other socket and may still be queued.
+    time.sleep(0.1)
+    replayed, _ = read_journal(sock, first_lamp_seq)
+
+  print("%d commands replayed in %.3f s at speed %s, %d skipped, %d NAKs." %
+        (len(commands) - skipped, elapsed, speed if speed > 0 else "max", skipped, naks))
+  for source in REPLAYED_SOURCES:
+    sent = sum(1 for entry in commands if entry[3] == source)
+    if sent == 0:
+      continue
+    print("%s:" % SOURCES[source])
+    percentiles("  lamp processing (us)", [entry[2] for entry in replayed
+                                          if entry[3] == source and
+                                          entry[1] == client_IP])
+    if source in (SOURCE_TCP_LEGACY, SOURCE_TCP_SEQ):
+      percentiles("  round trip (us)", round_trips_us[source])
+  if speed > 0:
+    percentiles("sent late (us)", late_us)
+
+
+if __name__ == "__main__":
+  if len(sys.argv) == 5 and sys.argv[1] == "dump":
+    dump(sys.argv[2], int(sys.argv[3]), sys.argv[4])
+  elif len(sys.argv) == 3 and sys.argv[1] == "show":
+    show(sys.argv[2])
+  elif len(sys.argv) in (5, 6) and sys.argv[1] == "replay":
+    replay(sys.argv[2], sys.argv[3], int(sys.argv[4]),
+           float(sys.argv[5]) if len(sys.argv) == 6 else 1.0)
+  else:
+    sys.exit("usage: journal_replay.py dump <host> <port> <journal.bin> | "
+             "show <journal.bin> | replay <journal.bin> <host> <port> [<speed>]")
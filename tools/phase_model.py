@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+#
+# @file      phase_model.py
+# @authors   Álvaro Velasco García
+# @date      October 18, 2026
+#
+# @brief     Host model of the phase staggering of the LEDs that share a LEDC timer
+#            (stagger_hpoints and model_phase_profile, src/BSP/LED/LED.c). It reports
+#            the supply current profile along the PWM period with all the channels
+#            aligned at hpoint 0 and with the staggered hpoints.
+#
+# Usage:
+#
+#   phase_model.py profile <resolution> <current_mA> <duty%> [<duty%> ...]
+#       Profile of one set of duty cycles of the channels of a timer.
+#
+#   phase_model.py sweep <resolution> <current_mA> <channels> [<sets>]
+#       Peak current of random sets of duty cycles, 1000 sets by default.
+#
+# The current is the one of a single channel while it is on, all the channels of a
+# timer drive the same kind of LED.
+
+import random
+import sys
+
+# Duty cycle limits in percentage, they must match System_lights.h.
+MIN_DUTY_CYCLE_PERC = 20
+MAX_DUTY_CYCLE_PERC = 100
+
+
+def duty_in_steps(resolution, percentage):
+  # Same clamp and conversion than cacl_pwm_duty, 0 is a LED turned off.
+  if percentage == 0:
+    return 0
+  percentage = min(max(percentage, MIN_DUTY_CYCLE_PERC), MAX_DUTY_CYCLE_PERC)
+  return int(((1 << resolution) - 1) * (percentage / 100.0))
+
+
+def stagger_hpoints(duties, period):
+  # First fit decreasing, each lane is a period that on-times fill one after other.
+  hpoints = [0] * len(duties)
+  lanes_end = []
+  for channel in sorted(range(len(duties)), key=lambda i: -duties[i]):
+    if duties[channel] == 0:
+      continue
+    lane = 0
+    while lane < len(lanes_end) and lanes_end[lane] + duties[channel] > period:
+      lane += 1
+    if lane == len(lanes_end):
+      lanes_end.append(0)
+    hpoints[channel] = lanes_end[lane]
+    lanes_end[lane] += duties[channel]
+  return hpoints
+
+
+def phase_profile(duties, hpoints, period):
+  # Time of the period spent with N channels on, and the maximum N.
+  edges = []
+  for duty, hpoint in zip(duties, hpoints):
+    if duty == 0:
+      continue
+    edges.append((hpoint, 1))
+    edges.append((min(hpoint + duty, period), -1))
+  # Turn offs first, so touching on-times do not overlap.
+  edges.sort(key=lambda edge: (edge[0], edge[1]))
+
+  on_time = [0] * (len(duties) + 1)
+  last_time = 0
+  channels_on = 0
+  peak = 0
+  for time, step in edges:
+    on_time[channels_on] += time - last_time
+    last_time = time
+    channels_on += step
+    peak = max(peak, channels_on)
+  on_time[channels_on] += period - last_time
+  return peak, on_time
+
+
+def report(resolution, current_ma, percentages):
+  period = 1 << resolution
+  duties = [duty_in_steps(resolution, percentage) for percentage in percentages]
+  average_ma = current_ma * sum(duties) / period
+
+  for name, hpoints in (("aligned", [0] * len(duties)),
+                        ("staggered", stagger_hpoints(duties, period))):
+    peak, on_time = phase_profile(duties, hpoints, period)
+    print("%-9s peak %3d channels %8.1f mA  average %8.1f mA  hpoints %s" %
+          (name, peak, peak * current_ma, average_ma, hpoints))
+    for channels, time in enumerate(on_time):
+      if time:
+        print("            %3d on  %5.1f %% of the period" %
+              (channels, 100.0 * time / period))
+
+
+def sweep(resolution, current_ma, channels, sets):
+  period = 1 << resolution
+  aligned = []
+  staggered = []
+  for _ in range(sets):
+    percentages = [random.randint(0, 100) for _ in range(channels)]
+    duties = [duty_in_steps(resolution, percentage) for percentage in percentages]
+    aligned.append(phase_profile(duties, [0] * channels, period)[0])
+    staggered.append(phase_profile(duties, stagger_hpoints(duties, period), period)[0])
+
+  for name, peaks in (("aligned", aligned), ("staggered", staggered)):
+    peaks.sort()
+    print("%-9s peak mean %8.1f mA  p99 %8.1f mA  max %8.1f mA" %
+          (name, current_ma * sum(peaks) / sets,
+           current_ma * peaks[(sets * 99) // 100 - 1], current_ma * peaks[-1]))
+  print("%d sets of %d channels at %d bits." % (sets, channels, resolution))
+
+
+if __name__ == "__main__":
+  try:
+    if len(sys.argv) >= 5 and sys.argv[1] == "profile":
+      report(int(sys.argv[2]), float(sys.argv[3]), [int(arg) for arg in sys.argv[4:]])
+    elif len(sys.argv) in (5, 6) and sys.argv[1] == "sweep":
+      random.seed(0)
+      sweep(int(sys.argv[2]), float(sys.argv[3]), int(sys.argv[4]),
+            int(sys.argv[5]) if len(sys.argv) == 6 else 1000)
+    else:
+      raise ValueError
+  except ValueError:
+    sys.exit("usage: phase_model.py profile <resolution> <current_mA> <duty%>... | "
+             "sweep <resolution> <current_mA> <channels> [<sets>]")
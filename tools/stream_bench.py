@@ -0,0 +1,269 @@
+#!/usr/bin/env python3
+#
+# @file      stream_bench.py
+# @authors   Álvaro Velasco García
+# @date      October 18, 2026
+#
+# @brief     Host benchmark of the encodings of the stream frames (src/Core/Stream). It
+#            encodes effect traces with every encoding and reports the bytes on air and
+#            the decode cost of each one against the full frames.
+#
+# Usage:
+#
+#   stream_bench.py [<channels>] [<seconds>] [<key_interval>]
+#       8 channels, 10 seconds at the tick rate and a frame that changes all the
+#       channels every 60 frames by default, so a lost frame only breaks one second.
+#
+# The decode cost is measured with decode_stream_frame itself, taken from Stream.c and
+# compiled for the host with gcc. The absolute times are the ones of the host CPU, only
+# the ratio against the full frames is meaningful for the lamp. Without gcc only the
+# bytes are reported.
+#
+# The bytes on air are the ones of the 802.11 data frame: the stream frame plus the
+# UDP, IPv4, LLC/SNAP and MAC headers and the FCS, without the PHY preamble.
+
+import math
+import os
+import random
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+
+# Format of the frames, it must match Stream.h.
+STREAM_MAGIC = 0x4C535452
+HEADER = struct.Struct("<IIqBB")
+STREAM_MAX_CHANNELS = 32
+STREAM_RLE_KEEP = 0xFF
+STREAM_TICK_US = 16667
+ENCODINGS = ("full", "delta", "rle")
+
+# MAC header, LLC/SNAP, IPv4, UDP and FCS of every datagram.
+AIR_OVERHEAD = 24 + 8 + 20 + 8 + 4
+
+SOURCE_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "src",
+                          "Core", "Stream")
+
+
+def trace_static(channels, frames):
+  # A scene that changes every 5 seconds, as a cue list.
+  scene = [0] * channels
+  for frame in range(frames):
+    if frame % 300 == 0:
+      scene = [random.randint(0, 100) for _ in range(channels)]
+    yield list(scene)
+
+
+def trace_fade(channels, frames):
+  # All the channels fade together from 0 to 100 and back in 3 seconds.
+  for frame in range(frames):
+    phase = (frame % 360) / 180.0
+    level = round(100 * (phase if phase <= 1.0 else 2.0 - phase))
+    yield [level] * channels
+
+
+def trace_wave(channels, frames):
+  # A sine wave that runs along the channels once per second.
+  for frame in range(frames):
+    yield [round(50 + 50 * math.sin(2 * math.pi * (frame / 60.0 - channel / channels)))
+           for channel in range(channels)]
+
+
+def trace_chase(channels, frames):
+  # A single lit channel that moves every 4 frames.
+  for frame in range(frames):
+    levels = [0] * channels
+    levels[(frame // 4) % channels] = 100
+    yield levels
+
+
+def trace_sparkle(channels, frames):
+  # Two random channels flash every frame and every lit channel decays.
+  levels = [0] * channels
+  for _ in range(frames):
+    levels = [max(0, level - 10) for level in levels]
+    for channel in random.sample(range(channels), min(2, channels)):
+      levels[channel] = 100
+    yield list(levels)
+
+
+def trace_strobe(channels, frames):
+  # All the channels on for 3 frames and off for 3.
+  for frame in range(frames):
+    yield [100 if (frame // 3) % 2 == 0 else 0] * channels
+
+
+TRACES = (("static", trace_static), ("fade", trace_fade), ("wave", trace_wave),
+          ("chase", trace_chase), ("sparkle", trace_sparkle), ("strobe", trace_strobe))
+
+
+def encode(encoding, levels, previous):
+  # Payload of a frame, previous is None in the frames that must change all channels.
+  changed = [previous is None or level != old
+             for level, old in zip(levels, previous or levels)]
+  if encoding == "full":
+    return bytes(levels)
+  if encoding == "delta":
+    bitmap = sum(1 << channel for channel, change in enumerate(changed) if change)
+    return struct.pack("<I", bitmap) + bytes(level for level, change
+                                             in zip(levels, changed) if change)
+  # The unchanged channels are sent as runs of STREAM_RLE_KEEP.
+  values = [level if change else STREAM_RLE_KEEP
+            for level, change in zip(levels, changed)]
+  payload = b""
+  start = 0
+  for channel in range(1, len(values) + 1):
+    if channel == len(values) or values[channel] != values[start]:
+      payload += bytes((channel - start, values[start]))
+      start = channel
+  return payload
+
+
+def encode_trace(trace, channels, frames, key_interval):
+  # Frames of every encoding, and of the smallest one per frame as a sender would do.
+  encoded = {encoding: [] for encoding in ENCODINGS + ("best",)}
+  previous = None
+  for seq, levels in enumerate(trace(channels, frames)):
+    key = (seq % key_interval == 0)
+    payloads = {}
+    for index, encoding in enumerate(ENCODINGS):
+      payloads[encoding] = (index, encode(encoding, levels, None if key else previous))
+      encoded[encoding].append(payloads[encoding])
+    encoded["best"].append(min(payloads.values(), key=lambda item: len(item[1])))
+    previous = levels
+  return encoded
+
+
+HARNESS = r"""
+#include <Stream.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+%(defines)s
+
+%(slot)s
+
+static uint8_t stream_levels[STREAM_MAX_CHANNELS];
+
+%(decode)s
+
+int main(int argc, char **argv)
+{
+  /* Frames of the file: number of channels, encoding, size and payload. */
+  static stream_slot frames[1u << 16u];
+  uint32_t num_of_frames = 0u;
+  FILE *file = fopen(argv[1], "rb");
+  uint8_t head[3];
+  while(fread(head, 1u, 3u, file) == 3u)
+  {
+    frames[num_of_frames].num_of_channels = head[0];
+    frames[num_of_frames].encoding = head[1];
+    if(fread(frames[num_of_frames].payload, 1u, head[2], file) != head[2])
+    {
+      return 1;
+    }
+    num_of_frames++;
+  }
+  fclose(file);
+
+  const uint32_t repetitions = (uint32_t)atoi(argv[2]);
+  uint32_t channels = 0u;
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for(uint32_t r = 0u; r < repetitions; r++)
+  {
+    for(uint32_t i = 0u; i < num_of_frames; i++)
+    {
+      channels ^= decode_stream_frame(&frames[i]);
+      __asm__ volatile("" ::: "memory");
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  const double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+  printf("%%.2f %%u\n", ns / ((double)repetitions * num_of_frames), channels);
+  return 0;
+}
+"""
+
+
+def build_harness(directory):
+  # Takes the private definitions and the decoder of Stream.c as they are.
+  with open(os.path.join(SOURCE_DIR, "Stream.c")) as source_file:
+    source = source_file.read()
+  defines = "\n".join(re.findall(r"^#define STREAM_(?:DELTA_BITMAP_SIZE|CHANNELS_MASK)"
+                                 r"\b.*$", source, re.M))
+  slot = re.search(r"^typedef struct\n\{\n(?:.*\n)*?\} stream_slot;", source, re.M)
+  decode = re.search(r"^static uint32_t decode_stream_frame\(const stream_slot \*frame\)"
+                     r"\n\{\n(?:.*\n)*?\}\n", source, re.M)
+  if not defines or not slot or not decode:
+    return None
+
+  harness = os.path.join(directory, "harness.c")
+  with open(harness, "w") as harness_file:
+    harness_file.write(HARNESS % {"defines": defines, "slot": slot.group(0),
+                                  "decode": decode.group(0)})
+  binary = os.path.join(directory, "harness")
+  try:
+    subprocess.run(["gcc", "-O2", "-std=gnu11", "-I", SOURCE_DIR, "-o", binary, harness],
+                   check=True, capture_output=True)
+  except (OSError, subprocess.CalledProcessError):
+    return None
+  return binary
+
+
+def decode_ns(binary, directory, channels, frames):
+  path = os.path.join(directory, "frames.bin")
+  with open(path, "wb") as frames_file:
+    for index, payload in frames:
+      frames_file.write(bytes((channels, index, len(payload))) + payload)
+  repetitions = max(1, 2000000 // len(frames))
+  output = subprocess.run([binary, path, str(repetitions)], check=True,
+                          capture_output=True, text=True).stdout
+  return float(output.split()[0])
+
+
+def main(channels, seconds, key_interval):
+  random.seed(0)
+  frames = int(seconds * 1e6 / STREAM_TICK_US)
+  with tempfile.TemporaryDirectory() as directory:
+    binary = build_harness(directory)
+    if binary is None:
+      print("gcc or the decoder of Stream.c is not available, only bytes are reported.")
+
+    print("%d channels, %d frames, a key frame every %d.\n" %
+          (channels, frames, key_interval))
+    print("%-8s %-6s %9s %9s %7s %9s %7s" %
+          ("trace", "enc", "payload B", "air B", "air %", "decode ns", "cost %"))
+    for name, trace in TRACES:
+      encoded = encode_trace(trace, channels, frames, key_interval)
+      full_air = None
+      full_ns = None
+      for encoding in ENCODINGS + ("best",):
+        payload = sum(len(payload) for _, payload in encoded[encoding]) / frames
+        air = payload + HEADER.size + AIR_OVERHEAD
+        full_air = full_air or air
+        line = "%-8s %-6s %9.1f %9.1f %6.1f%%" % (name, encoding, payload, air,
+                                                  100.0 * air / full_air)
+        if binary is not None:
+          ns = decode_ns(binary, directory, channels, encoded[encoding])
+          full_ns = full_ns or ns
+          line += " %9.2f %6.1f%%" % (ns, 100.0 * ns / full_ns)
+        print(line)
+  return 0
+
+
+if __name__ == "__main__":
+  try:
+    args = [int(arg) for arg in sys.argv[1:]]
+    if len(args) > 3:
+      raise ValueError
+    args += [8, 10, 60][len(args):]
+    if not 1 <= args[0] <= STREAM_MAX_CHANNELS or args[1] < 1 or args[2] < 1:
+      raise ValueError
+    sys.exit(main(*args))
+  except ValueError:
+    sys.exit("usage: stream_bench.py [<channels>] [<seconds>] [<key_interval>]")
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+#
+# @file      task_plan_model.py
+# @authors   Álvaro Velasco García
+# @date      October 18, 2026
+#
+# @brief     Host model of the task plan of src/Core/System_config/System_tasks.h. It
+#            simulates the fixed priority scheduler of the two cores with the tasks of
+#            the plan and of the baseline (SYSTEM_TASKS_PLAN_ENABLE=0 with
+#            sdkconfig.baseline) under a flood of command frames, and reports the
+#            latency of the button, of the timers and of the commands. The plan is
+#            simulated with the server task and with the raw ingress
+#            (TCP_SERVER_RAW_INGRESS_ENABLE=1), where the ingress task dispatches the
+#            commands in the lighting core.
+#
+# Usage:
+#
+#   task_plan_model.py [<flood_hz>] [<seconds>]
+#       Command frames per second of the flood, 0 and 4000 by default, and simulated
+#       seconds, 5 by default.
+#
+# The cost of every job is an estimate of the work of the firmware on the ESP32, not a
+# measurement, so the model compares the plan with the baseline and does not predict
+# the absolute latencies. The button latency of the lamp is measured on the device
+# with EXT_FRAME_GET_BUTTON_STATS. The model has no locks, no cache effects and no
+# time slicing between tasks of the same priority, the first one ready runs first.
+
+import heapq
+import random
+import sys
+
+# Priorities of ESP-IDF, configMAX_PRIORITIES is 25.
+MAX_PRIORITIES = 25
+ESP_TASK_TIMER_PRIO = MAX_PRIORITIES - 3
+ANY = (0, 1)
+
+# Rows of the model: name, plan priority and cores, baseline priority and cores. The
+# WiFi, lwIP and esp_timer tasks take their affinity from sdkconfig.defaults and
+# sdkconfig.baseline.
+TASKS = (
+  ("wifi",      23, (0,), 23, (0,)),
+  ("lwip",      18, (0,), 18, ANY),
+  ("esp_timer", ESP_TASK_TIMER_PRIO, (1,), ESP_TASK_TIMER_PRIO, (0,)),
+  ("lamp",      MAX_PRIORITIES - 1, (1,), MAX_PRIORITIES - 1, ANY),
+  ("scheduler", MAX_PRIORITIES - 2, (1,), MAX_PRIORITIES - 2, ANY),
+  ("dmx",       MAX_PRIORITIES - 2, (1,), MAX_PRIORITIES - 2, ANY),
+  ("stream_present", MAX_PRIORITIES - 2, (1,), MAX_PRIORITIES - 2, ANY),
+  ("ingress",   ESP_TASK_TIMER_PRIO - 1, (1,), MAX_PRIORITIES - 1, ANY),
+  ("stream",    7,  (0,), MAX_PRIORITIES - 2, ANY),
+  ("time_sync", 6,  (0,), MAX_PRIORITIES - 2, ANY),
+  ("server",    5,  (0,), MAX_PRIORITIES - 1, ANY),
+  ("fleet",     5,  (0,), MAX_PRIORITIES - 1, ANY),
+  ("httpd",     4,  (0,), 5, ANY),
+)
+
+# Cost in microseconds of the jobs.
+WIFI_RX_US = 25
+LWIP_RX_US = 50
+SERVER_COMMAND_US = 120
+INGRESS_COMMAND_US = 100
+FLEET_DATAGRAM_US = 150
+TIME_SYNC_EXCHANGE_US = 30
+DMX_UNIVERSE_US = 60
+SCHEDULER_CUE_US = 40
+SCHEDULER_TICK_US = 5
+STREAM_FRAME_US = 30
+LAMP_BUTTON_US = 40
+DITHER_TICK_US = 6
+STREAM_TICK_US = 10
+STREAM_PRESENT_US = 60
+GUI_PUSH_US = 200
+
+# Periods in microseconds of the periodic work.
+DITHER_PERIOD_US = 500
+STREAM_PERIOD_US = 16667
+GUI_PERIOD_US = 100000
+DMX_PERIOD_US = 22727
+FLEET_PERIOD_US = 100000
+SCHEDULER_PERIOD_US = 50000
+TIME_SYNC_PERIOD_US = 1000000
+
+# Frames that the lwIP mailbox holds, the rest are dropped.
+LWIP_MBOX_SIZE = 32
+
+
+class Task:
+
+  def __init__(self, name, priority, cores):
+    self.name = name
+    self.priority = priority
+    self.cores = cores
+    self.jobs = []
+    self.core = None
+    self.last_core = cores[0]
+
+
+def simulate(plan, flood_hz, seconds, raw=False):
+  random.seed(0)
+  tasks = {row[0]: Task(row[0], row[1] if plan else row[3], row[2] if plan else row[4])
+           for row in TASKS}
+  end_us = int(seconds * 1e6)
+
+  # Releases: time, order, task, cost, kind, time of the origin of the job.
+  releases = []
+  order = [0]
+
+  def release(time_us, task, cost_us, kind, origin_us=None):
+    order[0] += 1
+    heapq.heappush(releases, (time_us, order[0], task, cost_us, kind,
+                              time_us if origin_us is None else origin_us))
+
+  for time_us in range(0, end_us, DITHER_PERIOD_US):
+    release(time_us, "esp_timer", DITHER_TICK_US, "tick")
+  for time_us in range(0, end_us, STREAM_PERIOD_US):
+    release(time_us, "esp_timer", STREAM_TICK_US, "select")
+    release(time_us + random.randint(0, 2000), "wifi", WIFI_RX_US, "stream")
+  for time_us in range(0, end_us, GUI_PERIOD_US):
+    release(time_us, "httpd", GUI_PUSH_US, "gui")
+  for time_us in range(0, end_us, DMX_PERIOD_US):
+    release(time_us + random.randint(0, 2000), "wifi", WIFI_RX_US, "dmx")
+  for time_us in range(0, end_us, FLEET_PERIOD_US):
+    release(time_us + random.randint(0, 2000), "wifi", WIFI_RX_US, "fleet")
+  for time_us in range(0, end_us, TIME_SYNC_PERIOD_US):
+    release(time_us + random.randint(0, 2000), "wifi", WIFI_RX_US, "sync")
+  for time_us in range(0, end_us, SCHEDULER_PERIOD_US):
+    release(time_us, "esp_timer", SCHEDULER_TICK_US, "cue")
+  time_us = 0
+  while time_us < end_us:
+    time_us += random.randint(10000, 30000)
+    release(time_us, "lamp", LAMP_BUTTON_US, "button")
+  if flood_hz > 0:
+    time_us = 0.0
+    while time_us < end_us:
+      time_us += random.expovariate(flood_hz / 1e6)
+      release(int(time_us), "wifi", WIFI_RX_US, "command")
+
+  latencies = {"button": [], "tick": [], "command": []}
+  dropped = 0
+  now_us = 0
+  while now_us < end_us:
+    while releases and releases[0][0] <= now_us:
+      _, _, name, cost_us, kind, origin_us = heapq.heappop(releases)
+      task = tasks[name]
+      if name == "lwip" and len(task.jobs) >= LWIP_MBOX_SIZE:
+        dropped += 1
+        continue
+      task.jobs.append([cost_us, kind, origin_us])
+
+    # The highest priority ready tasks take the cores they can run in, the first ready
+    # first among the same priority.
+    for task in tasks.values():
+      task.core = None
+    free = set((0, 1))
+    ready = sorted((task for task in tasks.values() if task.jobs),
+                   key=lambda task: (-task.priority, task.jobs[0][2]))
+    for task in ready:
+      allowed = [core for core in task.cores if core in free]
+      if allowed:
+        task.core = task.last_core if task.last_core in allowed else allowed[0]
+        task.last_core = task.core
+        free.discard(task.core)
+
+    running = [task for task in tasks.values() if task.core is not None]
+    next_us = releases[0][0] if releases else end_us
+    if running:
+      next_us = min(next_us, now_us + min(task.jobs[0][0] for task in running))
+    step_us = max(1, next_us - now_us)
+
+    for task in running:
+      job = task.jobs[0]
+      job[0] -= step_us
+      if job[0] > 0:
+        continue
+      task.jobs.pop(0)
+      cost_us, kind, origin_us = job
+      done_us = now_us + step_us
+      if task.name == "wifi":
+        release(done_us, "lwip", LWIP_RX_US, kind, origin_us)
+      elif task.name == "lwip":
+        if kind == "command" and raw:
+          release(done_us, "ingress", INGRESS_COMMAND_US, kind, origin_us)
+        elif kind == "command":
+          release(done_us, "server", SERVER_COMMAND_US, kind, origin_us)
+        elif kind == "dmx":
+          # The universe is parsed in the lwIP thread and applied by the DMX task.
+          release(done_us, "dmx", DMX_UNIVERSE_US, kind, origin_us)
+        elif kind == "fleet":
+          release(done_us, "fleet", FLEET_DATAGRAM_US, kind, origin_us)
+        elif kind == "sync":
+          release(done_us, "time_sync", TIME_SYNC_EXCHANGE_US, kind, origin_us)
+        else:
+          release(done_us, "stream", STREAM_FRAME_US, kind, origin_us)
+      elif kind == "cue":
+        latencies["tick"].append(done_us - origin_us)
+        release(done_us, "scheduler", SCHEDULER_CUE_US, "scheduler", origin_us)
+      elif kind == "select":
+        # The tick only selects the frames, the present task applies them.
+        latencies["tick"].append(done_us - origin_us)
+        release(done_us, "stream_present", STREAM_PRESENT_US, "present", origin_us)
+      elif kind in latencies:
+        latencies[kind].append(done_us - origin_us)
+    now_us += step_us
+
+  return latencies, dropped
+
+
+def percentiles(values):
+  if not values:
+    return "no samples"
+  values = sorted(values)
+  return "p50 %7d  p99 %7d  max %7d" % (values[len(values) // 2],
+                                         values[max(0, (len(values) * 99) // 100 - 1)],
+                                         values[-1])
+
+
+def main(floods, seconds):
+  for flood_hz in floods:
+    print("Flood of %d command frames per second, %d s:" % (flood_hz, seconds))
+    for plan, raw in ((False, False), (True, False), (True, True)):
+      latencies, dropped = simulate(plan, flood_hz, seconds, raw)
+      name = ("plan raw" if raw else "plan") if plan else "baseline"
+      print("  %-8s button  (us) %s" % (name, percentiles(latencies["button"])))
+      print("  %-8s timers  (us) %s" % ("", percentiles(latencies["tick"])))
+      print("  %-8s command (us) %s  done %d  dropped %d" %
+            ("", percentiles(latencies["command"]), len(latencies["command"]), dropped))
+  return 0
+
+
+if __name__ == "__main__":
+  try:
+    args = [int(arg) for arg in sys.argv[1:]]
+    if len(args) > 2:
+      raise ValueError
+    floods = args[:1] or [0, 4000]
+    sys.exit(main(floods, args[1] if len(args) == 2 else 5))
+  except ValueError:
+    sys.exit("usage: task_plan_model.py [<flood_hz>] [<seconds>]")
@@ -0,0 +1,237 @@
+#!/usr/bin/env python3
+#
+# @file      time_sync_loopback.py
+# @authors   Álvaro Velasco García
+# @date      October 18, 2026
+#
+# @brief     Host test of the clock synchronization (src/Core/Time_sync/Time_sync.c)
+#            with several nodes over the loopback interface. A master and the slaves run
+#            the protocol of the lamps, every node with its own clock offset and drift,
+#            and the test checks that all the slaves follow the master clock.
+#
+# Usage:
+#
+#   time_sync_loopback.py [<slaves>] [<rounds>] [<loss%>] [<jitter_us>] [<period_ms>]
+#       4 slaves, 40 rounds, no losses, no jitter and TIME_SYNC_PERIOD_MS by default.
+#       The losses drop requests and answers at random, the jitter delays the answers
+#       of the master a random time up to the given value, only in one direction.
+#
+# The slaves exchange every period, the filter, the drift estimation and the limits
+# are the ones of Time_sync.h, the drift of every slave is up to 50 ppm. The clocks
+# are read one period after the last exchange, when the offset is the oldest. The
+# test fails if a slave is not synchronized or its error against the master clock is
+# over the error bound that it reports, aged until the read, plus the error of the
+# clocks of the host, TOLERANCE_US.
+
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+# Protocol and filter, they must match Time_sync.h and Time_sync.c.
+TIME_SYNC_MAGIC = 0x4C545359
+PACKET = struct.Struct("<IIqqq")
+TIME_SYNC_PERIOD_MS = 1000
+TIME_SYNC_TIMEOUT_MS = 200
+TIME_SYNC_FILTER_SIZE = 8
+TIME_SYNC_MAX_DELAY_US = 50000
+TIME_SYNC_MAX_DRIFT_PPM = 100
+TIME_SYNC_DRIFT_INTERVAL_MS = 16000
+PPB = 10**9
+
+# Error in microseconds allowed over the bound of a slave, scheduling of the host.
+TOLERANCE_US = 100
+
+
+class Clock:
+  # Local clock of a node, the host clock with an offset and a drift.
+
+  def __init__(self, offset_us, drift_ppm):
+    self.offset_us = offset_us
+    self.drift_ppm = drift_ppm
+    self.start = time.perf_counter()
+
+  def now_us(self, host_time=None):
+    if host_time is None:
+      host_time = time.perf_counter()
+    elapsed_us = (host_time - self.start) * 1e6
+    return int(self.offset_us + elapsed_us * (1.0 + self.drift_ppm / 1e6))
+
+
+def serve_master(sock, clock, loss, jitter_us, stop):
+  # Same as serve_master of Time_sync.c.
+  sock.settimeout(0.1)
+  while not stop.is_set():
+    try:
+      data, source = sock.recvfrom(PACKET.size)
+    except socket.timeout:
+      continue
+    t2 = clock.now_us()
+    if len(data) != PACKET.size:
+      continue
+    magic, seq, t1, _, _ = PACKET.unpack(data)
+    if magic != TIME_SYNC_MAGIC or random.random() < loss:
+      continue
+    if jitter_us:
+      time.sleep(random.uniform(0, jitter_us) / 1e6)
+    sock.sendto(PACKET.pack(magic, seq, t1, t2, clock.now_us()), source)
+
+
+def divide(numerator, denominator):
+  # Integer division of C, it truncates towards 0.
+  quotient = abs(numerator) // abs(denominator)
+  return quotient if (numerator < 0) == (denominator < 0) else -quotient
+
+
+class Slave:
+  # Same as follow_master, filter_exchange and get_offset_us of Time_sync.c.
+
+  def __init__(self, clock, master_addr, loss):
+    self.clock = clock
+    self.master_addr = master_addr
+    self.loss = loss
+    self.exchanges = []
+    self.anchor = None
+    self.drift_error_ppb = TIME_SYNC_MAX_DRIFT_PPM * 1000
+    self.drift_ppb = 0
+    self.synced = False
+    self.offset_us = 0
+    self.offset_local_us = 0
+    self.error_us = 0
+    self.lost = 0
+
+  def run(self, rounds, period):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.settimeout(TIME_SYNC_TIMEOUT_MS / 1000.0)
+    for seq in range(1, rounds + 1):
+      t1 = self.clock.now_us()
+      if random.random() >= self.loss:
+        sock.sendto(PACKET.pack(TIME_SYNC_MAGIC, seq, t1, 0, 0), self.master_addr)
+      if not self.receive(sock, seq):
+        self.lost += 1
+      time.sleep(period)
+    sock.close()
+
+  def receive(self, sock, seq):
+    while True:
+      try:
+        data = sock.recv(PACKET.size)
+      except socket.timeout:
+        return False
+      t4 = self.clock.now_us()
+      if len(data) != PACKET.size:
+        continue
+      magic, answer_seq, t1, t2, t3 = PACKET.unpack(data)
+      if magic != TIME_SYNC_MAGIC or answer_seq != seq:
+        continue
+      delay_us = (t4 - t1) - (t3 - t2)
+      if delay_us < 0 or delay_us > TIME_SYNC_MAX_DELAY_US:
+        return False
+      self.filter_exchange(divide((t2 - t1) + (t3 - t4), 2), delay_us, t4)
+      return True
+
+  def filter_exchange(self, offset_us, delay_us, local_us):
+    self.exchanges = (self.exchanges +
+                      [(offset_us, delay_us, local_us)])[-TIME_SYNC_FILTER_SIZE:]
+    best, best_error_us = None, None
+    for exchange in self.exchanges:
+      error_us = (exchange[1] // 2 +
+                  -(-(local_us - exchange[2]) * self.drift_error_ppb // PPB))
+      if best is None or error_us < best_error_us:
+        best, best_error_us = exchange, error_us
+
+    if self.anchor is None:
+      self.anchor = best
+    elif best[2] - self.anchor[2] >= TIME_SYNC_DRIFT_INTERVAL_MS * 1000:
+      interval_us = best[2] - self.anchor[2]
+      max_drift_ppb = TIME_SYNC_MAX_DRIFT_PPM * 1000
+      measured_ppb = divide((best[0] - self.anchor[0]) * PPB, interval_us)
+      error_ppb = (best[1] + self.anchor[1]) // 2 * PPB // interval_us
+      measured_ppb = max(-max_drift_ppb, min(max_drift_ppb, measured_ppb))
+      if self.drift_error_ppb >= max_drift_ppb:
+        self.drift_ppb = measured_ppb
+        self.drift_error_ppb = min(error_ppb, self.drift_error_ppb)
+      else:
+        self.drift_ppb += divide(measured_ppb - self.drift_ppb, 4)
+        self.drift_error_ppb = (self.drift_error_ppb * 3 +
+                                min(error_ppb, self.drift_error_ppb)) // 4
+      self.anchor = best
+
+    self.offset_us = best[0] + divide((local_us - best[2]) * self.drift_ppb, PPB)
+    self.offset_local_us = local_us
+    self.error_us = best_error_us
+    self.synced = True
+
+  def synced_us(self, local_us):
+    return local_us + self.offset_us + divide(
+      (local_us - self.offset_local_us) * self.drift_ppb, PPB)
+
+  def bound_us(self, local_us):
+    # Error bound of the offset aged until the given time.
+    return self.error_us + (local_us - self.offset_local_us) * self.drift_error_ppb // PPB
+
+
+def main(num_of_slaves, rounds, loss, jitter_us, period_ms):
+  random.seed(0)
+  master_clock = Clock(random.randint(0, 10**9), 0.0)
+  master_sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+  master_sock.bind(("127.0.0.1", 0))
+  stop = threading.Event()
+  master = threading.Thread(target=serve_master,
+                            args=(master_sock, master_clock, loss, jitter_us, stop))
+  master.start()
+
+  slaves = [Slave(Clock(random.randint(0, 10**9), random.uniform(-50, 50)),
+                  master_sock.getsockname(), loss) for _ in range(num_of_slaves)]
+  threads = [threading.Thread(target=slave.run,
+                              args=(rounds, period_ms / 1000.0))
+             for slave in slaves]
+  for thread in threads:
+    thread.start()
+  for thread in threads:
+    thread.join()
+  stop.set()
+  master.join()
+  master_sock.close()
+
+  # Every slave reads its synchronized clock at the same host instant.
+  failed = 0
+  synced_us = []
+  host_time = time.perf_counter()
+  master_us = master_clock.now_us(host_time)
+  for i, slave in enumerate(slaves):
+    local_us = slave.clock.now_us(host_time)
+    error_us = slave.synced_us(local_us) - master_us
+    bound_us = slave.bound_us(local_us)
+    ok = slave.synced and abs(error_us) <= bound_us + TOLERANCE_US
+    failed += not ok
+    if slave.synced:
+      synced_us.append(error_us)
+    print("slave %d  drift %+6.1f ppm  estimated %+7.1f ppm  %-8s error %+7d us  "
+          "bound %5d us  lost %3d  %s" %
+          (i, slave.clock.drift_ppm, -slave.drift_ppb / 1000.0,
+           "synced" if slave.synced else "unsynced", error_us, bound_us, slave.lost,
+           "ok" if ok else "FAIL"))
+
+  if synced_us:
+    print("spread between slaves %d us." % (max(synced_us) - min(synced_us)))
+  print("%d slaves, %d rounds of %d ms, %.0f %% loss, %d us jitter: %s." %
+        (num_of_slaves, rounds, period_ms, loss * 100, jitter_us,
+         "FAIL" if failed else "ok"))
+  return 1 if failed else 0
+
+
+if __name__ == "__main__":
+  try:
+    args = [float(arg) for arg in sys.argv[1:]]
+    if len(args) > 5:
+      raise ValueError
+    defaults = [4, 40, 0, 0, TIME_SYNC_PERIOD_MS]
+    args += defaults[len(args):]
+    sys.exit(main(int(args[0]), int(args[1]), args[2] / 100.0, int(args[3]),
+                  int(args[4])))
+  except ValueError:
+    sys.exit("usage: time_sync_loopback.py [<slaves>] [<rounds>] [<loss%>] "
+             "[<jitter_us>] [<period_ms>]")